@@ -11,6 +11,8 @@
 #include "OpenGLContext.h"
 #include "OpenGLFramebuffer.h"
 #include "OpenGLUniformBuffer.h"
+#include "OpenGLStorageBuffer.h"
+#include "OpenGLComputeShader.h"
 
 namespace PetrolEngine {
     class OPENGL_: public RRC {
@@ -39,6 +41,15 @@ namespace PetrolEngine {
 
         Framebuffer* newFramebuffer(const FramebufferSpecification& spec) override { return new OpenGLFramebuffer(spec); }
 
+        // OpenGL only, not part of RRC
+        OpenGLStorageBuffer* newStorageBuffer(uint32_t size, uint32_t binding) { return new OpenGLStorageBuffer(size, binding); }
+        OpenGLComputeShader* newComputeShader(const String& name, const String& computeShader, const ShaderSpecialization& specialization = {}) { return new OpenGLComputeShader(name, computeShader, specialization); }
+
+        OpenGLShaderVariants* newShaderVariants(const String&           name,
+                                                const String&   vertexShader,
+                                                const String& fragmentShader,
+                                                const String& geometryShader = "") { return new OpenGLShaderVariants(name, vertexShader, fragmentShader, geometryShader); }
+
     };
 
     extern OPENGL_ OpenGL;
@@ -0,0 +1,152 @@
+#include <PCH.h>
+
+#include "OpenGLCapabilities.h"
+
+#include <cstdio>
+
+namespace PetrolEngine {
+    static OpenGLCapabilities capabilities;
+    static bool               detected = false;
+
+    static String getString(GLenum name) {
+        const GLubyte* value = glGetString(name);
+        return value ? String((const char*) value) : String();
+    }
+
+    static int32 getInteger(GLenum name) {
+        GLint value = 0;
+        glGetIntegerv(name, &value);
+        return (int32) value;
+    }
+
+    static bool contains(const String& text, const char* part) { return text.find(part) != String::npos; }
+
+    void OpenGLCapabilities::detect() { LOG_FUNCTION();
+        OpenGLCapabilities& c = capabilities;
+        c = {};
+
+        c.major    = GLVersion.major;
+        c.minor    = GLVersion.minor;
+        c.vendor   = getString(GL_VENDOR  );
+        c.renderer = getString(GL_RENDERER);
+        c.version  = getString(GL_VERSION );
+
+        // "4.50 NVIDIA ..." or "4.50"
+        int glslMajor = 0, glslMinor = 0;
+        if (std::sscanf(getString(GL_SHADING_LANGUAGE_VERSION).c_str(), "%d.%d", &glslMajor, &glslMinor) == 2)
+            c.glslVersion = glslMajor * 100 + glslMinor;
+
+        for (const char* name : { "llvmpipe", "softpipe", "SwiftShader", "Software Rasterizer", "GDI Generic", "Microsoft Basic Render" })
+            if (contains(c.renderer, name)) c.softwareRenderer = true;
+
+        c.directStateAccess     = GLAD_GL_VERSION_4_5 || GLAD_GL_ARB_direct_state_access;
+        c.bufferStorage         = GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+        c.textureStorage        = GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_texture_storage;
+        c.vertexAttribBinding   = GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_vertex_attrib_binding;
+        c.clearBufferObject     = GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_clear_buffer_object;
+        c.baseInstance          = GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_base_instance;
+        c.multiDrawIndirect     = GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_multi_draw_indirect;
+        c.indirectCount         = GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_indirect_parameters;
+        c.computeShaders        = GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_compute_shader;
+        c.storageBuffers        = GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_shader_storage_buffer_object;
+        c.separateShaderObjects = GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_separate_shader_objects;
+        c.spirv                 = GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_gl_spirv;
+        c.parallelCompile       = GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+        c.viewportArrays        = GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_viewport_array;
+        c.vertexLayer           = GLAD_GL_ARB_shader_viewport_layer_array || GLAD_GL_NV_viewport_array2;
+        c.timerQueries          = GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query;
+        c.debugOutput           = GLAD_GL_VERSION_4_3 || GLAD_GL_KHR_debug;
+        c.anisotropicFiltering  = GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_texture_filter_anisotropic;
+
+        c.compression.s3tc = GLAD_GL_EXT_texture_compression_s3tc;
+        c.compression.rgtc = GLAD_GL_VERSION_3_0 || GLAD_GL_ARB_texture_compression_rgtc;
+        c.compression.bptc = GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_texture_compression_bptc;
+        c.compression.etc2 = GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_ES3_compatibility;
+        c.compression.astc = GLAD_GL_KHR_texture_compression_astc_ldr;
+
+        auto& limits = c.limits;
+
+        limits.textureSize            = getInteger(GL_MAX_TEXTURE_SIZE               );
+        limits.cubeMapSize            = getInteger(GL_MAX_CUBE_MAP_TEXTURE_SIZE      );
+        limits.arrayLayers            = getInteger(GL_MAX_ARRAY_TEXTURE_LAYERS       );
+        limits.textureUnits           = getInteger(GL_MAX_TEXTURE_IMAGE_UNITS        );
+        limits.combinedTextureUnits   = getInteger(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS);
+        limits.vertexAttributes       = getInteger(GL_MAX_VERTEX_ATTRIBS             );
+        limits.colorAttachments       = getInteger(GL_MAX_COLOR_ATTACHMENTS          );
+        limits.samples                = getInteger(GL_MAX_SAMPLES                    );
+        limits.uniformBlockSize       = getInteger(GL_MAX_UNIFORM_BLOCK_SIZE         );
+        limits.uniformBufferBindings  = getInteger(GL_MAX_UNIFORM_BUFFER_BINDINGS    );
+        limits.uniformBufferAlignment = getInteger(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT);
+
+        // limits of missing features are left at their defaults, asking for them is an invalid enum
+        if (c.viewportArrays) limits.viewports = getInteger(GL_MAX_VIEWPORTS);
+
+        if (c.storageBuffers) {
+            GLint64 size = 0;
+            glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &size);
+
+            limits.storageBlockSize       = (int64) size;
+            limits.storageBufferBindings  = getInteger(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS   );
+            limits.storageBufferAlignment = getInteger(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT);
+        }
+
+        if (c.computeShaders) {
+            limits.computeInvocations  = getInteger(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS);
+            limits.computeSharedMemory = getInteger(GL_MAX_COMPUTE_SHARED_MEMORY_SIZE    );
+
+            for (GLuint axis = 0; axis < 3; axis++) {
+                GLint size = 0;
+                glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, axis, &size);
+                limits.computeWorkGroupSize[axis] = (int32) size;
+            }
+        }
+
+        if (c.anisotropicFiltering) glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &limits.anisotropy);
+
+        detected = true;
+    }
+
+    const OpenGLCapabilities& OpenGLCapabilities::get() {
+        // contexts loaded without OpenGLContext::init are detected on first use
+        if (!detected) detect();
+
+        return capabilities;
+    }
+
+    void OpenGLCapabilities::log() {
+        const OpenGLCapabilities& c = get();
+
+        LOG("OpenGL " + toString(c.major) + "." + toString(c.minor) + ", GLSL " + toString(c.glslVersion) + ": "
+            + c.renderer + " (" + c.vendor + ")" + (c.softwareRenderer ? ", software renderer" : ""), 1);
+
+        String missing;
+
+        auto feature = [&](bool supported, const char* name) { if (!supported) missing += String(missing.empty() ? "" : ", ") + name; };
+
+        feature(c.directStateAccess    , "direct state access (emulated)");
+        feature(c.bufferStorage        , "buffer storage"                );
+        feature(c.multiDrawIndirect    , "multi draw indirect"           );
+        feature(c.indirectCount        , "indirect count"                );
+        feature(c.computeShaders       , "compute shaders"               );
+        feature(c.separateShaderObjects, "separate shader objects"       );
+        feature(c.spirv                , "SPIR-V (GLSL is used)"         );
+        feature(c.parallelCompile      , "parallel shader compile"       );
+        feature(c.viewportArrays       , "viewport arrays"               );
+        feature(c.vertexLayer          , "vertex stage layer output"     );
+        feature(c.timerQueries         , "timer queries"                 );
+        feature(c.debugOutput          , "debug output"                  );
+
+        if (!missing.empty()) LOG("Not supported: " + missing + ".", 1);
+
+        String formats;
+        if (c.compression.s3tc) formats += " S3TC";
+        if (c.compression.rgtc) formats += " RGTC";
+        if (c.compression.bptc) formats += " BPTC";
+        if (c.compression.etc2) formats += " ETC2";
+        if (c.compression.astc) formats += " ASTC";
+
+        LOG("Compressed formats:" + (formats.empty() ? String(" none") : formats) + ", max texture size " + toString(c.limits.textureSize)
+            + ", texture units " + toString(c.limits.combinedTextureUnits) + ", samples " + toString(c.limits.samples)
+            + ", uniform block " + toString(c.limits.uniformBlockSize) + " B, storage block " + toString(c.limits.storageBlockSize) + " B.", 1);
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <Core/Aliases.h>
+
+#include <glad/glad.h>
+
+namespace PetrolEngine {
+    // What the context supports, read once by OpenGLContext::init after the functions are loaded.
+    // The backend picks its paths from here instead of asking for extensions where it needs them.
+    //
+    // A feature is set when the context version has it in core or the extension is exposed.
+    // The renderer needs GL 4.3, OpenGLContext::init logs older contexts as unsupported. Its own shaders
+    // are GLSL 4.30, features whose storage buffer binding is past the context's limit are turned off.
+    // Without direct state access OpenGLContext installs OpenGLStateAccess, which emulates the
+    // named calls the backend uses with bind-to-edit, and without SPIR-V shaders are cross compiled
+    // back to GLSL.
+    struct OpenGLCapabilities {
+        int32  major       = 0;
+        int32  minor       = 0;
+        int32  glslVersion = 0; // 450 for 4.50
+        String vendor;
+        String renderer;
+        String version;
+
+        // llvmpipe, softpipe, SwiftShader, the Windows GDI and basic render drivers...
+        bool softwareRenderer = false;
+
+        bool directStateAccess     = false;
+        bool bufferStorage         = false;
+        bool textureStorage        = false;
+        bool vertexAttribBinding   = false;
+        bool clearBufferObject     = false;
+        bool baseInstance          = false;
+        bool multiDrawIndirect     = false;
+        bool indirectCount         = false;
+        bool computeShaders        = false;
+        bool storageBuffers        = false;
+        bool separateShaderObjects = false;
+        bool spirv                 = false;
+        bool parallelCompile       = false;
+        bool viewportArrays        = false;
+        bool vertexLayer           = false; // gl_Layer and gl_ViewportIndex from the vertex stage
+        bool timerQueries          = false;
+        bool debugOutput           = false;
+        bool anisotropicFiltering  = false;
+
+        struct {
+            bool s3tc = false; // BC1-3
+            bool rgtc = false; // BC4-5
+            bool bptc = false; // BC6H-7
+            bool etc2 = false;
+            bool astc = false;
+        } compression;
+
+        struct {
+            int32 textureSize              = 0;
+            int32 cubeMapSize              = 0;
+            int32 arrayLayers              = 0;
+            int32 textureUnits             = 0; // per fragment stage
+            int32 combinedTextureUnits     = 0;
+            int32 vertexAttributes         = 0;
+            int32 colorAttachments         = 0;
+            int32 samples                  = 0;
+            int32 viewports                = 1;
+            int32 uniformBlockSize         = 0;
+            int32 uniformBufferBindings    = 0;
+            int32 uniformBufferAlignment   = 0;
+            int64 storageBlockSize         = 0;
+            int32 storageBufferBindings    = 0;
+            int32 storageBufferAlignment   = 0;
+            int32 computeInvocations       = 0;
+            int32 computeSharedMemory      = 0;
+            int32 computeWorkGroupSize[3]  = {};
+            float anisotropy               = 1.f;
+        } limits;
+
+        // has to be called on the GL thread with the functions loaded
+        static void detect();
+        static const OpenGLCapabilities& get();
+
+        // context, features and limits in a few lines
+        static void log();
+
+        // whether the context version is at least major.minor
+        bool atLeast(int32 major, int32 minor) const { return this->major > major || (this->major == major && this->minor >= minor); }
+
+        // GL 4.3 only guarantees storage buffer bindings 0 to 7
+        bool storageBinding(uint32 binding) const { return (int64) binding < limits.storageBufferBindings; }
+    };
+}
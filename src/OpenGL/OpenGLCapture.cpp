@@ -0,0 +1,1515 @@
+#include <PCH.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "OpenGLCapture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+
+namespace PetrolEngine {
+    namespace Capture {
+        // file layout: magic, version, viewport, table of function names (ids are only valid in
+        // the build that wrote the file), setup records, frame records
+        // record layout: uint16 function id, uint32 payload size, arguments
+        static constexpr char   magic[4] = { 'P', 'G', 'L', 'C' };
+        static constexpr uint32 version  = 1;
+
+        enum class Kind : uint8 { Buffer, Texture, Sampler, VertexArray, Framebuffer, Shader, Program, Pipeline, Sync };
+        static constexpr uint32 kindCount = 9;
+
+        // sizes of pointer arguments come from other arguments of the same call
+        struct Sizes {
+            int64 count  = 0;
+            int64 size   = 0;
+            int64 width  = 0;
+            int64 height = 0;
+            int64 depth  = 1;
+            int64 format = 0;
+            int64 type   = 0;
+
+            int64 alignment = 4;
+            const GLint* lengths = nullptr;
+        };
+
+        struct Writer {
+            Vector<uint8>& out;
+            Sizes sizes;
+
+            template<typename T>
+            void value(T value) { bytes(&value, sizeof(T)); }
+
+            void bytes(const void* data, uint64 size) {
+                out.insert(out.end(), (const uint8*) data, (const uint8*) data + size);
+            }
+
+            void blob(const void* data, uint64 size) {
+                value<uint8>(data != nullptr);
+
+                if (data == nullptr) return;
+
+                value<uint64>(size);
+                bytes(data, size);
+            }
+        };
+
+        struct Reader {
+            const uint8* data;
+            uint64 size;
+            uint64 position = 0;
+            bool   failed   = false;
+
+            template<typename T>
+            T value() {
+                T result{};
+
+                if (position + sizeof(T) > size) { failed = true; return result; }
+
+                std::memcpy(&result, data + position, sizeof(T));
+                position += sizeof(T);
+                return result;
+            }
+
+            const void* blob() {
+                if (!value<uint8>()) return nullptr;
+
+                uint64 length = value<uint64>();
+
+                if (failed || length > size - position) { failed = true; return nullptr; }
+
+                const void* result = data + position;
+                position += length;
+                return result;
+            }
+
+            uint32 count(uint64 elementSize) {
+                uint32 result = value<uint32>();
+
+                if (result > (size - position) / elementSize) { failed = true; return 0; }
+                return result;
+            }
+        };
+
+        struct ReplayState {
+            UnorderedMap<uint64, uint64> names[kindCount];
+
+            // objects deleted or never captured replay as 0
+            uint64 name(Kind kind, uint64 captured) const {
+                if (captured == 0) return 0;
+
+                auto found = names[(uint32) kind].find(captured);
+                return found == names[(uint32) kind].end() ? 0 : found->second;
+            }
+
+            void bind(Kind kind, uint64 captured, uint64 replayed) { names[(uint32) kind][captured] = replayed; }
+
+            bool   timed   = false;
+            GLuint query   = 0;
+            double cpuTime = 0.0;
+
+            std::chrono::high_resolution_clock::time_point start;
+
+            void begin() {
+                if (!timed) return;
+
+                glBeginQuery(GL_TIME_ELAPSED, query);
+                start = std::chrono::high_resolution_clock::now();
+            }
+
+            void end() {
+                if (!timed) return;
+
+                cpuTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+                glEndQuery(GL_TIME_ELAPSED);
+            }
+        };
+
+        static uint64 imageSize(int64 width, int64 height, int64 depth, GLenum format, GLenum type, int64 alignment) {
+            if (width <= 0 || height <= 0 || depth <= 0) return 0;
+
+            int64 components = 4;
+            switch (format) {
+                case GL_RED: case GL_RED_INTEGER: case GL_GREEN: case GL_BLUE: case GL_ALPHA:
+                case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX: case GL_DEPTH_STENCIL:        components = 1; break;
+                case GL_RG : case GL_RG_INTEGER:                                              components = 2; break;
+                case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: case GL_BGR_INTEGER:           components = 3; break;
+                default: break;
+            }
+
+            int64 pixel = 4 * components;
+            switch (type) {
+                case GL_UNSIGNED_BYTE : case GL_BYTE :                     pixel =     components; break;
+                case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: pixel = 2 * components; break;
+
+                case GL_UNSIGNED_BYTE_3_3_2: case GL_UNSIGNED_BYTE_2_3_3_REV: pixel = 1; break;
+
+                case GL_UNSIGNED_SHORT_5_6_5  : case GL_UNSIGNED_SHORT_5_6_5_REV  :
+                case GL_UNSIGNED_SHORT_4_4_4_4: case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+                case GL_UNSIGNED_SHORT_5_5_5_1: case GL_UNSIGNED_SHORT_1_5_5_5_REV: pixel = 2; break;
+
+                case GL_UNSIGNED_INT_8_8_8_8  : case GL_UNSIGNED_INT_8_8_8_8_REV  :
+                case GL_UNSIGNED_INT_10_10_10_2: case GL_UNSIGNED_INT_2_10_10_10_REV:
+                case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_10F_11F_11F_REV: case GL_UNSIGNED_INT_5_9_9_9_REV: pixel = 4; break;
+
+                case GL_FLOAT_32_UNSIGNED_INT_24_8_REV: pixel = 8; break;
+                default: break;
+            }
+
+            alignment = std::max<int64>(alignment, 1);
+
+            // the last row is not padded
+            int64 row = (width * pixel + alignment - 1) / alignment * alignment;
+            return (uint64) (row * (height * depth - 1) + width * pixel);
+        }
+
+        // Argument kinds. Every one knows the GL type, how to write it and how to decode it for a
+        // replay, names are translated from captured objects to replayed ones.
+
+        template<typename T>
+        struct Value {
+            using Type = T;
+
+            static void gather(Sizes&, T) {}
+            static void write (Writer& writer, T value) { writer.value(value); }
+
+            struct Decoded {
+                T value{};
+
+                void read (Reader& reader, ReplayState&) { value = reader.value<T>(); }
+                T    get  () const { return value; }
+                void after(ReplayState&) {}
+            };
+        };
+
+        template<typename T, int64 Sizes::* field>
+        struct Sized : Value<T> {
+            static void gather(Sizes& sizes, T value) { sizes.*field = (int64) value; }
+        };
+
+        using Count       = Sized<GLsizei   , &Sizes::count >;
+        using Size        = Sized<GLsizeiptr, &Sizes::size  >;
+        using Length      = Sized<GLsizei   , &Sizes::size  >;
+        using Width       = Sized<GLsizei   , &Sizes::width >;
+        using Height      = Sized<GLsizei   , &Sizes::height>;
+        using Depth       = Sized<GLsizei   , &Sizes::depth >;
+        using PixelFormat = Sized<GLenum    , &Sizes::format>;
+        using PixelType   = Sized<GLenum    , &Sizes::type  >;
+        using Constants   = Sized<GLuint    , &Sizes::count >;
+
+        template<Kind kind>
+        struct Name : Value<GLuint> {
+            struct Decoded : Value<GLuint>::Decoded {
+                void read(Reader& reader, ReplayState& state) { value = (GLuint) state.name(kind, reader.value<GLuint>()); }
+            };
+        };
+
+        struct SyncName {
+            using Type = GLsync;
+
+            static void gather(Sizes&, GLsync) {}
+            static void write (Writer& writer, GLsync sync) { writer.value<uint64>((uint64) (uintptr_t) sync); }
+
+            struct Decoded {
+                GLsync value = nullptr;
+
+                void   read (Reader& reader, ReplayState& state) { value = (GLsync) (uintptr_t) state.name(Kind::Sync, reader.value<uint64>()); }
+                GLsync get  () const { return value; }
+                void   after(ReplayState&) {}
+            };
+        };
+
+        // names created by glGen* and glCreate*
+        template<Kind kind>
+        struct NamesOut {
+            using Type = GLuint*;
+
+            static void gather(Sizes&, GLuint*) {}
+            static void write (Writer& writer, GLuint* names) {
+                writer.value<uint32>((uint32) writer.sizes.count);
+                writer.bytes(names, writer.sizes.count * sizeof(GLuint));
+            }
+
+            struct Decoded {
+                Vector<GLuint> captured, names;
+
+                void read(Reader& reader, ReplayState&) {
+                    captured.resize(reader.count(sizeof(GLuint)));
+                    names   .resize(captured.size());
+
+                    for (auto& name : captured) name = reader.value<GLuint>();
+                }
+
+                GLuint* get() { return names.data(); }
+
+                void after(ReplayState& state) {
+                    for (uint64 i = 0; i < captured.size(); i++) state.bind(kind, captured[i], names[i]);
+                }
+            };
+        };
+
+        template<Kind kind>
+        struct NamesIn {
+            using Type = const GLuint*;
+
+            static void gather(Sizes&, const GLuint*) {}
+            static void write (Writer& writer, const GLuint* names) {
+                writer.value<uint32>((uint32) writer.sizes.count);
+                writer.bytes(names, writer.sizes.count * sizeof(GLuint));
+            }
+
+            struct Decoded {
+                Vector<GLuint> names;
+
+                void read(Reader& reader, ReplayState& state) {
+                    names.resize(reader.count(sizeof(GLuint)));
+
+                    for (auto& name : names) name = (GLuint) state.name(kind, reader.value<GLuint>());
+                }
+
+                const GLuint* get  () const { return names.data(); }
+                void          after(ReplayState&) {}
+            };
+        };
+
+        // payloads point into the loaded file when replayed
+        template<typename T>
+        struct Payload {
+            using Type = const T*;
+
+            static void gather(Sizes&, const T*) {}
+
+            struct Decoded {
+                const void* data = nullptr;
+
+                void     read (Reader& reader, ReplayState&) { data = reader.blob(); }
+                const T* get  () const { return (const T*) data; }
+                void     after(ReplayState&) {}
+            };
+        };
+
+        struct Data : Payload<void> {
+            static void write(Writer& writer, const void* data) { writer.blob(data, (uint64) writer.sizes.size); }
+        };
+
+        template<typename T, uint32 components>
+        struct Array : Payload<T> {
+            static void write(Writer& writer, const T* data) { writer.blob(data, writer.sizes.count * components * sizeof(T)); }
+        };
+
+        struct Pixels : Payload<void> {
+            static void write(Writer& writer, const void* data) {
+                const Sizes& sizes = writer.sizes;
+                writer.blob(data, imageSize(sizes.width, sizes.height, sizes.depth, (GLenum) sizes.format, (GLenum) sizes.type, sizes.alignment));
+            }
+        };
+
+        // single pixel clear values
+        struct Pixel : Payload<void> {
+            static void write(Writer& writer, const void* data) {
+                writer.blob(data, imageSize(1, 1, 1, (GLenum) writer.sizes.format, (GLenum) writer.sizes.type, 1));
+            }
+        };
+
+        struct CString : Payload<GLchar> {
+            static void write(Writer& writer, const GLchar* string) { writer.blob(string, string ? std::strlen(string) + 1 : 0); }
+        };
+
+        // offsets into bound buffers passed as pointers (indices, indirect commands)
+        struct Offset {
+            using Type = const void*;
+
+            static void gather(Sizes&, const void*) {}
+            static void write (Writer& writer, const void* offset) { writer.value<uint64>((uint64) (uintptr_t) offset); }
+
+            struct Decoded {
+                uint64 offset = 0;
+
+                void        read (Reader& reader, ReplayState&) { offset = reader.value<uint64>(); }
+                const void* get  () const { return (const void*) (uintptr_t) offset; }
+                void        after(ReplayState&) {}
+            };
+        };
+
+        // shader sources are stored null terminated, lengths are not needed by the replay
+        struct Lengths {
+            using Type = const GLint*;
+
+            static void gather(Sizes& sizes, const GLint* lengths) { sizes.lengths = lengths; }
+            static void write (Writer&, const GLint*) {}
+
+            struct Decoded {
+                void         read (Reader&, ReplayState&) {}
+                const GLint* get  () const { return nullptr; }
+                void         after(ReplayState&) {}
+            };
+        };
+
+        struct Sources {
+            using Type = const GLchar* const*;
+
+            static void gather(Sizes&, const GLchar* const*) {}
+            static void write (Writer& writer, const GLchar* const* strings) {
+                writer.value<uint32>((uint32) writer.sizes.count);
+
+                for (int64 i = 0; i < writer.sizes.count; i++) {
+                    const GLint* lengths = writer.sizes.lengths;
+                    uint64 length = (lengths && lengths[i] >= 0) ? (uint64) lengths[i] : std::strlen(strings[i]);
+
+                    writer.value<uint8 >(1);
+                    writer.value<uint64>(length + 1);
+                    writer.bytes(strings[i], length);
+                    writer.value<GLchar>(0);
+                }
+            }
+
+            struct Decoded {
+                Vector<const GLchar*> strings;
+
+                void read(Reader& reader, ReplayState&) {
+                    strings.resize(reader.count(1));
+
+                    for (auto& string : strings) string = (const GLchar*) reader.blob();
+                }
+
+                const GLchar* const* get  () const { return strings.data(); }
+                void                 after(ReplayState&) {}
+            };
+        };
+
+        struct Void { using Type = void; };
+
+        template<typename T>
+        struct Returned {
+            using Type = T;
+
+            static void write(Writer& writer, T value) { writer.value(value); }
+
+            struct Decoded {
+                void read (Reader& reader, ReplayState&) { reader.value<T>(); }
+                void after(ReplayState&, T) {}
+            };
+        };
+
+        template<Kind kind>
+        struct ReturnName : Returned<GLuint> {
+            struct Decoded {
+                GLuint captured = 0;
+
+                void read (Reader& reader, ReplayState&) { captured = reader.value<GLuint>(); }
+                void after(ReplayState& state, GLuint name) { state.bind(kind, captured, name); }
+            };
+        };
+
+        struct ReturnSync {
+            using Type = GLsync;
+
+            static void write(Writer& writer, GLsync sync) { writer.value<uint64>((uint64) (uintptr_t) sync); }
+
+            struct Decoded {
+                uint64 captured = 0;
+
+                void read (Reader& reader, ReplayState&) { captured = reader.value<uint64>(); }
+                void after(ReplayState& state, GLsync sync) { state.bind(Kind::Sync, captured, (uint64) (uintptr_t) sync); }
+            };
+        };
+
+        // Every GL function the backend calls. Functions missing here are not captured, and a
+        // frame using them replays without them.
+        #define CAPTURED_FUNCTIONS(F) \
+            F(Clear                            , Void                      , (Value<GLbitfield>)) \
+            F(Viewport                         , Void                      , (Value<GLint>, Value<GLint>, Value<GLsizei>, Value<GLsizei>)) \
+            F(ViewportIndexedf                 , Void                      , (Value<GLuint>, Value<GLfloat>, Value<GLfloat>, Value<GLfloat>, Value<GLfloat>)) \
+            F(Enable                           , Void                      , (Value<GLenum>)) \
+            F(Disable                          , Void                      , (Value<GLenum>)) \
+            F(DepthFunc                        , Void                      , (Value<GLenum>)) \
+            F(CullFace                         , Void                      , (Value<GLenum>)) \
+            F(PixelStorei                      , Void                      , (Value<GLenum>, Value<GLint>)) \
+            F(DrawArrays                       , Void                      , (Value<GLenum>, Value<GLint>, Value<GLsizei>)) \
+            F(DrawElementsInstancedBaseInstance, Void                      , (Value<GLenum>, Value<GLsizei>, Value<GLenum>, Offset, Value<GLsizei>, Value<GLuint>)) \
+            F(MultiDrawElementsIndirect        , Void                      , (Value<GLenum>, Value<GLenum>, Offset, Value<GLsizei>, Value<GLsizei>)) \
+            F(MultiDrawElementsIndirectCount   , Void                      , (Value<GLenum>, Value<GLenum>, Offset, Value<GLintptr>, Value<GLsizei>, Value<GLsizei>)) \
+            F(MultiDrawElementsIndirectCountARB, Void                      , (Value<GLenum>, Value<GLenum>, Offset, Value<GLintptr>, Value<GLsizei>, Value<GLsizei>)) \
+            F(DispatchCompute                  , Void                      , (Value<GLuint>, Value<GLuint>, Value<GLuint>)) \
+            F(DispatchComputeIndirect          , Void                      , (Value<GLintptr>)) \
+            F(MemoryBarrier                    , Void                      , (Value<GLbitfield>)) \
+            F(FenceSync                        , ReturnSync                , (Value<GLenum>, Value<GLbitfield>)) \
+            F(DeleteSync                       , Void                      , (SyncName)) \
+            F(ClientWaitSync                   , Returned<GLenum>          , (SyncName, Value<GLbitfield>, Value<GLuint64>)) \
+            F(CreateBuffers                    , Void                      , (Count, NamesOut<Kind::Buffer>)) \
+            F(DeleteBuffers                    , Void                      , (Count, NamesIn <Kind::Buffer>)) \
+            F(NamedBufferData                  , Void                      , (Name<Kind::Buffer>, Size, Data, Value<GLenum>)) \
+            F(NamedBufferSubData               , Void                      , (Name<Kind::Buffer>, Value<GLintptr>, Size, Data)) \
+            F(CopyNamedBufferSubData           , Void                      , (Name<Kind::Buffer>, Name<Kind::Buffer>, Value<GLintptr>, Value<GLintptr>, Value<GLsizeiptr>)) \
+            F(ClearNamedBufferData             , Void                      , (Name<Kind::Buffer>, Value<GLenum>, PixelFormat, PixelType, Pixel)) \
+            F(BindBuffer                       , Void                      , (Value<GLenum>, Name<Kind::Buffer>)) \
+            F(BindBufferBase                   , Void                      , (Value<GLenum>, Value<GLuint>, Name<Kind::Buffer>)) \
+            F(GenTextures                      , Void                      , (Count, NamesOut<Kind::Texture>)) \
+            F(CreateTextures                   , Void                      , (Value<GLenum>, Count, NamesOut<Kind::Texture>)) \
+            F(DeleteTextures                   , Void                      , (Count, NamesIn <Kind::Texture>)) \
+            F(ActiveTexture                    , Void                      , (Value<GLenum>)) \
+            F(BindTexture                      , Void                      , (Value<GLenum>, Name<Kind::Texture>)) \
+            F(BindTextureUnit                  , Void                      , (Value<GLuint>, Name<Kind::Texture>)) \
+            F(TexImage2D                       , Void                      , (Value<GLenum>, Value<GLint>, Value<GLint>, Width, Height, Value<GLint>, PixelFormat, PixelType, Pixels)) \
+            F(TexSubImage2D                    , Void                      , (Value<GLenum>, Value<GLint>, Value<GLint>, Value<GLint>, Width, Height, PixelFormat, PixelType, Pixels)) \
+            F(TextureSubImage2D                , Void                      , (Name<Kind::Texture>, Value<GLint>, Value<GLint>, Value<GLint>, Width, Height, PixelFormat, PixelType, Pixels)) \
+            F(TextureSubImage3D                , Void                      , (Name<Kind::Texture>, Value<GLint>, Value<GLint>, Value<GLint>, Value<GLint>, Width, Height, Depth, PixelFormat, PixelType, Pixels)) \
+            F(TexStorage2D                     , Void                      , (Value<GLenum>, Value<GLsizei>, Value<GLenum>, Value<GLsizei>, Value<GLsizei>)) \
+            F(TextureStorage2D                 , Void                      , (Name<Kind::Texture>, Value<GLsizei>, Value<GLenum>, Value<GLsizei>, Value<GLsizei>)) \
+            F(TexParameteri                    , Void                      , (Value<GLenum>, Value<GLenum>, Value<GLint>)) \
+            F(TextureParameteri                , Void                      , (Name<Kind::Texture>, Value<GLenum>, Value<GLint>)) \
+            F(GenerateMipmap                   , Void                      , (Value<GLenum>)) \
+            F(CreateSamplers                   , Void                      , (Count, NamesOut<Kind::Sampler>)) \
+            F(DeleteSamplers                   , Void                      , (Count, NamesIn <Kind::Sampler>)) \
+            F(SamplerParameteri                , Void                      , (Name<Kind::Sampler>, Value<GLenum>, Value<GLint>)) \
+            F(BindSampler                      , Void                      , (Value<GLuint>, Name<Kind::Sampler>)) \
+            F(BindImageTexture                 , Void                      , (Value<GLuint>, Name<Kind::Texture>, Value<GLint>, Value<GLboolean>, Value<GLint>, Value<GLenum>, Value<GLenum>)) \
+            F(CreateVertexArrays               , Void                      , (Count, NamesOut<Kind::VertexArray>)) \
+            F(DeleteVertexArrays               , Void                      , (Count, NamesIn <Kind::VertexArray>)) \
+            F(BindVertexArray                  , Void                      , (Name<Kind::VertexArray>)) \
+            F(EnableVertexArrayAttrib          , Void                      , (Name<Kind::VertexArray>, Value<GLuint>)) \
+            F(VertexArrayAttribFormat          , Void                      , (Name<Kind::VertexArray>, Value<GLuint>, Value<GLint>, Value<GLenum>, Value<GLboolean>, Value<GLuint>)) \
+            F(VertexArrayAttribIFormat         , Void                      , (Name<Kind::VertexArray>, Value<GLuint>, Value<GLint>, Value<GLenum>, Value<GLuint>)) \
+            F(VertexArrayAttribBinding         , Void                      , (Name<Kind::VertexArray>, Value<GLuint>, Value<GLuint>)) \
+            F(VertexArrayBindingDivisor        , Void                      , (Name<Kind::VertexArray>, Value<GLuint>, Value<GLuint>)) \
+            F(VertexArrayVertexBuffer          , Void                      , (Name<Kind::VertexArray>, Value<GLuint>, Name<Kind::Buffer>, Value<GLintptr>, Value<GLsizei>)) \
+            F(VertexArrayElementBuffer         , Void                      , (Name<Kind::VertexArray>, Name<Kind::Buffer>)) \
+            F(GenFramebuffers                  , Void                      , (Count, NamesOut<Kind::Framebuffer>)) \
+            F(CreateFramebuffers               , Void                      , (Count, NamesOut<Kind::Framebuffer>)) \
+            F(DeleteFramebuffers               , Void                      , (Count, NamesIn <Kind::Framebuffer>)) \
+            F(BindFramebuffer                  , Void                      , (Value<GLenum>, Name<Kind::Framebuffer>)) \
+            F(BlitNamedFramebuffer             , Void                      , (Name<Kind::Framebuffer>, Name<Kind::Framebuffer>, Value<GLint>, Value<GLint>, Value<GLint>, Value<GLint>, Value<GLint>, Value<GLint>, Value<GLint>, Value<GLint>, Value<GLbitfield>, Value<GLenum>)) \
+            F(FramebufferTexture2D             , Void                      , (Value<GLenum>, Value<GLenum>, Value<GLenum>, Name<Kind::Texture>, Value<GLint>)) \
+            F(NamedFramebufferTexture          , Void                      , (Name<Kind::Framebuffer>, Value<GLenum>, Name<Kind::Texture>, Value<GLint>)) \
+            F(NamedFramebufferTextureLayer     , Void                      , (Name<Kind::Framebuffer>, Value<GLenum>, Name<Kind::Texture>, Value<GLint>, Value<GLint>)) \
+            F(CreateShader                     , ReturnName<Kind::Shader > , (Value<GLenum>)) \
+            F(DeleteShader                     , Void                      , (Name<Kind::Shader>)) \
+            F(ShaderSource                     , Void                      , (Name<Kind::Shader>, Count, Sources, Lengths)) \
+            F(ShaderBinary                     , Void                      , (Count, NamesIn<Kind::Shader>, Value<GLenum>, Data, Length)) \
+            F(SpecializeShader                 , Void                      , (Name<Kind::Shader>, CString, Constants, Array<GLuint, 1>, Array<GLuint, 1>)) \
+            F(CompileShader                    , Void                      , (Name<Kind::Shader>)) \
+            F(CreateProgram                    , ReturnName<Kind::Program> , ()) \
+            F(DeleteProgram                    , Void                      , (Name<Kind::Program>)) \
+            F(AttachShader                     , Void                      , (Name<Kind::Program>, Name<Kind::Shader>)) \
+            F(LinkProgram                      , Void                      , (Name<Kind::Program>)) \
+            F(UseProgram                       , Void                      , (Name<Kind::Program>)) \
+            F(ProgramParameteri                , Void                      , (Name<Kind::Program>, Value<GLenum>, Value<GLint>)) \
+            F(CreateShaderProgramv             , ReturnName<Kind::Program> , (Value<GLenum>, Count, Sources)) \
+            F(CreateProgramPipelines           , Void                      , (Count, NamesOut<Kind::Pipeline>)) \
+            F(DeleteProgramPipelines           , Void                      , (Count, NamesIn <Kind::Pipeline>)) \
+            F(UseProgramStages                 , Void                      , (Name<Kind::Pipeline>, Value<GLbitfield>, Name<Kind::Program>)) \
+            F(BindProgramPipeline              , Void                      , (Name<Kind::Pipeline>)) \
+            F(UniformBlockBinding              , Void                      , (Name<Kind::Program>, Value<GLuint>, Value<GLuint>)) \
+            F(Uniform1f                        , Void                      , (Value<GLint>, Value<GLfloat>)) \
+            F(Uniform1i                        , Void                      , (Value<GLint>, Value<GLint>)) \
+            F(Uniform1ui                       , Void                      , (Value<GLint>, Value<GLuint>)) \
+            F(Uniform2f                        , Void                      , (Value<GLint>, Value<GLfloat>, Value<GLfloat>)) \
+            F(Uniform3f                        , Void                      , (Value<GLint>, Value<GLfloat>, Value<GLfloat>, Value<GLfloat>)) \
+            F(Uniform4f                        , Void                      , (Value<GLint>, Value<GLfloat>, Value<GLfloat>, Value<GLfloat>, Value<GLfloat>)) \
+            F(Uniform2fv                       , Void                      , (Value<GLint>, Count, Array<GLfloat, 2>)) \
+            F(Uniform3fv                       , Void                      , (Value<GLint>, Count, Array<GLfloat, 3>)) \
+            F(Uniform4fv                       , Void                      , (Value<GLint>, Count, Array<GLfloat, 4>)) \
+            F(UniformMatrix2fv                 , Void                      , (Value<GLint>, Count, Value<GLboolean>, Array<GLfloat, 4>)) \
+            F(UniformMatrix3fv                 , Void                      , (Value<GLint>, Count, Value<GLboolean>, Array<GLfloat, 9>)) \
+            F(UniformMatrix4fv                 , Void                      , (Value<GLint>, Count, Value<GLboolean>, Array<GLfloat, 16>)) \
+            F(ProgramUniform1f                 , Void                      , (Name<Kind::Program>, Value<GLint>, Value<GLfloat>)) \
+            F(ProgramUniform1i                 , Void                      , (Name<Kind::Program>, Value<GLint>, Value<GLint>)) \
+            F(ProgramUniform1ui                , Void                      , (Name<Kind::Program>, Value<GLint>, Value<GLuint>)) \
+            F(ProgramUniform2f                 , Void                      , (Name<Kind::Program>, Value<GLint>, Value<GLfloat>, Value<GLfloat>)) \
+            F(ProgramUniform3f                 , Void                      , (Name<Kind::Program>, Value<GLint>, Value<GLfloat>, Value<GLfloat>, Value<GLfloat>)) \
+            F(ProgramUniform4f                 , Void                      , (Name<Kind::Program>, Value<GLint>, Value<GLfloat>, Value<GLfloat>, Value<GLfloat>, Value<GLfloat>)) \
+            F(ProgramUniform2fv                , Void                      , (Name<Kind::Program>, Value<GLint>, Count, Array<GLfloat, 2>)) \
+            F(ProgramUniform3fv                , Void                      , (Name<Kind::Program>, Value<GLint>, Count, Array<GLfloat, 3>)) \
+            F(ProgramUniform4fv                , Void                      , (Name<Kind::Program>, Value<GLint>, Count, Array<GLfloat, 4>)) \
+            F(ProgramUniform4i                 , Void                      , (Name<Kind::Program>, Value<GLint>, Value<GLint>, Value<GLint>, Value<GLint>, Value<GLint>)) \
+            F(ProgramUniformMatrix2fv          , Void                      , (Name<Kind::Program>, Value<GLint>, Count, Value<GLboolean>, Array<GLfloat, 4>)) \
+            F(ProgramUniformMatrix3fv          , Void                      , (Name<Kind::Program>, Value<GLint>, Count, Value<GLboolean>, Array<GLfloat, 9>)) \
+            F(ProgramUniformMatrix4fv          , Void                      , (Name<Kind::Program>, Value<GLint>, Count, Value<GLboolean>, Array<GLfloat, 16>))
+
+        enum class Call : uint16 {
+            None,
+            #define CAPTURE_ENUM(name, result, arguments) name,
+            CAPTURED_FUNCTIONS(CAPTURE_ENUM)
+            #undef CAPTURE_ENUM
+            Count
+        };
+
+        struct Object {
+            Kind   kind  = Kind::Buffer;
+            GLuint name  = 0;
+            uint64 order = 0;
+
+            // the first entry creates the object, later entries replace the one with the same key
+            // so state set every frame does not pile up, key 0 always appends
+            Vector<Pair<uint64, Vector<uint8>>> entries;
+
+            int64 size = 0;                      // buffers
+            GLenum target = 0, internalFormat = 0; // textures
+            Vector<Pair<int64, int64>> levels;
+            Vector<GLuint> attached;             // programs
+        };
+
+        struct Recorder {
+            std::mutex mutex;
+
+            bool installed = false;
+            bool pending   = false;
+
+            // read without the mutex by calls that are not journaled
+            std::atomic<bool> capturing = false;
+
+            String path;
+            Vector<uint8> setup;
+            Vector<uint8> frame;
+            uint32 frameCalls = 0;
+            GLint  viewport[4] = { 0, 0, 0, 0 };
+
+            UnorderedMap<uint64, Object> objects;
+            UnorderedMap<uint64, Pair<uint64, Vector<uint8>>> globals;
+            uint64 order = 0;
+
+            // bindings the bind to edit functions act on
+            GLenum activeTexture   = GL_TEXTURE0;
+            GLuint program         = 0;
+            GLuint vertexArray     = 0;
+            GLuint drawFramebuffer = 0;
+            GLuint readFramebuffer = 0;
+            int64  unpackAlignment = 4;
+            UnorderedMap<uint64, GLuint> textures;
+        };
+
+        static Recorder recorder;
+
+        template<Call id>
+        struct Journal {
+            static constexpr bool journaled = false;
+
+            template<typename... Values>
+            static void record(Values...) {}
+        };
+
+        // Arguments is a function type listing the argument kinds
+        template<Call id, auto* pointer, typename Return, typename Arguments>
+        struct Hook;
+
+        template<Call id, auto* pointer, typename Return, typename... Arguments>
+        struct Hook<id, pointer, Return, void(Arguments...)> {
+            using Function = std::remove_pointer_t<decltype(pointer)>;
+
+            static_assert(std::is_same_v<Function, typename Return::Type (APIENTRYP)(typename Arguments::Type...)>,
+                          "captured arguments do not match the GL function");
+
+            static inline Function original = nullptr;
+
+            static void install() {
+                if (*pointer == nullptr || *pointer == &capture) return;
+
+                original = *pointer;
+                *pointer = &capture;
+            }
+
+            static Function function() { return original ? original : *pointer; }
+
+            template<typename... Result>
+            static void append(Vector<uint8>& out, typename Arguments::Type... arguments, Result... result) {
+                Writer writer{ out };
+                writer.sizes.alignment = recorder.unpackAlignment;
+
+                writer.value<uint16>((uint16) id);
+
+                uint64 sizePosition = out.size();
+                writer.value<uint32>(0);
+
+                (Arguments::gather(writer.sizes, arguments), ...);
+                (Arguments::write (writer      , arguments), ...);
+                (Return   ::write (writer      , result   ), ...);
+
+                uint32 size = (uint32) (out.size() - sizePosition - sizeof(uint32));
+                std::memcpy(out.data() + sizePosition, &size, sizeof(uint32));
+            }
+
+            static typename Return::Type APIENTRY capture(typename Arguments::Type... arguments) {
+                // draws and uniforms between captures cost one atomic load, only journaled calls lock
+                if constexpr (std::is_void_v<typename Return::Type>) {
+                    original(arguments...);
+
+                    if (!Journal<id>::journaled && !recorder.capturing) return;
+
+                    std::lock_guard<std::mutex> lock(recorder.mutex);
+                    if (recorder.capturing) { append(recorder.frame, arguments...); recorder.frameCalls++; }
+
+                    Journal<id>::record(arguments...);
+                }
+                else {
+                    auto result = original(arguments...);
+
+                    if (!Journal<id>::journaled && !recorder.capturing) return result;
+
+                    std::lock_guard<std::mutex> lock(recorder.mutex);
+                    if (recorder.capturing) { append(recorder.frame, arguments..., result); recorder.frameCalls++; }
+
+                    Journal<id>::record(arguments..., result);
+                    return result;
+                }
+            }
+
+            static void replay(Reader& reader, ReplayState& state) {
+                std::tuple<typename Arguments::Decoded...> decoded;
+                std::apply([&](auto&... argument) { (argument.read(reader, state), ...); }, decoded);
+
+                Function call = function();
+
+                if constexpr (std::is_void_v<typename Return::Type>) {
+                    if (reader.failed || call == nullptr) return;
+
+                    state.begin();
+                    std::apply([&](auto&... argument) { call(argument.get()...); }, decoded);
+                    state.end();
+
+                    std::apply([&](auto&... argument) { (argument.after(state), ...); }, decoded);
+                }
+                else {
+                    typename Return::Decoded result;
+                    result.read(reader, state);
+
+                    if (reader.failed || call == nullptr) return;
+
+                    state.begin();
+                    auto value = std::apply([&](auto&... argument) { return call(argument.get()...); }, decoded);
+                    state.end();
+
+                    std::apply([&](auto&... argument) { (argument.after(state), ...); }, decoded);
+                    result.after(state, value);
+                }
+            }
+        };
+
+        template<Call id>
+        struct HookOf;
+
+        #define CAPTURE_HOOK(name, result, arguments) \
+            template<> struct HookOf<Call::name> { using Type = Hook<Call::name, &glad_gl##name, result, void arguments>; };
+        CAPTURED_FUNCTIONS(CAPTURE_HOOK)
+        #undef CAPTURE_HOOK
+
+        template<Call id, typename... Values>
+        static Vector<uint8> encode(Values... values) {
+            Vector<uint8> out;
+            HookOf<id>::Type::append(out, values...);
+            return out;
+        }
+
+        // calls the driver without recording
+        template<Call id, typename... Values>
+        static auto call(Values... values) { return HookOf<id>::Type::function()(values...); }
+
+        static void extend(Vector<uint8>& out, const Vector<uint8>& records) {
+            out.insert(out.end(), records.begin(), records.end());
+        }
+
+        static Vector<uint8> concat(Vector<uint8> first, const Vector<uint8>& second) {
+            extend(first, second);
+            return first;
+        }
+
+        static uint64 key(Call id, uint64 a = 0, uint64 b = 0) {
+            return ((uint64) id << 48) | ((a & 0xFFFFFF) << 24) | (b & 0xFFFFFF);
+        }
+
+        static uint64 objectKey(Kind kind, GLuint name) { return ((uint64) kind << 32) | name; }
+
+        static Object* find(Kind kind, GLuint name) {
+            auto found = recorder.objects.find(objectKey(kind, name));
+            return found == recorder.objects.end() ? nullptr : &found->second;
+        }
+
+        static void create(Kind kind, GLuint name, Vector<uint8> record) {
+            Object& object = recorder.objects[objectKey(kind, name)];
+
+            object = Object();
+            object.kind  = kind;
+            object.name  = name;
+            object.order = recorder.order++;
+            object.entries.push_back({ 0, std::move(record) });
+        }
+
+        template<Call id>
+        static void create(Kind kind, GLsizei count, GLuint* names) {
+            for (GLsizei i = 0; i < count; i++) create(kind, names[i], encode<id>(1, &names[i]));
+        }
+
+        static void destroy(Kind kind, GLsizei count, const GLuint* names) {
+            for (GLsizei i = 0; i < count; i++) recorder.objects.erase(objectKey(kind, names[i]));
+        }
+
+        static void journal(Object* object, uint64 key, Vector<uint8> record) {
+            if (object == nullptr) return;
+
+            if (key) for (auto& entry : object->entries) {
+                if (entry.first != key) continue;
+
+                entry.second = std::move(record);
+                return;
+            }
+
+            object->entries.push_back({ key, std::move(record) });
+        }
+
+        static void global(uint64 key, Vector<uint8> record) {
+            recorder.globals[key] = { recorder.order++, std::move(record) };
+        }
+
+        static GLenum bindingTarget(GLenum target) {
+            if (target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z) return GL_TEXTURE_CUBE_MAP;
+            return target;
+        }
+
+        static uint64 textureSlot(GLenum unit, GLenum target) { return ((uint64) unit << 32) | target; }
+
+        static GLuint boundTexture(GLenum target) {
+            auto found = recorder.textures.find(textureSlot(recorder.activeTexture, bindingTarget(target)));
+            return found == recorder.textures.end() ? 0 : found->second;
+        }
+
+        static void setLevels(Object* object, GLint level, int64 width, int64 height, GLint count = 1) {
+            if (object->levels.size() < (uint64) (level + count)) object->levels.resize(level + count);
+
+            for (GLint i = 0; i < count; i++) {
+                object->levels[level + i] = { std::max<int64>(width >> i, 1), std::max<int64>(height >> i, 1) };
+            }
+        }
+
+        static uint64 uniformKey(GLint location) { return key(Call::UseProgram, (uint64) location + 1); }
+
+        template<Call id, typename... Values>
+        static void uniform(GLint location, Values... values) {
+            if (recorder.program == 0) return;
+
+            journal(find(Kind::Program, recorder.program), uniformKey(location),
+                    concat(encode<Call::UseProgram>(recorder.program), encode<id>(location, values...)));
+        }
+
+        template<Call id, typename... Values>
+        static void programUniform(GLuint program, GLint location, Values... values) {
+            journal(find(Kind::Program, program), uniformKey(location), encode<id>(program, location, values...));
+        }
+
+        // What every call leaves behind between frames. Bind to edit calls are journaled against
+        // the object they edit so the order of binds does not matter when the journal is replayed.
+        #define JOURNAL(name, ...) \
+            template<> struct Journal<Call::name> { static constexpr bool journaled = true; static void record(__VA_ARGS__); }; \
+            void Journal<Call::name>::record(__VA_ARGS__)
+
+        JOURNAL(Viewport , GLint x, GLint y, GLsizei width, GLsizei height) { global(key(Call::Viewport ), encode<Call::Viewport >(x, y, width, height)); }
+        JOURNAL(ViewportIndexedf, GLuint index, GLfloat x, GLfloat y, GLfloat width, GLfloat height) {
+            global(key(Call::ViewportIndexedf, index), encode<Call::ViewportIndexedf>(index, x, y, width, height));
+        }
+        JOURNAL(Enable   , GLenum capability) { global(key(Call::Enable, capability), encode<Call::Enable >(capability)); }
+        JOURNAL(Disable  , GLenum capability) { global(key(Call::Enable, capability), encode<Call::Disable>(capability)); }
+        JOURNAL(DepthFunc, GLenum function  ) { global(key(Call::DepthFunc), encode<Call::DepthFunc>(function)); }
+        JOURNAL(CullFace , GLenum mode      ) { global(key(Call::CullFace ), encode<Call::CullFace >(mode    )); }
+
+        JOURNAL(PixelStorei, GLenum name, GLint value) {
+            if (name == GL_UNPACK_ALIGNMENT) recorder.unpackAlignment = value;
+
+            global(key(Call::PixelStorei, name), encode<Call::PixelStorei>(name, value));
+        }
+
+        JOURNAL(CreateBuffers, GLsizei count, GLuint*       buffers) { create<Call::CreateBuffers>(Kind::Buffer, count, buffers); }
+        JOURNAL(DeleteBuffers, GLsizei count, const GLuint* buffers) { destroy(Kind::Buffer, count, buffers); }
+
+        // contents are read back when a capture starts
+        JOURNAL(NamedBufferData, GLuint buffer, GLsizeiptr size, const void*, GLenum usage) {
+            Object* object = find(Kind::Buffer, buffer);
+            if (object == nullptr) return;
+
+            object->size = size;
+            journal(object, key(Call::NamedBufferData), encode<Call::NamedBufferData>(buffer, size, nullptr, usage));
+        }
+
+        JOURNAL(BindBuffer, GLenum target, GLuint buffer) {
+            // element array binding belongs to the vertex array
+            if (target == GL_ELEMENT_ARRAY_BUFFER) {
+                journal(find(Kind::VertexArray, recorder.vertexArray), key(Call::VertexArrayElementBuffer),
+                        encode<Call::VertexArrayElementBuffer>(recorder.vertexArray, buffer));
+                return;
+            }
+
+            global(key(Call::BindBuffer, target), encode<Call::BindBuffer>(target, buffer));
+        }
+
+        JOURNAL(BindBufferBase, GLenum target, GLuint index, GLuint buffer) {
+            global(key(Call::BindBufferBase, target, index), encode<Call::BindBufferBase>(target, index, buffer));
+        }
+
+        JOURNAL(GenTextures   ,                GLsizei count, GLuint*       textures) { create<Call::GenTextures>(Kind::Texture, count, textures); }
+        JOURNAL(DeleteTextures,                GLsizei count, const GLuint* textures) { destroy(Kind::Texture, count, textures); }
+        JOURNAL(CreateTextures, GLenum target, GLsizei count, GLuint*       textures) {
+            for (GLsizei i = 0; i < count; i++) {
+                create(Kind::Texture, textures[i], encode<Call::CreateTextures>(target, 1, &textures[i]));
+                find(Kind::Texture, textures[i])->target = target;
+            }
+        }
+
+        JOURNAL(ActiveTexture, GLenum unit) { recorder.activeTexture = unit; }
+
+        JOURNAL(BindTexture, GLenum target, GLuint texture) {
+            recorder.textures[textureSlot(recorder.activeTexture, target)] = texture;
+
+            // generated names get their target with the first bind, replays create them with it
+            Object* object = find(Kind::Texture, texture);
+            if (object && object->target == 0) {
+                object->target = target;
+                object->entries[0].second = encode<Call::CreateTextures>(target, 1, &texture);
+            }
+
+            global(key(Call::BindTexture, recorder.activeTexture, target),
+                   concat(encode<Call::ActiveTexture>(recorder.activeTexture), encode<Call::BindTexture>(target, texture)));
+        }
+
+        JOURNAL(BindTextureUnit, GLuint unit, GLuint texture) {
+            Object* object = find(Kind::Texture, texture);
+            GLenum  target = object ? object->target : 0;
+
+            if (target) recorder.textures[textureSlot(GL_TEXTURE0 + unit, target)] = texture;
+
+            global(key(Call::BindTexture, GL_TEXTURE0 + unit, target), encode<Call::BindTextureUnit>(unit, texture));
+        }
+
+        JOURNAL(TexImage2D, GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void*) {
+            GLenum  binding = bindingTarget(target);
+            GLuint  texture = boundTexture(binding);
+            Object* object  = find(Kind::Texture, texture);
+            if (object == nullptr) return;
+
+            object->target         = binding;
+            object->internalFormat = (GLenum) internalFormat;
+            setLevels(object, level, width, height);
+
+            journal(object, key(Call::TexImage2D, target, level),
+                    concat(encode<Call::BindTexture>(binding, texture), encode<Call::TexImage2D>(target, level, internalFormat, width, height, border, format, type, nullptr)));
+        }
+
+        JOURNAL(TexStorage2D, GLenum target, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height) {
+            GLuint  texture = boundTexture(target);
+            Object* object  = find(Kind::Texture, texture);
+            if (object == nullptr) return;
+
+            object->internalFormat = internalFormat;
+            setLevels(object, 0, width, height, levels);
+
+            journal(object, key(Call::TexStorage2D),
+                    concat(encode<Call::BindTexture>(target, texture), encode<Call::TexStorage2D>(target, levels, internalFormat, width, height)));
+        }
+
+        JOURNAL(TextureStorage2D, GLuint texture, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height) {
+            Object* object = find(Kind::Texture, texture);
+            if (object == nullptr) return;
+
+            object->internalFormat = internalFormat;
+            setLevels(object, 0, width, height, levels);
+
+            journal(object, key(Call::TexStorage2D), encode<Call::TextureStorage2D>(texture, levels, internalFormat, width, height));
+        }
+
+        JOURNAL(TexParameteri, GLenum target, GLenum name, GLint value) {
+            GLuint texture = boundTexture(target);
+
+            journal(find(Kind::Texture, texture), key(Call::TextureParameteri, name), encode<Call::TextureParameteri>(texture, name, value));
+        }
+
+        JOURNAL(TextureParameteri, GLuint texture, GLenum name, GLint value) {
+            journal(find(Kind::Texture, texture), key(Call::TextureParameteri, name), encode<Call::TextureParameteri>(texture, name, value));
+        }
+
+        // allocates the mip chain, its contents come with the read back like every other level
+        JOURNAL(GenerateMipmap, GLenum target) {
+            GLuint  texture = boundTexture(target);
+            Object* object  = find(Kind::Texture, texture);
+            if (object == nullptr || object->levels.empty()) return;
+
+            auto [width, height] = object->levels[0];
+
+            GLint levels = 1;
+            while ((std::max(width, height) >> levels) > 0) levels++;
+
+            setLevels(object, 0, width, height, levels);
+
+            journal(object, key(Call::GenerateMipmap),
+                    concat(encode<Call::BindTexture>(target, texture), encode<Call::GenerateMipmap>(target)));
+        }
+
+        JOURNAL(CreateSamplers, GLsizei count, GLuint*       samplers) { create<Call::CreateSamplers>(Kind::Sampler, count, samplers); }
+        JOURNAL(DeleteSamplers, GLsizei count, const GLuint* samplers) { destroy(Kind::Sampler, count, samplers); }
+
+        JOURNAL(SamplerParameteri, GLuint sampler, GLenum name, GLint value) {
+            journal(find(Kind::Sampler, sampler), key(Call::SamplerParameteri, name), encode<Call::SamplerParameteri>(sampler, name, value));
+        }
+
+        JOURNAL(BindSampler, GLuint unit, GLuint sampler) {
+            global(key(Call::BindSampler, unit), encode<Call::BindSampler>(unit, sampler));
+        }
+
+        JOURNAL(BindImageTexture, GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format) {
+            global(key(Call::BindImageTexture, unit), encode<Call::BindImageTexture>(unit, texture, level, layered, layer, access, format));
+        }
+
+        JOURNAL(CreateVertexArrays, GLsizei count, GLuint*       arrays) { create<Call::CreateVertexArrays>(Kind::VertexArray, count, arrays); }
+        JOURNAL(DeleteVertexArrays, GLsizei count, const GLuint* arrays) { destroy(Kind::VertexArray, count, arrays); }
+
+        JOURNAL(BindVertexArray, GLuint array) {
+            recorder.vertexArray = array;
+
+            global(key(Call::BindVertexArray), encode<Call::BindVertexArray>(array));
+        }
+
+        JOURNAL(EnableVertexArrayAttrib, GLuint array, GLuint index) {
+            journal(find(Kind::VertexArray, array), key(Call::EnableVertexArrayAttrib, index), encode<Call::EnableVertexArrayAttrib>(array, index));
+        }
+
+        JOURNAL(VertexArrayAttribFormat, GLuint array, GLuint index, GLint size, GLenum type, GLboolean normalized, GLuint offset) {
+            journal(find(Kind::VertexArray, array), key(Call::VertexArrayAttribFormat, index),
+                    encode<Call::VertexArrayAttribFormat>(array, index, size, type, normalized, offset));
+        }
+
+        JOURNAL(VertexArrayAttribIFormat, GLuint array, GLuint index, GLint size, GLenum type, GLuint offset) {
+            journal(find(Kind::VertexArray, array), key(Call::VertexArrayAttribFormat, index),
+                    encode<Call::VertexArrayAttribIFormat>(array, index, size, type, offset));
+        }
+
+        JOURNAL(VertexArrayAttribBinding, GLuint array, GLuint index, GLuint binding) {
+            journal(find(Kind::VertexArray, array), key(Call::VertexArrayAttribBinding, index), encode<Call::VertexArrayAttribBinding>(array, index, binding));
+        }
+
+        JOURNAL(VertexArrayBindingDivisor, GLuint array, GLuint binding, GLuint divisor) {
+            journal(find(Kind::VertexArray, array), key(Call::VertexArrayBindingDivisor, binding), encode<Call::VertexArrayBindingDivisor>(array, binding, divisor));
+        }
+
+        JOURNAL(VertexArrayVertexBuffer, GLuint array, GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride) {
+            journal(find(Kind::VertexArray, array), key(Call::VertexArrayVertexBuffer, binding),
+                    encode<Call::VertexArrayVertexBuffer>(array, binding, buffer, offset, stride));
+        }
+
+        JOURNAL(VertexArrayElementBuffer, GLuint array, GLuint buffer) {
+            journal(find(Kind::VertexArray, array), key(Call::VertexArrayElementBuffer), encode<Call::VertexArrayElementBuffer>(array, buffer));
+        }
+
+        JOURNAL(GenFramebuffers   , GLsizei count, GLuint*       framebuffers) { create<Call::CreateFramebuffers>(Kind::Framebuffer, count, framebuffers); }
+        JOURNAL(CreateFramebuffers, GLsizei count, GLuint*       framebuffers) { create<Call::CreateFramebuffers>(Kind::Framebuffer, count, framebuffers); }
+        JOURNAL(DeleteFramebuffers, GLsizei count, const GLuint* framebuffers) { destroy(Kind::Framebuffer, count, framebuffers); }
+
+        JOURNAL(BindFramebuffer, GLenum target, GLuint framebuffer) {
+            if (target != GL_READ_FRAMEBUFFER) {
+                recorder.drawFramebuffer = framebuffer;
+                global(key(Call::BindFramebuffer, GL_DRAW_FRAMEBUFFER), encode<Call::BindFramebuffer>(GL_DRAW_FRAMEBUFFER, framebuffer));
+            }
+
+            if (target != GL_DRAW_FRAMEBUFFER) {
+                recorder.readFramebuffer = framebuffer;
+                global(key(Call::BindFramebuffer, GL_READ_FRAMEBUFFER), encode<Call::BindFramebuffer>(GL_READ_FRAMEBUFFER, framebuffer));
+            }
+        }
+
+        JOURNAL(FramebufferTexture2D, GLenum target, GLenum attachment, GLenum textureTarget, GLuint texture, GLint level) {
+            GLuint framebuffer = (target == GL_READ_FRAMEBUFFER) ? recorder.readFramebuffer : recorder.drawFramebuffer;
+
+            journal(find(Kind::Framebuffer, framebuffer), key(Call::FramebufferTexture2D, attachment),
+                    concat(encode<Call::BindFramebuffer>(GL_FRAMEBUFFER, framebuffer),
+                           encode<Call::FramebufferTexture2D>(GL_FRAMEBUFFER, attachment, textureTarget, texture, level)));
+        }
+
+        // same key as FramebufferTexture2D, the last attachment made to a point is the one replayed
+        JOURNAL(NamedFramebufferTexture, GLuint framebuffer, GLenum attachment, GLuint texture, GLint level) {
+            journal(find(Kind::Framebuffer, framebuffer), key(Call::FramebufferTexture2D, attachment),
+                    encode<Call::NamedFramebufferTexture>(framebuffer, attachment, texture, level));
+        }
+
+        JOURNAL(NamedFramebufferTextureLayer, GLuint framebuffer, GLenum attachment, GLuint texture, GLint level, GLint layer) {
+            journal(find(Kind::Framebuffer, framebuffer), key(Call::FramebufferTexture2D, attachment),
+                    encode<Call::NamedFramebufferTextureLayer>(framebuffer, attachment, texture, level, layer));
+        }
+
+        JOURNAL(CreateShader, GLenum type, GLuint shader) { create(Kind::Shader, shader, encode<Call::CreateShader>(type, shader)); }
+
+        JOURNAL(DeleteShader, GLuint shader) { destroy(Kind::Shader, 1, &shader); }
+
+        JOURNAL(ShaderSource, GLuint shader, GLsizei count, const GLchar* const* strings, const GLint* lengths) {
+            journal(find(Kind::Shader, shader), key(Call::ShaderSource), encode<Call::ShaderSource>(shader, count, strings, lengths));
+        }
+
+        JOURNAL(ShaderBinary, GLsizei count, const GLuint* shaders, GLenum format, const void* binary, GLsizei length) {
+            for (GLsizei i = 0; i < count; i++) {
+                journal(find(Kind::Shader, shaders[i]), key(Call::ShaderSource), encode<Call::ShaderBinary>(1, &shaders[i], format, binary, length));
+            }
+        }
+
+        JOURNAL(SpecializeShader, GLuint shader, const GLchar* entry, GLuint count, const GLuint* indices, const GLuint* values) {
+            journal(find(Kind::Shader, shader), key(Call::SpecializeShader), encode<Call::SpecializeShader>(shader, entry, count, indices, values));
+        }
+
+        JOURNAL(CompileShader, GLuint shader) {
+            journal(find(Kind::Shader, shader), key(Call::CompileShader), encode<Call::CompileShader>(shader));
+        }
+
+        JOURNAL(CreateProgram, GLuint program) { create(Kind::Program, program, encode<Call::CreateProgram>(program)); }
+
+        JOURNAL(DeleteProgram, GLuint program) { destroy(Kind::Program, 1, &program); }
+
+        JOURNAL(AttachShader, GLuint program, GLuint shader) {
+            Object* object = find(Kind::Program, program);
+            if (object) object->attached.push_back(shader);
+        }
+
+        // shaders are usually deleted right after linking, the program keeps its own copy of them
+        JOURNAL(LinkProgram, GLuint program) {
+            Object* object = find(Kind::Program, program);
+            if (object == nullptr) return;
+
+            for (GLuint shader : object->attached) {
+                Object* source = find(Kind::Shader, shader);
+                if (source == nullptr) continue;
+
+                for (auto& entry : source->entries) journal(object, 0, entry.second);
+                journal(object, 0, encode<Call::AttachShader>(program, shader));
+            }
+
+            journal(object, 0, encode<Call::LinkProgram>(program));
+        }
+
+        JOURNAL(UseProgram, GLuint program) {
+            recorder.program = program;
+
+            global(key(Call::UseProgram), encode<Call::UseProgram>(program));
+        }
+
+        JOURNAL(ProgramParameteri, GLuint program, GLenum name, GLint value) {
+            journal(find(Kind::Program, program), key(Call::ProgramParameteri, name), encode<Call::ProgramParameteri>(program, name, value));
+        }
+
+        // compiled and linked by the one call, the record carries the sources
+        JOURNAL(CreateShaderProgramv, GLenum type, GLsizei count, const GLchar* const* strings, GLuint program) {
+            create(Kind::Program, program, encode<Call::CreateShaderProgramv>(type, count, strings, program));
+        }
+
+        JOURNAL(CreateProgramPipelines, GLsizei count, GLuint*       pipelines) { create<Call::CreateProgramPipelines>(Kind::Pipeline, count, pipelines); }
+        JOURNAL(DeleteProgramPipelines, GLsizei count, const GLuint* pipelines) { destroy(Kind::Pipeline, count, pipelines); }
+
+        JOURNAL(UseProgramStages, GLuint pipeline, GLbitfield stages, GLuint program) {
+            journal(find(Kind::Pipeline, pipeline), key(Call::UseProgramStages, stages), encode<Call::UseProgramStages>(pipeline, stages, program));
+        }
+
+        JOURNAL(BindProgramPipeline, GLuint pipeline) {
+            global(key(Call::BindProgramPipeline), encode<Call::BindProgramPipeline>(pipeline));
+        }
+
+        JOURNAL(UniformBlockBinding, GLuint program, GLuint index, GLuint binding) {
+            journal(find(Kind::Program, program), key(Call::UniformBlockBinding, index), encode<Call::UniformBlockBinding>(program, index, binding));
+        }
+
+        JOURNAL(Uniform1f       , GLint location, GLfloat x                                ) { uniform<Call::Uniform1f >(location, x         ); }
+        JOURNAL(Uniform1i       , GLint location, GLint   x                                ) { uniform<Call::Uniform1i >(location, x         ); }
+        JOURNAL(Uniform1ui      , GLint location, GLuint  x                                ) { uniform<Call::Uniform1ui>(location, x         ); }
+        JOURNAL(Uniform2f       , GLint location, GLfloat x, GLfloat y                     ) { uniform<Call::Uniform2f >(location, x, y      ); }
+        JOURNAL(Uniform3f       , GLint location, GLfloat x, GLfloat y, GLfloat z          ) { uniform<Call::Uniform3f >(location, x, y, z   ); }
+        JOURNAL(Uniform4f       , GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w) { uniform<Call::Uniform4f >(location, x, y, z, w); }
+        JOURNAL(Uniform2fv      , GLint location, GLsizei count, const GLfloat* value) { uniform<Call::Uniform2fv>(location, count, value); }
+        JOURNAL(Uniform3fv      , GLint location, GLsizei count, const GLfloat* value) { uniform<Call::Uniform3fv>(location, count, value); }
+        JOURNAL(Uniform4fv      , GLint location, GLsizei count, const GLfloat* value) { uniform<Call::Uniform4fv>(location, count, value); }
+        JOURNAL(UniformMatrix2fv, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { uniform<Call::UniformMatrix2fv>(location, count, transpose, value); }
+        JOURNAL(UniformMatrix3fv, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { uniform<Call::UniformMatrix3fv>(location, count, transpose, value); }
+        JOURNAL(UniformMatrix4fv, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { uniform<Call::UniformMatrix4fv>(location, count, transpose, value); }
+
+        JOURNAL(ProgramUniform1f , GLuint program, GLint location, GLfloat x) { programUniform<Call::ProgramUniform1f >(program, location, x); }
+        JOURNAL(ProgramUniform1i , GLuint program, GLint location, GLint   x) { programUniform<Call::ProgramUniform1i >(program, location, x); }
+        JOURNAL(ProgramUniform1ui, GLuint program, GLint location, GLuint  x) { programUniform<Call::ProgramUniform1ui>(program, location, x); }
+        JOURNAL(ProgramUniform2f , GLuint program, GLint location, GLfloat x, GLfloat y                      ) { programUniform<Call::ProgramUniform2f>(program, location, x, y      ); }
+        JOURNAL(ProgramUniform3f , GLuint program, GLint location, GLfloat x, GLfloat y, GLfloat z           ) { programUniform<Call::ProgramUniform3f>(program, location, x, y, z   ); }
+        JOURNAL(ProgramUniform4f , GLuint program, GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w) { programUniform<Call::ProgramUniform4f>(program, location, x, y, z, w); }
+        JOURNAL(ProgramUniform2fv, GLuint program, GLint location, GLsizei count, const GLfloat* value) { programUniform<Call::ProgramUniform2fv>(program, location, count, value); }
+        JOURNAL(ProgramUniform3fv, GLuint program, GLint location, GLsizei count, const GLfloat* value) { programUniform<Call::ProgramUniform3fv>(program, location, count, value); }
+        JOURNAL(ProgramUniform4fv, GLuint program, GLint location, GLsizei count, const GLfloat* value) { programUniform<Call::ProgramUniform4fv>(program, location, count, value); }
+        JOURNAL(ProgramUniform4i , GLuint program, GLint location, GLint x, GLint y, GLint z, GLint w) { programUniform<Call::ProgramUniform4i>(program, location, x, y, z, w); }
+        JOURNAL(ProgramUniformMatrix2fv, GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+            programUniform<Call::ProgramUniformMatrix2fv>(program, location, count, transpose, value);
+        }
+        JOURNAL(ProgramUniformMatrix3fv, GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+            programUniform<Call::ProgramUniformMatrix3fv>(program, location, count, transpose, value);
+        }
+        JOURNAL(ProgramUniformMatrix4fv, GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+            programUniform<Call::ProgramUniformMatrix4fv>(program, location, count, transpose, value);
+        }
+
+        #undef JOURNAL
+
+        // format and type a level of given internal format is read back and uploaded again with
+        static Pair<GLenum, GLenum> transferFormat(GLenum internalFormat) {
+            switch (internalFormat) {
+                case GL_RED : case GL_R8   :                     return { GL_RED , GL_UNSIGNED_BYTE };
+                case GL_RG  : case GL_RG8  :                     return { GL_RG  , GL_UNSIGNED_BYTE };
+                case GL_RGB : case GL_RGB8 : case GL_SRGB8:      return { GL_RGB , GL_UNSIGNED_BYTE };
+                case GL_RGBA: case GL_RGBA8: case GL_SRGB8_ALPHA8: return { GL_RGBA, GL_UNSIGNED_BYTE };
+
+                case GL_R16F   : case GL_R32F   : return { GL_RED , GL_FLOAT };
+                case GL_RG16F  : case GL_RG32F  : return { GL_RG  , GL_FLOAT };
+                case GL_RGB16F : case GL_RGB32F : return { GL_RGB , GL_FLOAT };
+                case GL_RGBA16F: case GL_RGBA32F: return { GL_RGBA, GL_FLOAT };
+
+                case GL_R32UI  : return { GL_RED_INTEGER , GL_UNSIGNED_INT };
+                case GL_RGBA32UI: return { GL_RGBA_INTEGER, GL_UNSIGNED_INT };
+
+                case GL_DEPTH_COMPONENT: case GL_DEPTH_COMPONENT16: case GL_DEPTH_COMPONENT24:
+                case GL_DEPTH_COMPONENT32: case GL_DEPTH_COMPONENT32F: return { GL_DEPTH_COMPONENT, GL_FLOAT };
+
+                case GL_DEPTH_STENCIL: case GL_DEPTH24_STENCIL8: return { GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8 };
+
+                default: return { 0, 0 };
+            }
+        }
+
+        // contents of every buffer and texture at the start of the captured frame
+        static Vector<uint8> readBack() { LOG_FUNCTION();
+            Vector<uint8> out;
+            Vector<uint8> data;
+
+            GLint packAlignment;
+            glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+            call<Call::PixelStorei>(GL_PACK_ALIGNMENT, 1);
+
+            int64 unpackAlignment = recorder.unpackAlignment;
+            recorder.unpackAlignment = 1;
+
+            extend(out, encode<Call::PixelStorei>(GL_UNPACK_ALIGNMENT, 1));
+
+            for (auto& [_, object] : recorder.objects) {
+                if (object.kind == Kind::Buffer && object.size > 0) {
+                    data.resize((uint64) object.size);
+                    glGetNamedBufferSubData(object.name, 0, (GLsizeiptr) object.size, data.data());
+
+                    extend(out, encode<Call::NamedBufferSubData>(object.name, 0, (GLsizeiptr) object.size, data.data()));
+                    continue;
+                }
+
+                if (object.kind != Kind::Texture || object.levels.empty()) continue;
+
+                auto [format, type] = transferFormat(object.internalFormat);
+
+                if (format == 0 || (object.target != GL_TEXTURE_2D && object.target != GL_TEXTURE_CUBE_MAP)) {
+                    LOG("Contents of texture " + toString(object.name) + " can not be captured.", 2);
+                    continue;
+                }
+
+                GLint faces = (object.target == GL_TEXTURE_CUBE_MAP) ? 6 : 1;
+
+                for (GLint level = 0; level < (GLint) object.levels.size(); level++) {
+                    auto [width, height] = object.levels[level];
+
+                    data.resize(imageSize(width, height, faces, format, type, 1));
+                    glGetTextureImage(object.name, level, format, type, (GLsizei) data.size(), data.data());
+
+                    if (faces == 1)
+                        extend(out, encode<Call::TextureSubImage2D>(object.name, level, 0, 0, (GLsizei) width, (GLsizei) height, format, type, data.data()));
+                    else
+                        extend(out, encode<Call::TextureSubImage3D>(object.name, level, 0, 0, 0, (GLsizei) width, (GLsizei) height, faces, format, type, data.data()));
+                }
+            }
+
+            recorder.unpackAlignment = unpackAlignment;
+            call<Call::PixelStorei>(GL_PACK_ALIGNMENT, packAlignment);
+
+            return out;
+        }
+
+        // journal in an order that can be replayed: every object is created first since they
+        // refer to each other, then their state by kind so shaders exist before programs link
+        static void beginCapture() {
+            Vector<const Object*> objects;
+            for (auto& [_, object] : recorder.objects) objects.push_back(&object);
+
+            std::sort(objects.begin(), objects.end(), [](const Object* a, const Object* b) {
+                if (a->kind != b->kind) return a->kind < b->kind;
+                return a->order < b->order;
+            });
+
+            Vector<uint8>& setup = recorder.setup;
+            setup.clear();
+
+            for (auto object : objects) extend(setup, object->entries[0].second);
+
+            for (auto object : objects)
+                for (uint64 i = 1; i < object->entries.size(); i++) extend(setup, object->entries[i].second);
+
+            extend(setup, readBack());
+
+            Vector<const Pair<uint64, Vector<uint8>>*> globals;
+            for (auto& [_, state] : recorder.globals) globals.push_back(&state);
+
+            std::sort(globals.begin(), globals.end(), [](auto a, auto b) { return a->first < b->first; });
+
+            for (auto state : globals) extend(setup, state->second);
+
+            extend(setup, encode<Call::ActiveTexture>(recorder.activeTexture));
+            extend(setup, encode<Call::PixelStorei  >(GL_UNPACK_ALIGNMENT, (GLint) recorder.unpackAlignment));
+
+            glGetIntegerv(GL_VIEWPORT, recorder.viewport);
+
+            recorder.frame.clear();
+            recorder.frameCalls = 0;
+            recorder.capturing  = true;
+        }
+
+        static const char* functionNames[] = {
+            "",
+            #define CAPTURE_NAME(name, result, arguments) #name,
+            CAPTURED_FUNCTIONS(CAPTURE_NAME)
+            #undef CAPTURE_NAME
+        };
+
+        static void (*const replayers[])(Reader&, ReplayState&) = {
+            nullptr,
+            #define CAPTURE_REPLAYER(name, result, arguments) &HookOf<Call::name>::Type::replay,
+            CAPTURED_FUNCTIONS(CAPTURE_REPLAYER)
+            #undef CAPTURE_REPLAYER
+        };
+
+        static void endCapture() { LOG_FUNCTION();
+            recorder.capturing = false;
+
+            Vector<uint8> out;
+            Writer writer{ out };
+
+            writer.bytes(magic, sizeof(magic));
+            writer.value<uint32>(version);
+            writer.bytes(recorder.viewport, sizeof(recorder.viewport));
+
+            writer.value<uint32>((uint32) Call::Count - 1);
+
+            for (uint16 id = 1; id < (uint16) Call::Count; id++) {
+                writer.value<uint16>(id);
+                writer.value<uint8 >((uint8) std::strlen(functionNames[id]));
+                writer.bytes(functionNames[id], std::strlen(functionNames[id]));
+            }
+
+            writer.value<uint64>(recorder.setup.size());
+            writer.bytes(recorder.setup.data(), recorder.setup.size());
+
+            writer.value<uint32>(recorder.frameCalls);
+            writer.value<uint64>(recorder.frame.size());
+            writer.bytes(recorder.frame.data(), recorder.frame.size());
+
+            std::ofstream file(recorder.path, std::ios::out | std::ios::binary);
+            file.write((const char*) out.data(), (std::streamsize) out.size());
+
+            if (!file) LOG("Writing capture " + recorder.path + " failed.", 2);
+            else       LOG("Captured " + toString(recorder.frameCalls) + " calls to " + recorder.path + ".", 1);
+
+            recorder.setup.clear(); recorder.setup.shrink_to_fit();
+            recorder.frame.clear(); recorder.frame.shrink_to_fit();
+        }
+
+        // runs the records of a stream, calls maps captured function ids to this build's,
+        // with a report the first calls are timed into it
+        static void execute(const uint8* data, uint64 size, const UnorderedMap<uint16, Call>& calls, ReplayState& state,
+                            OpenGLCapture::ReplayReport* report = nullptr, const Vector<GLuint>* queries = nullptr) {
+            Reader reader{ data, size };
+
+            for (uint64 index = 0; reader.position < size; index++) {
+                uint16 id     = reader.value<uint16>();
+                uint32 length = reader.value<uint32>();
+
+                if (reader.failed || length > size - reader.position) break;
+
+                auto found = calls.find(id);
+                Call call  = (found == calls.end()) ? Call::None : found->second;
+
+                state.timed   = report && index < report->calls.size();
+                state.cpuTime = 0.0;
+
+                if (state.timed) state.query = (*queries)[index];
+
+                if (call != Call::None) {
+                    Reader arguments{ data + reader.position, length };
+                    replayers[(uint16) call](arguments, state);
+                }
+
+                if (state.timed) {
+                    report->calls[index].name     = (call == Call::None) ? "unknown" : functionNames[(uint16) call];
+                    report->calls[index].cpuTime += state.cpuTime;
+                }
+
+                reader.position += length;
+            }
+
+            state.timed = false;
+        }
+    }
+
+    using namespace Capture;
+
+    void OpenGLCapture::install() { LOG_FUNCTION();
+        std::lock_guard<std::mutex> lock(recorder.mutex);
+
+        #define CAPTURE_INSTALL(name, result, arguments) HookOf<Call::name>::Type::install();
+        CAPTURED_FUNCTIONS(CAPTURE_INSTALL)
+        #undef CAPTURE_INSTALL
+
+        recorder.installed = true;
+
+        LOG("GL capture installed.", 1);
+    }
+
+    bool OpenGLCapture::isInstalled() { return recorder.installed; }
+
+    void OpenGLCapture::captureFrame(const String& path) {
+        if (!recorder.installed) {
+            LOG("GL capture is not installed, frame can not be captured.", 2);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(recorder.mutex);
+
+        recorder.path    = path;
+        recorder.pending = true;
+    }
+
+    void OpenGLCapture::frameBoundary() {
+        if (!recorder.installed) return;
+
+        std::lock_guard<std::mutex> lock(recorder.mutex);
+
+        if (recorder.capturing) endCapture();
+
+        if (recorder.pending) {
+            recorder.pending = false;
+            beginCapture();
+        }
+    }
+
+    bool OpenGLCapture::replay(const String& path, ReplayReport& report, uint32 iterations) { LOG_FUNCTION();
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+
+        if (!file) {
+            LOG("Capture " + path + " can not be opened.", 2);
+            return false;
+        }
+
+        Vector<uint8> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        Reader reader{ data.data(), data.size() };
+
+        char fileMagic[4];
+        for (auto& c : fileMagic) c = reader.value<char>();
+
+        if (std::memcmp(fileMagic, magic, sizeof(magic)) != 0 || reader.value<uint32>() != version) {
+            LOG("File " + path + " is not a capture of this version.", 2);
+            return false;
+        }
+
+        GLint viewport[4];
+        for (auto& value : viewport) value = reader.value<GLint>();
+
+        // ids are matched by name so captures survive changes of the function table
+        UnorderedMap<uint16, Call> calls;
+        uint32 functionCount = reader.value<uint32>();
+
+        for (uint32 i = 0; i < functionCount && !reader.failed; i++) {
+            uint16 id     = reader.value<uint16>();
+            uint8  length = reader.value<uint8 >();
+
+            if (length > reader.size - reader.position) { reader.failed = true; break; }
+
+            String name((const char*) reader.data + reader.position, length);
+            reader.position += length;
+
+            for (uint16 local = 1; local < (uint16) Call::Count; local++)
+                if (name == functionNames[local]) calls[id] = (Call) local;
+        }
+
+        uint64 setupSize = reader.value<uint64>();
+        if (setupSize > reader.size - reader.position) reader.failed = true;
+
+        const uint8* setup = reader.data + reader.position;
+        reader.position += reader.failed ? 0 : setupSize;
+
+        uint32 frameCalls = reader.value<uint32>();
+        uint64 frameSize  = reader.value<uint64>();
+        if (frameSize > reader.size - reader.position) reader.failed = true;
+
+        const uint8* frame = reader.data + reader.position;
+
+        if (reader.failed) {
+            LOG("Capture " + path + " is truncated.", 2);
+            return false;
+        }
+
+        // headless replays get a hidden window of the captured size
+        GLFWwindow* window = nullptr;
+
+        if (glfwGetCurrentContext() == nullptr) {
+            if (!glfwInit()) {
+                LOG("GLFW initialization for the replay failed.", 2);
+                return false;
+            }
+
+            glfwWindowHint(GLFW_VISIBLE              , GLFW_FALSE);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+            glfwWindowHint(GLFW_OPENGL_PROFILE       , GLFW_OPENGL_CORE_PROFILE);
+
+            window = glfwCreateWindow(std::max(viewport[2], 1), std::max(viewport[3], 1), "replay", nullptr, nullptr);
+
+            if (window == nullptr) {
+                LOG("Creating the replay context failed.", 2);
+                return false;
+            }
+
+            glfwMakeContextCurrent(window);
+            gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
+        }
+
+        ReplayState state;
+        execute(setup, setupSize, calls, state);
+        glFinish();
+
+        Vector<GLuint> queries(frameCalls);
+        glGenQueries((GLsizei) frameCalls, queries.data());
+
+        report = ReplayReport();
+        report.calls.resize(frameCalls);
+
+        iterations = std::max<uint32>(iterations, 1);
+
+        for (uint32 iteration = 0; iteration < iterations; iteration++) {
+            execute(frame, frameSize, calls, state, &report, &queries);
+            glFinish();
+
+            // calls that were skipped never started their query
+            for (uint32 i = 0; i < frameCalls; i++) {
+                GLuint64 elapsed = 0;
+                if (glIsQuery(queries[i])) glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+
+                report.calls[i].gpuTime += (double) elapsed / 1e6;
+            }
+        }
+
+        for (auto& timing : report.calls) {
+            timing.cpuTime /= iterations;
+            timing.gpuTime /= iterations;
+
+            report.cpuTime += timing.cpuTime;
+            report.gpuTime += timing.gpuTime;
+        }
+
+        glDeleteQueries((GLsizei) frameCalls, queries.data());
+
+        if (window) glfwDestroyWindow(window);
+
+        LOG("Replayed " + toString(frameCalls) + " calls: CPU " + toString(report.cpuTime) + " ms, GPU " + toString(report.gpuTime) + " ms.", 1);
+        return true;
+    }
+}
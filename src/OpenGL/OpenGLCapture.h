@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Core/Aliases.h>
+
+namespace PetrolEngine {
+    // Capture of the GL command stream at the glad function pointer level.
+    //
+    // When installed (OpenGLContext::captureEnabled or the PETROL_GL_CAPTURE environment variable
+    // set before OpenGLContext::init) every GL function the backend calls goes through a recording
+    // wrapper. Between frames only a compacted journal of the live objects is kept (creation,
+    // allocation, parameters, shader sources and binaries, vertex array setup) together with the
+    // last value of every bit of global state, so memory does not grow with the number of frames.
+    // A captured file holds that journal, the contents of every buffer and texture read back when
+    // the frame started and then the frame's calls with their buffer and texture payloads.
+    //
+    // Captures assume a single context. Uniform locations and query results are taken as
+    // recorded, so replays are exact on the same driver and close anywhere else.
+    class OpenGLCapture {
+    public:
+        struct CallTiming {
+            String name;
+            double cpuTime = 0.0; // milliseconds spent in the call on the CPU
+            double gpuTime = 0.0; // milliseconds the GPU spent on the call (GL_TIME_ELAPSED)
+        };
+
+        struct ReplayReport {
+            Vector<CallTiming> calls; // every call of the frame in order, averaged over iterations
+
+            double cpuTime = 0.0;
+            double gpuTime = 0.0;
+        };
+
+        // hooks the glad pointers, has to be called after glad loaded them
+        static void install();
+        static bool isInstalled();
+
+        // the calls between the next two frame boundaries are written to path
+        static void captureFrame(const String& path);
+
+        // called by the renderer once the frame's work is submitted
+        static void frameBoundary();
+
+        // re-executes a capture, creating a hidden window when no context is current,
+        // setup is replayed once and the frame iterations times
+        static bool replay(const String& path, ReplayReport& report, uint32 iterations = 1);
+    };
+}
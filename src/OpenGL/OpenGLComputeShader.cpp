@@ -0,0 +1,199 @@
+#include <PCH.h>
+
+#include "OpenGLComputeShader.h"
+#include "OpenGLCapabilities.h"
+#include "OpenGLStorageBuffer.h"
+#include "OpenGLMemory.h"
+
+#include <Core/Renderer/Shader.h>
+#include <Core/Renderer/Texture.h>
+
+#include <shaderc/shaderc.hpp>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace PetrolEngine {
+    bool OpenGLComputeShader::isSupported() {
+        return OpenGLCapabilities::get().computeShaders;
+    }
+
+    OpenGLComputeShader::OpenGLComputeShader(String name, String computeCode, ShaderSpecialization specialization) {
+        this->computeShaderSourceCode = computeCode;
+        this->name                    = name;
+        this->specialization          = std::move(specialization);
+
+        this->compile();
+    }
+
+    OpenGLComputeShader::~OpenGLComputeShader() {
+        OpenGLMemory::untrack(GL_PROGRAM, ID);
+
+        glDeleteShader (computeShaderID);
+        glDeleteProgram(ID);
+    }
+
+    int OpenGLComputeShader::compile() { LOG_FUNCTION();
+        bool spirv = OpenGLCapabilities::get().spirv;
+
+        if (!spirv) {
+            compileNative(computeShaderSourceCode);
+            return ID ? 0 : 1;
+        }
+
+        // edited sources and other specializations must not pick up a stale binary
+        char sourceHash[17];
+        std::snprintf(sourceHash, sizeof(sourceHash), "%016llx", (unsigned long long) std::hash<String>()(computeShaderSourceCode));
+
+        String cacheName = "glsl_" + name + "_" + sourceHash + specialization.getKey() + ".comp.cache";
+
+        if (std::filesystem::exists(cacheName) && !Shader::alwaysCompile) {
+            std::ifstream file(cacheName, std::ios::in | std::ios::binary);
+
+            file.seekg (0, file.end);
+            int length = file.tellg();
+            file.seekg (0, file.beg);
+
+            Vector<uint32> byteCode(length / sizeof(uint32));
+            file.read((char*) byteCode.data(), length);
+
+            compileFromSpv(&byteCode);
+            return ID ? 0 : 1;
+        }
+
+        shaderc::Compiler compiler;
+        shaderc::CompileOptions options;
+
+        options.SetOptimizationLevel(shaderc_optimization_level_performance);
+        options.SetTargetEnvironment(shaderc_target_env_opengl, 450);
+
+        auto result = compiler.CompileGlslToSpv(computeShaderSourceCode, shaderc_glsl_compute_shader, name.c_str(), options);
+
+        if (result.GetCompilationStatus()) {
+            LOG("Compute shader compilation to SPIR-V failed, compiling GLSL: " + result.GetErrorMessage(), 2);
+
+            compileNative(computeShaderSourceCode);
+            return ID ? 0 : 1;
+        }
+
+        Vector<uint32> byteCode(result.cbegin(), result.cend());
+
+        std::ofstream file(cacheName, std::ios::out | std::ios::binary);
+        file.write((char*) byteCode.data(), byteCode.size() * sizeof(uint32));
+        file.close();
+
+        compileFromSpv(&byteCode);
+        return ID ? 0 : 1;
+    }
+
+    void OpenGLComputeShader::compileFromSpv(Vector<uint32>* computeByteCode) { LOG_FUNCTION();
+        uint32 shader  = glCreateShader(GL_COMPUTE_SHADER);
+        uint32 program = glCreateProgram();
+
+        glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, computeByteCode->data(), (GLsizei) (computeByteCode->size() * sizeof(uint32)));
+
+        Vector<GLuint> indices, values;
+
+        for (auto& constant : specialization.getConstants()) {
+            indices.push_back(constant.id   );
+            values .push_back(constant.value);
+        }
+
+        glSpecializeShader(shader, "main", (GLuint) indices.size(), indices.data(), values.data());
+
+        replaceProgram(shader, program);
+    }
+
+    void OpenGLComputeShader::compileNative(const String& computeShaderSourceCode) { LOG_FUNCTION();
+        uint32 shader  = glCreateShader(GL_COMPUTE_SHADER);
+        uint32 program = glCreateProgram();
+
+        String specialized = specialization.specializeGlsl(computeShaderSourceCode);
+
+        const char* source = specialized.c_str();
+        glShaderSource (shader, 1, &source, nullptr);
+        glCompileShader(shader);
+
+        replaceProgram(shader, program);
+    }
+
+    void OpenGLComputeShader::replaceProgram(uint32 shader, uint32 program) {
+        GLint  success;
+        GLchar infoLog[1024];
+
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+
+        if (!success) {
+            glGetShaderInfoLog(shader, 1024, nullptr, infoLog);
+            LOG("ERROR::SHADER_COMPILATION_ERROR(COMPUTE " + name + "): " + infoLog, 2);
+        }
+
+        glAttachShader(program, shader);
+        glLinkProgram (program);
+
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+        // if error occurred keep the previous program
+        if (!success) {
+            glGetProgramInfoLog(program, 1024, nullptr, infoLog);
+            LOG("PROGRAM_LINKING_ERROR(" + name + "): " + String(infoLog), 2);
+
+            glDeleteShader (shader );
+            glDeleteProgram(program);
+            return;
+        }
+
+        if (this->computeShaderID) glDeleteShader (this->computeShaderID);
+        if (this->             ID) glDeleteProgram(this->             ID);
+
+        OpenGLMemory::untrack(GL_PROGRAM, this->ID);
+
+        this->computeShaderID = shader;
+        this->             ID = program;
+
+        OpenGLMemory::trackProgram(ID, name);
+
+        GLint size[3];
+        glGetProgramiv(program, GL_COMPUTE_WORK_GROUP_SIZE, size);
+
+        localSize = glm::uvec3((uint32) size[0], (uint32) size[1], (uint32) size[2]);
+    }
+
+    void OpenGLComputeShader::dispatch(uint32 x, uint32 y, uint32 z) { LOG_FUNCTION();
+        glUseProgram(ID);
+        glDispatchCompute(x, y, z);
+    }
+
+    void OpenGLComputeShader::dispatchIndirect(const OpenGLStorageBuffer* arguments, uint32 offset) { LOG_FUNCTION();
+        glUseProgram(ID);
+
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, arguments->getID());
+        glDispatchComputeIndirect((GLintptr) offset);
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+    }
+
+    void OpenGLComputeShader::memoryBarrier(GLbitfield barriers) {
+        glMemoryBarrier(barriers);
+    }
+
+    void OpenGLComputeShader::bindStorageBuffer(uint32 binding, const OpenGLStorageBuffer* buffer) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer ? buffer->getID() : 0);
+    }
+
+    void OpenGLComputeShader::bindImage(uint32 unit, const Texture* texture, uint32 level, GLenum access, GLenum format) {
+        // layered so every layer of arrays, cube maps and 3D textures is accessible
+        glBindImageTexture(unit, texture ? texture->getID() : 0, (GLint) level, GL_TRUE, 0, access, format);
+    }
+
+    void OpenGLComputeShader::setInt  (int location, int              x) { glProgramUniform1i (ID, location, x); }
+    void OpenGLComputeShader::setUint (int location, uint             x) { glProgramUniform1ui(ID, location, x); }
+    void OpenGLComputeShader::setFloat(int location, float            x) { glProgramUniform1f (ID, location, x); }
+    void OpenGLComputeShader::setVec2 (int location, const glm::vec2& x) { glProgramUniform2fv(ID, location, 1, glm::value_ptr(x)); }
+    void OpenGLComputeShader::setVec3 (int location, const glm::vec3& x) { glProgramUniform3fv(ID, location, 1, glm::value_ptr(x)); }
+    void OpenGLComputeShader::setVec4 (int location, const glm::vec4& x) { glProgramUniform4fv(ID, location, 1, glm::value_ptr(x)); }
+    void OpenGLComputeShader::setIVec4(int location, const glm::ivec4& x) { glProgramUniform4i (ID, location, x.x, x.y, x.z, x.w); }
+    void OpenGLComputeShader::setMat4 (int location, const glm::mat4& x) { glProgramUniformMatrix4fv(ID, location, 1, GL_FALSE, glm::value_ptr(x)); }
+}
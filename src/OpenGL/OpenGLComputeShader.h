@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Core/Aliases.h>
+#include <glm/glm.hpp>
+
+#include <glad/glad.h>
+
+#include "OpenGLShaderVariants.h"
+
+namespace PetrolEngine {
+    class Texture;
+    class OpenGLStorageBuffer;
+
+    // Compute program. Source is compiled to SPIR-V with shaderc (cached like OpenGLShader) when the
+    // context takes SPIR-V shaders, otherwise the GLSL source is compiled by the driver.
+    // SPIR-V shaders keep no uniform names, so uniforms are set by their explicit location:
+    //
+    // layout(location = 0) uniform uint count;
+    // layout(std430, binding = 2) buffer Particles { Particle particles[]; };
+    // layout(binding = 0, rgba8) uniform writeonly image2D target;
+    //
+    // Specialization constants are applied with glSpecializeShader. The SPIR-V module is cached per
+    // source and specialization, named like the modules of OpenGLShader.
+    class OpenGLComputeShader {
+    public:
+        OpenGLComputeShader(String name, String computeCode, ShaderSpecialization specialization = {});
+        ~OpenGLComputeShader();
+
+        static bool isSupported();
+
+        void compileFromSpv(Vector<uint32>* computeByteCode);
+        void compileNative (const String&   computeShaderSourceCode);
+
+        // x, y, z are work group counts
+        void dispatch        (uint32 x, uint32 y = 1, uint32 z = 1);
+        // arguments buffer holds uvec3 work group counts at given offset
+        void dispatchIndirect(const OpenGLStorageBuffer* arguments, uint32 offset = 0);
+
+        // glMemoryBarrier bits, has to be issued before results of a dispatch are read by anything else
+        static void memoryBarrier(GLbitfield barriers);
+
+        static void bindStorageBuffer(uint32 binding, const OpenGLStorageBuffer* buffer);
+        static void bindImage        (uint32 unit, const Texture* texture, uint32 level, GLenum access, GLenum format);
+
+        void setInt  (int location, int              x);
+        void setUint (int location, uint             x);
+        void setFloat(int location, float            x);
+        void setVec2 (int location, const glm::vec2& x);
+        void setVec3 (int location, const glm::vec3& x);
+        void setVec4 (int location, const glm::vec4& x);
+        void setIVec4(int location, const glm::ivec4& x);
+        void setMat4 (int location, const glm::mat4& x);
+
+        uint32            getID       () const { return ID;        }
+        const glm::uvec3& getLocalSize() const { return localSize; }
+
+        String name;
+        String computeShaderSourceCode;
+        ShaderSpecialization specialization;
+
+    private:
+        int compile();
+        void replaceProgram(uint32 shader, uint32 program);
+
+        uint32 ID              = 0;
+        uint32 computeShaderID = 0;
+
+        glm::uvec3 localSize{1, 1, 1};
+    };
+}
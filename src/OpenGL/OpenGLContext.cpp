@@ -1,12 +1,69 @@
 #include <PCH.h>
 
 #include "OpenGLContext.h"
+#include "OpenGLCapture.h"
+#include "OpenGLCapabilities.h"
+#include "OpenGLStateAccess.h"
+#include "OpenGLMultiView.h"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <cstdlib>
+
 namespace PetrolEngine {
+	bool OpenGLContext::captureEnabled = false;
+
+    // what the renderer uses without a fallback, vertex attrib binding, base instance draws, storage
+    // buffers and GLSL 4.30 for its own shaders, all core in GL 4.3
+    static void checkSupported(const OpenGLCapabilities& capabilities) {
+        String missing;
+
+        auto require = [&](bool supported, const char* name) { if (!supported) missing += String(missing.empty() ? "" : ", ") + name; };
+
+        require(capabilities.vertexAttribBinding, "vertex attrib binding");
+        require(capabilities.baseInstance       , "base instance"        );
+        require(capabilities.storageBuffers     , "storage buffers"      );
+        require(capabilities.textureStorage     , "texture storage"      );
+        require(capabilities.glslVersion >= 430 , "GLSL 4.30"            );
+
+        if (!missing.empty())
+            LOG("OpenGL " + toString(capabilities.major) + "." + toString(capabilities.minor) + " is not supported, the renderer needs GL 4.3 ("
+                + missing + " missing).", 3);
+
+        // the highest binding is the multi view Views buffer, the renderer turns off what does not fit
+        if (capabilities.storageBuffers && !capabilities.storageBinding(OpenGLMultiView::viewsBinding))
+            LOG("Only " + toString(capabilities.limits.storageBufferBindings) + " storage buffer bindings, "
+                + "instanced quads, GPU skinning or multi view draws past them are disabled.", 2);
+    }
+
 	int OpenGLContext::init(void* loaderProc) {
-        return (loaderProc == nullptr) ? gladLoadGL() : gladLoadGLLoader((GLADloadproc)loaderProc);
+        int loaded = (loaderProc == nullptr) ? gladLoadGL() : gladLoadGLLoader((GLADloadproc)loaderProc);
+
+        if (loaded) {
+            OpenGLCapabilities::detect();
+            OpenGLCapabilities::log();
+
+            const OpenGLCapabilities& capabilities = OpenGLCapabilities::get();
+
+            checkSupported(capabilities);
+
+            // before the capture, which records whatever the named calls end up being, forced to test the emulation
+            if (!capabilities.directStateAccess || std::getenv("PETROL_GL_EMULATE_DSA")) OpenGLStateAccess::install();
+
+            // the driver picks the number of compiler threads, shaders compile while the program is linked
+            if      (GLAD_GL_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+            else if (GLAD_GL_ARB_parallel_shader_compile) glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        }
+
+        const char* capturePath = std::getenv("PETROL_GL_CAPTURE");
+
+        if (loaded && (captureEnabled || capturePath)) {
+            OpenGLCapture::install();
+
+            if (capturePath && *capturePath) OpenGLCapture::captureFrame(capturePath);
+        }
+
+        return loaded;
 	}
 }
\ No newline at end of file
@@ -6,5 +6,9 @@ namespace PetrolEngine {
 	class OpenGLContext : public GraphicsContext {
 	public:
 		int init(void* loaderProc) override;
+
+		// installs OpenGLCapture over the loaded functions, so does setting PETROL_GL_CAPTURE
+		// to a file path, which also captures the first full frame to it
+		static bool captureEnabled;
 	};
 }
\ No newline at end of file
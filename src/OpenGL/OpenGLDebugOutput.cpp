@@ -0,0 +1,227 @@
+#include <PCH.h>
+
+#include "OpenGLDebugOutput.h"
+#include "OpenGLCapabilities.h"
+#include "OpenGLTracer.h"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+
+namespace PetrolEngine {
+    struct DebugMessage {
+        GLenum source   = 0;
+        GLenum type     = 0;
+        GLenum severity = 0;
+        GLuint id       = 0;
+        String text;
+
+        uint32 count      = 0;
+        uint64 firstFrame = 0;
+        uint64 lastFrame  = 0;
+
+        // scope names are string literals, their addresses are stable
+        UnorderedMap<const char*, uint32> scopes;
+    };
+
+    struct DebugOutputState {
+        std::mutex mutex;
+
+        UnorderedMap<uint64, DebugMessage> messages;
+
+        OpenGLDebugOutput::Statistics current;
+        OpenGLDebugOutput::Statistics last;
+
+        uint64 frame   = 0;
+        bool   enabled = false;
+    };
+
+    static DebugOutputState& getState() {
+        static DebugOutputState instance;
+        return instance;
+    }
+
+    static const char* getSourceName(GLenum source) {
+        switch (source) {
+            case GL_DEBUG_SOURCE_API            : return "API";
+            case GL_DEBUG_SOURCE_WINDOW_SYSTEM  : return "window system";
+            case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+            case GL_DEBUG_SOURCE_THIRD_PARTY    : return "third party";
+            case GL_DEBUG_SOURCE_APPLICATION    : return "application";
+            default                             : return "other";
+        }
+    }
+
+    static const char* getTypeName(GLenum type) {
+        switch (type) {
+            case GL_DEBUG_TYPE_ERROR              : return "error";
+            case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+            case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR : return "undefined behavior";
+            case GL_DEBUG_TYPE_PORTABILITY        : return "portability";
+            case GL_DEBUG_TYPE_PERFORMANCE        : return "performance";
+            default                               : return "other";
+        }
+    }
+
+    static const char* getScopeName(const char* scope) { return scope ? scope : "outside of any scope"; }
+
+    static void APIENTRY onMessage(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* text, const void*) {
+        // debug groups and markers are annotations, not messages about the driver
+        if (type == GL_DEBUG_TYPE_MARKER || type == GL_DEBUG_TYPE_PUSH_GROUP || type == GL_DEBUG_TYPE_POP_GROUP) return;
+
+        const char* scope = OpenGLTracer::getCurrentScope();
+
+        auto& state = getState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        auto& statistics = state.current;
+        statistics.messages++;
+
+        if      (type == GL_DEBUG_TYPE_ERROR      ) statistics.errors     ++;
+        else if (type == GL_DEBUG_TYPE_PERFORMANCE) statistics.performance++;
+        else                                        statistics.other      ++;
+
+        String content = length < 0 ? String(text) : String(text, (size_t) length);
+
+        // some drivers end messages with a line break
+        while (!content.empty() && (content.back() == '\n' || content.back() == '\r' || content.back() == '\0')) content.pop_back();
+
+        // some drivers use one id for a whole class of messages (Mesa for every invalid enum), the text tells them apart
+        uint64 key = std::hash<String>()(content) ^ ((uint64) id << 32) ^ ((uint64) source << 16) ^ (uint64) type;
+
+        DebugMessage& message = state.messages[key];
+
+        if (message.count == 0) {
+            message.source     = source;
+            message.type       = type;
+            message.severity   = severity;
+            message.id         = id;
+            message.text       = std::move(content);
+            message.firstFrame = state.frame;
+
+            statistics.unique++;
+        }
+
+        message.count++;
+        message.lastFrame = state.frame;
+
+        // the same message from another draw or pass is worth a line of its own
+        if (message.scopes[scope]++ > 0) return;
+
+        LOG(String("GL ") + getTypeName(type) + " (" + getSourceName(source) + ", " + toString(id) + ") in "
+            + getScopeName(scope) + ": " + message.text, severity == GL_DEBUG_SEVERITY_NOTIFICATION ? 1 : 2);
+    }
+
+    bool OpenGLDebugOutput::enable(bool notifications) { LOG_FUNCTION();
+        if (!OpenGLCapabilities::get().debugOutput) {
+            LOG("KHR_debug is not supported, debug output is disabled.", 1);
+            return false;
+        }
+
+        GLint flags = 0;
+        glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+
+        if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+            LOG("Context was not created with the debug flag, the driver may report only a few messages.", 1);
+
+        glEnable(GL_DEBUG_OUTPUT);
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE                 , 0, nullptr, GL_TRUE                           );
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, notifications ? GL_TRUE : GL_FALSE);
+
+        glDebugMessageCallback(onMessage, nullptr);
+
+        OpenGLTracer::trackScopes(true);
+
+        auto& state = getState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        state.enabled = true;
+        return true;
+    }
+
+    void OpenGLDebugOutput::disable() { LOG_FUNCTION();
+        auto& state = getState();
+
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (!state.enabled) return;
+
+            state.enabled = false;
+        }
+
+        glDebugMessageCallback(nullptr, nullptr);
+        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+        glDisable(GL_DEBUG_OUTPUT);
+
+        OpenGLTracer::trackScopes(false);
+    }
+
+    bool OpenGLDebugOutput::isEnabled() {
+        auto& state = getState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        return state.enabled;
+    }
+
+    void OpenGLDebugOutput::frameBoundary() {
+        auto& state = getState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        if (!state.enabled) return;
+
+        state.last    = state.current;
+        state.current = {};
+        state.frame++;
+    }
+
+    OpenGLDebugOutput::Statistics OpenGLDebugOutput::getFrameStatistics() {
+        auto& state = getState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        return state.last;
+    }
+
+    void OpenGLDebugOutput::logSummary() { LOG_FUNCTION();
+        Vector<DebugMessage> messages;
+
+        {
+            auto& state = getState();
+            std::lock_guard<std::mutex> lock(state.mutex);
+
+            for (auto& it : state.messages) messages.push_back(it.second);
+        }
+
+        if (messages.empty()) {
+            LOG("No GL debug messages.", 1);
+            return;
+        }
+
+        std::sort(messages.begin(), messages.end(), [](const DebugMessage& a, const DebugMessage& b) { return a.count > b.count; });
+
+        LOG(toString(messages.size()) + " distinct GL debug messages:", 1);
+
+        for (auto& message : messages) {
+            Vector<Pair<const char*, uint32>> scopes(message.scopes.begin(), message.scopes.end());
+            std::sort(scopes.begin(), scopes.end(), [](const Pair<const char*, uint32>& a, const Pair<const char*, uint32>& b) { return a.second > b.second; });
+
+            String from;
+            for (auto& scope : scopes) from += String(from.empty() ? "" : ", ") + getScopeName(scope.first) + " x" + toString(scope.second);
+
+            LOG("  " + toString(message.count) + "x " + getTypeName(message.type) + " (" + getSourceName(message.source) + ", "
+                + toString(message.id) + "), frames " + toString(message.firstFrame) + "-" + toString(message.lastFrame)
+                + ": " + message.text, 1);
+            LOG("    from " + from, 1);
+        }
+    }
+
+    void OpenGLDebugOutput::clear() {
+        auto& state = getState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        state.messages.clear();
+        state.current = {};
+        state.last    = {};
+    }
+}
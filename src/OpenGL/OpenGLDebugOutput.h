@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Core/Aliases.h>
+
+#include <glad/glad.h>
+
+namespace PetrolEngine {
+    // Driver messages through the KHR_debug callback, for the renderer's debug mode.
+    //
+    // Output is synchronous, so the callback runs inside the call that caused the message and the
+    // message is attributed to the innermost tracer scope (TRACE_FUNCTION / TRACE_SCOPE) active at
+    // that moment: the draw, upload or pass. Messages are deduplicated by source, type, id and text, each
+    // one is logged the first time it shows up in a scope and only counted after that.
+    //
+    // Drivers send most performance hints (implicit syncs, shader recompiles, slow paths) only to
+    // contexts created with the debug flag (GLFW_OPENGL_DEBUG_CONTEXT).
+    class OpenGLDebugOutput {
+    public:
+        struct Statistics {
+            uint32 messages    = 0;
+            uint32 errors      = 0;
+            uint32 performance = 0;
+            uint32 other       = 0; // deprecated, undefined behavior, portability and other
+            uint32 unique      = 0; // messages seen for the first time
+        };
+
+        // has to be called on the GL thread, returns false without KHR_debug,
+        // notifications are informational messages (buffer placement and such) and are noisy on most drivers
+        static bool enable (bool notifications = false);
+        static void disable();
+        static bool isEnabled();
+
+        // called by the renderer at the end of every frame
+        static void frameBoundary();
+
+        // of the last finished frame
+        static Statistics getFrameStatistics();
+
+        // every distinct message since enable or clear, most frequent first, with the scopes it came from
+        static void logSummary();
+        static void clear();
+    };
+}
@@ -0,0 +1,213 @@
+#include <PCH.h>
+
+#include "OpenGLDynamicResolution.h"
+#include "OpenGLFramebuffer.h"
+#include "OpenGLShader.h"
+#include "OpenGLTexture.h"
+#include "OpenGLVertexArray.h"
+#include "OpenGLTracer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace PetrolEngine {
+    static const char* upscaleVertexSource = R"(
+        #version 430
+
+        layout(location = 0) out vec2 uv;
+
+        void main() {
+            // one triangle covering the viewport
+            uv          = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+            gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+        }
+    )";
+
+    // contrast adaptive sharpening on top of the bilinear fetch: the weight of the cross around a
+    // pixel shrinks where its neighbourhood already has high contrast, so edges do not ring
+    static const char* sharpenFragmentSource = R"(
+        #version 430
+
+        layout(location = 0) in  vec2 uv;
+        layout(location = 0) out vec4 color;
+
+        layout(binding = 0) uniform sampler2D source;
+
+        uniform vec2  sourceScale; // part of the target the scene covers
+        uniform float sharpness;
+
+        void main() {
+            vec2 texel = 1.0 / vec2(textureSize(source, 0));
+            vec2 at    = clamp(uv * sourceScale, texel * 0.5, sourceScale - texel * 0.5);
+
+            vec4 center = texture(source, at);
+            vec3 north  = texture(source, at + vec2(0.0,  texel.y)).rgb;
+            vec3 south  = texture(source, at - vec2(0.0,  texel.y)).rgb;
+            vec3 east   = texture(source, at + vec2(texel.x,  0.0)).rgb;
+            vec3 west   = texture(source, at - vec2(texel.x,  0.0)).rgb;
+
+            vec3 low  = min(center.rgb, min(min(north, south), min(east, west)));
+            vec3 high = max(center.rgb, max(max(north, south), max(east, west)));
+
+            vec3 amplitude = sqrt(clamp(min(low, 1.0 - high) / max(high, 1e-5), 0.0, 1.0));
+            vec3 weight    = -amplitude * mix(0.125, 0.2, sharpness);
+
+            color = vec4((center.rgb + (north + south + east + west) * weight) / (1.0 + 4.0 * weight), center.a);
+        }
+    )";
+
+    OpenGLDynamicResolution::OpenGLDynamicResolution() { LOG_FUNCTION();
+        for (auto& pair : queries) glCreateQueries(GL_TIMESTAMP, 2, pair);
+    }
+
+    OpenGLDynamicResolution::~OpenGLDynamicResolution() { LOG_FUNCTION();
+        for (auto& pair : queries) glDeleteQueries(2, pair);
+
+        // attachments are owned by the framebuffer
+        delete target;
+        delete sharpenShader;
+
+        glDeleteVertexArrays(1, &emptyVertexArray);
+    }
+
+    void OpenGLDynamicResolution::setScaleRange(float minimum, float maximum) {
+        minScale = std::clamp(minimum , 0.1f, 1.0f);
+        maxScale = std::clamp(maximum, minScale, 1.0f);
+        scale    = std::clamp(scale  , minScale, maxScale);
+    }
+
+    void OpenGLDynamicResolution::setOverride(float scale) {
+        overrideScale = scale > 0.f ? std::clamp(scale, 0.1f, 1.0f) : 0.f;
+
+        if (overrideScale > 0.f) this->scale = overrideScale;
+    }
+
+    void OpenGLDynamicResolution::setFilter(Filter filter, float sharpness) { LOG_FUNCTION();
+        this->filter    = filter;
+        this->sharpness = std::clamp(sharpness, 0.f, 1.f);
+
+        if (filter != Filter::Sharpen || sharpenShader) return;
+
+        sharpenShader = new OpenGLShader("dynamic_resolution_sharpen", upscaleVertexSource, sharpenFragmentSource, "");
+        glCreateVertexArrays(1, &emptyVertexArray);
+    }
+
+    void OpenGLDynamicResolution::beginFrame() {
+        GLuint* pair = queries[frame % framesInFlight];
+
+        // the slot was written framesInFlight frames ago, a result that is not there yet is skipped
+        if (frame >= framesInFlight) {
+            GLint available = 0;
+            glGetQueryObjectiv(pair[1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+            if (available) {
+                GLuint64 begin, end;
+                glGetQueryObjectui64v(pair[0], GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(pair[1], GL_QUERY_RESULT, &end  );
+
+                update((double) (end - begin) / 1e6);
+            }
+        }
+
+        glQueryCounter(pair[0], GL_TIMESTAMP);
+    }
+
+    void OpenGLDynamicResolution::endFrame() {
+        glQueryCounter(queries[frame % framesInFlight][1], GL_TIMESTAMP);
+        frame++;
+    }
+
+    void OpenGLDynamicResolution::update(double milliseconds) {
+        gpuFrameTime = (float) milliseconds;
+
+        if (overrideScale > 0.f || milliseconds <= 0.0) return;
+
+        // shading cost follows the pixel count, so the scale goes with the square root of the time,
+        // aiming a bit under the target to keep headroom for spikes
+        float desired = scale * std::sqrt(0.9f * targetFrameTime / gpuFrameTime);
+        desired = std::clamp(desired, minScale, maxScale);
+
+        // down quickly when over budget, up slowly so it does not oscillate
+        float rate = desired < scale ? 0.5f : 0.1f;
+
+        scale += (desired - scale) * rate;
+    }
+
+    void OpenGLDynamicResolution::resize(int width, int height) { LOG_FUNCTION();
+        delete target;
+
+        FramebufferSpecification specification;
+        specification.width  = (uint32) width;
+        specification.height = (uint32) height;
+
+        target = new OpenGLFramebuffer(specification);
+        color  = new OpenGLTexture(width, height, TextureFormat::RGBA8          );
+        depth  = new OpenGLTexture(width, height, TextureFormat::DEPTH24STENCIL8);
+
+        // sampled without mipmaps by the upscale
+        glTextureParameteri(color->getID(), GL_TEXTURE_MIN_FILTER, GL_LINEAR       );
+        glTextureParameteri(color->getID(), GL_TEXTURE_WRAP_S    , GL_CLAMP_TO_EDGE);
+        glTextureParameteri(color->getID(), GL_TEXTURE_WRAP_T    , GL_CLAMP_TO_EDGE);
+
+        target->addAttachment(color);
+        target->addAttachment(depth);
+
+        targetWidth  = width;
+        targetHeight = height;
+    }
+
+    glm::ivec2 OpenGLDynamicResolution::beginScene(int x, int y, int width, int height) { TRACE_FUNCTION();
+        // before resizing, attaching to the new target rebinds the default framebuffer
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &outputFramebuffer);
+
+        if (width != targetWidth || height != targetHeight) resize(width, height);
+
+        outputViewport[0] = x;
+        outputViewport[1] = y;
+        outputViewport[2] = width;
+        outputViewport[3] = height;
+
+        sceneSize.x = std::max((int) std::lround(width  * scale), 1);
+        sceneSize.y = std::max((int) std::lround(height * scale), 1);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, target->getID());
+        glViewport(0, 0, sceneSize.x, sceneSize.y);
+
+        // clears the whole target, so the upscale never reads what an earlier, larger scale left
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+        return sceneSize;
+    }
+
+    void OpenGLDynamicResolution::endScene() { TRACE_FUNCTION();
+        GLint x = outputViewport[0], y = outputViewport[1], width = outputViewport[2], height = outputViewport[3];
+
+        if (filter == Filter::Bilinear || sharpenShader == nullptr || !sharpenShader->isValid()) {
+            glBlitNamedFramebuffer(target->getID(), (GLuint) outputFramebuffer,
+                                   0, 0, sceneSize.x, sceneSize.y,
+                                   x, y, x + width, y + height,
+                                   GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, (GLuint) outputFramebuffer);
+            glViewport(x, y, width, height);
+            return;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, (GLuint) outputFramebuffer);
+        glViewport(x, y, width, height);
+
+        // the output keeps its depth for the 2D pass, the upscale neither tests nor writes it
+        glDisable(GL_DEPTH_TEST);
+
+        sharpenShader->bind();
+        sharpenShader->setVec2 ("sourceScale", (float) sceneSize.x / (float) targetWidth, (float) sceneSize.y / (float) targetHeight);
+        sharpenShader->setFloat("sharpness"  , sharpness);
+
+        glBindTextureUnit(0, color->getID());
+
+        OpenGLVertexArray::bind(emptyVertexArray);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glEnable(GL_DEPTH_TEST);
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <Core/Aliases.h>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace PetrolEngine {
+    class OpenGLFramebuffer;
+    class OpenGLShader;
+    class Texture;
+
+    // Renders the 3D scene at a fraction of the output resolution and upscales it to the output,
+    // 2D batches are drawn over it at native resolution. The scale follows the GPU time of the
+    // renderer's frames against a target, measured with GL_TIMESTAMP queries that are read back
+    // framesInFlight frames later so the CPU never waits for them.
+    // The target is allocated at output size and the scene is drawn into its lower left corner,
+    // so a new scale costs nothing. While it is used occlusion culling builds its pyramid from the
+    // scene's corner of the target's depth instead of the texture set with setOcclusionDepthSource.
+    class OpenGLDynamicResolution {
+    public:
+        enum class Filter { Bilinear, Sharpen };
+
+        static constexpr uint32 framesInFlight = 3;
+
+        OpenGLDynamicResolution();
+        ~OpenGLDynamicResolution();
+
+        // milliseconds
+        void setTargetFrameTime(float milliseconds) { targetFrameTime = milliseconds; }
+        void setScaleRange     (float minimum, float maximum);
+
+        // fixed scale, 0 gives control back to the measured frame time
+        void setOverride(float scale);
+
+        // sharpness from 0 to 1, only used by Filter::Sharpen
+        void setFilter(Filter filter, float sharpness = 0.5f);
+
+        float getScale       () const { return scale;        }
+
+        // depth attachment of the target and the part of it the current scene covers
+        const Texture* getDepth    () const { return depth;     }
+        glm::ivec2     getSceneSize() const { return sceneSize; }
+        float getGpuFrameTime() const { return gpuFrameTime; } // last measured, milliseconds
+
+        // around everything the renderer submits in a frame
+        void beginFrame();
+        void endFrame  ();
+
+        // binds the target, sets the viewport to the scaled size and clears it, returns that size
+        glm::ivec2 beginScene(int x, int y, int width, int height);
+
+        // upscales into the framebuffer and viewport that were bound at beginScene
+        void endScene();
+
+    private:
+        void update(double milliseconds);
+        void resize(int width, int height);
+
+        float targetFrameTime = 1000.f / 60.f;
+        float minScale        = 0.5f;
+        float maxScale        = 1.0f;
+        float scale           = 1.0f;
+        float overrideScale   = 0.0f;
+        float gpuFrameTime    = 0.0f;
+
+        Filter filter    = Filter::Bilinear;
+        float  sharpness = 0.5f;
+
+        GLuint queries[framesInFlight][2] = {};
+        uint64 frame = 0;
+
+        OpenGLFramebuffer* target = nullptr;
+        Texture*           color  = nullptr;
+        Texture*           depth  = nullptr;
+        int targetWidth  = 0;
+        int targetHeight = 0;
+
+        OpenGLShader* sharpenShader = nullptr;
+        GLuint        emptyVertexArray = 0;
+
+        // scene size and what was bound when the scene began
+        glm::ivec2 sceneSize{0, 0};
+        GLint      outputFramebuffer = 0;
+        GLint      outputViewport[4] = { 0, 0, 0, 0 };
+    };
+}
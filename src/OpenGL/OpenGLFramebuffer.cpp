@@ -4,6 +4,7 @@
 
 #include "Core/Renderer/Texture.h"
 #include "OpenGLFramebuffer.h"
+#include "OpenGLMemory.h"
 
 namespace PetrolEngine{
 
@@ -32,9 +33,13 @@ namespace PetrolEngine{
                 LOG("Framebuffer is not complete!", 2);
 
             glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            // the object itself has no storage, its attachments are counted as render targets
+            OpenGLMemory::track(OpenGLMemory::Category::Framebuffer, GL_FRAMEBUFFER, id, 0, "Framebuffer");
         }
 
         OpenGLFramebuffer::~OpenGLFramebuffer() {
+            OpenGLMemory::untrack(GL_FRAMEBUFFER, id);
             glDeleteFramebuffers(1, &id);
 
             for(Texture* texture : attachments) delete texture;
@@ -44,6 +49,8 @@ namespace PetrolEngine{
             attachments.push_back(texture);
             //texture = nullptr;
 
+            OpenGLMemory::classify(GL_TEXTURE, texture->getID(), OpenGLMemory::Category::RenderTarget);
+
             glBindFramebuffer(GL_FRAMEBUFFER, id);
 
             glBindTexture(GL_TEXTURE_2D, texture->getID());
@@ -61,4 +68,33 @@ namespace PetrolEngine{
             glBindFramebuffer(GL_FRAMEBUFFER, 0);
         }
 
+        static GLenum attachmentPoint(const Texture* texture) {
+            return texture->format == TextureFormat::DEPTH24STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_COLOR_ATTACHMENT0;
+        }
+
+        void OpenGLFramebuffer::addLayeredAttachment(Texture* texture) {
+            attachments.push_back(texture);
+            layered    .push_back(texture);
+
+            OpenGLMemory::classify(GL_TEXTURE, texture->getID(), OpenGLMemory::Category::RenderTarget);
+
+            // named, the draw framebuffer binding is left alone
+            if(selectedLayer < 0) glNamedFramebufferTexture     (id, attachmentPoint(texture), texture->getID(), 0);
+            else                  glNamedFramebufferTextureLayer(id, attachmentPoint(texture), texture->getID(), 0, selectedLayer);
+
+            if(glCheckNamedFramebufferStatus(id, GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                LOG("Framebuffer is not complete!", 2);
+        }
+
+        void OpenGLFramebuffer::selectLayer(int32 layer) {
+            if(layer == selectedLayer) return;
+
+            selectedLayer = layer;
+
+            for(Texture* texture : layered) {
+                if(layer < 0) glNamedFramebufferTexture     (id, attachmentPoint(texture), texture->getID(), 0);
+                else          glNamedFramebufferTextureLayer(id, attachmentPoint(texture), texture->getID(), 0, layer);
+            }
+        }
+
 }
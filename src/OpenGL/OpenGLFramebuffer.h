@@ -12,7 +12,18 @@ namespace PetrolEngine{
 
         void addAttachment(Texture* texture) override;
 
+        // every layer (cube map face, array layer) is attached at once, draws pick theirs with gl_Layer
+        void addLayeredAttachment(Texture* texture);
+
+        // attaches only that layer of every layered attachment, -1 attaches all of them again
+        void selectLayer(int32 layer);
+        int32 getSelectedLayer() const { return selectedLayer; }
+
         ~OpenGLFramebuffer() override;
+
+    private:
+        Vector<Texture*> layered;
+        int32 selectedLayer = -1;
     };
 
 }
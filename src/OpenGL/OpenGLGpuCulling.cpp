@@ -0,0 +1,449 @@
+#include <PCH.h>
+
+#include <glad/glad.h>
+
+#include "OpenGLGpuCulling.h"
+#include "OpenGLCapabilities.h"
+#include "OpenGLTracer.h"
+
+#include <Core/Renderer/Texture.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace PetrolEngine {
+    static const char* cullShaderSource = R"(
+        #version 430
+        layout(local_size_x = 64) in;
+
+        struct CullObject {
+            vec4  aabbMin;
+            vec4  aabbMax;
+            uvec4 draw;
+            uvec4 range;
+        };
+
+        struct DrawCommand {
+            uint count;
+            uint instanceCount;
+            uint firstIndex;
+            int  baseVertex;
+            uint baseInstance;
+        };
+
+        layout(std430, binding = 5) readonly  buffer Objects  { CullObject  objects [];  };
+        layout(std430, binding = 6) writeonly buffer Commands { DrawCommand commands[];  };
+        layout(std430, binding = 7)           buffer Counts   { uint        counts  [];  };
+
+        layout(location =  0) uniform vec4 frustumPlanes[6];
+        layout(location =  6) uniform mat4 pyramidViewProjection;
+        layout(location =  7) uniform uint objectCount;
+        layout(location =  8) uniform uint compact;
+        layout(location =  9) uniform uint occlusion;
+        layout(location = 10) uniform vec2 pyramidSize;
+        layout(location = 11) uniform uint pyramidLevels;
+
+        layout(binding = 0) uniform sampler2D pyramid;
+
+        const uint statisticsCounters = 3;
+
+        bool frustumVisible(vec3 aabbMin, vec3 aabbMax) {
+            vec3  center = (aabbMin + aabbMax) * 0.5;
+            float radius = length(aabbMax - aabbMin) * 0.5;
+
+            for (int i = 0; i < 6; i++) {
+                vec4 plane = frustumPlanes[i];
+
+                // bounding sphere first, then the box corner furthest along the plane normal
+                if (dot(plane.xyz, center) + plane.w < -radius) return false;
+
+                vec3 positive = mix(aabbMin, aabbMax, greaterThan(plane.xyz, vec3(0.0)));
+                if (dot(plane.xyz, positive) + plane.w < 0.0) return false;
+            }
+
+            return true;
+        }
+
+        bool occlusionVisible(vec3 aabbMin, vec3 aabbMax) {
+            vec2  rectMin = vec2(1.0);
+            vec2  rectMax = vec2(0.0);
+            float nearest = 1.0;
+
+            for (int i = 0; i < 8; i++) {
+                vec3 corner = vec3(
+                    (i & 1) != 0 ? aabbMax.x : aabbMin.x,
+                    (i & 2) != 0 ? aabbMax.y : aabbMin.y,
+                    (i & 4) != 0 ? aabbMax.z : aabbMin.z
+                );
+
+                vec4 clip = pyramidViewProjection * vec4(corner, 1.0);
+
+                // crosses the near plane, cannot be tested reliably
+                if (clip.w <= 0.0) return true;
+
+                vec3 ndc = clip.xyz / clip.w;
+
+                rectMin = min(rectMin, ndc.xy * 0.5 + 0.5);
+                rectMax = max(rectMax, ndc.xy * 0.5 + 0.5);
+                nearest = min(nearest, ndc.z  * 0.5 + 0.5);
+            }
+
+            rectMin = clamp(rectMin, vec2(0.0), vec2(1.0));
+            rectMax = clamp(rectMax, vec2(0.0), vec2(1.0));
+
+            // pick the level where the rectangle covers at most 2x2 texels
+            vec2  size  = (rectMax - rectMin) * pyramidSize;
+            float level = clamp(ceil(log2(max(max(size.x, size.y), 1.0))), 0.0, float(pyramidLevels - 1));
+
+            float depth = max(
+                max(textureLod(pyramid, rectMin                    , level).r, textureLod(pyramid, vec2(rectMax.x, rectMin.y), level).r),
+                max(textureLod(pyramid, vec2(rectMin.x, rectMax.y), level).r, textureLod(pyramid, rectMax                    , level).r)
+            );
+
+            return nearest <= depth;
+        }
+
+        void main() {
+            uint index = gl_GlobalInvocationID.x;
+            if (index >= objectCount) return;
+
+            CullObject object = objects[index];
+
+            bool visible = frustumVisible(object.aabbMin.xyz, object.aabbMax.xyz);
+
+            if (!visible) atomicAdd(counts[1], 1u);
+            else if (occlusion != 0u && !occlusionVisible(object.aabbMin.xyz, object.aabbMax.xyz)) {
+                visible = false;
+                atomicAdd(counts[2], 1u);
+            }
+
+            if (visible) atomicAdd(counts[0], 1u);
+
+            DrawCommand command;
+            command.count         = object.draw.x;
+            command.instanceCount = visible ? 1u : 0u;
+            command.firstIndex    = object.range.x;
+            command.baseVertex    = 0;
+            command.baseInstance  = object.draw.y;
+
+            if (compact == 0u) {
+                commands[floatBitsToUint(object.aabbMin.w)] = command;
+                return;
+            }
+
+            if (!visible) return;
+
+            uint slot = atomicAdd(counts[statisticsCounters + object.draw.z], 1u);
+            commands[object.draw.w + slot] = command;
+        }
+    )";
+
+    static const char* depthCopyShaderSource = R"(
+        #version 430
+        layout(local_size_x = 8, local_size_y = 8) in;
+
+        layout(binding = 0) uniform sampler2D depth;
+        layout(binding = 0, r32f) uniform writeonly image2D destination;
+
+        void main() {
+            ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+            if (any(greaterThanEqual(coord, imageSize(destination)))) return;
+
+            imageStore(destination, coord, vec4(texelFetch(depth, coord, 0).r));
+        }
+    )";
+
+    static const char* depthDownsampleShaderSource = R"(
+        #version 430
+        layout(local_size_x = 8, local_size_y = 8) in;
+
+        layout(binding = 0, r32f) uniform readonly  image2D source;
+        layout(binding = 1, r32f) uniform writeonly image2D destination;
+
+        void main() {
+            ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+            ivec2 size  = imageSize(destination);
+            if (any(greaterThanEqual(coord, size))) return;
+
+            ivec2 sourceSize = imageSize(source);
+
+            // odd source sizes fold the last row/column into the border texels
+            int lastX = ((sourceSize.x & 1) != 0 && coord.x == size.x - 1) ? 2 : 1;
+            int lastY = ((sourceSize.y & 1) != 0 && coord.y == size.y - 1) ? 2 : 1;
+
+            float depth = 0.0;
+
+            for (int y = 0; y <= lastY; y++)
+                for (int x = 0; x <= lastX; x++)
+                    depth = max(depth, imageLoad(source, min(coord * 2 + ivec2(x, y), sourceSize - 1)).r);
+
+            imageStore(destination, coord, vec4(depth));
+        }
+    )";
+
+    // grows the buffer when needed, otherwise orphans it so in-flight draws are not waited for
+    static void reserveBuffer(uint32 buffer, uint32& capacity, uint32 size) {
+        if (size <= capacity) {
+            glNamedBufferData(buffer, capacity, nullptr, GL_DYNAMIC_DRAW);
+            return;
+        }
+
+        capacity = capacity ? capacity : 1024;
+        while (capacity < size) capacity *= 2;
+
+        glNamedBufferData(buffer, capacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    bool OpenGLGpuCulling::isSupported() {
+        const OpenGLCapabilities& capabilities = OpenGLCapabilities::get();
+
+        return capabilities.computeShaders && capabilities.multiDrawIndirect && capabilities.baseInstance
+            && capabilities.glslVersion >= 430 && capabilities.storageBinding(countsBinding);
+    }
+
+    OpenGLGpuCulling::OpenGLGpuCulling() { LOG_FUNCTION();
+        drawCount = OpenGLCapabilities::get().indirectCount;
+
+        cullShader      = new OpenGLComputeShader("culling"         , cullShaderSource           );
+        depthCopyShader = new OpenGLComputeShader("depth_copy"      , depthCopyShaderSource      );
+        depthDownShader = new OpenGLComputeShader("depth_downsample", depthDownsampleShaderSource);
+
+        glCreateBuffers(1, &objectsBuffer );
+        glCreateBuffers(1, &commandsBuffer);
+        glCreateBuffers(1, &countsBuffer  );
+
+        for (auto& readback : readbacks) {
+            glCreateBuffers  (1, &readback.buffer);
+            glNamedBufferData(readback.buffer, statisticsCounters * sizeof(uint32), nullptr, GL_STREAM_READ);
+        }
+
+        glCreateSamplers(1, &depthSampler);
+        glSamplerParameteri(depthSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glSamplerParameteri(depthSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glCreateSamplers(1, &pyramidSampler);
+        glSamplerParameteri(pyramidSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glSamplerParameteri(pyramidSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glSamplerParameteri(pyramidSampler, GL_TEXTURE_WRAP_S    , GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(pyramidSampler, GL_TEXTURE_WRAP_T    , GL_CLAMP_TO_EDGE);
+
+        if (!drawCount) LOG("Indirect draw count is not supported, culled draws use plain multi draw indirect.", 1);
+    }
+
+    OpenGLGpuCulling::~OpenGLGpuCulling() { LOG_FUNCTION();
+        delete cullShader;
+        delete depthCopyShader;
+        delete depthDownShader;
+
+        glDeleteBuffers(1, &objectsBuffer );
+        glDeleteBuffers(1, &commandsBuffer);
+        glDeleteBuffers(1, &countsBuffer  );
+
+        glDeleteSamplers(1, &depthSampler  );
+        glDeleteSamplers(1, &pyramidSampler);
+
+        glDeleteTextures(1, &depthPyramid);
+
+        for (auto& readback : readbacks) {
+            glDeleteBuffers(1, &readback.buffer);
+
+            if (readback.fence) glDeleteSync((GLsync) readback.fence);
+        }
+    }
+
+    void OpenGLGpuCulling::begin(const glm::mat4& viewProjection) {
+        this->viewProjection = viewProjection;
+
+        objects.clear();
+        batches.clear();
+    }
+
+    uint32 OpenGLGpuCulling::addBatch() {
+        batches.push_back({ (uint32) objects.size(), 0 });
+
+        return (uint32) batches.size() - 1;
+    }
+
+    void OpenGLGpuCulling::addObject(uint32 batch, const glm::vec3& aabbMin, const glm::vec3& aabbMax, uint32 indexCount, uint32 firstIndex, uint32 baseInstance) {
+        uint32 slot = (uint32) objects.size();
+
+        CullObject object;
+        object.aabbMin = glm::vec4(aabbMin, 0.f);
+        object.aabbMax = glm::vec4(aabbMax, 0.f);
+        object.draw    = glm::uvec4(indexCount, baseInstance, batch, batches[batch].firstCommand);
+        object.range   = glm::uvec4(firstIndex, 0, 0, 0);
+
+        std::memcpy(&object.aabbMin.w, &slot, sizeof(uint32));
+
+        objects.push_back(object);
+        batches[batch].commandCount++;
+    }
+
+    void OpenGLGpuCulling::cull() { TRACE_FUNCTION();
+        statistics.submitted = (uint32) objects.size();
+
+        if (objects.empty()) return;
+
+        // statistics of earlier frames, oldest first, read only once the gpu is done with them so nothing stalls
+        for (uint32 i = 0; i < statisticsFrames; i++) {
+            StatisticsReadback& readback = readbacks[(nextReadback + i) % statisticsFrames];
+
+            if (!readback.fence) continue;
+
+            GLenum status = glClientWaitSync((GLsync) readback.fence, 0, 0);
+
+            // the newer ones are not done either
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+
+            uint32 counters[statisticsCounters];
+            glGetNamedBufferSubData(readback.buffer, 0, sizeof(counters), counters);
+
+            statistics.visible         = counters[0];
+            statistics.frustumCulled   = counters[1];
+            statistics.occlusionCulled = counters[2];
+
+            glDeleteSync((GLsync) readback.fence);
+            readback.fence = nullptr;
+        }
+
+        uint32 objectsSize  = (uint32) (objects.size() * sizeof(CullObject));
+        uint32 commandsSize = (uint32) (objects.size() * sizeof(DrawElementsIndirectCommand));
+        uint32 countsSize   = (uint32) ((statisticsCounters + batches.size()) * sizeof(uint32));
+
+        reserveBuffer(objectsBuffer , objectsCapacity , objectsSize );
+        reserveBuffer(commandsBuffer, commandsCapacity, commandsSize);
+        reserveBuffer(countsBuffer  , countsCapacity  , countsSize  );
+
+        glNamedBufferSubData (objectsBuffer, 0, objectsSize, objects.data());
+        glClearNamedBufferData(countsBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+        // Gribb-Hartmann plane extraction, rows of the column major matrix
+        glm::vec4 planes[6];
+        for (int i = 0; i < 3; i++) {
+            glm::vec4 row (viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+            glm::vec4 last(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+            planes[i * 2 + 0] = last + row;
+            planes[i * 2 + 1] = last - row;
+        }
+
+        for (auto& plane : planes) plane = plane / glm::length(glm::vec3(plane.x, plane.y, plane.z));
+
+        bool occlusion = occlusionCulling && pyramidValid;
+
+        glUseProgram(cullShader->getID());
+
+        glUniform4fv      ( 0, 6, glm::value_ptr(planes[0]));
+        glUniformMatrix4fv( 6, 1, GL_FALSE, glm::value_ptr(pyramidViewProjection));
+        glUniform1ui      ( 7, (uint32) objects.size());
+        glUniform1ui      ( 8, drawCount ? 1 : 0);
+        glUniform1ui      ( 9, occlusion ? 1 : 0);
+        glUniform2f       (10, (float) pyramidWidth, (float) pyramidHeight);
+        glUniform1ui      (11, pyramidLevels);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, objectsBinding , objectsBuffer );
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, commandsBinding, commandsBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, countsBinding  , countsBuffer  );
+
+        if (occlusion) {
+            glBindTextureUnit(0, depthPyramid  );
+            glBindSampler    (0, pyramidSampler);
+        }
+
+        cullShader->dispatch(((uint32) objects.size() + 63) / 64);
+
+        if (occlusion) glBindSampler(0, 0);
+
+        OpenGLComputeShader::memoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        // with every readback still in flight this frame's counters are skipped
+        StatisticsReadback& readback = readbacks[nextReadback];
+
+        if (!readback.fence) {
+            glCopyNamedBufferSubData(countsBuffer, readback.buffer, 0, 0, statisticsCounters * sizeof(uint32));
+
+            readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            nextReadback   = (nextReadback + 1) % statisticsFrames;
+        }
+    }
+
+    void OpenGLGpuCulling::drawBatch(uint32 batch) { TRACE_FUNCTION();
+        const Batch& drawBatch = batches[batch];
+
+        if (drawBatch.commandCount == 0) return;
+
+        auto offset = (const void*) (uint64) (drawBatch.firstCommand * sizeof(DrawElementsIndirectCommand));
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandsBuffer);
+
+        if (!drawCount) {
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, offset, (GLsizei) drawBatch.commandCount, sizeof(DrawElementsIndirectCommand));
+            return;
+        }
+
+        auto countOffset = (GLintptr) ((statisticsCounters + batch) * sizeof(uint32));
+
+        glBindBuffer(GL_PARAMETER_BUFFER, countsBuffer);
+
+        if (GLAD_GL_VERSION_4_6)
+            glMultiDrawElementsIndirectCount   (GL_TRIANGLES, GL_UNSIGNED_INT, offset, countOffset, (GLsizei) drawBatch.commandCount, sizeof(DrawElementsIndirectCommand));
+        else
+            glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, offset, countOffset, (GLsizei) drawBatch.commandCount, sizeof(DrawElementsIndirectCommand));
+    }
+
+    void OpenGLGpuCulling::createDepthPyramid(uint32 width, uint32 height) { LOG_FUNCTION();
+        glDeleteTextures(1, &depthPyramid);
+
+        pyramidWidth  = width;
+        pyramidHeight = height;
+        pyramidLevels = (uint32) std::floor(std::log2((float) std::max(width, height))) + 1;
+
+        glCreateTextures  (GL_TEXTURE_2D, 1, &depthPyramid);
+        glTextureStorage2D(depthPyramid, (GLsizei) pyramidLevels, GL_R32F, (GLsizei) width, (GLsizei) height);
+    }
+
+    void OpenGLGpuCulling::buildDepthPyramid(const Texture* depth, const glm::mat4& viewProjection, glm::ivec2 region) { TRACE_FUNCTION();
+        GLint width, height;
+        glGetTextureLevelParameteriv(depth->getID(), 0, GL_TEXTURE_WIDTH , &width );
+        glGetTextureLevelParameteriv(depth->getID(), 0, GL_TEXTURE_HEIGHT, &height);
+
+        // the copy reads the texels under the pyramid's level 0, which starts at the origin
+        if (region.x > 0 && region.y > 0) {
+            width  = std::min(width , region.x);
+            height = std::min(height, region.y);
+        }
+
+        if (width <= 0 || height <= 0) return;
+
+        if ((uint32) width != pyramidWidth || (uint32) height != pyramidHeight)
+            createDepthPyramid((uint32) width, (uint32) height);
+
+        glBindTextureUnit (0, depth->getID());
+        glBindSampler     (0, depthSampler  );
+        glBindImageTexture(0, depthPyramid, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+        depthCopyShader->dispatch((width + 7) / 8, (height + 7) / 8);
+
+        glBindSampler(0, 0);
+
+        for (uint32 level = 1; level < pyramidLevels; level++) {
+            OpenGLComputeShader::memoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+            uint32 levelWidth  = std::max(pyramidWidth  >> level, 1u);
+            uint32 levelHeight = std::max(pyramidHeight >> level, 1u);
+
+            glBindImageTexture(0, depthPyramid, (GLint) level - 1, GL_FALSE, 0, GL_READ_ONLY , GL_R32F);
+            glBindImageTexture(1, depthPyramid, (GLint) level    , GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+            depthDownShader->dispatch((levelWidth + 7) / 8, (levelHeight + 7) / 8);
+        }
+
+        OpenGLComputeShader::memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        pyramidViewProjection = viewProjection;
+        pyramidValid          = true;
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <Core/Aliases.h>
+#include <glm/glm.hpp>
+
+#include "OpenGLComputeShader.h"
+
+namespace PetrolEngine {
+    class Texture;
+
+    // Compute shader frustum and occlusion culling.
+    // Objects are grouped into batches (draws sharing vao, shader and textures), visible objects of every
+    // batch are compacted into an indirect command buffer and drawn with one multi draw indirect call.
+    // Occlusion is tested against a hierarchical depth pyramid built from the previous frame's depth.
+    class OpenGLGpuCulling {
+    public:
+        struct Statistics {
+            uint32 submitted       = 0;
+            uint32 visible         = 0;
+            uint32 frustumCulled   = 0;
+            uint32 occlusionCulled = 0;
+        };
+
+        // indirect command layout expected by glMultiDrawElementsIndirect
+        struct DrawElementsIndirectCommand {
+            uint32 count;
+            uint32 instanceCount;
+            uint32 firstIndex;
+            int32  baseVertex;
+            uint32 baseInstance;
+        };
+
+        static constexpr uint32 objectsBinding  = 5;
+        static constexpr uint32 commandsBinding = 6;
+        static constexpr uint32 countsBinding   = 7;
+
+        static bool isSupported();
+
+        OpenGLGpuCulling();
+        ~OpenGLGpuCulling();
+
+        // every compute program linked
+        bool isCompiled() const { return cullShader->getID() && depthCopyShader->getID() && depthDownShader->getID(); }
+
+        void   begin   (const glm::mat4& viewProjection);
+        uint32 addBatch();
+        // objects have to be added batch after batch, baseInstance is the index passed to the shader
+        void   addObject(uint32 batch, const glm::vec3& aabbMin, const glm::vec3& aabbMax, uint32 indexCount, uint32 firstIndex, uint32 baseInstance);
+
+        void cull();
+        // expects the batch's vertex array and program to be bound
+        void drawBatch(uint32 batch);
+
+        // builds the depth pyramid used by the next frame's occlusion test, from the lower left region
+        // of depth when it is given, otherwise the whole texture
+        void buildDepthPyramid(const Texture* depth, const glm::mat4& viewProjection, glm::ivec2 region = { 0, 0 });
+
+        const Statistics& getStatistics() const { return statistics; }
+
+        bool occlusionCulling = true;
+
+    private:
+        struct CullObject {
+            glm::vec4  aabbMin; // w - command slot when draws are not compacted
+            glm::vec4  aabbMax;
+            glm::uvec4 draw;    // index count, base instance, batch, first command of batch
+            glm::uvec4 range;   // first index
+        };
+
+        struct Batch {
+            uint32 firstCommand;
+            uint32 commandCount;
+        };
+
+        static constexpr uint32 statisticsCounters = 3;
+        static constexpr uint32 statisticsFrames   = 3; // frames the counters can be in flight before one is skipped
+
+        // counters of one frame copied out of the counts buffer, which is orphaned every frame
+        struct StatisticsReadback {
+            uint32 buffer = 0;
+            void*  fence  = nullptr;
+        };
+
+        void createDepthPyramid(uint32 width, uint32 height);
+
+        Vector<CullObject> objects;
+        Vector<Batch     > batches;
+
+        glm::mat4 viewProjection{1.f};
+        glm::mat4 pyramidViewProjection{1.f};
+
+        OpenGLComputeShader* cullShader      = nullptr;
+        OpenGLComputeShader* depthCopyShader = nullptr;
+        OpenGLComputeShader* depthDownShader = nullptr;
+
+        uint32 objectsBuffer       = 0; uint32 objectsCapacity  = 0;
+        uint32 commandsBuffer      = 0; uint32 commandsCapacity = 0;
+        uint32 countsBuffer        = 0; uint32 countsCapacity   = 0;
+
+        uint32 depthSampler        = 0;
+        uint32 pyramidSampler      = 0;
+
+        uint32 depthPyramid        = 0;
+        uint32 pyramidWidth        = 0;
+        uint32 pyramidHeight       = 0;
+        uint32 pyramidLevels       = 0;
+        bool   pyramidValid        = false;
+
+        bool   drawCount           = false;
+
+        StatisticsReadback readbacks[statisticsFrames];
+        uint32             nextReadback = 0;
+
+        Statistics statistics;
+    };
+}
@@ -3,38 +3,72 @@
 #include <glad/glad.h>
 
 #include "OpenGLIndexBuffer.h"
+#include "OpenGLMeshOptimizer.h"
+#include "OpenGLMemory.h"
+#include "OpenGLTracer.h"
+
+#include <algorithm>
 
 namespace PetrolEngine {
+	bool OpenGLIndexBuffer::optimizeOnUpload = false;
+
 	OpenGLIndexBuffer::OpenGLIndexBuffer(const void* data, int64 size) {
 		LOG_FUNCTION();
 
-        this->size = size / (int64) sizeof(int);
+		glCreateBuffers(1, &ID);
 
-		glGenBuffers(1, &ID);
+		OpenGLMemory::track(OpenGLMemory::Category::IndexBuffer, GL_BUFFER, ID, 0, "Index buffer");
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
-
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+		upload(data, size, optimizeOnUpload);
 	}
 
 	OpenGLIndexBuffer::OpenGLIndexBuffer() {
 		LOG_FUNCTION();
 		
-		glGenBuffers(1, &ID);
+		glCreateBuffers(1, &ID);
+
+		OpenGLMemory::track(OpenGLMemory::Category::IndexBuffer, GL_BUFFER, ID, 0, "Index buffer");
 	}
 
 	void OpenGLIndexBuffer::setData(const void* data, int64 size) {
 		LOG_FUNCTION();
 
+		upload(data, size, optimizeOnUpload);
+	}
+
+	void OpenGLIndexBuffer::setData(const void* data, int64 size, bool optimize) {
+		LOG_FUNCTION();
+
+		upload(data, size, optimize);
+	}
+
+	void OpenGLIndexBuffer::upload(const void* data, int64 size, bool optimize) { TRACE_FUNCTION();
 		this->size = size / (int64) sizeof(int);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
+		OpenGLMemory::resize(GL_BUFFER, ID, size);
+
+		// named upload, binding to GL_ELEMENT_ARRAY_BUFFER would change the element buffer of the bound vertex array
+		if (!optimize || data == nullptr || this->size < 3) {
+			glNamedBufferData(ID, size, data, GL_STATIC_DRAW);
+			return;
+		}
+
+		// only the index data is known here, vertex fetch remapping needs OpenGLMeshOptimizer::upload
+		Vector<uint32> indices((const uint32*) data, (const uint32*) data + this->size);
+		uint32 vertexCount = *std::max_element(indices.begin(), indices.end()) + 1;
+
+		MeshStatistics before = OpenGLMeshOptimizer::analyze(indices.data(), this->size, vertexCount);
+		OpenGLMeshOptimizer::optimizeVertexCache(indices.data(), this->size, vertexCount);
+		MeshStatistics after  = OpenGLMeshOptimizer::analyze(indices.data(), this->size, vertexCount);
+
+		LOG("Index buffer optimized: ACMR " + toString(before.acmr) + " -> " + toString(after.acmr), 1);
 
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+		glNamedBufferData(ID, size, indices.data(), GL_STATIC_DRAW);
 	}
 
 	OpenGLIndexBuffer::~OpenGLIndexBuffer() { LOG_FUNCTION();
         LOG("Deleting OpenGLIndexBuffer", 1);
+		OpenGLMemory::untrack(GL_BUFFER, ID);
 		glDeleteBuffers(1, &ID);
 	}
 }
\ No newline at end of file
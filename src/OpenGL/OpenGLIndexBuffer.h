@@ -9,7 +9,16 @@ namespace PetrolEngine {
 		OpenGLIndexBuffer(const void* data, int64 size);
 
         void setData(const void* data, int64 size) override;
+        // optimize instead of optimizeOnUpload, for indices that are already ordered (lod chains, optimized meshes)
+        void setData(const void* data, int64 size, bool optimize);
 
 		~OpenGLIndexBuffer() override;
+
+		// reorder triangles for the post-transform cache on every upload (see OpenGLMeshOptimizer),
+		// read by uploads on any thread, so it is set before meshes are loaded and not toggled
+		static bool optimizeOnUpload;
+
+	private:
+		void upload(const void* data, int64 size, bool optimize);
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,260 @@
+#include <PCH.h>
+
+#include <glad/glad.h>
+
+#include "OpenGLLightManager.h"
+#include "OpenGLTracer.h"
+
+#include <Core/Components/Camera.h>
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86)
+    #include <xmmintrin.h>
+    #define OPENGL_LIGHTS_SSE
+#endif
+
+namespace PetrolEngine {
+    static constexpr uint32 tilesPerSlice = OpenGLLightManager::clustersX * OpenGLLightManager::clustersY;
+
+    OpenGLLightManager::OpenGLLightManager() {
+        lightsBuffer        = new OpenGLStorageBuffer(sizeof(Light)                                     , lightsBinding       );
+        lightClustersBuffer = new OpenGLStorageBuffer(sizeof(ClustersHeader) + clusterCount * sizeof(glm::uvec2), lightClustersBinding);
+        lightIndicesBuffer  = new OpenGLStorageBuffer(sizeof(uint32)                                    , lightIndicesBinding );
+
+        sliceBounds.resize(clustersZ);
+        clusters   .resize(clusterCount);
+    }
+
+    OpenGLLightManager::~OpenGLLightManager() {
+        delete lightsBuffer;
+        delete lightClustersBuffer;
+        delete lightIndicesBuffer;
+    }
+
+    uint32 OpenGLLightManager::addLight(const Light& light) {
+        if (!freeHandles.empty()) {
+            uint32 handle = freeHandles.back();
+            freeHandles.pop_back();
+
+            lights[handle] = light;
+            used  [handle] = true;
+
+            return handle;
+        }
+
+        lights.push_back(light);
+        used  .push_back(true);
+
+        return (uint32) lights.size() - 1;
+    }
+
+    void OpenGLLightManager::removeLight(uint32 handle) {
+        if (handle >= lights.size() || !used[handle]) {
+            LOG("Removing light that does not exist.", 2);
+            return;
+        }
+
+        used[handle] = false;
+        freeHandles.push_back(handle);
+    }
+
+    const Light* OpenGLLightManager::getDirectionalLight() const {
+        for (uint32 handle = 0; handle < lights.size(); handle++)
+            if (used[handle] && lights[handle].type == (uint32) LightType::Directional) return &lights[handle];
+
+        return nullptr;
+    }
+
+    void OpenGLLightManager::clearLights() {
+        lights     .clear();
+        used       .clear();
+        freeHandles.clear();
+    }
+
+    void OpenGLLightManager::buildClusterBounds(const glm::mat4& projection, float near, float far) { LOG_FUNCTION();
+        boundsProjection = projection;
+
+        // view space x at given depth for ndc x (handles off-center projections)
+        auto toView = [](float ndc, float depth, float scale, float offset) { return (ndc + offset) * depth / scale; };
+
+        for (uint32 z = 0; z < clustersZ; z++) {
+            SliceBounds& slice = sliceBounds[z];
+
+            float sliceNear = near * std::pow(far / near, (float)  z      / clustersZ);
+            float sliceFar  = near * std::pow(far / near, (float) (z + 1) / clustersZ);
+
+            slice.minZ = -sliceFar;
+            slice.maxZ = -sliceNear;
+
+            for (uint32 y = 0; y < clustersY; y++) {
+                for (uint32 x = 0; x < clustersX; x++) {
+                    uint32 tile = x + y * clustersX;
+
+                    float ndcX0 = -1.f + 2.f * (float)  x      / clustersX;
+                    float ndcX1 = -1.f + 2.f * (float) (x + 1) / clustersX;
+                    float ndcY0 = -1.f + 2.f * (float)  y      / clustersY;
+                    float ndcY1 = -1.f + 2.f * (float) (y + 1) / clustersY;
+
+                    float xs[4] = {
+                        toView(ndcX0, sliceNear, projection[0][0], projection[2][0]),
+                        toView(ndcX0, sliceFar , projection[0][0], projection[2][0]),
+                        toView(ndcX1, sliceNear, projection[0][0], projection[2][0]),
+                        toView(ndcX1, sliceFar , projection[0][0], projection[2][0])
+                    };
+
+                    float ys[4] = {
+                        toView(ndcY0, sliceNear, projection[1][1], projection[2][1]),
+                        toView(ndcY0, sliceFar , projection[1][1], projection[2][1]),
+                        toView(ndcY1, sliceNear, projection[1][1], projection[2][1]),
+                        toView(ndcY1, sliceFar , projection[1][1], projection[2][1])
+                    };
+
+                    slice.minX[tile] = std::min(std::min(xs[0], xs[1]), std::min(xs[2], xs[3]));
+                    slice.maxX[tile] = std::max(std::max(xs[0], xs[1]), std::max(xs[2], xs[3]));
+                    slice.minY[tile] = std::min(std::min(ys[0], ys[1]), std::min(ys[2], ys[3]));
+                    slice.maxY[tile] = std::max(std::max(ys[0], ys[1]), std::max(ys[2], ys[3]));
+                }
+            }
+        }
+    }
+
+    void OpenGLLightManager::update(const Camera* camera, uint32 width, uint32 height) { TRACE_FUNCTION();
+        if (camera == nullptr) return;
+
+        glm::mat4 projection = camera->getPerspective();
+        glm::mat4 view       = camera->getViewMatrix ();
+
+        // orthographic cameras (2D) do not use clustered lighting, lists of the last perspective camera stay bound
+        if (projection[2][3] != -1.f) return;
+
+        float near = projection[3][2] / (projection[2][2] - 1.f);
+        float far  = projection[3][2] / (projection[2][2] + 1.f);
+
+        if (!(far > near) || std::isinf(far)) far = near * 10000.f;
+
+        if (projection != boundsProjection) buildClusterBounds(projection, near, far);
+
+        float sliceScale = (float) clustersZ / std::log(far / near);
+        float sliceBias  = sliceScale * std::log(near);
+
+        // directional lights first, they are not clustered
+        frameLights.clear();
+
+        for (uint32 i = 0; i < lights.size(); i++)
+            if (used[i] && lights[i].type == (uint32) LightType::Directional) frameLights.push_back(lights[i]);
+
+        uint32 directionalCount = (uint32) frameLights.size();
+
+        for (uint32 i = 0; i < lights.size(); i++)
+            if (used[i] && lights[i].type != (uint32) LightType::Directional) frameLights.push_back(lights[i]);
+
+        for (auto& cluster : clusters) cluster = glm::uvec2(0, 0);
+
+        clusterOfPair.clear();
+        lightOfPair  .clear();
+
+        for (uint32 lightIndex = directionalCount; lightIndex < frameLights.size(); lightIndex++) {
+            const Light& light = frameLights[lightIndex];
+
+            glm::vec4 center = view * glm::vec4(light.position, 1.f);
+            float     radius = light.range;
+            float     depth  = -center.z;
+
+            if (depth + radius < near || depth - radius > far) continue;
+
+            auto sliceOf = [&](float d) {
+                return (uint32) glm::clamp((int) (std::log(d) * sliceScale - sliceBias), 0, (int) clustersZ - 1);
+            };
+
+            uint32 firstSlice = sliceOf(std::max(depth - radius, near));
+            uint32 lastSlice  = sliceOf(std::min(depth + radius, far ));
+
+            float radius2 = radius * radius;
+
+            for (uint32 z = firstSlice; z <= lastSlice; z++) {
+                const SliceBounds& slice = sliceBounds[z];
+
+                float dz  = std::max(slice.minZ - center.z, 0.f) + std::max(center.z - slice.maxZ, 0.f);
+                float dz2 = dz * dz;
+
+                if (dz2 > radius2) continue;
+
+                // sphere against four cluster boxes at once
+#ifdef OPENGL_LIGHTS_SSE
+                __m128 zero = _mm_setzero_ps();
+                __m128 cx   = _mm_set1_ps(center.x);
+                __m128 cy   = _mm_set1_ps(center.y);
+                __m128 dzz  = _mm_set1_ps(dz2);
+                __m128 r2   = _mm_set1_ps(radius2);
+
+                for (uint32 tile = 0; tile < tilesPerSlice; tile += 4) {
+                    __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(slice.minX + tile), cx), zero),
+                                           _mm_max_ps(_mm_sub_ps(cx, _mm_load_ps(slice.maxX + tile)), zero));
+                    __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(slice.minY + tile), cy), zero),
+                                           _mm_max_ps(_mm_sub_ps(cy, _mm_load_ps(slice.maxY + tile)), zero));
+
+                    __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), dzz);
+
+                    int mask = _mm_movemask_ps(_mm_cmple_ps(distance2, r2));
+
+                    for (int lane = 0; mask; lane++, mask >>= 1) {
+                        if (!(mask & 1)) continue;
+
+                        uint32 cluster = z * tilesPerSlice + tile + lane;
+
+                        clusters[cluster].y++;
+                        clusterOfPair.push_back(cluster);
+                        lightOfPair  .push_back(lightIndex);
+                    }
+                }
+#else
+                for (uint32 tile = 0; tile < tilesPerSlice; tile++) {
+                    float dx = std::max(slice.minX[tile] - center.x, 0.f) + std::max(center.x - slice.maxX[tile], 0.f);
+                    float dy = std::max(slice.minY[tile] - center.y, 0.f) + std::max(center.y - slice.maxY[tile], 0.f);
+
+                    if (dx * dx + dy * dy + dz2 > radius2) continue;
+
+                    uint32 cluster = z * tilesPerSlice + tile;
+
+                    clusters[cluster].y++;
+                    clusterOfPair.push_back(cluster);
+                    lightOfPair  .push_back(lightIndex);
+                }
+#endif
+            }
+        }
+
+        // counts to offsets, then scatter light indices into per-cluster lists
+        uint32 offset = 0;
+        for (auto& cluster : clusters) {
+            cluster.x = offset;
+            offset   += cluster.y;
+            cluster.y = 0;
+        }
+
+        lightIndices.resize(lightOfPair.size());
+
+        for (uint32 pair = 0; pair < lightOfPair.size(); pair++) {
+            glm::uvec2& cluster = clusters[clusterOfPair[pair]];
+            lightIndices[cluster.x + cluster.y++] = lightOfPair[pair];
+        }
+
+        ClustersHeader header;
+        header.gridSize = glm::uvec4(clustersX, clustersY, clustersZ, directionalCount);
+        header.screen   = glm::vec4 ((float) width, (float) height, sliceScale, sliceBias);
+
+        uint32 lightsSize  = (uint32) (frameLights .size() * sizeof(Light ));
+        uint32 indicesSize = (uint32) (lightIndices.size() * sizeof(uint32));
+
+        lightsBuffer->reserve(lightsSize);
+        lightsBuffer->setData(frameLights.data(), lightsSize, 0);
+
+        lightClustersBuffer->reserve(sizeof(ClustersHeader) + clusterCount * sizeof(glm::uvec2));
+        lightClustersBuffer->setData(&header, sizeof(ClustersHeader), 0);
+        lightClustersBuffer->setData(clusters.data(), clusterCount * sizeof(glm::uvec2), sizeof(ClustersHeader));
+
+        lightIndicesBuffer->reserve(indicesSize);
+        lightIndicesBuffer->setData(lightIndices.data(), indicesSize, 0);
+    }
+}
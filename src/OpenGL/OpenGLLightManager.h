@@ -0,0 +1,103 @@
+#pragma once
+
+#include <Core/Aliases.h>
+#include <glm/glm.hpp>
+
+#include "OpenGLStorageBuffer.h"
+
+namespace PetrolEngine {
+    class Camera;
+
+    enum class LightType : uint32 {
+        Directional = 1,
+        Point       = 2,
+        Spot        = 3
+    };
+
+    // std430 layout, matches the Light struct in shaders
+    struct Light {
+        glm::vec3 position ; float  range        = 10.f;
+        glm::vec3 direction; float  cosOuterCone = 0.f;
+        glm::vec3 ambient  ; float  cosInnerCone = 0.f;
+        glm::vec3 diffuse  ; uint32 type         = (uint32) LightType::Point;
+        glm::vec3 specular ; float  padding      = 0.f;
+    };
+
+    // Clustered forward lighting.
+    // Lights are uploaded once per frame, view frustum is split into froxels and every froxel gets
+    // a list of point and spot lights touching it. Directional lights are stored first and affect everything.
+    //
+    // Shader side:
+    //   layout(std430, binding = 2) readonly buffer Lights        { Light lights[]; };
+    //   layout(std430, binding = 3) readonly buffer LightClusters {
+    //       uvec4 gridSize;         // x, y, z, directional light count
+    //       vec4  screen;           // width, height, slice scale, slice bias
+    //       uvec2 clusters[];       // offset, count into lightIndices
+    //   };
+    //   layout(std430, binding = 4) readonly buffer LightIndices  { uint lightIndices[]; };
+    //
+    //   uint  slice   = uint(max(log(-viewPosition.z) * screen.z - screen.w, 0.0));
+    //   uvec2 tile    = uvec2(gl_FragCoord.xy / (screen.xy / vec2(gridSize.xy)));
+    //   uvec2 cluster = clusters[tile.x + gridSize.x * (tile.y + gridSize.y * slice)];
+    class OpenGLLightManager {
+    public:
+        static constexpr uint32 clustersX = 16;
+        static constexpr uint32 clustersY = 9;
+        static constexpr uint32 clustersZ = 24;
+        static constexpr uint32 clusterCount = clustersX * clustersY * clustersZ;
+
+        static constexpr uint32 lightsBinding        = 2;
+        static constexpr uint32 lightClustersBinding = 3;
+        static constexpr uint32 lightIndicesBinding  = 4;
+
+        OpenGLLightManager();
+        ~OpenGLLightManager();
+
+        uint32 addLight   (const Light& light);
+        void   removeLight(uint32 handle);
+        Light& getLight   (uint32 handle) { return lights[handle]; }
+        void   clearLights();
+
+        uint32 getLightCount() const { return (uint32) (lights.size() - freeHandles.size()); }
+
+        // first directional light, shaders with the light[0] uniforms of before lights were managed are lit by it
+        const Light* getDirectionalLight() const;
+
+        // rebuilds cluster lists for given camera and uploads everything, called once per camera per frame
+        void update(const Camera* camera, uint32 width, uint32 height);
+
+    private:
+        struct ClustersHeader {
+            glm::uvec4 gridSize;
+            glm::vec4  screen;
+        };
+
+        // cluster bounds in view space, structure of arrays per slice so four clusters are tested at once
+        struct SliceBounds {
+            alignas(16) float minX[clustersX * clustersY];
+            alignas(16) float minY[clustersX * clustersY];
+            alignas(16) float maxX[clustersX * clustersY];
+            alignas(16) float maxY[clustersX * clustersY];
+            float minZ, maxZ;
+        };
+
+        void buildClusterBounds(const glm::mat4& projection, float near, float far);
+
+        Vector<Light > lights;
+        Vector<bool  > used;
+        Vector<uint32> freeHandles;
+
+        Vector<Light      > frameLights;
+        Vector<SliceBounds> sliceBounds;
+        Vector<glm::uvec2 > clusters;
+        Vector<uint32     > lightIndices;
+        Vector<uint32     > clusterOfPair;
+        Vector<uint32     > lightOfPair;
+
+        glm::mat4 boundsProjection{0.f};
+
+        OpenGLStorageBuffer* lightsBuffer        = nullptr;
+        OpenGLStorageBuffer* lightClustersBuffer = nullptr;
+        OpenGLStorageBuffer* lightIndicesBuffer  = nullptr;
+    };
+}
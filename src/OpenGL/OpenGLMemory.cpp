@@ -0,0 +1,274 @@
+#include <PCH.h>
+
+#include "OpenGLMemory.h"
+#include "OpenGLCapabilities.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace PetrolEngine {
+    struct MemoryRegistry {
+        std::mutex mutex;
+
+        UnorderedMap<uint64, OpenGLMemory::Allocation> allocations;
+
+        int64  total     = 0;
+        int64  highWater = 0;
+        int64  bytes     [OpenGLMemory::categoryCount] = {};
+        int64  highWaters[OpenGLMemory::categoryCount] = {};
+        uint32 objects   [OpenGLMemory::categoryCount] = {};
+
+        uint64 serial     = 0;
+        int64  budget     = 0;
+        bool   overBudget = false;
+    };
+
+    // constructed on first use, objects can be tracked from other static initializers
+    static MemoryRegistry& getRegistry() {
+        static MemoryRegistry instance;
+        return instance;
+    }
+
+    static uint64 keyOf(GLenum identifier, GLuint id) { return ((uint64) identifier << 32) | id; }
+
+    static String formatBytes(int64 bytes) {
+        if (bytes >= (1ll << 20) || bytes <= -(1ll << 20)) return toString((double) bytes / (double) (1 << 20)) + " MB";
+        if (bytes >= (1ll << 10) || bytes <= -(1ll << 10)) return toString((double) bytes / (double) (1 << 10)) + " KB";
+
+        return toString(bytes) + " B";
+    }
+
+    // registry lock has to be held
+    static void account(MemoryRegistry& registry, OpenGLMemory::Category category, int64 delta) {
+        uint32 index = (uint32) category;
+
+        registry.bytes[index] += delta;
+        registry.total        += delta;
+
+        registry.highWaters[index] = std::max(registry.highWaters[index], registry.bytes[index]);
+        registry.highWater         = std::max(registry.highWater        , registry.total       );
+
+        bool over = registry.budget > 0 && registry.total > registry.budget;
+
+        if (over && !registry.overBudget)
+            LOG("GPU memory over budget: " + formatBytes(registry.total) + " of " + formatBytes(registry.budget) + ".", 2);
+
+        registry.overBudget = over;
+    }
+
+    const char* OpenGLMemory::getCategoryName(Category category) {
+        switch (category) {
+            case Category::Texture      : return "Texture";
+            case Category::RenderTarget : return "RenderTarget";
+            case Category::VertexBuffer : return "VertexBuffer";
+            case Category::IndexBuffer  : return "IndexBuffer";
+            case Category::UniformBuffer: return "UniformBuffer";
+            case Category::StorageBuffer: return "StorageBuffer";
+            case Category::Framebuffer  : return "Framebuffer";
+            case Category::Program      : return "Program";
+            default                     : return "Unknown";
+        }
+    }
+
+    void OpenGLMemory::label(GLenum identifier, GLuint id, const String& name) {
+        if (OpenGLCapabilities::get().debugOutput && !name.empty())
+            glObjectLabel(identifier, id, (GLsizei) name.size(), name.c_str());
+    }
+
+    void OpenGLMemory::track(Category category, GLenum identifier, GLuint id, int64 bytes, const String& name) {
+        if (id == 0) return;
+
+        label(identifier, id, name);
+
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        auto& allocation = registry.allocations[keyOf(identifier, id)];
+
+        // names are reused after deletion, an object that was never untracked is replaced
+        if (allocation.serial != 0) {
+            account(registry, allocation.category, -allocation.bytes);
+            registry.objects[(uint32) allocation.category]--;
+        }
+
+        allocation = { category, identifier, id, bytes, ++registry.serial, name };
+
+        registry.objects[(uint32) category]++;
+        account(registry, category, bytes);
+    }
+
+    void OpenGLMemory::resize(GLenum identifier, GLuint id, int64 bytes) {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        auto allocation = registry.allocations.find(keyOf(identifier, id));
+        if (allocation == registry.allocations.end()) return;
+
+        account(registry, allocation->second.category, bytes - allocation->second.bytes);
+        allocation->second.bytes = bytes;
+    }
+
+    void OpenGLMemory::untrack(GLenum identifier, GLuint id) {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        auto allocation = registry.allocations.find(keyOf(identifier, id));
+        if (allocation == registry.allocations.end()) return;
+
+        account(registry, allocation->second.category, -allocation->second.bytes);
+        registry.objects[(uint32) allocation->second.category]--;
+
+        registry.allocations.erase(allocation);
+    }
+
+    void OpenGLMemory::rename(GLenum identifier, GLuint id, const String& name) {
+        label(identifier, id, name);
+
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        auto allocation = registry.allocations.find(keyOf(identifier, id));
+        if (allocation != registry.allocations.end()) allocation->second.name = name;
+    }
+
+    void OpenGLMemory::classify(GLenum identifier, GLuint id, Category category) {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        auto allocation = registry.allocations.find(keyOf(identifier, id));
+        if (allocation == registry.allocations.end() || allocation->second.category == category) return;
+
+        account(registry, allocation->second.category, -allocation->second.bytes);
+        registry.objects[(uint32) allocation->second.category]--;
+
+        allocation->second.category = category;
+
+        registry.objects[(uint32) category]++;
+        account(registry, category, allocation->second.bytes);
+    }
+
+    void OpenGLMemory::trackProgram(GLuint program, const String& name) {
+        GLint length = 0;
+        if (program) glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+        track(Category::Program, GL_PROGRAM, program, length, name);
+    }
+
+    int64 OpenGLMemory::getTotal() {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        return registry.total;
+    }
+
+    int64 OpenGLMemory::getTotal(Category category) {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        return registry.bytes[(uint32) category];
+    }
+
+    int64 OpenGLMemory::getHighWater() {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        return registry.highWater;
+    }
+
+    int64 OpenGLMemory::getHighWater(Category category) {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        return registry.highWaters[(uint32) category];
+    }
+
+    uint32 OpenGLMemory::getCount(Category category) {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        return registry.objects[(uint32) category];
+    }
+
+    void OpenGLMemory::setBudget(int64 bytes) {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        registry.budget     = bytes;
+        registry.overBudget = bytes > 0 && registry.total > bytes;
+    }
+
+    bool OpenGLMemory::isOverBudget() {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        return registry.overBudget;
+    }
+
+    OpenGLMemory::Snapshot OpenGLMemory::snapshot() {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        Snapshot result;
+        result.serial = registry.serial;
+
+        for (uint32 category = 0; category < categoryCount; category++) {
+            result.bytes  [category] = registry.bytes  [category];
+            result.objects[category] = registry.objects[category];
+        }
+
+        return result;
+    }
+
+    Vector<OpenGLMemory::Allocation> OpenGLMemory::allocatedSince(const Snapshot& from) {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        Vector<Allocation> result;
+
+        for (auto& it : registry.allocations)
+            if (it.second.serial > from.serial) result.push_back(it.second);
+
+        std::sort(result.begin(), result.end(), [](const Allocation& a, const Allocation& b) { return a.serial < b.serial; });
+
+        return result;
+    }
+
+    void OpenGLMemory::logDiff(const Snapshot& from, const Snapshot& to) {
+        for (uint32 category = 0; category < categoryCount; category++) {
+            int64 bytes   = to.bytes  [category] - from.bytes  [category];
+            int64 objects = (int64) to.objects[category] - (int64) from.objects[category];
+
+            if (bytes == 0 && objects == 0) continue;
+
+            LOG(String(getCategoryName((Category) category)) + ": " + (bytes >= 0 ? "+" : "") + formatBytes(bytes)
+                + ", " + (objects >= 0 ? "+" : "") + toString(objects) + " objects", 1);
+        }
+
+        for (auto& allocation : allocatedSince(from)) {
+            if (allocation.serial > to.serial) continue;
+
+            LOG(String("  alive: ") + getCategoryName(allocation.category) + " " + toString(allocation.id)
+                + " '" + allocation.name + "' " + formatBytes(allocation.bytes), 1);
+        }
+    }
+
+    uint32 OpenGLMemory::reportLeaks() {
+        Vector<Allocation> alive = allocatedSince(Snapshot());
+
+        if (alive.empty()) {
+            LOG("No GPU objects leaked.", 1);
+            return 0;
+        }
+
+        int64 bytes = 0;
+        for (auto& allocation : alive) bytes += allocation.bytes;
+
+        LOG(toString(alive.size()) + " GPU objects leaked, " + formatBytes(bytes) + ":", 2);
+
+        for (auto& allocation : alive)
+            LOG(String("  ") + getCategoryName(allocation.category) + " " + toString(allocation.id)
+                + " '" + allocation.name + "' " + formatBytes(allocation.bytes), 2);
+
+        return (uint32) alive.size();
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Core/Aliases.h>
+
+#include <glad/glad.h>
+
+namespace PetrolEngine {
+    // Registry of the GPU objects the backend holds, with an estimate of their size.
+    //
+    // Backend objects track themselves when they are created and untrack when they are deleted,
+    // sizes follow reallocation. Estimates are what the object's storage needs (texels with their mip
+    // chain, buffer sizes, program binary length), drivers add alignment and bookkeeping on top.
+    // Objects get their name as debug label (glObjectLabel) when KHR_debug is there, so captures and
+    // graphics debuggers show the same names as the reports.
+    //
+    // Thread safe, objects can be created on the resource loader thread.
+    class OpenGLMemory {
+    public:
+        enum class Category : uint8 {
+            Texture,
+            RenderTarget, // textures attached to framebuffers
+            VertexBuffer,
+            IndexBuffer,
+            UniformBuffer,
+            StorageBuffer,
+            Framebuffer,
+            Program,
+            Count
+        };
+
+        static constexpr uint32 categoryCount = (uint32) Category::Count;
+
+        static const char* getCategoryName(Category category);
+
+        // identifier is the namespace of the name, as for glObjectLabel (GL_TEXTURE, GL_BUFFER, ...)
+        static void track   (Category category, GLenum identifier, GLuint id, int64 bytes, const String& name);
+        static void resize  (GLenum identifier, GLuint id, int64 bytes);
+        static void untrack (GLenum identifier, GLuint id);
+        static void rename  (GLenum identifier, GLuint id, const String& name);
+        static void classify(GLenum identifier, GLuint id, Category category);
+
+        // linked programs are estimated by their binary length
+        static void trackProgram(GLuint program, const String& name);
+
+        static int64  getTotal    ();
+        static int64  getTotal    (Category category);
+        static int64  getHighWater();
+        static int64  getHighWater(Category category);
+        static uint32 getCount    (Category category);
+
+        // totals above the budget are logged once every time they cross it, 0 disables it
+        static void  setBudget   (int64 bytes);
+        static bool  isOverBudget();
+
+        struct Snapshot {
+            uint64 serial = 0; // objects tracked later have a higher serial
+
+            int64  bytes  [categoryCount] = {};
+            uint32 objects[categoryCount] = {};
+        };
+
+        struct Allocation {
+            Category category   = Category::Texture;
+            GLenum   identifier = 0;
+            GLuint   id         = 0;
+            int64    bytes      = 0;
+            uint64   serial     = 0;
+            String   name;
+        };
+
+        static Snapshot snapshot();
+
+        // objects tracked after from that are still alive
+        static Vector<Allocation> allocatedSince(const Snapshot& from);
+
+        // per category difference between two snapshots and what is still alive of the objects created in between
+        static void logDiff(const Snapshot& from, const Snapshot& to);
+
+        // every object still alive, meant to run once everything the backend created should be deleted,
+        // returns their number
+        static uint32 reportLeaks();
+
+    private:
+        static void label(GLenum identifier, GLuint id, const String& name);
+    };
+}
@@ -0,0 +1,334 @@
+#include <PCH.h>
+
+#include <glad/glad.h>
+
+#include "OpenGLMeshFile.h"
+#include "OpenGLVertexArray.h"
+#include "OpenGLVertexBuffer.h"
+#include "OpenGLIndexBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace PetrolEngine {
+    int64 OpenGLMeshFile::uploadChunkSize = 4 << 20;
+
+    struct OpenGLMeshFile::Header {
+        char   magic[4];
+        uint32 version;
+
+        uint32 elementCount;
+        uint32 lodCount;
+        uint32 submeshCount;
+        uint32 vertexSize;
+
+        float  boundsMin[3];
+        float  boundsMax[3];
+
+        uint64 elementsOffset;
+        uint64 lodsOffset;
+        uint64 submeshesOffset;
+        uint64 verticesOffset;
+        uint64 verticesSize;
+        uint64 indicesOffset;
+        uint64 indicesSize;
+    };
+
+    static constexpr char meshFileMagic[4] = { 'P', 'M', 'S', 'H' };
+
+    struct MeshFileElement {
+        uint32 type;
+        char   name[60];
+    };
+
+    static_assert(sizeof(MeshFileElement) == 64, "Mesh file elements have to stay 64 bytes.");
+    static_assert(sizeof(LodLevel       ) == 12, "Mesh file lods are stored as LodLevel.");
+
+    static uint64 align(uint64 offset, uint64 alignment) { return (offset + alignment - 1) / alignment * alignment; }
+
+    bool OpenGLMeshFile::write(const String& path, const VertexLayout& layout,
+                               const void*   vertices, int64 verticesSize,
+                               const uint32* indices , int64 indexCount,
+                               const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                               const Vector<LodLevel>& lods,
+                               const Vector<Submesh> & submeshes) { LOG_FUNCTION();
+        auto& elements = layout.getElements();
+
+        Header header{};
+        std::memcpy(header.magic, meshFileMagic, sizeof(meshFileMagic));
+
+        header.version      = version;
+        header.elementCount = (uint32) elements.size();
+        header.lodCount     = (uint32) lods.size();
+        header.submeshCount = (uint32) submeshes.size();
+        header.vertexSize   = OpenGLMeshOptimizer::getVertexSize(layout);
+
+        for (int i = 0; i < 3; i++) {
+            header.boundsMin[i] = boundsMin[i];
+            header.boundsMax[i] = boundsMax[i];
+        }
+
+        header.elementsOffset  = sizeof(Header);
+        header.lodsOffset      = header.elementsOffset  + elements .size() * sizeof(MeshFileElement);
+        header.submeshesOffset = header.lodsOffset      + lods     .size() * sizeof(LodLevel);
+        header.verticesOffset  = align(header.submeshesOffset + submeshes.size() * sizeof(Submesh), pageAlignment);
+        header.verticesSize    = (uint64) verticesSize;
+        header.indicesOffset   = align(header.verticesOffset + header.verticesSize, pageAlignment);
+        header.indicesSize     = (uint64) indexCount * sizeof(uint32);
+
+        if (header.vertexSize == 0 || header.verticesSize % header.vertexSize != 0) {
+            LOG("Mesh file " + path + " not written, vertex data does not match its layout.", 2);
+            return false;
+        }
+
+        std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+        if (!file.is_open()) {
+            LOG("Mesh file " + path + " can not be opened for writing.", 2);
+            return false;
+        }
+
+        auto padTo = [&](uint64 offset) {
+            static const char zeros[pageAlignment] = {};
+            uint64 position = (uint64) file.tellp();
+
+            if (offset > position) file.write(zeros, (std::streamsize) (offset - position));
+        };
+
+        file.write((const char*) &header, sizeof(header));
+
+        for (auto& it : elements) {
+            MeshFileElement element{};
+            element.type = (uint32) it.type;
+            std::strncpy(element.name, it.name.c_str(), sizeof(element.name) - 1);
+
+            file.write((const char*) &element, sizeof(element));
+        }
+
+        file.write((const char*) lods     .data(), (std::streamsize) (lods     .size() * sizeof(LodLevel)));
+        file.write((const char*) submeshes.data(), (std::streamsize) (submeshes.size() * sizeof(Submesh )));
+
+        padTo(header.verticesOffset);
+        file.write((const char*) vertices, (std::streamsize) header.verticesSize);
+
+        padTo(header.indicesOffset);
+        file.write((const char*) indices, (std::streamsize) header.indicesSize);
+
+        return file.good();
+    }
+
+    OpenGLMeshFile::~OpenGLMeshFile() {
+        close();
+    }
+
+    bool OpenGLMeshFile::open(const String& path) { LOG_FUNCTION();
+        close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER size;
+        GetFileSizeEx(file, &size);
+
+        HANDLE object = size.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+        CloseHandle(file);
+
+        if (object == nullptr) return false;
+
+        mapping     = (const uint8*) MapViewOfFile(object, FILE_MAP_READ, 0, 0, 0);
+        mappingSize = (uint64) size.QuadPart;
+        fileHandle  = object;
+
+        if (mapping == nullptr) {
+            close();
+            return false;
+        }
+#else
+        int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0) return false;
+
+        struct stat status{};
+
+        if (fstat(file, &status) != 0) {
+            ::close(file);
+            return false;
+        }
+
+        void* view = status.st_size > 0 ? mmap(nullptr, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+        ::close(file);
+
+        if (view == MAP_FAILED) return false;
+
+        // blocks are read front to back exactly once
+        madvise(view, (size_t) status.st_size, MADV_SEQUENTIAL);
+
+        mapping     = (const uint8*) view;
+        mappingSize = (uint64) status.st_size;
+#endif
+
+        header = (const Header*) mapping;
+
+        // every block lies behind the header and inside the mapping
+        auto inside = [&](uint64 offset, uint64 size) { return offset >= sizeof(Header) && offset <= mappingSize && size <= mappingSize - offset; };
+
+        bool valid = mappingSize >= sizeof(Header)
+                  && std::memcmp(header->magic, meshFileMagic, sizeof(meshFileMagic)) == 0
+                  && header->version == version
+                  && header->vertexSize > 0
+                  && inside(header->elementsOffset , (uint64) header->elementCount * sizeof(MeshFileElement))
+                  && inside(header->lodsOffset     , (uint64) header->lodCount     * sizeof(LodLevel))
+                  && inside(header->submeshesOffset, (uint64) header->submeshCount * sizeof(Submesh ))
+                  && inside(header->verticesOffset , header->verticesSize)
+                  && inside(header->indicesOffset  , header->indicesSize )
+                  && header->verticesSize % header->vertexSize == 0
+                  && header->indicesSize  % sizeof(uint32)     == 0;
+
+        if (!valid) {
+            LOG("Mesh file " + path + " is not a valid version " + toString(version) + " mesh file.", 2);
+
+            close();
+            return false;
+        }
+
+        // the small tables are copied, vertices and indices stay in the mapping
+        Vector<VertexElement> elements;
+        auto* element = (const MeshFileElement*) (mapping + header->elementsOffset);
+
+        for (uint32 i = 0; i < header->elementCount; i++, element++) {
+            if (element->type == (uint32) ShaderDataType::None || element->type > (uint32) ShaderDataType::Bool) {
+                LOG("Mesh file " + path + " has an element of unknown type " + toString(element->type) + ".", 2);
+
+                close();
+                return false;
+            }
+
+            char name[sizeof(element->name) + 1] = {};
+            std::memcpy(name, element->name, sizeof(element->name));
+
+            elements.push_back({ name, (ShaderDataType) element->type });
+        }
+
+        layout = VertexLayout(elements);
+
+        if (OpenGLMeshOptimizer::getVertexSize(layout) != header->vertexSize) {
+            LOG("Mesh file " + path + " has a vertex size that does not match its layout.", 2);
+
+            close();
+            return false;
+        }
+
+        auto* lodLevels = (const LodLevel*) (mapping + header->lodsOffset     );
+        auto* ranges    = (const Submesh *) (mapping + header->submeshesOffset);
+
+        lods     .assign(lodLevels, lodLevels + header->lodCount    );
+        submeshes.assign(ranges   , ranges    + header->submeshCount);
+
+        // the GPU does not check any of these, an index past the vertices reads whatever follows the buffer
+        uint64 indexCount  = header->indicesSize  / sizeof(uint32);
+        uint64 vertexCount = header->verticesSize / header->vertexSize;
+
+        auto inIndices = [&](uint32 firstIndex, uint32 count) { return (uint64) firstIndex + count <= indexCount; };
+
+        bool rangesValid = std::all_of(lods     .begin(), lods     .end(), [&](const LodLevel& lod    ) { return inIndices(lod    .firstIndex, lod    .indexCount); })
+                        && std::all_of(submeshes.begin(), submeshes.end(), [&](const Submesh & submesh) { return inIndices(submesh.firstIndex, submesh.indexCount); });
+
+        auto* indices = (const uint32*) (mapping + header->indicesOffset);
+
+        bool indicesValid = std::all_of(indices, indices + indexCount, [&](uint32 index) { return index < vertexCount; });
+
+        if (!rangesValid || !indicesValid) {
+            LOG("Mesh file " + path + (rangesValid ? " has indices past its vertices." : " has lods or submeshes past its indices."), 2);
+
+            close();
+            return false;
+        }
+
+        boundsMin = { header->boundsMin[0], header->boundsMin[1], header->boundsMin[2] };
+        boundsMax = { header->boundsMax[0], header->boundsMax[1], header->boundsMax[2] };
+
+        return true;
+    }
+
+    void OpenGLMeshFile::close() {
+        if (mapping == nullptr) return;
+
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+        CloseHandle((HANDLE) fileHandle);
+
+        fileHandle = nullptr;
+#else
+        munmap((void*) mapping, (size_t) mappingSize);
+#endif
+
+        mapping     = nullptr;
+        mappingSize = 0;
+        header      = nullptr;
+    }
+
+    const uint8*  OpenGLMeshFile::getVertices    () const { return mapping ? mapping + header->verticesOffset : nullptr;                     }
+    int64         OpenGLMeshFile::getVerticesSize() const { return mapping ? (int64) header->verticesSize : 0;                                }
+    const uint32* OpenGLMeshFile::getIndices     () const { return mapping ? (const uint32*) (mapping + header->indicesOffset) : nullptr;     }
+    int64         OpenGLMeshFile::getIndexCount  () const { return mapping ? (int64) (header->indicesSize / sizeof(uint32)) : 0;               }
+
+    void OpenGLMeshFile::release(uint64 offset, uint64 size) {
+#ifndef _WIN32
+        // page aligned start, the pages are clean so they are dropped without writing anything back
+        uint64 begin = offset / pageAlignment * pageAlignment;
+
+        madvise((void*) (mapping + begin), (size_t) (offset + size - begin), MADV_DONTNEED);
+#endif
+    }
+
+    void OpenGLMeshFile::uploadRange(uint32 buffer, uint64 offset, uint64 size) {
+        for (uint64 uploaded = 0; uploaded < size; uploaded += (uint64) uploadChunkSize) {
+            uint64 chunk = std::min(size - uploaded, (uint64) uploadChunkSize);
+
+            glNamedBufferSubData(buffer, (GLintptr) uploaded, (GLsizeiptr) chunk, mapping + offset + uploaded);
+
+            // the driver has its copy once the call returns, so the resident set stays at about one chunk
+            release(offset + uploaded, chunk);
+        }
+    }
+
+    OpenGLVertexArray* OpenGLMeshFile::load() { LOG_FUNCTION();
+        if (mapping == nullptr) return nullptr;
+
+        auto* vertexArray = new OpenGLVertexArray();
+
+        // allocated empty and filled in chunks straight from the mapping
+        auto* vertices = new OpenGLVertexBuffer(layout);
+        vertices->setData(nullptr, (int64) header->verticesSize);
+        uploadRange(vertices->getID(), header->verticesOffset, header->verticesSize);
+
+        // files are optimized when baked
+        auto* indices = new OpenGLIndexBuffer();
+        indices->setData(nullptr, (int64) header->indicesSize, false);
+        uploadRange(indices->getID(), header->indicesOffset, header->indicesSize);
+
+        VertexBuffer* vertexBuffer = vertices;
+        IndexBuffer*  indexBuffer  = indices;
+
+        vertexArray->addVertexBuffer(vertexBuffer);
+        vertexArray->setIndexBuffer (indexBuffer );
+
+        vertexArray->setBounds(boundsMin, boundsMax);
+        if (!lods.empty()) vertexArray->setLods(lods);
+
+        return vertexArray;
+    }
+}
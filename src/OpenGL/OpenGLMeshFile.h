@@ -0,0 +1,90 @@
+#pragma once
+
+#include <Core/Aliases.h>
+#include <Core/Renderer/VertexBuffer.h>
+
+#include "OpenGLMeshOptimizer.h"
+
+#include <glm/glm.hpp>
+
+namespace PetrolEngine {
+    class OpenGLVertexArray;
+
+    // Packed mesh file whose blocks are what the GPU buffers hold, so loading is a memory mapping
+    // and uploads straight from it, no vertices or indices go through CPU side vectors.
+    //
+    // header | layout elements | lods | submeshes | vertices | indices
+    //
+    // The vertex block is interleaved exactly as the stored VertexLayout (no padding between
+    // elements, same order), indices are uint32 like OpenGLIndexBuffer expects. Vertex and index
+    // blocks start on pageAlignment so uploaded pages can be dropped from the mapping right away.
+    // Files are little endian and meant to be baked from already optimized meshes
+    // (OpenGLMeshOptimizer::optimizeMesh, generateLodChain).
+    class OpenGLMeshFile {
+    public:
+        static constexpr uint32 version       = 1;
+        static constexpr uint32 pageAlignment = 4096;
+
+        // largest piece uploaded at once, pages of a piece are released before the next one is touched
+        static int64 uploadChunkSize;
+
+        struct Submesh {
+            uint32 firstIndex = 0;
+            uint32 indexCount = 0;
+            uint32 material   = 0;
+            uint32 padding    = 0;
+        };
+
+        static bool write(const String& path, const VertexLayout& layout,
+                          const void*   vertices, int64 verticesSize,
+                          const uint32* indices , int64 indexCount,
+                          const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                          const Vector<LodLevel>& lods      = {},
+                          const Vector<Submesh> & submeshes = {});
+
+        OpenGLMeshFile() = default;
+        ~OpenGLMeshFile();
+
+        OpenGLMeshFile(const OpenGLMeshFile&) = delete;
+        OpenGLMeshFile& operator=(const OpenGLMeshFile&) = delete;
+
+        // maps the file, false when it is missing or not a valid mesh file
+        bool open(const String& path);
+        void close();
+
+        bool isOpen() const { return mapping != nullptr; }
+
+        // new vertex array with buffers uploaded from the mapping, bounds and lods set,
+        // the file can be closed afterwards
+        OpenGLVertexArray* load();
+
+        const VertexLayout&     getLayout   () const { return layout;    }
+        const Vector<LodLevel>& getLods     () const { return lods;      }
+        const Vector<Submesh>&  getSubmeshes() const { return submeshes; }
+        const glm::vec3&        getBoundsMin() const { return boundsMin; }
+        const glm::vec3&        getBoundsMax() const { return boundsMax; }
+
+        // point into the mapping, valid until close
+        const uint8*  getVertices    () const;
+        int64         getVerticesSize() const;
+        const uint32* getIndices     () const;
+        int64         getIndexCount  () const;
+
+    private:
+        struct Header;
+
+        void uploadRange(uint32 buffer, uint64 offset, uint64 size);
+        void release    (uint64 offset, uint64 size);
+
+        const uint8* mapping     = nullptr;
+        uint64       mappingSize = 0;
+        void*        fileHandle  = nullptr; // windows only, the mapping object
+
+        const Header*    header = nullptr;
+        VertexLayout     layout;
+        Vector<LodLevel> lods;
+        Vector<Submesh>  submeshes;
+        glm::vec3        boundsMin{0.f};
+        glm::vec3        boundsMax{0.f};
+    };
+}
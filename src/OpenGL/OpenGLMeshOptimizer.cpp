@@ -0,0 +1,517 @@
+#include <PCH.h>
+
+#include "OpenGLMeshOptimizer.h"
+#include "OpenGLVertexBuffer.h"
+#include "OpenGLIndexBuffer.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace PetrolEngine {
+    // Forsyth's "Linear-Speed Vertex Cache Optimisation" constants
+    static constexpr uint32 forsythCacheSize  = 32;
+    static constexpr float  cacheDecayPower   = 1.5f;
+    static constexpr float  lastTriangleScore = 0.75f;
+    static constexpr float  valenceBoostScale = 2.0f;
+    static constexpr float  valenceBoostPower = 0.5f;
+
+    static float forsythVertexScore(int32 cachePosition, uint32 liveTriangles) {
+        if (liveTriangles == 0) return -1.f;
+
+        float score = 0.f;
+
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) score = lastTriangleScore;
+            else                   score = std::pow(1.f - (float) (cachePosition - 3) / (forsythCacheSize - 3), cacheDecayPower);
+        }
+
+        return score + valenceBoostScale * std::pow((float) liveTriangles, -valenceBoostPower);
+    }
+
+    static glm::vec3 readPosition(const uint8* positions, uint32 stride, uint32 index) {
+        glm::vec3 position;
+        std::memcpy(&position, positions + (uint64) index * stride, sizeof(glm::vec3));
+
+        return position;
+    }
+
+    MeshStatistics OpenGLMeshOptimizer::analyze(const uint32* indices, int64 indexCount, uint32 vertexCount, uint32 cacheSize) { LOG_FUNCTION();
+        MeshStatistics statistics;
+
+        if (indexCount < 3) return statistics;
+
+        // fifo cache simulation, vertex is in cache if it was inserted less than cacheSize misses ago
+        Vector<uint32> timestamps(vertexCount, 0);
+        Vector<bool  > referenced(vertexCount, false);
+
+        uint32 time   = cacheSize + 1;
+        uint32 misses = 0;
+        uint32 unique = 0;
+
+        for (int64 i = 0; i < indexCount; i++) {
+            uint32 vertex = indices[i];
+
+            if (time - timestamps[vertex] > cacheSize) {
+                timestamps[vertex] = time++;
+                misses++;
+            }
+
+            if (!referenced[vertex]) {
+                referenced[vertex] = true;
+                unique++;
+            }
+        }
+
+        statistics.acmr = (float) misses / (float) (indexCount / 3);
+        statistics.atvr = (float) misses / (float) unique;
+
+        return statistics;
+    }
+
+    void OpenGLMeshOptimizer::optimizeVertexCache(uint32* indices, int64 indexCount, uint32 vertexCount) { LOG_FUNCTION();
+        int64 triangleCount = indexCount / 3;
+
+        if (triangleCount == 0) return;
+
+        // triangle adjacency of every vertex, live part of the list is [offset, offset + liveTriangles)
+        Vector<uint32> liveTriangles  (vertexCount    , 0);
+        Vector<uint32> adjacencyOffset(vertexCount + 1, 0);
+        Vector<uint32> adjacency      (triangleCount * 3);
+
+        for (int64 i = 0; i < triangleCount * 3; i++) liveTriangles[indices[i]]++;
+
+        for (uint32 vertex = 0; vertex < vertexCount; vertex++)
+            adjacencyOffset[vertex + 1] = adjacencyOffset[vertex] + liveTriangles[vertex];
+
+        {
+            Vector<uint32> filled(vertexCount, 0);
+
+            for (int64 i = 0; i < triangleCount * 3; i++) {
+                uint32 vertex = indices[i];
+                adjacency[adjacencyOffset[vertex] + filled[vertex]++] = (uint32) (i / 3);
+            }
+        }
+
+        Vector<int32> cachePosition(vertexCount, -1);
+        Vector<float> vertexScore  (vertexCount);
+
+        for (uint32 vertex = 0; vertex < vertexCount; vertex++)
+            vertexScore[vertex] = forsythVertexScore(-1, liveTriangles[vertex]);
+
+        Vector<float> triangleScore(triangleCount);
+        Vector<bool > emitted      (triangleCount, false);
+
+        int64 bestTriangle = 0;
+
+        for (int64 triangle = 0; triangle < triangleCount; triangle++) {
+            const uint32* t = indices + triangle * 3;
+
+            triangleScore[triangle] = vertexScore[t[0]] + vertexScore[t[1]] + vertexScore[t[2]];
+
+            if (triangleScore[triangle] > triangleScore[bestTriangle]) bestTriangle = triangle;
+        }
+
+        Vector<uint32> result;
+        result.reserve(triangleCount * 3);
+
+        Vector<uint32> cache   ; cache   .reserve(forsythCacheSize + 3);
+        Vector<uint32> newCache; newCache.reserve(forsythCacheSize + 3);
+
+        int64 scanPosition = 0;
+
+        for (int64 emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+            // nothing adjacent to the cache is left, continue with the next triangle in input order
+            if (bestTriangle < 0) {
+                while (emitted[scanPosition]) scanPosition++;
+                bestTriangle = scanPosition;
+            }
+
+            const uint32* t = indices + bestTriangle * 3;
+
+            result.insert(result.end(), t, t + 3);
+            emitted[bestTriangle] = true;
+
+            newCache.clear();
+
+            for (int i = 0; i < 3; i++) {
+                uint32  vertex = t[i];
+                uint32  begin  = adjacencyOffset[vertex];
+                uint32& live   = liveTriangles  [vertex];
+
+                for (uint32 j = begin; j < begin + live; j++) {
+                    if (adjacency[j] != (uint32) bestTriangle) continue;
+
+                    std::swap(adjacency[j], adjacency[begin + live - 1]);
+                    live--;
+                    break;
+                }
+
+                newCache.push_back(vertex);
+            }
+
+            for (uint32 vertex : cache)
+                if (vertex != t[0] && vertex != t[1] && vertex != t[2]) newCache.push_back(vertex);
+
+            std::swap(cache, newCache);
+
+            for (uint32 i = 0; i < cache.size(); i++) {
+                uint32 vertex = cache[i];
+
+                cachePosition[vertex] = i < forsythCacheSize ? (int32) i : -1;
+                vertexScore  [vertex] = forsythVertexScore(cachePosition[vertex], liveTriangles[vertex]);
+            }
+
+            if (cache.size() > forsythCacheSize) cache.resize(forsythCacheSize);
+
+            // rescore triangles touching the cache and pick the best one among them
+            bestTriangle = -1;
+            float bestScore = -1.f;
+
+            for (uint32 vertex : cache) {
+                uint32 begin = adjacencyOffset[vertex];
+
+                for (uint32 j = begin; j < begin + liveTriangles[vertex]; j++) {
+                    uint32 triangle = adjacency[j];
+                    const uint32* u = indices + (int64) triangle * 3;
+
+                    triangleScore[triangle] = vertexScore[u[0]] + vertexScore[u[1]] + vertexScore[u[2]];
+
+                    if (triangleScore[triangle] > bestScore) {
+                        bestScore    = triangleScore[triangle];
+                        bestTriangle = triangle;
+                    }
+                }
+            }
+        }
+
+        std::memcpy(indices, result.data(), result.size() * sizeof(uint32));
+    }
+
+    void OpenGLMeshOptimizer::optimizeOverdraw(uint32* indices, int64 indexCount, const uint8* positions, uint32 stride, uint32 vertexCount, float threshold) { LOG_FUNCTION();
+        int64 triangleCount = indexCount / 3;
+
+        if (triangleCount < 2) return;
+
+        // split into clusters where the cache restarts (all three vertices missed),
+        // reordering whole clusters keeps the cache behaviour inside of them intact
+        Vector<uint32> clusters;
+        {
+            Vector<uint32> timestamps(vertexCount, 0);
+            uint32 time = statisticsCacheSize + 1;
+
+            for (int64 triangle = 0; triangle < triangleCount; triangle++) {
+                int misses = 0;
+
+                for (int i = 0; i < 3; i++) {
+                    uint32 vertex = indices[triangle * 3 + i];
+
+                    if (time - timestamps[vertex] > statisticsCacheSize) {
+                        timestamps[vertex] = time++;
+                        misses++;
+                    }
+                }
+
+                if (misses == 3 || triangle == 0) clusters.push_back((uint32) triangle);
+            }
+        }
+
+        if (clusters.size() < 2) return;
+
+        glm::vec3 meshCentroid(0.f);
+
+        for (int64 i = 0; i < indexCount; i++) meshCentroid += readPosition(positions, stride, indices[i]);
+
+        meshCentroid = meshCentroid / (float) indexCount;
+
+        // clusters facing outwards are drawn first, they are the most likely to occlude the rest
+        Vector<Pair<float, uint32>> sortKeys(clusters.size());
+
+        for (uint32 cluster = 0; cluster < clusters.size(); cluster++) {
+            int64 begin = clusters[cluster];
+            int64 end   = cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangleCount;
+
+            glm::vec3 centroid(0.f);
+            glm::vec3 normal  (0.f);
+            float     area   = 0.f;
+
+            for (int64 triangle = begin; triangle < end; triangle++) {
+                glm::vec3 a = readPosition(positions, stride, indices[triangle * 3 + 0]);
+                glm::vec3 b = readPosition(positions, stride, indices[triangle * 3 + 1]);
+                glm::vec3 c = readPosition(positions, stride, indices[triangle * 3 + 2]);
+
+                glm::vec3 n = glm::cross(b - a, c - a);
+                float     s = glm::length(n);
+
+                centroid += (a + b + c) * (s / 3.f);
+                normal   += n;
+                area     += s;
+            }
+
+            float normalLength = glm::length(normal);
+
+            if (area         > 0.f) centroid = centroid / area;
+            if (normalLength > 0.f) normal   = normal   / normalLength;
+
+            sortKeys[cluster] = { glm::dot(centroid - meshCentroid, normal), cluster };
+        }
+
+        std::stable_sort(sortKeys.begin(), sortKeys.end(), [](const Pair<float, uint32>& a, const Pair<float, uint32>& b) {
+            return a.first > b.first;
+        });
+
+        Vector<uint32> result;
+        result.reserve(indexCount);
+
+        for (auto& [key, cluster] : sortKeys) {
+            int64 begin = clusters[cluster];
+            int64 end   = cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangleCount;
+
+            result.insert(result.end(), indices + begin * 3, indices + end * 3);
+        }
+
+        float before = analyze(indices      , indexCount, vertexCount).acmr;
+        float after  = analyze(result.data(), indexCount, vertexCount).acmr;
+
+        if (after > before * threshold) return;
+
+        std::memcpy(indices, result.data(), result.size() * sizeof(uint32));
+    }
+
+    Vector<uint32> OpenGLMeshOptimizer::optimizeVertexFetch(uint32* indices, int64 indexCount, uint32 vertexCount) { LOG_FUNCTION();
+        Vector<uint32> remap(vertexCount, UINT32_MAX);
+        uint32 next = 0;
+
+        for (int64 i = 0; i < indexCount; i++) {
+            uint32& target = remap[indices[i]];
+
+            if (target == UINT32_MAX) target = next++;
+
+            indices[i] = target;
+        }
+
+        // unreferenced vertices are kept at the end so the vertex count does not change
+        for (uint32& target : remap)
+            if (target == UINT32_MAX) target = next++;
+
+        return remap;
+    }
+
+    void OpenGLMeshOptimizer::remapVertices(uint8* destination, const uint8* source, uint32 vertexCount, uint32 stride, const Vector<uint32>& remap) { LOG_FUNCTION();
+        for (uint32 vertex = 0; vertex < vertexCount; vertex++)
+            std::memcpy(destination + (uint64) remap[vertex] * stride, source + (uint64) vertex * stride, stride);
+    }
+
+    // clusters vertices on a grid with given resolution and returns the surviving triangles
+    static Vector<uint32> clusterVertices(const uint32* indices, int64 indexCount, const uint8* positions, uint32 stride, uint32 vertexCount,
+                                          const glm::vec3& origin, float cellSize) {
+        auto cellOf = [&](const glm::vec3& position) {
+            uint64 x = (uint64) ((position.x - origin.x) / cellSize);
+            uint64 y = (uint64) ((position.y - origin.y) / cellSize);
+            uint64 z = (uint64) ((position.z - origin.z) / cellSize);
+
+            return x | (y << 21) | (z << 42);
+        };
+
+        // mean position of every cell
+        UnorderedMap<uint64, Pair<glm::vec3, uint32>> cells;
+        Vector<uint64> vertexCell(vertexCount);
+
+        for (int64 i = 0; i < indexCount; i++) {
+            uint32    vertex   = indices[i];
+            glm::vec3 position = readPosition(positions, stride, vertex);
+            uint64    cell     = cellOf(position);
+
+            vertexCell[vertex] = cell;
+
+            auto& [sum, count] = cells[cell];
+            sum += position;
+            count++;
+        }
+
+        // the vertex closest to the cell mean represents the whole cell
+        UnorderedMap<uint64, Pair<uint32, float>> representatives;
+
+        for (int64 i = 0; i < indexCount; i++) {
+            uint32 vertex = indices[i];
+            uint64 cell   = vertexCell[vertex];
+
+            auto& [sum, count] = cells[cell];
+            float distance = glm::length(readPosition(positions, stride, vertex) - sum / (float) count);
+
+            auto representative = representatives.find(cell);
+
+            if (representative == representatives.end() || distance < representative->second.second)
+                representatives[cell] = { vertex, distance };
+        }
+
+        Vector<uint32> result;
+
+        for (int64 i = 0; i + 2 < indexCount; i += 3) {
+            uint32 a = representatives[vertexCell[indices[i + 0]]].first;
+            uint32 b = representatives[vertexCell[indices[i + 1]]].first;
+            uint32 c = representatives[vertexCell[indices[i + 2]]].first;
+
+            if (a == b || b == c || a == c) continue;
+
+            result.push_back(a);
+            result.push_back(b);
+            result.push_back(c);
+        }
+
+        return result;
+    }
+
+    Vector<uint32> OpenGLMeshOptimizer::simplify(const uint32* indices, int64 indexCount, const uint8* positions, uint32 stride, uint32 vertexCount, int64 targetIndexCount, float& error) { LOG_FUNCTION();
+        error = 0.f;
+
+        if (indexCount <= targetIndexCount) return Vector<uint32>(indices, indices + indexCount);
+
+        glm::vec3 min = readPosition(positions, stride, indices[0]);
+        glm::vec3 max = min;
+
+        for (int64 i = 0; i < indexCount; i++) {
+            glm::vec3 position = readPosition(positions, stride, indices[i]);
+
+            min = glm::min(min, position);
+            max = glm::max(max, position);
+        }
+
+        glm::vec3 size   = max - min;
+        float     extent = std::max(std::max(size.x, size.y), size.z);
+
+        if (extent <= 0.f) return Vector<uint32>(indices, indices + indexCount);
+
+        // finest grid that still meets the target, triangle count grows with the resolution
+        uint32 low  = 1;
+        uint32 high = 1024;
+
+        Vector<uint32> best = clusterVertices(indices, indexCount, positions, stride, vertexCount, min, extent * 1.0001f);
+        float bestCell = extent;
+
+        while (low <= high) {
+            uint32 resolution = (low + high) / 2;
+            float  cellSize   = extent * 1.0001f / (float) resolution;
+
+            Vector<uint32> result = clusterVertices(indices, indexCount, positions, stride, vertexCount, min, cellSize);
+
+            if ((int64) result.size() <= targetIndexCount) {
+                best     = std::move(result);
+                bestCell = cellSize;
+                low      = resolution + 1;
+            } else {
+                high     = resolution - 1;
+            }
+        }
+
+        // a vertex moves at most by the cell diagonal
+        error = bestCell * std::sqrt(3.f);
+
+        return best;
+    }
+
+    Vector<uint32> OpenGLMeshOptimizer::generateLodChain(const Vector<uint32>& indices, const Vector<uint8>& vertices, const VertexLayout& layout, Vector<LodLevel>& levels, uint32 maxLevels, float reduction) { LOG_FUNCTION();
+        Vector<uint32> chain = indices;
+
+        levels.clear();
+        levels.push_back({ 0, (uint32) indices.size(), 0.f });
+
+        int64  positionOffset = getPositionOffset(layout);
+        uint32 stride         = getVertexSize(layout);
+
+        if (positionOffset < 0 || stride == 0) {
+            LOG("No position element in layout, lod chain has only the base level.", 2);
+            return chain;
+        }
+
+        uint32 vertexCount = (uint32) (vertices.size() / stride);
+        int64  target      = (int64) indices.size();
+
+        while (levels.size() < maxLevels) {
+            target = (int64) ((float) target * reduction) / 3 * 3;
+
+            if (target < 3) break;
+
+            float error;
+            Vector<uint32> level = simplify(indices.data(), (int64) indices.size(), vertices.data() + positionOffset, stride, vertexCount, target, error);
+
+            // no meaningful reduction left
+            if (level.empty() || level.size() >= levels.back().indexCount * 9 / 10) break;
+
+            optimizeVertexCache(level.data(), (int64) level.size(), vertexCount);
+
+            levels.push_back({ (uint32) chain.size(), (uint32) level.size(), error });
+            chain.insert(chain.end(), level.begin(), level.end());
+
+            target = (int64) level.size();
+        }
+
+        return chain;
+    }
+
+    uint32 OpenGLMeshOptimizer::getVertexSize(const VertexLayout& layout) {
+        uint32 size = 0;
+        for (auto& element : layout.getElements()) size += ShaderDataTypeSize(element.type);
+
+        return size;
+    }
+
+    int64 OpenGLMeshOptimizer::getPositionOffset(const VertexLayout& layout) {
+        int64 offset      = 0;
+        int64 firstFloat3 = -1;
+
+        for (auto& element : layout.getElements()) {
+            if (element.type == ShaderDataType::Float3) {
+                if (element.name == "position") return offset;
+                if (firstFloat3 == -1) firstFloat3 = offset;
+            }
+
+            offset += ShaderDataTypeSize(element.type);
+        }
+
+        return firstFloat3;
+    }
+
+    Pair<MeshStatistics, MeshStatistics> OpenGLMeshOptimizer::optimizeMesh(Vector<uint32>& indices, Vector<uint8>& vertices, const VertexLayout& layout) { LOG_FUNCTION();
+        uint32 stride      = getVertexSize(layout);
+        uint32 vertexCount = stride ? (uint32) (vertices.size() / stride) : 0;
+        int64  indexCount  = (int64) indices.size();
+
+        MeshStatistics before = analyze(indices.data(), indexCount, vertexCount);
+
+        optimizeVertexCache(indices.data(), indexCount, vertexCount);
+
+        int64 positionOffset = getPositionOffset(layout);
+
+        if (positionOffset >= 0)
+            optimizeOverdraw(indices.data(), indexCount, vertices.data() + positionOffset, stride, vertexCount);
+        else
+            LOG("No position element in layout, skipping overdraw optimization.", 1);
+
+        Vector<uint32> remap = optimizeVertexFetch(indices.data(), indexCount, vertexCount);
+
+        Vector<uint8> remapped(vertices.size());
+        remapVertices(remapped.data(), vertices.data(), vertexCount, stride, remap);
+        vertices.swap(remapped);
+
+        MeshStatistics after = analyze(indices.data(), indexCount, vertexCount);
+
+        LOG("Mesh optimized: ACMR " + toString(before.acmr) + " -> " + toString(after.acmr) +
+                          ", ATVR " + toString(before.atvr) + " -> " + toString(after.atvr), 1);
+
+        return { before, after };
+    }
+
+    void OpenGLMeshOptimizer::upload(OpenGLVertexBuffer* vertexBuffer, OpenGLIndexBuffer* indexBuffer, const void* vertices, int64 verticesSize, const uint32* indices, int64 indicesSize) { LOG_FUNCTION();
+        Vector<uint8 > vertexData((const uint8*) vertices, (const uint8*) vertices + verticesSize);
+        Vector<uint32> indexData (indices, indices + indicesSize / (int64) sizeof(uint32));
+
+        optimizeMesh(indexData, vertexData, vertexBuffer->getVertexLayout());
+
+        // index buffer must not optimize it again on its own
+        vertexBuffer->setData(vertexData.data(), (int64)  vertexData.size());
+        indexBuffer ->setData(indexData .data(), (int64) (indexData .size() * sizeof(uint32)), false);
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Core/Aliases.h>
+#include <Core/Renderer/VertexBuffer.h>
+
+namespace PetrolEngine {
+    class OpenGLVertexBuffer;
+    class OpenGLIndexBuffer;
+
+    // Post-transform cache statistics of an index buffer.
+    // acmr - average cache miss ratio (transformed vertices per triangle, 0.5 - 3.0)
+    // atvr - average transformed vertex ratio (transformed vertices per referenced vertex, 1.0 is optimal)
+    struct MeshStatistics {
+        float acmr = 0.f;
+        float atvr = 0.f;
+    };
+
+    // range of the shared index buffer, error is the geometric deviation in mesh units
+    struct LodLevel {
+        uint32 firstIndex = 0;
+        uint32 indexCount = 0;
+        float  error      = 0.f;
+    };
+
+    // CPU only mesh optimization stage, it does not touch any GL state so it can be
+    // used offline to bake meshes as well as on the upload path.
+    //
+    // Full pipeline run by optimizeMesh:
+    // 1. vertex cache reordering of triangles (Forsyth)
+    // 2. overdraw aware reordering of triangle clusters
+    // 3. vertex fetch reordering, vertices are remapped into first use order
+    class OpenGLMeshOptimizer {
+    public:
+        static constexpr uint32 statisticsCacheSize = 16;
+
+        static MeshStatistics analyze(const uint32* indices, int64 indexCount, uint32 vertexCount, uint32 cacheSize = statisticsCacheSize);
+
+        static void optimizeVertexCache(uint32* indices, int64 indexCount, uint32 vertexCount);
+
+        // threshold - how much worse acmr is allowed to get to reduce overdraw (1.05 = 5%)
+        static void optimizeOverdraw(uint32* indices, int64 indexCount, const uint8* positions, uint32 stride, uint32 vertexCount, float threshold = 1.05f);
+
+        // rewrites indices and returns the table mapping old vertex index to the new one
+        static Vector<uint32> optimizeVertexFetch(uint32* indices, int64 indexCount, uint32 vertexCount);
+        static void remapVertices(uint8* destination, const uint8* source, uint32 vertexCount, uint32 stride, const Vector<uint32>& remap);
+
+        // runs all steps, positions are taken from "position" element of the layout (or the first Float3)
+        static Pair<MeshStatistics, MeshStatistics> optimizeMesh(Vector<uint32>& indices, Vector<uint8>& vertices, const VertexLayout& layout);
+
+        // vertex clustering simplification, result indexes the same vertices so lods can share the vertex buffer
+        static Vector<uint32> simplify(const uint32* indices, int64 indexCount, const uint8* positions, uint32 stride, uint32 vertexCount, int64 targetIndexCount, float& error);
+
+        // every level has about reduction times the triangles of the previous one, levels are appended to one index list
+        static Vector<uint32> generateLodChain(const Vector<uint32>& indices, const Vector<uint8>& vertices, const VertexLayout& layout, Vector<LodLevel>& levels, uint32 maxLevels = 5, float reduction = 0.5f);
+
+        // runs optimizeMesh and uploads the result into given buffers
+        static void upload(OpenGLVertexBuffer* vertexBuffer, OpenGLIndexBuffer* indexBuffer, const void* vertices, int64 verticesSize, const uint32* indices, int64 indicesSize);
+
+        static uint32 getVertexSize     (const VertexLayout& layout);
+        static int64  getPositionOffset (const VertexLayout& layout);
+    };
+}
@@ -0,0 +1,149 @@
+#include <PCH.h>
+
+#include "OpenGLMultiView.h"
+#include "OpenGLCapabilities.h"
+#include "OpenGLFramebuffer.h"
+#include "OpenGLShader.h"
+#include "OpenGLStorageBuffer.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+
+namespace PetrolEngine {
+    OpenGLMultiView::OpenGLMultiView(OpenGLFramebuffer* target): target(target) {
+        buffer = new OpenGLStorageBuffer((uint32) (sizeof(Header) + maxViews * sizeof(ViewData)), viewsBinding);
+    }
+
+    OpenGLMultiView::~OpenGLMultiView() {
+        delete buffer;
+    }
+
+    void OpenGLMultiView::setViews(const Vector<View>& views) { LOG_FUNCTION();
+        if (views.size() > maxViews) LOG("Multi view has more than " + toString(maxViews) + " views, the rest is dropped.", 2);
+
+        this->views.assign(views.begin(), views.begin() + std::min<size_t>(views.size(), maxViews));
+
+        sharedViewport = true;
+        layered        = false;
+
+        ViewData data[maxViews];
+
+        for (uint32 i = 0; i < this->views.size(); i++) {
+            const View& view = this->views[i];
+
+            data[i].projection = view.projection;
+            data[i].view       = view.view;
+            data[i].layer      = view.layer;
+            data[i].viewport   = (int32) i;
+            data[i].padding[0] = 0;
+            data[i].padding[1] = 0;
+
+            for (int c = 0; c < 4; c++)
+                if (view.viewport[c] != this->views[0].viewport[c]) sharedViewport = false;
+
+            if (view.layer != 0) layered = true;
+        }
+
+        if (!this->views.empty())
+            buffer->setData(data, (uint32) (this->views.size() * sizeof(ViewData)), sizeof(Header));
+    }
+
+    Vector<OpenGLMultiView::View> OpenGLMultiView::cubeFaces(const glm::vec3& position, float nearPlane, float farPlane, int32 size) {
+        // directions and up vectors of the faces as cube map lookups expect them
+        const glm::vec3 directions[6] = { { 1, 0, 0 }, { -1,  0,  0 }, { 0, 1, 0 }, { 0, -1,  0 }, { 0,  0, 1 }, { 0,  0, -1 } };
+        const glm::vec3 ups       [6] = { { 0,-1, 0 }, {  0, -1,  0 }, { 0, 0, 1 }, { 0,  0, -1 }, { 0, -1, 0 }, { 0, -1,  0 } };
+
+        glm::mat4 projection = glm::perspective(glm::radians(90.f), 1.f, nearPlane, farPlane);
+
+        Vector<View> faces(6);
+
+        for (int32 face = 0; face < 6; face++) {
+            faces[face].projection = projection;
+            faces[face].view       = glm::lookAt(position, position + directions[face], ups[face]);
+            faces[face].viewport   = { 0, 0, size, size };
+            faces[face].layer      = face;
+        }
+
+        return faces;
+    }
+
+    bool OpenGLMultiView::isSupported() {
+        return OpenGLCapabilities::get().storageBinding(viewsBinding);
+    }
+
+    bool OpenGLMultiView::supportsViewportArrays() {
+        return OpenGLCapabilities::get().viewportArrays;
+    }
+
+    bool OpenGLMultiView::supportsVertexLayer() {
+        return OpenGLCapabilities::get().vertexLayer;
+    }
+
+    bool OpenGLMultiView::isSinglePass(const Shader* shader) const {
+        auto* routing = static_cast<const OpenGLShader*>(shader);
+
+        // primitives that are not routed land in layer 0 and viewport 0, which is right only when every view is there
+        bool layers    = !layered       || routing->writesLayer();
+        bool viewports =  sharedViewport || (routing->writesViewportIndex() && supportsViewportArrays());
+
+        return layers && viewports;
+    }
+
+    void OpenGLMultiView::setHeader(uint32 viewCount, uint32 firstView) {
+        Header header{ viewCount, firstView, { 0, 0 } };
+
+        buffer->setData(&header, sizeof(Header), 0);
+    }
+
+    void OpenGLMultiView::begin(bool singlePass) {
+        if (!active) {
+            active = true;
+
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+            glGetIntegerv(GL_VIEWPORT                , previousViewport    );
+
+            if (target) glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->getID());
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, viewsBinding, buffer->getID());
+        }
+
+        if (!singlePass) return;
+
+        if (target) target->selectLayer(-1);
+
+        if (sharedViewport || !supportsViewportArrays()) {
+            const glm::ivec4& viewport = views[0].viewport;
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        }
+        else for (uint32 i = 0; i < views.size(); i++) {
+            const glm::ivec4& viewport = views[i].viewport;
+            glViewportIndexedf(i, (float) viewport[0], (float) viewport[1], (float) viewport[2], (float) viewport[3]);
+        }
+
+        setHeader((uint32) views.size(), 0);
+    }
+
+    void OpenGLMultiView::beginView(uint32 view) {
+        // written layers go to the only one attached, and glViewport sets every viewport whatever index is written
+        if (target) target->selectLayer(views[view].layer);
+
+        const glm::ivec4& viewport = views[view].viewport;
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+        setHeader(1, view);
+    }
+
+    void OpenGLMultiView::end() {
+        if (!active) return;
+
+        active = false;
+
+        if (target) target->selectLayer(-1);
+
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint) previousFramebuffer);
+
+        // sets every viewport of the array
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <Core/Aliases.h>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace PetrolEngine {
+    class OpenGLFramebuffer;
+    class OpenGLStorageBuffer;
+    class Shader;
+
+    // Several views of the same draws with one submission: the faces of a cube map shadow or
+    // reflection probe (layers of a layered target) or split screen cameras (viewports of one target).
+    //
+    // Draws recorded with OpenGLRenderer::renderMeshViews are drawn with their instance count
+    // multiplied by the number of views. Shaders take the view from the instance index and route
+    // the primitive with gl_Layer and gl_ViewportIndex, from a geometry stage or from the vertex
+    // stage, which needs the extension (supportsVertexLayer):
+    //
+    // #extension GL_ARB_shader_viewport_layer_array : require
+    //
+    // struct ViewData { mat4 projection; mat4 view; int layer; int viewport; int padding[2]; };
+    // layout(std430, binding = 12) readonly buffer Views { uint viewCount; uint firstView; uint padding[2]; ViewData views[]; };
+    //
+    // uint view     = firstView + gl_InstanceID % viewCount;
+    // uint instance =             gl_InstanceID / viewCount; // for instanced draws
+    // gl_Position   = views[view].projection * views[view].view * objects[objectIndex].model * vec4(position, 1.0);
+    // gl_Layer         = views[view].layer;
+    // gl_ViewportIndex = views[view].viewport;
+    //
+    // Whether a shader routes is read from its source (OpenGLShader::writesLayer, writesViewportIndex).
+    // Shaders that do not write what the views need (gl_Layer when a view is not in layer 0,
+    // gl_ViewportIndex when the viewports differ), and views with different viewports without
+    // viewport arrays, fall back to one draw per view:
+    // the target gets the view's layer attached alone and the view's viewport, the Views header
+    // selects the view, so the same shader works either way.
+    // Multi view draws are not frustum culled and use the full detail level of their mesh.
+    class OpenGLMultiView {
+    public:
+        static constexpr uint32 viewsBinding = 12;
+        static constexpr uint32 maxViews     = 16; // minimum GL_MAX_VIEWPORTS
+
+        struct View {
+            glm::mat4  projection{1.f};
+            glm::mat4  view      {1.f};
+            glm::ivec4 viewport  {0, 0, 0, 0}; // x, y, width, height
+            int32      layer = 0;
+        };
+
+        // nullptr target draws into whatever framebuffer is bound when the renderer flushes (split screen),
+        // the target is not owned
+        OpenGLMultiView(OpenGLFramebuffer* target = nullptr);
+        ~OpenGLMultiView();
+
+        OpenGLMultiView(const OpenGLMultiView&) = delete;
+        OpenGLMultiView& operator=(const OpenGLMultiView&) = delete;
+
+        // at most maxViews, views are read when the recorded draws are submitted at flush
+        void setViews(const Vector<View>& views);
+
+        const Vector<View>& getViews () const { return views;  }
+        OpenGLFramebuffer*  getTarget() const { return target; }
+
+        // the six faces of a cube map seen from position, in GL face order (+X, -X, +Y, -Y, +Z, -Z)
+        static Vector<View> cubeFaces(const glm::vec3& position, float nearPlane, float farPlane, int32 size);
+
+        // the Views buffer binding is past the 8 GL 4.3 guarantees
+        static bool isSupported();
+        static bool supportsViewportArrays();
+        static bool supportsVertexLayer();
+
+        // whether draws with shader reach every view in a single draw
+        bool isSinglePass(const Shader* shader) const;
+
+        // used by the renderer while submitting, end restores the framebuffer and viewport begin found
+        void begin    (bool singlePass);
+        void beginView(uint32 view);
+        void end      ();
+
+    private:
+        // std430 layout of the Views buffer
+        struct ViewData {
+            glm::mat4 projection;
+            glm::mat4 view;
+            int32     layer;
+            int32     viewport;
+            int32     padding[2];
+        };
+
+        struct Header {
+            uint32 viewCount;
+            uint32 firstView;
+            uint32 padding[2];
+        };
+
+        void setHeader(uint32 viewCount, uint32 firstView);
+
+        OpenGLFramebuffer*   target = nullptr;
+        OpenGLStorageBuffer* buffer = nullptr;
+
+        Vector<View> views;
+        bool sharedViewport = true;
+        bool layered        = false; // a view is not in layer 0
+
+        // state begin found
+        GLint previousFramebuffer = 0;
+        GLint previousViewport[4] = {};
+        bool  active              = false;
+    };
+}
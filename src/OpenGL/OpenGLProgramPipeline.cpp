@@ -0,0 +1,165 @@
+#include <PCH.h>
+
+#include "OpenGLProgramPipeline.h"
+#include "OpenGLCapabilities.h"
+#include "OpenGLMemory.h"
+
+#include <chrono>
+
+namespace PetrolEngine {
+    UnorderedMap<String, OpenGLProgramPipeline::Entry > OpenGLProgramPipeline::stages;
+    UnorderedMap<uint32, String                       > OpenGLProgramPipeline::stageKeys;
+    UnorderedMap<String, OpenGLProgramPipeline::Entry > OpenGLProgramPipeline::pipelines;
+    UnorderedMap<uint32, String                       > OpenGLProgramPipeline::pipelineKeys;
+
+    OpenGLProgramPipeline::Stats OpenGLProgramPipeline::stats;
+
+    static String stageName(GLenum stage) {
+        switch (stage) {
+            case GL_VERTEX_SHADER  : return "VERTEX";
+            case GL_FRAGMENT_SHADER: return "FRAGMENT";
+            case GL_GEOMETRY_SHADER: return "GEOMETRY";
+            default                : return "STAGE";
+        }
+    }
+
+    // on failure the program is deleted and 0 returned
+    static uint32 checkLinked(uint32 program, GLenum stage, const String& name) {
+        GLint  success;
+        GLchar infoLog[1024];
+
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+        if (success) return program;
+
+        glGetProgramInfoLog(program, 1024, nullptr, infoLog);
+        LOG("PROGRAM_LINKING_ERROR(" + stageName(stage) + " " + name + "): " + String(infoLog), 2);
+
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    bool OpenGLProgramPipeline::isSupported() {
+        return OpenGLCapabilities::get().separateShaderObjects;
+    }
+
+    uint32 OpenGLProgramPipeline::acquireStage(GLenum stage, const String& name, const String& source) {
+        String key = "glsl " + toString(stage) + "\n" + source;
+
+        return acquireStage(key, name, [&]() {
+            const char* code = source.c_str();
+
+            // compiles, marks the program separable and links in one call
+            return checkLinked(glCreateShaderProgramv(stage, 1, &code), stage, name);
+        });
+    }
+
+    uint32 OpenGLProgramPipeline::acquireStage(GLenum stage, const String& name, const Vector<uint32>& byteCode) {
+        String key = "spirv " + toString(stage) + "\n" + String((const char*) byteCode.data(), byteCode.size() * sizeof(uint32));
+
+        return acquireStage(key, name, [&]() {
+            uint32 shader  = glCreateShader(stage);
+            uint32 program = glCreateProgram();
+
+            glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, byteCode.data(), (GLsizei) (byteCode.size() * sizeof(uint32)));
+            glSpecializeShader(shader, "main", 0, nullptr, nullptr);
+
+            glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+            glAttachShader(program, shader);
+            glLinkProgram (program);
+
+            // the program keeps it until it is deleted itself
+            glDeleteShader(shader);
+
+            return checkLinked(program, stage, name);
+        });
+    }
+
+    uint32 OpenGLProgramPipeline::acquireStage(const String& key, const String& name, const std::function<uint32()>& link) {
+        auto found = stages.find(key);
+
+        if (found != stages.end()) {
+            stats.stageHits++;
+            found->second.references++;
+
+            return found->second.name;
+        }
+
+        LOG_FUNCTION();
+
+        auto   begin   = std::chrono::steady_clock::now();
+        uint32 program = link();
+
+        stats.links    += 1;
+        stats.linkTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+        if (program == 0) return 0;
+
+        OpenGLMemory::trackProgram(program, name);
+
+        stages[key]        = { program, 1 };
+        stageKeys[program] = key;
+        stats.stages++;
+
+        return program;
+    }
+
+    void OpenGLProgramPipeline::releaseStage(uint32 program) {
+        auto key = stageKeys.find(program);
+        if (key == stageKeys.end()) return;
+
+        Entry& entry = stages[key->second];
+
+        if (--entry.references > 0) return;
+
+        OpenGLMemory::untrack(GL_PROGRAM, program);
+        glDeleteProgram(program);
+
+        stages.erase(key->second);
+        stageKeys.erase(key);
+        stats.stages--;
+    }
+
+    uint32 OpenGLProgramPipeline::acquire(uint32 vertexProgram, uint32 fragmentProgram, uint32 geometryProgram) {
+        String key = toString(vertexProgram) + "_" + toString(fragmentProgram) + "_" + toString(geometryProgram);
+
+        auto found = pipelines.find(key);
+
+        if (found != pipelines.end()) {
+            stats.pipelineHits++;
+            found->second.references++;
+
+            return found->second.name;
+        }
+
+        LOG_FUNCTION();
+
+        uint32 pipeline;
+        glCreateProgramPipelines(1, &pipeline);
+
+        if (  vertexProgram) glUseProgramStages(pipeline, GL_VERTEX_SHADER_BIT  ,   vertexProgram);
+        if (fragmentProgram) glUseProgramStages(pipeline, GL_FRAGMENT_SHADER_BIT, fragmentProgram);
+        if (geometryProgram) glUseProgramStages(pipeline, GL_GEOMETRY_SHADER_BIT, geometryProgram);
+
+        pipelines[key]         = { pipeline, 1 };
+        pipelineKeys[pipeline] = key;
+        stats.pipelines++;
+
+        return pipeline;
+    }
+
+    void OpenGLProgramPipeline::release(uint32 pipeline) {
+        auto key = pipelineKeys.find(pipeline);
+        if (key == pipelineKeys.end()) return;
+
+        Entry& entry = pipelines[key->second];
+
+        if (--entry.references > 0) return;
+
+        glDeleteProgramPipelines(1, &pipeline);
+
+        pipelines.erase(key->second);
+        pipelineKeys.erase(key);
+        stats.pipelines--;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Core/Aliases.h>
+
+#include <glad/glad.h>
+
+#include <functional>
+
+namespace PetrolEngine {
+    // Cache of separable programs, one per distinct stage code, and of the program pipelines
+    // combining them. Shaders with the same vertex stage share one linked vertex program, so the
+    // number of links grows with the number of stages rather than with their combinations.
+    // Both are reference counted and deleted with their last user.
+    class OpenGLProgramPipeline {
+    public:
+        struct Stats {
+            uint32 stages    = 0; // alive
+            uint32 pipelines = 0; // alive
+
+            uint32 links         = 0; // stage programs linked so far
+            uint32 stageHits     = 0;
+            uint32 pipelineHits  = 0;
+            double linkTime      = 0.0; // milliseconds spent linking stage programs
+        };
+
+        static bool isSupported();
+
+        // stage is a shader type (GL_VERTEX_SHADER, ...), code is GLSL source or a SPIR-V module,
+        // 0 when it does not compile or link
+        static uint32 acquireStage(GLenum stage, const String& name, const String&         source  );
+        static uint32 acquireStage(GLenum stage, const String& name, const Vector<uint32>& byteCode);
+        static void   releaseStage(uint32 program);
+
+        // stage programs can be 0 for stages that are not used
+        static uint32 acquire(uint32 vertexProgram, uint32 fragmentProgram, uint32 geometryProgram);
+        static void   release(uint32 pipeline);
+
+        static const Stats& getStats() { return stats; }
+
+    private:
+        struct Entry {
+            uint32 name       = 0;
+            uint32 references = 0;
+        };
+
+        static uint32 acquireStage(const String& key, const String& name, const std::function<uint32()>& link);
+
+        static UnorderedMap<String, Entry > stages;    // by stage type and code
+        static UnorderedMap<uint32, String> stageKeys; // by program
+        static UnorderedMap<String, Entry > pipelines; // by stage programs
+        static UnorderedMap<uint32, String> pipelineKeys;
+
+        static Stats stats;
+    };
+}
@@ -6,40 +6,78 @@
 #include "OpenGLRenderer.h"
 #include "Core/Renderer/Texture.h"
 
-#include <Core/Components/VertexData.h>
 #include <Core/Components/Transform.h>
 #include <Core/Components/Mesh.h>
 #include <Core/Files.h>
 
+#include <algorithm>
+#include <array>
+#include <cfloat>
+
 #include <Freetype/Renderer/Text.h>
 #include "OpenGL.h"
+#include "OpenGLCapture.h"
+#include "OpenGLTracer.h"
+#include "OpenGLDebugOutput.h"
+#include "OpenGLCapabilities.h"
+#include "OpenGLMemory.h"
 // TODO: !!!!! REMOVE STATIC RENDERER DEPENDENCY !!!!!
 
 namespace PetrolEngine {
 
 	void OpenGLRenderer::getDeviceConstantValue(DeviceConstant deviceConstant, void* outputBuffer) {
+		// answered from the capabilities read at context init, without a round trip to the driver
+		if(deviceConstant == DeviceConstant::MAX_TEXTURE_IMAGE_UNITS) {
+			*(GLint*) outputBuffer = OpenGLCapabilities::get().limits.textureUnits;
+			return;
+		}
+
 		auto openGLDeviceConstant = openGLDeviceConstants.find(deviceConstant);
 
+		if(openGLDeviceConstant == openGLDeviceConstants.end()) {
+			LOG("Unknown device constant " + toString((int) deviceConstant) + ".", 2);
+			*(GLint*) outputBuffer = 0;
+			return;
+		}
+
 		glGetIntegerv(openGLDeviceConstant->second, (GLint*) outputBuffer);
 	}
 
     class Batch2D{
     public:
+        struct Vertex {
+            glm::vec3 position;
+            glm::vec2 texCords;
+            int32     textureIndex;
+
+            static constexpr auto attributes() {
+                return std::array{
+                    VERTEX_ATTRIBUTE(Vertex, position    ),
+                    VERTEX_ATTRIBUTE(Vertex, texCords    ),
+                    VERTEX_ATTRIBUTE(Vertex, textureIndex)
+                };
+            }
+        };
+
+        // std430 layout of OpenGLRenderer::QuadInstance
+        struct Instance {
+            glm::vec3 position;
+            uint32    textureIndex;
+            glm::vec2 size;
+            uint32    color;
+            uint32    padding;
+            glm::vec4 texCoords;
+        };
+
         Shader* shader;
         VertexArray* vertexArray;
-        VertexData vertexData;
-
-        VertexLayout layout = {{
-            {"position", ShaderDataType::Float3},
-            {"texCords", ShaderDataType::Float2},
-            {"textureIndex", ShaderDataType::Int}
-        }};
+        OpenGLVertexBuffer* vertexBuffer;
+        OpenGLStorageBuffer* instanceBuffer = nullptr;
 
         Vector<const Texture*> textures;
-        Vector<glm::vec3> vertices;
-        Vector<glm::vec2> texCoords;
-        Vector<uint> textureIndexes;
+        Vector<Vertex> vertices;
         Vector<uint> indices;
+        Vector<Instance> instances;
 
         struct Quad {
             const Texture* texture;
@@ -48,28 +86,21 @@ namespace PetrolEngine {
             glm::vec2 size;
 
             glm::vec4 texCoords;
+            glm::vec4 color = glm::vec4(1.f);
         };
 
-        void addQuad(const Quad& quad){
-            auto& pos = quad.position;
-
-            this->vertices.emplace_back(pos.x + 0          , pos.y + 0          , pos.z);
-            this->vertices.emplace_back(pos.x + quad.size.x, pos.y + 0          , pos.z);
-            this->vertices.emplace_back(pos.x + quad.size.x, pos.y + quad.size.y, pos.z);
-            this->vertices.emplace_back(pos.x + 0          , pos.y + quad.size.y, pos.z);
+        static uint32 packColor(const glm::vec4& color){
+            uint32 packed = 0;
 
-            const uint quadIndices[] = {0, 1, 2, 0, 2, 3};
+            for(int i = 0; i < 4; i++)
+                packed |= (uint32) (std::min(std::max(color[i], 0.f), 1.f) * 255.f + 0.5f) << (i * 8);
 
-            for(auto i : quadIndices)
-                this->indices.emplace_back(i + this->vertices.size() - 4);
+            return packed;
+        }
 
-            this->texCoords.emplace_back(quad.texCoords.x, quad.texCoords.y);
-            this->texCoords.emplace_back(quad.texCoords.z, quad.texCoords.y);
-            this->texCoords.emplace_back(quad.texCoords.z, quad.texCoords.w);
-            this->texCoords.emplace_back(quad.texCoords.x, quad.texCoords.w);
+        void addQuad(const Quad& quad, bool instanced){
+            auto& pos = quad.position;
 
-            //this->texCoords.push_back(quad.texCoords0);
-            //this->texCoords.push_back(quad.texCoords1);
             int found = -1;
             for (int i = 0; i < this->textures.size(); i++){
                 if (this->textures[i] == quad.texture){
@@ -83,34 +114,44 @@ namespace PetrolEngine {
                 found = this->textures.size() - 1;
             }
 
-            for(int i = 0; i < 4; i++)
-                this->textureIndexes.push_back(found);
-        }
+            // corners are expanded in the vertex shader, see OpenGLRenderer::setQuadInstancing
+            if(instanced){
+                this->instances.push_back({ pos, (uint32) found, quad.size, packColor(quad.color), 0, quad.texCoords });
+                return;
+            }
 
+            const uint quadIndices[] = {0, 1, 2, 0, 2, 3};
 
-        VertexArray* prepare(){
-            vertexData.resize(vertices.size());
+            for(auto i : quadIndices)
+                this->indices.emplace_back(i + this->vertices.size());
 
-            for(int i = 0; i < vertices.size(); i++){
-                vertexData[i]["position"] = vertices[i];
-                vertexData[i]["texCords"] = texCoords[i];
-                vertexData[i]["textureIndex"] = textureIndexes[i];
+            this->vertices.push_back({ { pos.x + 0          , pos.y + 0          , pos.z }, { quad.texCoords.x, quad.texCoords.y }, found });
+            this->vertices.push_back({ { pos.x + quad.size.x, pos.y + 0          , pos.z }, { quad.texCoords.z, quad.texCoords.y }, found });
+            this->vertices.push_back({ { pos.x + quad.size.x, pos.y + quad.size.y, pos.z }, { quad.texCoords.z, quad.texCoords.w }, found });
+            this->vertices.push_back({ { pos.x + 0          , pos.y + quad.size.y, pos.z }, { quad.texCoords.x, quad.texCoords.w }, found });
+        }
+
+
+        void prepare(){
+            if(!vertices.empty()){
+                vertexBuffer->setVertices(vertices);
+                vertexArray->getIndexBuffer()->setData(indices.data(), indices.size() * sizeof(uint));
             }
 
-//            auto a1 = vertexArray->getVertexBuffers()[0];
-//            auto a2 = vertexArray->getIndexBuffer  ()   ;
+            if(!instances.empty()){
+                uint32 size = (uint32) (instances.size() * sizeof(Instance));
 
-            vertexArray->getVertexBuffers()[0]->setData(vertexData.data , vertices.size() * vertexData.elementSize);
-            vertexArray->getIndexBuffer  ()   ->setData(indices   .data(), indices.size() * sizeof(uint));
+                if(instanceBuffer == nullptr) instanceBuffer = new OpenGLStorageBuffer(size, OpenGLRenderer::quadInstancesBinding);
 
-            return vertexArray;
+                instanceBuffer->reserve(size);
+                instanceBuffer->setData(instances.data(), size, 0);
+            }
         }
 
         void clear(){
             vertices.clear();
-            texCoords.clear();
-            textureIndexes.clear();
             indices.clear();
+            instances.clear();
             textures.clear();
         }
 
@@ -118,15 +159,14 @@ namespace PetrolEngine {
         Batch2D(Shader* shader){
             this->shader = shader;
 
-            vertexArray = OpenGL.newVertexArray();
+            vertexArray  = OpenGL.newVertexArray();
+            vertexBuffer = new OpenGLVertexBuffer(vertexLayoutOf<Vertex>());
 
-            auto* vbo = OpenGL.newVertexBuffer(layout);
+            VertexBuffer* vbo = vertexBuffer;
             auto* ibo = OpenGL.newIndexBuffer();
 
             vertexArray->addVertexBuffer(vbo);
             vertexArray-> setIndexBuffer(ibo);
-
-            vertexData.changeLayout(layout);
         }
     };
 
@@ -136,6 +176,10 @@ namespace PetrolEngine {
         const Camera* camera;
         const Transform* transform;
 
+        bool instancing = false;
+        // shared by all instanced batches, draws two triangles per instance
+        VertexArray* quadArray = nullptr;
+
         void addQuad(const Batch2D::Quad& quad, Shader* shader, const Transform* tra, const Camera* camera){
             auto batch = this->batches.find(shader);
             this->camera = camera;
@@ -146,18 +190,22 @@ namespace PetrolEngine {
                 batch = this->batches.find(shader);
             }
 
-            batch->second.addQuad(quad);
+            batch->second.addQuad(quad, instancing);
         }
 
         struct BatchData{
             VertexArray* vertexArray;
             Shader* shader;
             Vector<const Texture*>* textures;
+            const OpenGLStorageBuffer* instances;
+            uint32 instanceCount;
 
-            BatchData(VertexArray* vertexArray, Shader* shader, Vector<const Texture*>* textures){
+            BatchData(VertexArray* vertexArray, Shader* shader, Vector<const Texture*>* textures, const OpenGLStorageBuffer* instances = nullptr, uint32 instanceCount = 0){
                 this->vertexArray = vertexArray;
                 this->shader = shader;
                 this->textures = textures;
+                this->instances = instances;
+                this->instanceCount = instanceCount;
             }
         };
 
@@ -165,7 +213,23 @@ namespace PetrolEngine {
             Vector<BatchData> result;
 
             for(auto& batch : this->batches){
-                result.emplace_back(batch.second.prepare(), batch.second.shader, &batch.second.textures);
+                batch.second.prepare();
+
+                if(!batch.second.vertices.empty())
+                    result.emplace_back(batch.second.vertexArray, batch.second.shader, &batch.second.textures);
+
+                if(!batch.second.instances.empty()){
+                    if(quadArray == nullptr){
+                        const uint32 quadIndices[] = {0, 1, 2, 0, 2, 3};
+
+                        quadArray = OpenGL.newVertexArray();
+
+                        IndexBuffer* ibo = new OpenGLIndexBuffer(quadIndices, sizeof(quadIndices));
+                        quadArray->setIndexBuffer(ibo);
+                    }
+
+                    result.emplace_back(quadArray, batch.second.shader, &batch.second.textures, batch.second.instanceBuffer, (uint32) batch.second.instances.size());
+                }
             }
 
             return result;
@@ -175,6 +239,19 @@ namespace PetrolEngine {
             for(auto& batch : this->batches) batch.second.clear();
         }
 
+        // batches are copied around, so their GPU objects are deleted here and not by a destructor
+        void release(){
+            for(auto& batch : this->batches){
+                delete batch.second.vertexArray;
+                delete batch.second.instanceBuffer;
+            }
+
+            delete quadArray;
+
+            this->batches.clear();
+            quadArray = nullptr;
+        }
+
         Batcher2D(){
 
         }
@@ -196,18 +273,60 @@ namespace PetrolEngine {
 
     }
 
-    void OpenGLRenderer::draw(){ LOG_FUNCTION();
+    void OpenGLRenderer::draw(){ TRACE_FUNCTION();
+        // draws recorded so far request their texture levels once their world matrices are known
+        resolveTransforms();
+
+        // levels requested by the draws recorded so far are uploaded before they are submitted
+        if(textureStreamer) textureStreamer->update();
+
+        // everything recorded so far is the scene, 2D batches are recorded below and stay at native resolution
+        if(dynamicResolution) {
+            flush();
+            endScene();
+
+            overlayPass = true;
+        }
+
         for(auto batch : batcher2D.prepare()){
-            Transform a; // *batcher2D.transform->parent
-            renderMesh(batch.vertexArray, a, *batch.textures, batch.shader, batcher2D.camera);
-            batcher2D.clear();
-            delete  batcher2D.transform;
-            batcher2D.transform = nullptr;
+            if(batch.instances) {
+                renderQuads(batch.vertexArray, batch.instances, batch.instanceCount, *batch.textures, batch.shader, batcher2D.camera);
+                continue;
+            }
+
+            // vertices of the batches are already in world space
+            recordMesh(batch.vertexArray, nullptr, *batch.textures, batch.shader, batcher2D.camera);
         }
 
+        // recorded draws keep their own copy of the textures, batches can be cleared after all of them are recorded
+        batcher2D.clear();
+        batcher2D.transform = nullptr;
+        glyphTransforms.clear();
+
+        flush();
+
+        overlayPass = false;
+
+        if(frameOpen) {
+            dynamicResolution->endFrame();
+            frameOpen = false;
+        }
+
+        OpenGLCapture    ::frameBoundary();
+        OpenGLTracer     ::frameBoundary();
+        OpenGLDebugOutput::frameBoundary();
     }
 
 	void OpenGLRenderer::setViewport(int x, int y, int width, int height) { LOG_FUNCTION();
+		// recorded draws are submitted with the viewport they were recorded with, a scaled scene is upscaled into it
+		flush();
+		endScene();
+
+		viewportX      = x;
+		viewportY      = y;
+		viewportWidth  = width;
+		viewportHeight = height;
+
 		glViewport(x, y, width, height);
 	}
 
@@ -219,14 +338,79 @@ namespace PetrolEngine {
 		//	return 1;
 		//}
 
+		// installed first so messages about the setup below are reported too
+		if (debug) OpenGLDebugOutput::enable();
+
 		glEnable(GL_DEPTH_TEST);
         glDepthFunc(GL_LEQUAL);
 		glEnable(GL_CULL_FACE);
 		glCullFace(GL_BACK);
 
+		cameraBuffer  = new OpenGLUniformBuffer(sizeof(CameraData), cameraBinding );
+		objectsBuffer = new OpenGLStorageBuffer(sizeof(ObjectData), objectsBinding);
+		viewBuffer    = new OpenGLUniformBuffer(sizeof(ViewData  ), viewBinding   );
+		lightManager  = new OpenGLLightManager();
+
+		if(OpenGLGpuCulling::isSupported()) gpuCulling = new OpenGLGpuCulling();
+		else LOG("Compute shaders, multi draw indirect or storage buffer bindings are missing, GPU culling is disabled.", 1);
+
+		if(gpuCulling && !gpuCulling->isCompiled()) {
+			LOG("Culling shaders failed to compile, GPU culling is disabled.", 2);
+			delete gpuCulling;
+			gpuCulling = nullptr;
+		}
+
+		if(OpenGLSkinning::isSupported()) skinning = new OpenGLSkinning();
+		else LOG("Compute shaders or storage buffer bindings are missing, GPU skinning is disabled.", 1);
+
+		if(skinning && !skinning->isCompiled()) {
+			LOG("Skinning shader failed to compile, GPU skinning is disabled.", 2);
+			delete skinning;
+			skinning = nullptr;
+		}
+
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+
+		viewportX      = viewport[0];
+		viewportY      = viewport[1];
+		viewportWidth  = viewport[2];
+		viewportHeight = viewport[3];
+
+		// the directional light shaders had hard-coded before lights were managed, shaders that still declare
+		// the light[0] uniforms get it there as well (see bindCommand)
+		Light sun;
+		sun.type      = (uint32) LightType::Directional;
+		sun.direction = { -1.0f,  0.0f, 1.0f };
+		sun.ambient   = {  0.2f,  0.2f, 0.2f };
+		sun.diffuse   = {  1.0f,  1.0f, 1.0f };
+		sun.specular  = {  0.0f,  0.0f, 0.0f };
+
+		lightManager->addLight(sun);
+
 		return 0;
 	}
 
+	OpenGLRenderer::~OpenGLRenderer() {
+		delete cameraBuffer;
+		delete objectsBuffer;
+		delete viewBuffer;
+		delete lightManager;
+		delete gpuCulling;
+		delete skinning;
+		delete dynamicResolution;
+
+		batcher2D.release();
+
+		// everything the backend created itself is gone, what is left was not deleted by its owner
+		OpenGLMemory::reportLeaks();
+
+		if (OpenGLDebugOutput::isEnabled()) {
+			OpenGLDebugOutput::logSummary();
+			OpenGLDebugOutput::disable();
+		}
+	}
+
 	void OpenGLRenderer::renderText(const String& text, const Transform& transform, const Texture* atlas, Text::FontAtlas* fa, Shader* shader, const Camera* camera) { LOG_FUNCTION();
 //		glUseProgram(shader->getID());
 
@@ -237,7 +421,7 @@ namespace PetrolEngine {
         float x = transform.position.x;
 		float y = transform.position.y;
 
-        Transform* a = new Transform();
+        Transform* a = &glyphTransforms.emplace_back();
         a->parent = &transform;
         //glBindTexture(GL_TEXTURE_2D, atlas->getID());
 
@@ -270,75 +454,12 @@ namespace PetrolEngine {
 		}
 	}
 
-    bool fir = false;
-    UniformBuffer* ubo = nullptr;
     void OpenGLRenderer::renderMesh(const VertexArray* vao, const Transform& transform, const Vector<const Texture*>& textures, Shader* shader, const Camera* camera) { LOG_FUNCTION();
-		if(shader == nullptr) {LOG("ABORTING OBJECT PROVIDED WITH SHADER NULLPTR.", 2); return;}
-		glBindVertexArray(vao->getID());
-        glUseProgram(shader->getID());
-
-        struct View {
-            glm::mat4 model;
-            glm::mat4 projection;
-            glm::mat4 view;
-        } view;
-
-        if(!fir){
-            fir = true;
-            ubo = OpenGL.newUniformBuffer(sizeof(View), 0);
-        }
- 
-        view.model      = transform.getRelativeTransform().transformation;
-        view.projection = camera->getPerspective();
-        view.view       = camera->getViewMatrix ();
-
-        ubo->setData(&view, sizeof(View), 0);
-
-        shader->bindUniformBuffer("View", ubo);
-        //auto ia = glGetUniformBlockIndex(a, "_12_14"); // glGetUniformBlockIndex(a, "_14");
-        //LOG(toString(ia), 3);
-
-        //glUniformBlockBinding(a, ubo->getID(), 1);
-        //glUniformBlockBinding(a, ubo->getID(), ia); // glGetUniformBlockIndex
-        // Applying them to shader used by mesh
-		//shader->setMat4("model", transform.transformation);
-		//shader->setMat4("pav"  , camera->getPerspective() * camera->getViewMatrix());
-
-		shader->setInt  ( "material.diffuse"  , 0   );
-		shader->setInt  ( "material.specular" , 0   );
-		shader->setFloat( "material.shininess", 1.f );
-
-		shader->setInt  ( "light[0].lightType",  1                 );
-		shader->setVec3 ( "light[0].direction", -1.0f,  0.0f, 1.0f );
-		shader->setVec3 ( "light[0].ambient"  ,  0.2f,  0.2f, 0.2f );
-		shader->setVec3 ( "light[0].diffuse"  ,  1.0f,  1.0f, 1.0f );
-		shader->setVec3 ( "light[0].specular" ,  0.0f,  0.0f, 0.0f );
-
-		// loading textures into the buffers
-		uint32 diffuseNumber  = 1;
-		uint32 heightNumber   = 1;
-		uint32 normalNumber   = 1;
-		uint32 specularNumber = 1;
-
-		for (uint32 textureIndex = 0; textureIndex < textures.size(); textureIndex++) { LOG_SCOPE("Assigning texture");
-			const Texture* texture = textures[textureIndex];
-
-			//glActiveTexture(GL_TEXTURE0  + textureIndex);
-            //glBindTexture  (GL_TEXTURE_2D, texture->getID());
-            //std::cout<<texture->getID()<<" - i chuj ci w\n";
-            glBindTextureUnit(shader->metadata.textures[textureIndex], texture->getID());
+        recordMesh(vao, &transform, textures, shader, camera);
+    }
 
-            // shader->setUint("texture_diffuse"  + toString( diffuseNumber), textureIndex);
-			/*
-			switch (texture->type) {
-				case TextureI::TextureType::DIFFUSE : shader->setUint("texture_diffuse"  + toString( diffuseNumber), textureIndex); continue;
-				case TextureI::TextureType::HEIGHT  : shader->setUint("texture_height"   + toString(  heightNumber), textureIndex); continue;
-				case TextureI::TextureType::NORMAL  : shader->setUint("texture_normal"   + toString(  normalNumber), textureIndex); continue;
-                case TextureI::TextureType::SPECULAR: shader->setUint("texture_specular" + toString(specularNumber), textureIndex); continue;
-				
-				default: continue;
-			}*/
-		}
+    void OpenGLRenderer::recordMesh(const VertexArray* vao, const Transform* transform, const Vector<const Texture*>& textures, Shader* shader, const Camera* camera) {
+		if(shader == nullptr) {LOG("ABORTING OBJECT PROVIDED WITH SHADER NULLPTR.", 2); return;}
 
         if(vao->getIndexBuffer() == nullptr)
             LOG("Index buffer is null at draw.", 3);
@@ -346,11 +467,523 @@ namespace PetrolEngine {
         if(vao->getVertexBuffers().size() == 0)
             LOG("No vertex buffers at draw.", 3);
 
-		glDrawElements(GL_TRIANGLES, (int) vao->getIndexBuffer()->getSize(), GL_UNSIGNED_INT, nullptr);
-        glBindVertexArray(0);
+        DrawCommand command;
+        command.vao           = vao;
+        command.shader        = shader;
+        command.camera        = camera;
+        command.object        = (uint32) objects     .size();
+        command.transform     = transform;
+        command.transformNode = transform ? transforms.add(transform) : OpenGLTransformCache::noNode;
+        command.textureOffset = (uint32) drawTextures.size();
+        command.textureCount  = (uint32) textures    .size();
+        command.firstIndex    = 0;
+        command.indexCount    = (uint32) vao->getIndexBuffer()->getSize();
+        command.instanceCount = 1;
+        command.instances     = nullptr;
+        command.views         = nullptr;
+
+        // the model matrix, level and streaming requests come at resolveTransforms
+        objects.push_back({ glm::mat4(1.f) });
+        drawTextures.insert(drawTextures.end(), textures.begin(), textures.end());
+        drawCommands.push_back(command);
 	}
+
+    void OpenGLRenderer::renderMeshViews(const VertexArray* vao, const Transform& transform, const Vector<const Texture*>& textures, Shader* shader, OpenGLMultiView* views) { LOG_FUNCTION();
+        if(!OpenGLMultiView::isSupported()) {LOG("Multi view draws need storage buffer binding " + toString(OpenGLMultiView::viewsBinding) + ", draw skipped.", 2); return;}
+
+        size_t recorded = drawCommands.size();
+
+        // without a camera the draw is not culled, keeps the full detail level and its textures are requested at full size
+        renderMesh(vao, transform, textures, shader, nullptr);
+
+        if(drawCommands.size() != recorded) drawCommands.back().views = views;
+    }
+
+    void OpenGLRenderer::renderQuads(const VertexArray* quads, const OpenGLStorageBuffer* instances, uint32 instanceCount, const Vector<const Texture*>& textures, Shader* shader, const Camera* camera) { LOG_FUNCTION();
+        if(shader == nullptr) {LOG("ABORTING OBJECT PROVIDED WITH SHADER NULLPTR.", 2); return;}
+
+        DrawCommand command;
+        command.vao           = quads;
+        command.shader        = shader;
+        command.camera        = camera;
+        command.object        = (uint32) objects     .size();
+        command.transform     = nullptr;
+        command.transformNode = OpenGLTransformCache::noNode;
+        command.textureOffset = (uint32) drawTextures.size();
+        command.textureCount  = (uint32) textures    .size();
+        command.firstIndex    = 0;
+        command.indexCount    = 6;
+        command.instanceCount = instanceCount;
+        command.instances     = instances;
+        command.views         = nullptr;
+
+        objects.push_back({ glm::mat4(1.f) });
+        drawTextures.insert(drawTextures.end(), textures.begin(), textures.end());
+        drawCommands.push_back(command);
+    }
+
+    void OpenGLRenderer::updateLodCamera(const Camera* camera) {
+        // camera position and pixels per unit at distance 1 are computed once per camera and frame
+        if(camera == lodCamera) return;
+
+        lodCamera = camera;
+
+        glm::mat4 projection = camera->getPerspective();
+
+        lodCameraPosition = glm::vec3(glm::inverse(camera->getViewMatrix())[3]);
+        lodPixelScale     = projection[2][3] == -1.f ? 0.5f * (float) viewportHeight * projection[1][1] : 0.f;
+    }
+
+    float OpenGLRenderer::projectedSize(const OpenGLVertexArray* vao, const glm::mat4& model, const Camera* camera) {
+        if(camera == nullptr || !vao->hasBounds()) return FLT_MAX;
+
+        updateLodCamera(camera);
+
+        if(lodPixelScale == 0.f) return FLT_MAX;
+
+        glm::vec3 center = (vao->getBoundsMin() + vao->getBoundsMax()) * 0.5f;
+        float     radius = glm::length(vao->getBoundsMax() - vao->getBoundsMin()) * 0.5f;
+
+        float scale    = std::max(std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))), glm::length(glm::vec3(model[2])));
+        float distance = glm::length(glm::vec3(model * glm::vec4(center, 1.f)) - lodCameraPosition) - radius * scale;
+
+        if(distance <= 0.f) return FLT_MAX;
+
+        return 2.f * radius * scale * lodPixelScale / distance;
+    }
+
+    uint32 OpenGLRenderer::selectLod(const OpenGLVertexArray* vao, const Transform* transform, const glm::mat4& model, const Camera* camera) {
+        if(camera == nullptr) return 0;
+
+        updateLodCamera(camera);
+
+        // orthographic cameras keep the full mesh
+        if(lodPixelScale == 0.f) return 0;
+
+        const auto& lods = vao->getLods();
+
+        glm::vec3 center = vao->hasBounds() ? (vao->getBoundsMin() + vao->getBoundsMax()) * 0.5f : glm::vec3(0.f);
+        float     radius = vao->hasBounds() ? glm::length(vao->getBoundsMax() - vao->getBoundsMin()) * 0.5f : 0.f;
+
+        float scale = std::max(std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))), glm::length(glm::vec3(model[2])));
+
+        // distance to the closest point of the bounding sphere, inside of it the full mesh is used
+        float distance = glm::length(glm::vec3(model * glm::vec4(center, 1.f)) - lodCameraPosition) - radius * scale;
+
+        if(distance <= 0.f) return 0;
+
+        float pixelsPerUnit = scale * lodPixelScale / distance;
+
+        uint64 key = std::hash<const void*>()(transform) ^ (std::hash<const void*>()(vao) * 0x9E3779B97F4A7C15ull);
+
+        auto [state, inserted] = lodStates.try_emplace(key, LodState{ 0, frameIndex });
+        uint32 level = std::min(state->second.level, (uint32) lods.size() - 1);
+
+        // coarser only once the error is clearly below the threshold, finer as soon as it is above
+        while(level + 1 < lods.size() && lods[level + 1].error * pixelsPerUnit <= lodErrorThreshold * (1.f - lodHysteresis)) level++;
+        while(level > 0 && lods[level].error * pixelsPerUnit > lodErrorThreshold) level--;
+
+        state->second.level     = level;
+        state->second.lastFrame = frameIndex;
+
+        return level;
+    }
+
+    void OpenGLRenderer::bindCommand(const DrawCommand& command) {
+        Shader* shader = command.shader;
+
+        // camera block is rewritten only when the camera changes, usually once per frame,
+        // multi view draws have their cameras in the views buffer
+        if(command.camera && command.camera != currentCamera) {
+            currentCamera = command.camera;
+
+            CameraData cameraData;
+            cameraData.projection = currentCamera->getPerspective();
+            cameraData.view       = currentCamera->getViewMatrix ();
+
+            cameraBuffer->setData(&cameraData, sizeof(CameraData), 0);
+
+            lightManager->update(currentCamera, (uint32) viewportWidth, (uint32) viewportHeight);
+        }
+
+        static_cast<const OpenGLVertexArray*>(command.vao)->bind();
+
+        if(command.instances)
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, quadInstancesBinding, command.instances->getID());
+
+        if(shader != currentShader) {
+            currentShader    = shader;
+            currentViewBlock = usesViewBlock(shader);
+
+            static_cast<OpenGLShader*>(shader)->bind();
+            shader->bindUniformBuffer(currentViewBlock ? "View" : "Camera", currentViewBlock ? (UniformBuffer*) viewBuffer : cameraBuffer);
+
+            shader->setInt  ( "material.diffuse"  , 0   );
+            shader->setInt  ( "material.specular" , 0   );
+            shader->setFloat( "material.shininess", 1.f );
+
+            // shaders that do not read the Lights buffer yet get the first directional light as uniforms
+            if(const Light* sun = lightManager->getDirectionalLight()) {
+                shader->setInt  ( "light[0].lightType", (int) sun->type );
+                shader->setVec3 ( "light[0].direction", sun->direction  );
+                shader->setVec3 ( "light[0].ambient"  , sun->ambient    );
+                shader->setVec3 ( "light[0].diffuse"  , sun->diffuse    );
+                shader->setVec3 ( "light[0].specular" , sun->specular   );
+            }
+        }
+
+        for (uint32 textureIndex = 0; textureIndex < command.textureCount; textureIndex++) { LOG_SCOPE("Assigning texture");
+            const Texture* texture = drawTextures[command.textureOffset + textureIndex];
+
+            glBindTextureUnit(shader->metadata.textures[textureIndex], texture->getID());
+        }
+
+        if(currentViewBlock && command.camera) {
+            ViewData view;
+            view.model      = objects[command.object].model;
+            view.projection = command.camera->getPerspective();
+            view.view       = command.camera->getViewMatrix ();
+
+            viewBuffer->setData(&view, sizeof(ViewData), 0);
+        }
+    }
+
+    bool OpenGLRenderer::usesViewBlock(const Shader* shader) {
+        auto [entry, inserted] = viewBlockShaders.try_emplace(shader, false);
+
+        if(inserted) entry->second = static_cast<const OpenGLShader*>(shader)->hasUniformBlock("View");
+
+        return entry->second;
+    }
+
+    bool OpenGLRenderer::sameState(const DrawCommand& a, const DrawCommand& b) const {
+        if(a.vao != b.vao || a.shader != b.shader || a.camera != b.camera || a.textureCount != b.textureCount) return false;
+
+        for(uint32 i = 0; i < a.textureCount; i++)
+            if(drawTextures[a.textureOffset + i] != drawTextures[b.textureOffset + i]) return false;
+
+        return true;
+    }
+
+    void OpenGLRenderer::submitCulled(Vector<uint32>& direct) { TRACE_FUNCTION();
+        culledCommands.clear();
+        culledCamera = nullptr;
+
+        // only draws with bounds seen by the first perspective camera are culled, everything else is drawn directly
+        for(uint32 i = 0; i < drawCommands.size(); i++) {
+            const DrawCommand& command = drawCommands[i];
+            auto* vao = static_cast<const OpenGLVertexArray*>(command.vao);
+
+            bool perspective = command.camera && command.camera->getPerspective()[2][3] == -1.f;
+
+            if(culledCamera == nullptr && perspective && vao->hasBounds()) culledCamera = command.camera;
+
+            // the View block holds one model matrix, multi draws of its shaders would share it
+            if(vao->hasBounds() && command.camera == culledCamera && culledCamera != nullptr && !usesViewBlock(command.shader))
+                culledCommands.push_back(i);
+            else
+                direct.push_back(i);
+        }
+
+        if(culledCommands.empty()) return;
+
+        std::sort(culledCommands.begin(), culledCommands.end(), [this](uint32 a, uint32 b) {
+            const DrawCommand& x = drawCommands[a];
+            const DrawCommand& y = drawCommands[b];
+
+            if(x.shader != y.shader) return x.shader < y.shader;
+            if(x.vao    != y.vao   ) return x.vao    < y.vao   ;
+
+            const Texture* xTexture = x.textureCount ? drawTextures[x.textureOffset] : nullptr;
+            const Texture* yTexture = y.textureCount ? drawTextures[y.textureOffset] : nullptr;
+
+            return xTexture < yTexture;
+        });
+
+        culledViewProjection = culledCamera->getPerspective() * culledCamera->getViewMatrix();
+
+        gpuCulling->begin(culledViewProjection);
+
+        // consecutive draws sharing all state become one batch, drawn with a single multi draw
+        Vector<Pair<uint32, uint32>> batches;
+
+        for(uint32 i = 0; i < culledCommands.size(); i++) {
+            const DrawCommand& command = drawCommands[culledCommands[i]];
+
+            if(batches.empty() || !sameState(drawCommands[batches.back().first], command))
+                batches.emplace_back(culledCommands[i], gpuCulling->addBatch());
+
+            auto* vao = static_cast<const OpenGLVertexArray*>(command.vao);
+            const glm::mat4& model = objects[command.object].model;
+
+            // world space box of the transformed local box
+            glm::vec3 center = (vao->getBoundsMin() + vao->getBoundsMax()) * 0.5f;
+            glm::vec3 extent = (vao->getBoundsMax() - vao->getBoundsMin()) * 0.5f;
+
+            glm::vec4 worldCenter = model * glm::vec4(center, 1.f);
+            glm::vec3 worldExtent;
+
+            for(int axis = 0; axis < 3; axis++)
+                worldExtent[axis] = std::abs(model[0][axis]) * extent.x + std::abs(model[1][axis]) * extent.y + std::abs(model[2][axis]) * extent.z;
+
+            glm::vec3 worldPosition(worldCenter.x, worldCenter.y, worldCenter.z);
+
+            gpuCulling->addObject(batches.back().second, worldPosition - worldExtent, worldPosition + worldExtent, command.indexCount, command.firstIndex, command.object);
+        }
+
+        gpuCulling->cull();
+
+        // culling used its own program
+        currentShader = nullptr;
+
+        for(auto& [command, batch] : batches) {
+            bindCommand(drawCommands[command]);
+            gpuCulling->drawBatch(batch);
+        }
+    }
+
+    void OpenGLRenderer::resolveTransforms() { TRACE_FUNCTION();
+        if(resolvedCommands == drawCommands.size()) return;
+
+        transforms.resolve();
+
+        for(uint32 i = resolvedCommands; i < drawCommands.size(); i++) {
+            DrawCommand& command = drawCommands[i];
+
+            // instanced quads carry their own positions
+            if(command.instances) continue;
+
+            glm::mat4& model = objects[command.object].model;
+
+            if(command.transformNode != OpenGLTransformCache::noNode) model = transforms.getWorld(command.transformNode);
+
+            auto* vao = static_cast<const OpenGLVertexArray*>(command.vao);
+            const auto& lods = vao->getLods();
+
+            if(!lods.empty()) {
+                const LodLevel& level = lods[selectLod(vao, command.transform, model, command.camera)];
+
+                command.firstIndex = level.firstIndex;
+                command.indexCount = level.indexCount;
+            }
+
+            if(textureStreamer && command.textureCount) {
+                float pixels = projectedSize(vao, model, command.camera);
+
+                for(uint32 t = 0; t < command.textureCount; t++) textureStreamer->request(drawTextures[command.textureOffset + t], pixels);
+            }
+        }
+
+        resolvedCommands = (uint32) drawCommands.size();
+    }
+
+    void OpenGLRenderer::flush() { TRACE_FUNCTION();
+        if(drawCommands.empty()) return;
+
+        beginScene();
+
+        resolveTransforms();
+
+        // all per-object data of the frame goes in with a single upload
+        uint32 objectsSize = (uint32) (objects.size() * sizeof(ObjectData));
+
+        objectsBuffer->reserve(objectsSize);
+        objectsBuffer->setData(objects.data(), objectsSize, 0);
+
+        OpenGLVertexArray::reserveObjectIndices((uint32) objects.size());
+
+        // skinned caches are shared by every pass, only new poses are skinned
+        if(skinning) skinning->update();
+
+        currentCamera = nullptr;
+        currentShader = nullptr;
+
+        // code outside the renderer may have bound vertex arrays since the last flush
+        OpenGLVertexArray::invalidateBinding();
+
+        directCommands.clear();
+
+        if(gpuCulling && gpuCullingEnabled)
+            submitCulled(directCommands);
+        else
+            for(uint32 i = 0; i < drawCommands.size(); i++) directCommands.push_back(i);
+
+        for(uint32 i : directCommands) { TRACE_SCOPE("Submitting draw");
+            const DrawCommand& command = drawCommands[i];
+
+            bindCommand(command);
+
+            if(command.views) {
+                submitViews(command);
+                continue;
+            }
+
+            if(currentViews) {
+                currentViews->end();
+                currentViews = nullptr;
+            }
+
+            submitDraw(command, command.instanceCount);
+        }
+
+        if(currentViews) {
+            currentViews->end();
+            currentViews = nullptr;
+        }
+
+        OpenGLVertexArray::unbind();
+
+        // depth of this frame is what the next frame's occlusion test uses
+        // the scene rendered into the dynamic resolution target covers its lower left corner
+        if(gpuCulling && gpuCullingEnabled && culledCamera) {
+            if(sceneOpen)           gpuCulling->buildDepthPyramid(dynamicResolution->getDepth(), culledViewProjection, dynamicResolution->getSceneSize());
+            else if(occlusionDepth) gpuCulling->buildDepthPyramid(occlusionDepth, culledViewProjection);
+
+            glUseProgram(0);
+        }
+
+        drawCommands.clear();
+        objects     .clear();
+        drawTextures.clear();
+
+        resolvedCommands = 0;
+
+        lodCamera = nullptr;
+
+        // shaders may be destroyed before the next flush
+        viewBlockShaders.clear();
+
+        if(++frameIndex % 256 == 0) {
+            for(auto it = lodStates.begin(); it != lodStates.end(); ) {
+                if(frameIndex - it->second.lastFrame > 256) it = lodStates.erase(it);
+                else                                        it++;
+            }
+        }
+	}
+
+    void OpenGLRenderer::submitDraw(const DrawCommand& command, uint32 instanceCount) {
+        // base instance carries the object index to the shader, it offsets the objectIndex attribute
+        glDrawElementsInstancedBaseInstance(
+            GL_TRIANGLES,
+            (int) command.indexCount,
+            GL_UNSIGNED_INT,
+            (const void*) (uint64) (command.firstIndex * sizeof(uint32)),
+            (int) instanceCount,
+            command.object
+        );
+    }
+
+    void OpenGLRenderer::submitViews(const DrawCommand& command) { TRACE_FUNCTION();
+        OpenGLMultiView* views = command.views;
+
+        uint32 viewCount = (uint32) views->getViews().size();
+        if(viewCount == 0) return;
+
+        bool singlePass = views->isSinglePass(command.shader);
+
+        // consecutive draws into the same views keep the target, viewports and header bound
+        if(views != currentViews || singlePass != currentSinglePass) {
+            if(currentViews && views != currentViews) currentViews->end();
+
+            views->begin(singlePass);
+
+            currentViews      = views;
+            currentSinglePass = singlePass;
+        }
+
+        if(singlePass) {
+            submitDraw(command, command.instanceCount * viewCount);
+            return;
+        }
+
+        for(uint32 view = 0; view < viewCount; view++) {
+            views->beginView(view);
+            submitDraw(command, command.instanceCount);
+        }
+    }
+
+    void OpenGLRenderer::beginScene() {
+        if(!dynamicResolution || sceneOpen || overlayPass) return;
+
+        // the frame is timed from its first scene on
+        if(!frameOpen) {
+            dynamicResolution->beginFrame();
+            frameOpen = true;
+        }
+
+        outputSize = { viewportWidth, viewportHeight };
+
+        glm::ivec2 sceneSize = dynamicResolution->beginScene(viewportX, viewportY, viewportWidth, viewportHeight);
+
+        viewportWidth  = sceneSize.x;
+        viewportHeight = sceneSize.y;
+
+        sceneOpen = true;
+    }
+
+    void OpenGLRenderer::endScene() {
+        if(!sceneOpen) return;
+
+        viewportWidth  = outputSize.x;
+        viewportHeight = outputSize.y;
+
+        dynamicResolution->endScene();
+
+        sceneOpen = false;
+    }
+
+    void OpenGLRenderer::dispatch(OpenGLComputeShader* shader, uint32 x, uint32 y, uint32 z) { TRACE_FUNCTION();
+        shader->dispatch(x, y, z);
+        currentShader = nullptr;
+    }
+
+    void OpenGLRenderer::dispatchIndirect(OpenGLComputeShader* shader, const OpenGLStorageBuffer* arguments, uint32 offset) { TRACE_FUNCTION();
+        shader->dispatchIndirect(arguments, offset);
+        currentShader = nullptr;
+    }
+
+    void OpenGLRenderer::memoryBarrier(GLbitfield barriers) {
+        OpenGLComputeShader::memoryBarrier(barriers);
+    }
+
+    void OpenGLRenderer::setQuadInstancing(bool enabled) {
+        if(enabled && !OpenGLCapabilities::get().storageBinding(quadInstancesBinding)) {
+            LOG("Quad instances need storage buffer binding " + toString(quadInstancesBinding) + ", quads stay batched as vertices.", 1);
+            return;
+        }
+
+        batcher2D.instancing = enabled;
+    }
+
+    void OpenGLRenderer::setGpuCulling(bool enabled) {
+        gpuCullingEnabled = enabled;
+    }
+
+    void OpenGLRenderer::setDynamicResolution(bool enabled) {
+        if(enabled == (dynamicResolution != nullptr)) return;
+
+        if(enabled) dynamicResolution = new OpenGLDynamicResolution();
+        else {
+            // draws already in the target are upscaled before it goes away
+            flush();
+            endScene();
+
+            if(frameOpen) dynamicResolution->endFrame();
+            frameOpen = false;
+
+            delete dynamicResolution;
+            dynamicResolution = nullptr;
+        }
+    }
+
+    OpenGLGpuCulling::Statistics OpenGLRenderer::getCullingStatistics() const {
+        return gpuCulling ? gpuCulling->getStatistics() : OpenGLGpuCulling::Statistics();
+    }
 	
 	void OpenGLRenderer::clear() {
+		// draws recorded before the clear go in first
+		flush();
+
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	}
 
@@ -7,11 +7,23 @@
 #include "OpenGLTexture.h"
 #include "OpenGLVertexArray.h"
 #include "OpenGLVertexBuffer.h"
+#include "OpenGLUniformBuffer.h"
+#include "OpenGLStorageBuffer.h"
+#include "OpenGLLightManager.h"
+#include "OpenGLGpuCulling.h"
+#include "OpenGLComputeShader.h"
+#include "OpenGLSkinning.h"
+#include "OpenGLDynamicResolution.h"
+#include "OpenGLTextureStreamer.h"
+#include "OpenGLMultiView.h"
+#include "OpenGLTransformCache.h"
 
 #include <Core/Components/Transform.h>
 #include <Core/Components/Material.h>
 #include <Core/Components/Camera.h>
 #include <Freetype/Renderer/Text.h>
+
+#include <deque>
 // TODO: make sure to move shader sources.
 
 namespace PetrolEngine {
@@ -23,7 +35,15 @@ namespace PetrolEngine {
 		void draw() override;
 		
 		// 3D stuff
+		// draws are recorded and submitted at flush (called by draw, setViewport and clear), per-object data is
+		// uploaded once per frame. Draws go into the framebuffer bound at flush, call flush before binding another one.
+		// Shaders read Camera and Objects (below), shaders that still declare the View block get it per draw.
+		// Draws are submitted in recording order, except with GPU culling (setGpuCulling): culled draws are sorted
+		// by state and submitted before all others, draws that depend on their order (blending) need no bounds.
 		void renderMesh(const VertexArray* vao, const Transform& transform, const Vector<const Texture*>& textures, Shader* shader, const Camera* camera) override;
+		// drawn once into every view of views (see OpenGLMultiView), which has to live until flush
+		void renderMeshViews(const VertexArray* vao, const Transform& transform, const Vector<const Texture*>& textures, Shader* shader, OpenGLMultiView* views);
+		void flush();
 
 		// utility
 		void setViewport(int x, int y, int width, int height) override;
@@ -39,8 +59,195 @@ namespace PetrolEngine {
 			{DeviceConstant::MAX_TEXTURE_IMAGE_UNITS, GL_MAX_TEXTURE_IMAGE_UNITS}
 		};
 
-        ~OpenGLRenderer() override = default;
+        ~OpenGLRenderer() override;
 
         void drawQuad2D(const Material &material, const Transform &transform, const Camera *camera);
+
+		// layout(std140, binding = 0) uniform Camera { mat4 projection; mat4 view; };
+		struct CameraData {
+			glm::mat4 projection;
+			glm::mat4 view;
+		};
+
+		// layout(std430, binding = 1) readonly buffer Objects { ObjectData objects[]; };
+		// indexed in shaders by the objectIndex attribute (OpenGLVertexArray::objectIndexLocation)
+		struct ObjectData {
+			glm::mat4 model;
+		};
+
+		// layout(std140) uniform View { mat4 model; mat4 projection; mat4 view; };
+		// the block every mesh was drawn with before Camera and Objects, written before every draw of a shader
+		// that declares it, those draws are not culled on the GPU
+		struct ViewData {
+			glm::mat4 model;
+			glm::mat4 projection;
+			glm::mat4 view;
+		};
+
+		static constexpr uint32 cameraBinding  = 0;
+		static constexpr uint32 objectsBinding = 1;
+		static constexpr uint32 viewBinding    = 1; // uniform buffer binding, storage binding 1 is Objects
+
+		// Instanced quads: every drawQuad2D becomes one record instead of 4 vertices and 6 indices,
+		// a shared index buffer draws two triangles per instance. Shaders of instanced batches pull the
+		// record by gl_InstanceID and expand the corner from gl_VertexID:
+		//
+		// struct QuadInstance { vec3 position; uint textureIndex; vec2 size; uint color; uint padding; vec4 texCoords; };
+		// layout(std430, binding = 8) readonly buffer QuadInstances { QuadInstance quads[]; };
+		//
+		// QuadInstance quad   = quads[gl_InstanceID];
+		// vec2         corner = vec2(gl_VertexID == 1 || gl_VertexID == 2, gl_VertexID >= 2);
+		// vec3         pos    = quad.position + vec3(corner * quad.size, 0.0);
+		// vec2         uv     = mix(quad.texCoords.xy, quad.texCoords.zw, corner);
+		// vec4         color  = unpackUnorm4x8(quad.color);
+		static constexpr uint32 quadInstancesBinding = 8;
+
+		void setQuadInstancing(bool enabled);
+
+		// compute work runs immediately, before the draws recorded so far are submitted at flush,
+		// results used by draws need a memoryBarrier (e.g. GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT)
+		void dispatch        (OpenGLComputeShader* shader, uint32 x, uint32 y = 1, uint32 z = 1);
+		void dispatchIndirect(OpenGLComputeShader* shader, const OpenGLStorageBuffer* arguments, uint32 offset = 0);
+		void memoryBarrier   (GLbitfield barriers);
+
+		OpenGLLightManager* getLightManager() { return lightManager; }
+		// nullptr without compute shaders, poses set before draw are skinned at the start of flush
+		OpenGLSkinning*     getSkinning    () { return skinning;     }
+
+		// draws of meshes with bounds (OpenGLVertexArray::setBounds) are culled on the GPU when supported,
+		// they are batched by state and submitted ahead of the other draws of the flush
+		void setGpuCulling(bool enabled);
+		// depth texture the scene is rendered into, used for occlusion culling in the next frame,
+		// with dynamic resolution the depth of its target is used instead
+		void setOcclusionDepthSource(const Texture* depth) { occlusionDepth = depth; }
+
+		OpenGLGpuCulling::Statistics getCullingStatistics() const;
+
+		// meshes with lods (OpenGLVertexArray::generateLods) use the coarsest level whose error
+		// projects to at most threshold pixels, hysteresis is the fraction the error has to drop
+		// below the threshold before switching to a coarser level
+		void setLodErrorThreshold(float pixels    ) { lodErrorThreshold = pixels;     }
+		void setLodHysteresis    (float hysteresis) { lodHysteresis     = hysteresis; }
+
+		// 3D draws are rendered at a scale of the viewport that follows the GPU frame time and upscaled,
+		// 2D batches are drawn afterwards at native resolution
+		void setDynamicResolution(bool enabled);
+		// nullptr while disabled
+		OpenGLDynamicResolution* getDynamicResolution() { return dynamicResolution; }
+
+		// textures of the streamer get the projected size of the meshes drawn with them as feedback,
+		// the streamer is updated at the start of draw, not owned
+		void setTextureStreamer(OpenGLTextureStreamer* streamer) { textureStreamer = streamer; }
+
+		// world matrices of drawn transforms are computed in batches at flush and kept while they do not change
+		OpenGLTransformCache& getTransformCache() { return transforms; }
+
+	private:
+		struct DrawCommand {
+			const VertexArray* vao;
+			Shader*            shader;
+			const Camera*      camera;
+			uint32             object;
+			const Transform*   transform;     // only identifies the draw for level selection, may be gone at flush
+			uint32             transformNode; // OpenGLTransformCache::noNode for identity
+			uint32             textureOffset;
+			uint32             textureCount;
+			uint32             firstIndex;
+			uint32             indexCount;
+			uint32             instanceCount;
+
+			const OpenGLStorageBuffer* instances;
+			OpenGLMultiView*           views;
+		};
+
+		void recordMesh (const VertexArray* vao, const Transform* transform, const Vector<const Texture*>& textures, Shader* shader, const Camera* camera);
+		void renderQuads(const VertexArray* quads, const OpenGLStorageBuffer* instances, uint32 instanceCount, const Vector<const Texture*>& textures, Shader* shader, const Camera* camera);
+
+		struct LodState {
+			uint32 level;
+			uint64 lastFrame;
+		};
+
+		uint32 selectLod(const OpenGLVertexArray* vao, const Transform* transform, const glm::mat4& model, const Camera* camera);
+		// screen space diameter of the mesh bounds in pixels, unbounded meshes and orthographic cameras get FLT_MAX
+		float  projectedSize(const OpenGLVertexArray* vao, const glm::mat4& model, const Camera* camera);
+		void   updateLodCamera(const Camera* camera);
+
+		// world matrices, levels and streaming feedback of the draws recorded since the last call
+		void resolveTransforms();
+
+		// whether the shader declares the View block, asked once per shader and flush
+		bool usesViewBlock(const Shader* shader);
+
+		void bindCommand (const DrawCommand& command);
+		bool sameState   (const DrawCommand& a, const DrawCommand& b) const;
+		void submitCulled(Vector<uint32>& direct);
+		void submitViews (const DrawCommand& command);
+		void submitDraw  (const DrawCommand& command, uint32 instanceCount);
+
+		// with dynamic resolution every flush of scene draws goes into its target, from the first one
+		// until the viewport changes or draw upscales it, so draws flushed early are not drawn over
+		void beginScene();
+		void endScene  ();
+
+		Vector<DrawCommand>    drawCommands;
+		Vector<ObjectData>     objects;
+		Vector<const Texture*> drawTextures;
+
+		OpenGLTransformCache transforms;
+		uint32               resolvedCommands = 0;
+
+		// one per renderText call, quads keep pointing at them until the 2D batches are drawn
+		std::deque<Transform> glyphTransforms;
+
+		OpenGLUniformBuffer* cameraBuffer  = nullptr;
+		OpenGLStorageBuffer* objectsBuffer = nullptr;
+		OpenGLUniformBuffer* viewBuffer    = nullptr;
+		OpenGLLightManager*  lightManager  = nullptr;
+		OpenGLGpuCulling*    gpuCulling    = nullptr;
+		OpenGLSkinning*      skinning      = nullptr;
+
+		OpenGLDynamicResolution* dynamicResolution = nullptr;
+		OpenGLTextureStreamer*   textureStreamer   = nullptr;
+
+		bool           gpuCullingEnabled = true;
+		const Texture* occlusionDepth    = nullptr;
+
+		Vector<uint32> directCommands;
+		Vector<uint32> culledCommands;
+		const Camera*  culledCamera = nullptr;
+		glm::mat4      culledViewProjection{1.f};
+
+		float lodErrorThreshold = 1.f;
+		float lodHysteresis     = 0.25f;
+
+		// last level of every (transform, vao) pair, entries not drawn for a while are dropped
+		UnorderedMap<uint64, LodState> lodStates;
+		uint64 frameIndex = 0;
+
+		const Camera* lodCamera = nullptr;
+		glm::vec3     lodCameraPosition{0.f};
+		float         lodPixelScale = 0.f;
+
+		// state tracking while submitting
+		const Camera* currentCamera    = nullptr;
+		const Shader* currentShader    = nullptr;
+		bool          currentViewBlock = false;
+
+		UnorderedMap<const Shader*, bool> viewBlockShaders;
+
+		OpenGLMultiView* currentViews      = nullptr;
+		bool             currentSinglePass = false;
+
+		int viewportX      = 0;
+		int viewportY      = 0;
+		int viewportWidth  = 0;
+		int viewportHeight = 0;
+
+		// dynamic resolution, the viewport size is the scene's while it is open
+		bool       sceneOpen    = false;
+		bool       frameOpen    = false;
+		bool       overlayPass  = false; // 2D batches, drawn at native resolution
+		glm::ivec2 outputSize{0, 0};
     };
 }
@@ -0,0 +1,221 @@
+#include <PCH.h>
+
+#include "OpenGLResourceLoader.h"
+#include "OpenGL.h"
+#include "OpenGLCapture.h"
+#include "OpenGLTexture.h"
+#include "OpenGLTracer.h"
+
+#include <GLFW/glfw3.h>
+
+#include <memory>
+
+namespace PetrolEngine {
+    OpenGLResourceLoader::OpenGLResourceLoader() { LOG_FUNCTION();
+        GLFWwindow* shared = glfwGetCurrentContext();
+
+        if (shared == nullptr || OpenGLCapture::isInstalled()) {
+            LOG("Resource loader runs on the render thread, no shared context.", 1);
+            return;
+        }
+
+        // same version and profile as the context it shares with
+        GLint major, minor, profile = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 3 || (major == 3 && minor >= 2)) glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &profile);
+
+        glfwWindowHint(GLFW_VISIBLE              , GLFW_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+        if (profile & GL_CONTEXT_CORE_PROFILE_BIT) glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+        // windows have to be created on the main thread, only making the context current moves
+        window = glfwCreateWindow(1, 1, "resource loader", nullptr, shared);
+
+        glfwDefaultWindowHints();
+
+        // creating a window can change the current context on some platforms
+        glfwMakeContextCurrent(shared);
+
+        if (window == nullptr) {
+            LOG("Shared context for the resource loader could not be created, it runs on the render thread.", 2);
+            return;
+        }
+
+        thread = std::thread(&OpenGLResourceLoader::run, this);
+    }
+
+    OpenGLResourceLoader::~OpenGLResourceLoader() { LOG_FUNCTION();
+        if (thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                // jobs that did not start are dropped, the one running finishes
+                pending -= (uint32) jobs.size();
+                jobs.clear();
+                stopping = true;
+            }
+
+            wake.notify_one();
+            thread.join();
+
+            glfwDestroyWindow(window);
+        }
+
+        // created resources are still handed over, waiting is fine at shutdown
+        for (auto& it : finished) {
+            glClientWaitSync(it.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(it.fence);
+
+            it.publish();
+        }
+    }
+
+    void OpenGLResourceLoader::enqueue(std::function<void()> create, std::function<void()> publish) {
+        pending++;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back({ std::move(create), std::move(publish) });
+        }
+
+        wake.notify_one();
+    }
+
+    void OpenGLResourceLoader::run() {
+        glfwMakeContextCurrent(window);
+
+        while (true) {
+            Job job;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+                if (stopping) break;
+
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            job.create();
+
+            // the fence is only seen by the render thread once it reached the GPU
+            GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back({ fence, std::move(job.publish) });
+        }
+
+        glfwMakeContextCurrent(nullptr);
+    }
+
+    uint32 OpenGLResourceLoader::poll() { TRACE_FUNCTION();
+        uint32 published = 0;
+
+        // without a loader thread, everything queued is created right here
+        if (!thread.joinable()) {
+            std::deque<Job> queued;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queued.swap(jobs);
+            }
+
+            for (auto& job : queued) {
+                job.create ();
+                job.publish();
+
+                pending--;
+                published++;
+            }
+
+            return published;
+        }
+
+        while (true) {
+            Finished next;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (finished.empty()) break;
+
+                // in queue order, the first one not complete holds back the rest
+                if (glClientWaitSync(finished.front().fence, 0, 0) == GL_TIMEOUT_EXPIRED) break;
+
+                next = std::move(finished.front());
+                finished.pop_front();
+            }
+
+            glDeleteSync(next.fence);
+            next.publish();
+
+            pending--;
+            published++;
+        }
+
+        return published;
+    }
+
+    void OpenGLResourceLoader::loadTexture(const Image& image, std::function<void(Texture*)> ready) {
+        auto texture = std::make_shared<Texture*>(nullptr);
+
+        // the mip chain is filtered here when the loader has a thread, on the render thread the driver generates it
+        bool threaded = isThreaded();
+
+        enqueue([texture, &image, threaded] {
+                    *texture = threaded ? new OpenGLTexture(OpenGLTexturePreprocessor::prepare(image)) : OpenGL.newTexture(image);
+                },
+                [texture, ready ] { ready(*texture); });
+    }
+
+    void OpenGLResourceLoader::loadMesh(const VertexLayout& layout, Vector<uint8> vertices, Vector<uint32> indices, std::function<void(OpenGLVertexArray*)> ready) {
+        struct Buffers {
+            VertexLayout   layout;
+            Vector<uint8>  vertices;
+            Vector<uint32> indices;
+            VertexBuffer*  vertexBuffer = nullptr;
+            IndexBuffer*   indexBuffer  = nullptr;
+        };
+
+        auto buffers = std::make_shared<Buffers>();
+        buffers->layout   = layout;
+        buffers->vertices = std::move(vertices);
+        buffers->indices  = std::move(indices);
+
+        enqueue([buffers] {
+            buffers->vertexBuffer = OpenGL.newVertexBuffer(buffers->layout, buffers->vertices.data(), (int64) buffers->vertices.size());
+            buffers->indexBuffer  = OpenGL.newIndexBuffer (                 buffers->indices .data(), (int64) (buffers->indices.size() * sizeof(uint32)));
+
+            // uploaded, the CPU copies are not needed any more
+            buffers->vertices = {};
+            buffers->indices  = {};
+        },
+        [buffers, ready] {
+            auto* vertexArray = static_cast<OpenGLVertexArray*>(OpenGL.newVertexArray());
+
+            vertexArray->addVertexBuffer(buffers->vertexBuffer);
+            vertexArray->setIndexBuffer (buffers->indexBuffer );
+
+            ready(vertexArray);
+        });
+    }
+
+    void OpenGLResourceLoader::loadShader(const String& name, const String& vertexCode, const String& fragmentCode, const String& geometryCode, std::function<void(Shader*)> ready) {
+        auto shader = std::make_shared<Shader*>(nullptr);
+
+        // pipelines and their stage cache belong to the render thread
+        bool separable = OpenGLShader::separablePrograms;
+
+        enqueue([shader, separable, name, vertexCode, fragmentCode, geometryCode] {
+            if (!separable) *shader = OpenGL.newShader(name, vertexCode, fragmentCode, geometryCode);
+        },
+        [shader, separable, name, vertexCode, fragmentCode, geometryCode, ready] {
+            if (separable) *shader = OpenGL.newShader(name, vertexCode, fragmentCode, geometryCode);
+
+            ready(*shader);
+        });
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Core/Aliases.h>
+#include <Core/Renderer/VertexBuffer.h>
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+struct GLFWwindow;
+
+namespace PetrolEngine {
+    class Image;
+    class Texture;
+    class Shader;
+    class OpenGLVertexArray;
+
+    // Creates GL resources on a thread of its own, with a hidden window whose context shares objects
+    // with the one current where the loader is constructed (the render thread's).
+    //
+    // A job creates and uploads on the loader thread, then a fence is inserted behind its commands.
+    // poll() on the render thread checks the fences without waiting and hands every resource whose
+    // fence is signaled to its callback, in the order the jobs were queued.
+    //
+    // Only shareable objects are created on the loader thread: textures, buffers and programs.
+    // Vertex arrays are container objects and OpenGLVertexArray shares them through a cache that
+    // belongs to the render thread, so meshes get their vertex array when published. The same goes
+    // for shaders while OpenGLShader::separablePrograms is set, their pipelines are compiled at publish.
+    //
+    // Without a shared context (no current GLFW context, or OpenGLCapture installed, which records a
+    // single context) every job runs on the render thread in poll().
+    class OpenGLResourceLoader {
+    public:
+        OpenGLResourceLoader();
+        ~OpenGLResourceLoader();
+
+        OpenGLResourceLoader(const OpenGLResourceLoader&) = delete;
+        OpenGLResourceLoader& operator=(const OpenGLResourceLoader&) = delete;
+
+        bool isThreaded() const { return thread.joinable(); }
+
+        // create runs with the loader context current, publish on the render thread once create's commands completed
+        void enqueue(std::function<void()> create, std::function<void()> publish);
+
+        // image has to stay alive until ready is called
+        void loadTexture(const Image& image, std::function<void(Texture*)> ready);
+        void loadMesh   (const VertexLayout& layout, Vector<uint8> vertices, Vector<uint32> indices, std::function<void(OpenGLVertexArray*)> ready);
+        void loadShader (const String& name, const String& vertexCode, const String& fragmentCode, const String& geometryCode, std::function<void(Shader*)> ready);
+
+        // publishes finished resources, never waits, returns how many were published
+        uint32 poll();
+
+        // queued or created but not published yet
+        uint32 getPendingCount() const { return pending; }
+
+    private:
+        struct Job {
+            std::function<void()> create;
+            std::function<void()> publish;
+        };
+
+        struct Finished {
+            GLsync                fence;
+            std::function<void()> publish;
+        };
+
+        void run();
+
+        GLFWwindow* window = nullptr;
+
+        std::thread             thread;
+        std::mutex              mutex;
+        std::condition_variable wake;
+        bool                    stopping = false;
+
+        std::deque<Job>      jobs;
+        std::deque<Finished> finished;
+
+        std::atomic<uint32> pending{0};
+    };
+}
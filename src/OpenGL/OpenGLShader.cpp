@@ -4,6 +4,9 @@
 #include "Core/DebugTools.h"
 #include "Core/Renderer/Shader.h"
 #include "OpenGLShader.h"
+#include "OpenGLProgramPipeline.h"
+#include "OpenGLMemory.h"
+#include "OpenGLCapabilities.h"
 
 #include <Core/Files.h>
 
@@ -13,6 +16,10 @@
 
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <regex>
+
 //
 // INFO
 // 1. I use here properties of glShaderXXX(shader) which is stated at khronos site "A value of 0 for shader will be silently ignored."
@@ -28,13 +35,104 @@ void errorCheck()
 
 namespace PetrolEngine {
 
+    bool OpenGLShader::separablePrograms = false;
+
     void OpenGLShader::bindUniformBuffer(const String& name, UniformBuffer* uniformBuffer) {
-        uint32 bind = this->metadata.uniforms[name];
-        glUniformBlockBinding(this->ID, bind, uniformBuffer->getBinding());
+        if (pipeline == 0) {
+            // blocks the reflection did not see are looked up, shaders without the block are left alone
+            auto   entry = this->metadata.uniforms.find(name);
+            GLuint bind  = entry != this->metadata.uniforms.end() ? (GLuint) entry->second : glGetUniformBlockIndex(this->ID, name.c_str());
+
+            if (bind != GL_INVALID_INDEX) glUniformBlockBinding(this->ID, bind, uniformBuffer->getBinding());
+            return;
+        }
+
+        // block indices are per program
+        for (uint32 program : stagePrograms) {
+            if (program == 0) continue;
+
+            GLuint index = glGetUniformBlockIndex(program, name.c_str());
+            if (index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, uniformBuffer->getBinding());
+        }
+    }
+
+    bool OpenGLShader::hasUniformBlock(const String& name) const {
+        if (pipeline == 0) return ID != 0 && glGetUniformBlockIndex(ID, name.c_str()) != GL_INVALID_INDEX;
+
+        for (uint32 program : stagePrograms)
+            if (program != 0 && glGetUniformBlockIndex(program, name.c_str()) != GL_INVALID_INDEX) return true;
+
+        return false;
+    }
+
+    void OpenGLShader::bind() const {
+        if (pipeline == 0) {
+            glUseProgram(ID);
+            return;
+        }
+
+        // a program in use takes precedence over the bound pipeline
+        glUseProgram(0);
+        glBindProgramPipeline(pipeline);
+    }
+
+    void OpenGLShader::compileSeparable(uint32 vertexProgram, uint32 fragmentProgram, uint32 geometryProgram, bool geometry) {
+        uint32 programs[3] = { vertexProgram, fragmentProgram, geometryProgram };
+
+        // if any stage failed keep the previous pipeline
+        if (vertexProgram == 0 || fragmentProgram == 0 || (geometry && geometryProgram == 0)) {
+            for (uint32 program : programs) OpenGLProgramPipeline::releaseStage(program);
+            return;
+        }
+
+        uint32 newPipeline = OpenGLProgramPipeline::acquire(vertexProgram, fragmentProgram, geometryProgram);
+
+        releaseSeparable();
+
+        this->pipeline = newPipeline;
+        for (uint32 i = 0; i < 3; i++) stagePrograms[i] = programs[i];
+    }
+
+    void OpenGLShader::releaseSeparable() {
+        OpenGLProgramPipeline::release(pipeline);
+        for (uint32 program : stagePrograms) OpenGLProgramPipeline::releaseStage(program);
+
+        pipeline = 0;
+        for (uint32& program : stagePrograms) program = 0;
+    }
+
+    // for drivers without GL_ARB_gl_spirv, the byte code back to GLSL of a version the driver compiles
+    static String fromSpvToGlsl(const Vector<uint32>& spv, const ShaderSpecialization& specialization) {
+        spirv_cross::CompilerGLSL compiler(spv);
+
+        auto options = compiler.get_common_options();
+        options.version = (uint32) std::min(450, std::max(330, OpenGLCapabilities::get().glslVersion));
+        options.es      = false;
+        compiler.set_common_options(options);
+
+        String source = compiler.compile();
+
+        // without Vulkan semantics specialization constants are overridable macros, defined right after #version
+        String defines;
+        for (auto& constant : specialization.getConstants())
+            defines += "#define SPIRV_CROSS_CONSTANT_ID_" + toString(constant.id) + " " + ShaderSpecialization::toLiteral(constant) + "\n";
+
+        size_t afterVersion = source.find('\n');
+        source.insert(afterVersion == String::npos ? 0 : afterVersion + 1, defines);
+
+        return source;
     }
 
     Vector<uint32>* OpenGLShader::fromSpvToGlslSpv(Vector<uint32>* spv, ShaderType type) { LOG_FUNCTION();
-        String cacheName = "glsl_" + name + shaderTypeToShadercExtensionS(type) + ".cache";
+        const String& stageSource = type == ShaderType::Vertex   ?   vertexShaderSourceCode
+                                  : type == ShaderType::Fragment ? fragmentShaderSourceCode
+                                  :                                geometryShaderSourceCode;
+
+        // edited sources and other specializations must not pick up a stale binary
+        char sourceHash[17];
+        std::snprintf(sourceHash, sizeof(sourceHash), "%016llx", (unsigned long long) std::hash<String>()(stageSource));
+
+        String cacheName = "glsl_" + name + "_" + sourceHash + specialization.getKey() + shaderTypeToShadercExtensionS(type) + ".cache";
         if(std::filesystem::exists(cacheName) && !Shader::alwaysCompile){ 
             std::ifstream file(cacheName, std::ios::in | std::ios::binary);
 
@@ -56,6 +154,10 @@ namespace PetrolEngine {
         options.SetOptimizationLevel(shaderc_optimization_level_performance);
         options.SetTargetEnvironment(shaderc_target_env_opengl, 450);
 
+        // without Vulkan semantics spirv-cross writes specialization constants as overridable macros
+        for (auto& constant : specialization.getConstants())
+            options.AddMacroDefinition("SPIRV_CROSS_CONSTANT_ID_" + toString(constant.id), ShaderSpecialization::toLiteral(constant));
+
         auto result = compiler.CompileGlslToSpv(
             source,
             shaderTypeToShadercShaderKind(type),
@@ -79,6 +181,34 @@ namespace PetrolEngine {
     void OpenGLShader::compileFromSpv(Vector<uint32>*   vertexByteCode,
                                       Vector<uint32>* fragmentByteCode,
                                       Vector<uint32>* geometryByteCode ){ LOG_FUNCTION();
+        if (!OpenGLCapabilities::get().spirv) {
+            compileNative(  vertexByteCode ? fromSpvToGlsl(*  vertexByteCode, specialization) : String(),
+                          fragmentByteCode ? fromSpvToGlsl(*fragmentByteCode, specialization) : String(),
+                          geometryByteCode ? fromSpvToGlsl(*geometryByteCode, specialization) : String());
+            return;
+        }
+
+        if (separablePrograms && OpenGLProgramPipeline::isSupported()) {
+            uint32 programs[3] = { 0, 0, 0 };
+            Vector<uint32>* byteCodes[3] = { vertexByteCode, fragmentByteCode, geometryByteCode };
+            ShaderType      types    [3] = { ShaderType::Vertex, ShaderType::Fragment, ShaderType::Geometry };
+            GLenum          stages   [3] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER };
+
+            for (uint32 i = 0; i < 3; i++) {
+                if (byteCodes[i] == nullptr) continue;
+
+                Vector<uint32>* byteCodeGlsl = fromSpvToGlslSpv(byteCodes[i], types[i]);
+                if (byteCodeGlsl == nullptr) continue;
+
+                programs[i] = OpenGLProgramPipeline::acquireStage(stages[i], name, *byteCodeGlsl);
+
+                delete byteCodeGlsl;
+            }
+
+            compileSeparable(programs[0], programs[1], programs[2], geometryByteCode != nullptr);
+            return;
+        }
+
         uint   vertexShaderID = 0;
         uint fragmentShaderID = 0;
         uint geometryShaderID = 0;
@@ -137,36 +267,82 @@ namespace PetrolEngine {
         if (this->geometryShaderID) glDeleteShader (this->geometryShaderID);
         if (this->              ID) glDeleteProgram(this->              ID);
 
+        OpenGLMemory::untrack(GL_PROGRAM, this->ID);
+
         // replace with new
         this->  vertexShaderID =   vertexShaderID;
         this->fragmentShaderID = fragmentShaderID;
         this->geometryShaderID = geometryShaderID;
         this->              ID =        programID;
+
+        OpenGLMemory::trackProgram(ID, name);
+    }
+
+    // assignments outside of comments, a declaration or a read alone does not route anything
+    static bool assigns(const String& source, const char* variable) {
+        static const std::regex comments(R"(//[^\n]*|/\*[\s\S]*?\*/)");
+
+        String code = std::regex_replace(source, comments, " ");
+
+        return std::regex_search(code, std::regex(String("\\b") + variable + R"(\s*=(?!=))"));
     }
 
     OpenGLShader::OpenGLShader( String         name,
                                 String   vertexCode,
                                 String fragmentCode,
-                                String geometryCode ) {
+                                String geometryCode,
+                                ShaderSpecialization specialization ) {
         this->vertexShaderSourceCode   =   vertexCode;
         this->fragmentShaderSourceCode = fragmentCode;
         this->geometryShaderSourceCode = geometryCode;
 
-        this->name = name;
+        this->name           = name;
+        this->specialization = std::move(specialization);
+
+        const String& routing = geometryCode.empty() ? vertexCode : geometryCode;
+
+        this->layerOutput    = assigns(routing, "gl_Layer"        );
+        this->viewportOutput = assigns(routing, "gl_ViewportIndex");
+
         this->compile();
     }
 
     OpenGLShader::~OpenGLShader() {
+        releaseSeparable();
+
         glDeleteShader(vertexShaderID  );
         glDeleteShader(fragmentShaderID);
         glDeleteShader(geometryShaderID);
 
+        OpenGLMemory::untrack(GL_PROGRAM, this->ID);
         glDeleteProgram(this->ID);
     }
 
     void OpenGLShader::compileNative( const String& vertexShaderSourceCode  ,
                                       const String& fragmentShaderSourceCode,
                                       const String& geometryShaderSourceCode ) { LOG_FUNCTION();
+        if (separablePrograms && OpenGLProgramPipeline::isSupported()) {
+            uint32 vertexProgram   = OpenGLProgramPipeline::acquireStage(GL_VERTEX_SHADER  , name, specialization.specializeGlsl(  vertexShaderSourceCode));
+            uint32 fragmentProgram = OpenGLProgramPipeline::acquireStage(GL_FRAGMENT_SHADER, name, specialization.specializeGlsl(fragmentShaderSourceCode));
+            uint32 geometryProgram = 0;
+
+            if (!geometryShaderSourceCode.empty())
+                geometryProgram = OpenGLProgramPipeline::acquireStage(GL_GEOMETRY_SHADER, name, specialization.specializeGlsl(geometryShaderSourceCode));
+
+            compileSeparable(vertexProgram, fragmentProgram, geometryProgram, !geometryShaderSourceCode.empty());
+            return;
+        }
+
+        // a recompile replaces the program, the registry must not keep the old one alive
+        if (this->  vertexShaderID) glDeleteShader(this->  vertexShaderID);
+        if (this->fragmentShaderID) glDeleteShader(this->fragmentShaderID);
+        if (this->geometryShaderID) glDeleteShader(this->geometryShaderID);
+
+        if (this->ID) {
+            OpenGLMemory::untrack(GL_PROGRAM, this->ID);
+            glDeleteProgram(this->ID);
+        }
+
         this->  vertexShaderID = 0;
         this->fragmentShaderID = 0;
         this->geometryShaderID = 0;
@@ -178,7 +354,9 @@ namespace PetrolEngine {
         {
             this->vertexShaderID = glCreateShader(GL_VERTEX_SHADER);
 
-            const char* source = vertexShaderSourceCode.c_str();
+            String specialized = specialization.specializeGlsl(vertexShaderSourceCode);
+
+            const char* source = specialized.c_str();
             glShaderSource (vertexShaderID, 1, &source, nullptr);
             glCompileShader(vertexShaderID);
 
@@ -191,7 +369,9 @@ namespace PetrolEngine {
         {
             this->fragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
-            const char* source = fragmentShaderSourceCode.c_str();
+            String specialized = specialization.specializeGlsl(fragmentShaderSourceCode);
+
+            const char* source = specialized.c_str();
             glShaderSource(fragmentShaderID, 1, &source, nullptr);
             glCompileShader(fragmentShaderID);
 
@@ -205,7 +385,9 @@ namespace PetrolEngine {
         {
             this->geometryShaderID = glCreateShader(GL_GEOMETRY_SHADER);
 
-            const char* source = geometryShaderSourceCode.c_str();
+            String specialized = specialization.specializeGlsl(geometryShaderSourceCode);
+
+            const char* source = specialized.c_str();
             glShaderSource (geometryShaderID, 1, &source, nullptr);
             glCompileShader(geometryShaderID);
 
@@ -216,47 +398,82 @@ namespace PetrolEngine {
 
         glLinkProgram(ID);
 
-        checkProgramCompileErrors(ID);
+        // a program that does not link is no program, isValid tells the variant cache
+        if (checkProgramCompileErrors(ID)) {
+            glDeleteProgram(ID);
+            this->ID = 0;
+            return;
+        }
+
+        OpenGLMemory::trackProgram(ID, name);
+    }
+
+    template<typename Bound, typename Separate>
+    void OpenGLShader::setUniform(const String& uniform, Bound bound, Separate separate) {
+        if (pipeline == 0) {
+            bound(glGetUniformLocation(ID, uniform.c_str()));
+            return;
+        }
+
+        for (uint32 program : stagePrograms) {
+            if (program == 0) continue;
+
+            GLint location = glGetUniformLocation(program, uniform.c_str());
+            if (location >= 0) separate(program, location);
+        }
     }
 
     void OpenGLShader::setVec4(const String& uniform, float x, float y, float z, float w) {
-        glUniform4f(glGetUniformLocation(ID, uniform.c_str()), x, y, z, w);
+        setUniform(uniform, [&](GLint location) { glUniform4f(location, x, y, z, w); },
+                            [&](uint32 program, GLint location) { glProgramUniform4f(program, location, x, y, z, w); });
     }
     void OpenGLShader::setBool(const String& uniform, bool     x) {
-        glUniform1i(glGetUniformLocation(ID, uniform.c_str()), (int)x);
+        setUniform(uniform, [&](GLint location) { glUniform1i(location, (int)x); },
+                            [&](uint32 program, GLint location) { glProgramUniform1i(program, location, (int)x); });
     }
     void OpenGLShader::setInt(const String& uniform, int      x) {
-        glUniform1i(glGetUniformLocation(ID, uniform.c_str()), x);
+        setUniform(uniform, [&](GLint location) { glUniform1i(location, x); },
+                            [&](uint32 program, GLint location) { glProgramUniform1i(program, location, x); });
     }
     void OpenGLShader::setUint(const String& uniform, uint      x) {
-        glUniform1ui(glGetUniformLocation(ID, uniform.c_str()), x);
+        setUniform(uniform, [&](GLint location) { glUniform1ui(location, x); },
+                            [&](uint32 program, GLint location) { glProgramUniform1ui(program, location, x); });
     }
     void OpenGLShader::setFloat(const String& uniform, float     x) {
-        glUniform1f(glGetUniformLocation(ID, uniform.c_str()), x);
+        setUniform(uniform, [&](GLint location) { glUniform1f(location, x); },
+                            [&](uint32 program, GLint location) { glProgramUniform1f(program, location, x); });
     }
     void OpenGLShader::setVec2(const String& uniform, const glm::vec2& x) {
-        glUniform2fv(glGetUniformLocation(ID, uniform.c_str()), 1, &x[0]);
+        setUniform(uniform, [&](GLint location) { glUniform2fv(location, 1, &x[0]); },
+                            [&](uint32 program, GLint location) { glProgramUniform2fv(program, location, 1, &x[0]); });
     }
     void OpenGLShader::setVec2(const String& uniform, float x, float    y) {
-        glUniform2f(glGetUniformLocation(ID, uniform.c_str()), x, y);
+        setUniform(uniform, [&](GLint location) { glUniform2f(location, x, y); },
+                            [&](uint32 program, GLint location) { glProgramUniform2f(program, location, x, y); });
     }
     void OpenGLShader::setVec3(const String& uniform, const glm::vec3& x) {
-        glUniform3fv(glGetUniformLocation(ID, uniform.c_str()), 1, &x[0]);
+        setUniform(uniform, [&](GLint location) { glUniform3fv(location, 1, &x[0]); },
+                            [&](uint32 program, GLint location) { glProgramUniform3fv(program, location, 1, &x[0]); });
     }
     void OpenGLShader::setVec3(const String& uniform, float x, float y, float z) {
-        glUniform3f(glGetUniformLocation(ID, uniform.c_str()), x, y, z);
+        setUniform(uniform, [&](GLint location) { glUniform3f(location, x, y, z); },
+                            [&](uint32 program, GLint location) { glProgramUniform3f(program, location, x, y, z); });
     }
     void OpenGLShader::setVec4(const String& uniform, const glm::vec4& x) {
-        glUniform4fv(glGetUniformLocation(ID, uniform.c_str()), 1, &x[0]);
+        setUniform(uniform, [&](GLint location) { glUniform4fv(location, 1, &x[0]); },
+                            [&](uint32 program, GLint location) { glProgramUniform4fv(program, location, 1, &x[0]); });
     }
     void OpenGLShader::setMat2(const String& uniform, const glm::mat2& mat) {
-        glUniformMatrix2fv(glGetUniformLocation(ID, uniform.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setUniform(uniform, [&](GLint location) { glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]); },
+                            [&](uint32 program, GLint location) { glProgramUniformMatrix2fv(program, location, 1, GL_FALSE, &mat[0][0]); });
     }
     void OpenGLShader::setMat3(const String& uniform, const glm::mat3& mat) {
-        glUniformMatrix3fv(glGetUniformLocation(ID, uniform.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setUniform(uniform, [&](GLint location) { glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]); },
+                            [&](uint32 program, GLint location) { glProgramUniformMatrix3fv(program, location, 1, GL_FALSE, &mat[0][0]); });
     }
     void OpenGLShader::setMat4(const String& uniform, const glm::mat4& mat) {
-        glUniformMatrix4fv(glGetUniformLocation(ID, uniform.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setUniform(uniform, [&](GLint location) { glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]); },
+                            [&](uint32 program, GLint location) { glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, &mat[0][0]); });
     }
 
     int OpenGLShader::checkProgramCompileErrors(GLuint id) { LOG_FUNCTION();
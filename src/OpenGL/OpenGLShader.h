@@ -7,16 +7,36 @@
 
 #include <glad/glad.h>
 
+#include "OpenGLShaderVariants.h"
+
 namespace PetrolEngine {
     class OpenGLShader : public Shader {
     public:
         OpenGLShader( String         name,
                       String   vertexCode,
                       String fragmentCode,
-                      String geometryCode  );
+                      String geometryCode,
+                      ShaderSpecialization specialization = {} );
         
         ~OpenGLShader() override;
 
+        // Every stage is linked as its own separable program shared with other shaders that have
+        // the same stage code (see OpenGLProgramPipeline), shaders are program pipelines. Applies to
+        // shaders compiled after it is set. Stages match their varyings by location, or by name and
+        // type, and vertex stages redeclare out gl_PerVertex { vec4 gl_Position; }.
+        static bool separablePrograms;
+
+        // glUseProgram, or glBindProgramPipeline for separable shaders
+        void bind() const;
+
+        // separable shaders have no program of their own
+        bool isValid() const { return ID != 0 || pipeline != 0; }
+
+        // whether the last stage before rasterization (geometry, otherwise vertex) assigns gl_Layer and
+        // gl_ViewportIndex, read from the source, multi view draws route their views with them
+        bool writesLayer        () const { return layerOutput;    }
+        bool writesViewportIndex() const { return viewportOutput; }
+
         Vector<uint32>* fromSpvToGlslSpv(Vector<uint32>* spv, ShaderType type);
 
         //void reflect(Vector<uint32>* spv, ShaderType type);
@@ -49,7 +69,29 @@ namespace PetrolEngine {
 
         void bindUniformBuffer(const String& name, UniformBuffer* uniformBuffer) override;
 
+        // in the program, or in any stage of a separable shader
+        bool hasUniformBlock(const String& name) const;
+
+        const ShaderSpecialization& getSpecialization() const { return specialization; }
+
     protected:
+        void compileSeparable(uint32 vertexProgram, uint32 fragmentProgram, uint32 geometryProgram, bool geometry);
+        void releaseSeparable();
+
+        // sets the uniform of the bound program with glUniform, or with glProgramUniform in every stage
+        // of a separable shader that has it
+        template<typename Bound, typename Separate>
+        void setUniform(const String& uniform, Bound bound, Separate separate);
+
+        uint32 pipeline         = 0;
+        uint32 stagePrograms[3] = { 0, 0, 0 }; // vertex, fragment, geometry
+
+        // baked into the GLSL that spirv-cross generates, so every variant has its own cache files
+        ShaderSpecialization specialization;
+
+        bool layerOutput    = false;
+        bool viewportOutput = false;
+
         static int checkShaderCompileErrors (GLuint shader, const String& type);
         static int checkProgramCompileErrors(GLuint shader);
     };
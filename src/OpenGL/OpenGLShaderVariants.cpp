@@ -0,0 +1,153 @@
+#include <PCH.h>
+
+#include "OpenGLShaderVariants.h"
+#include "OpenGLShader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <regex>
+
+namespace PetrolEngine {
+    ShaderSpecialization& ShaderSpecialization::set(uint32 id, bool value) {
+        return set(id, value ? 1u : 0u, Type::Bool);
+    }
+
+    ShaderSpecialization& ShaderSpecialization::set(uint32 id, int32 value) {
+        return set(id, (uint32) value, Type::Int);
+    }
+
+    ShaderSpecialization& ShaderSpecialization::set(uint32 id, uint32 value) {
+        return set(id, value, Type::Uint);
+    }
+
+    ShaderSpecialization& ShaderSpecialization::set(uint32 id, float value) {
+        uint32 bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        return set(id, bits, Type::Float);
+    }
+
+    ShaderSpecialization& ShaderSpecialization::set(uint32 id, uint32 value, Type type) {
+        auto constant = std::lower_bound(constants.begin(), constants.end(), id, [](const Constant& constant, uint32 id) { return constant.id < id; });
+
+        if (constant != constants.end() && constant->id == id) *constant = { id, value, type };
+        else constants.insert(constant, { id, value, type });
+
+        // also names the variant's cache files, so only characters that are fine in a file name,
+        // the type is part of it as the same bits are a different constant for every type
+        static const char typeNames[] = { 'b', 'i', 'u', 'f' };
+
+        key.clear();
+        for (auto& it : constants) key += "_" + toString(it.id) + "_" + typeNames[(uint32) it.type] + toString(it.value);
+
+        return *this;
+    }
+
+    String ShaderSpecialization::toLiteral(const Constant& constant) {
+        switch (constant.type) {
+            case Type::Bool : return constant.value ? "true" : "false";
+            case Type::Int  : return toString((int32) constant.value);
+            case Type::Uint : return toString(constant.value) + "u";
+            case Type::Float: {
+                float value;
+                std::memcpy(&value, &constant.value, sizeof(value));
+
+                char literal[32];
+                std::snprintf(literal, sizeof(literal), "%.9g", value);
+
+                String result = literal;
+                if (result.find_first_of(".e") == String::npos) result += ".0";
+
+                return result;
+            }
+        }
+
+        return "0";
+    }
+
+    String ShaderSpecialization::specializeGlsl(const String& source) const {
+        static const std::regex declaration(R"(layout\s*\(\s*constant_id\s*=\s*(\d+)\s*\)\s*const\s+(\w+)\s+(\w+)\s*=\s*([^;]+);)");
+
+        String result;
+        auto   last = source.cbegin();
+
+        for (std::sregex_iterator it(source.begin(), source.end(), declaration), end; it != end; it++) {
+            const std::smatch& match = *it;
+
+            uint32 id    = (uint32) std::stoul(match[1].str());
+            String value = match[4].str();
+
+            for (auto& constant : constants) if (constant.id == id) value = toLiteral(constant);
+
+            result.append(last, match[0].first);
+            result += "const " + match[2].str() + " " + match[3].str() + " = " + value + ";";
+
+            last = match[0].second;
+        }
+
+        result.append(last, source.cend());
+        return result;
+    }
+
+    OpenGLShaderVariants::OpenGLShaderVariants(String name, String vertexCode, String fragmentCode, String geometryCode) {
+        this->name                     = name;
+        this->vertexShaderSourceCode   = vertexCode;
+        this->fragmentShaderSourceCode = fragmentCode;
+        this->geometryShaderSourceCode = geometryCode;
+    }
+
+    OpenGLShaderVariants::~OpenGLShaderVariants() {
+        clear();
+    }
+
+    OpenGLShader* OpenGLShaderVariants::get(const ShaderSpecialization& specialization) {
+        auto variant = variants.find(specialization.getKey());
+
+        if (variant != variants.end()) {
+            stats.hits++;
+            return variant->second;
+        }
+
+        LOG_FUNCTION();
+
+        auto begin = std::chrono::steady_clock::now();
+
+        OpenGLShader* shader = new OpenGLShader(name, vertexShaderSourceCode, fragmentShaderSourceCode, geometryShaderSourceCode, specialization);
+
+        double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+        stats.variants      += 1;
+        stats.compileTime   += time;
+        stats.slowestCompile = std::max(stats.slowestCompile, time);
+
+        String variantName = name + (specialization.empty() ? String("") : specialization.getKey());
+
+        if (!shader->isValid()) {
+            LOG("Shader variant " + variantName + " failed to compile.", 2);
+
+            delete shader;
+            shader = nullptr;
+
+            stats.failed++;
+        }
+        else LOG("Shader variant " + variantName + " compiled in " + toString(time) + " ms.", 1);
+
+        variants[specialization.getKey()] = shader;
+        return shader;
+    }
+
+    void OpenGLShaderVariants::logStats() const {
+        LOG("Shader " + name + ": "
+            + toString(stats.variants) + " variants (" + toString(stats.failed) + " failed), "
+            + toString(stats.hits) + " cache hits, "
+            + toString(stats.compileTime) + " ms compiling, slowest " + toString(stats.slowestCompile) + " ms.", 1);
+    }
+
+    void OpenGLShaderVariants::clear() { LOG_FUNCTION();
+        for (auto& variant : variants) delete variant.second;
+
+        variants.clear();
+    }
+}
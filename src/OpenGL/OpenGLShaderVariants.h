@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Core/Aliases.h>
+
+namespace PetrolEngine {
+    class OpenGLShader;
+
+    // Values for the specialization constants of a shader, set by constant id:
+    //
+    // layout(constant_id = 0) const uint lightCount = 4;
+    // layout(constant_id = 1) const bool shadows    = true;
+    //
+    // Constants that are not set keep the default from the source.
+    class ShaderSpecialization {
+    public:
+        enum class Type { Bool, Int, Uint, Float };
+
+        struct Constant {
+            uint32 id;
+            uint32 value; // 32 bit pattern, as glSpecializeShader takes it
+            Type   type;
+        };
+
+        ShaderSpecialization& set(uint32 id, bool   value);
+        ShaderSpecialization& set(uint32 id, int32  value);
+        ShaderSpecialization& set(uint32 id, uint32 value);
+        ShaderSpecialization& set(uint32 id, float  value);
+
+        bool empty() const { return constants.empty(); }
+
+        // sorted by id
+        const Vector<Constant>& getConstants() const { return constants; }
+
+        // the same for the same values whatever order they were set in, empty without constants
+        const String& getKey() const { return key; }
+
+        // GLSL literal of the constant's value
+        static String toLiteral(const Constant& constant);
+
+        // for GLSL compiled by the driver, constant_id declarations become plain constants
+        String specializeGlsl(const String& source) const;
+
+    private:
+        ShaderSpecialization& set(uint32 id, uint32 value, Type type);
+
+        Vector<Constant> constants;
+        String key;
+    };
+
+    // Specializations of one shader source, compiled the first time they are asked for and
+    // kept until the cache is destroyed. Uber-shaders toggle features and sizes with
+    // specialization constants instead of branching on uniforms or copying the source.
+    class OpenGLShaderVariants {
+    public:
+        struct Stats {
+            uint32 variants = 0; // compiled, failed ones included
+            uint32 failed   = 0;
+            uint64 hits     = 0;
+
+            double compileTime    = 0.0; // milliseconds spent compiling variants
+            double slowestCompile = 0.0;
+        };
+
+        OpenGLShaderVariants(String name, String vertexCode, String fragmentCode, String geometryCode = "");
+        ~OpenGLShaderVariants();
+
+        // nullptr when the variant does not compile, it is not retried
+        OpenGLShader* get(const ShaderSpecialization& specialization);
+
+        const Stats& getStats() const { return stats; }
+        void logStats() const;
+
+        // deletes every variant, for example after the sources were edited
+        void clear();
+
+        String name;
+        String vertexShaderSourceCode;
+        String fragmentShaderSourceCode;
+        String geometryShaderSourceCode;
+
+    private:
+        UnorderedMap<String, OpenGLShader*> variants;
+        Stats stats;
+    };
+}
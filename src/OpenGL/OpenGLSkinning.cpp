@@ -0,0 +1,243 @@
+#include <PCH.h>
+
+#include <glad/glad.h>
+
+#include "OpenGLSkinning.h"
+#include "OpenGLTracer.h"
+#include "OpenGLCapabilities.h"
+#include "OpenGLIndexBuffer.h"
+#include "OpenGLVertexBuffer.h"
+
+#include <cfloat>
+
+namespace PetrolEngine {
+    // vertices are read and written as raw words, so any layout works as long as the
+    // skinned elements are there, everything else was copied when the instance was created
+    static const char* skinningShaderSource = R"(
+        #version 430
+        layout(local_size_x = 64) in;
+
+        layout(std430, binding =  9) readonly  buffer Palette { mat4 bones [];  };
+        layout(std430, binding = 10) readonly  buffer Source  { uint source[];  };
+        layout(std430, binding = 11) writeonly buffer Target  { uint target[];  };
+
+        layout(location = 0) uniform uint  vertexCount;
+        layout(location = 1) uniform uint  stride;
+        layout(location = 2) uniform ivec4 offsets;
+        layout(location = 3) uniform uint  firstBone;
+
+        vec3 readVec3(uint word) {
+            return uintBitsToFloat(uvec3(source[word], source[word + 1], source[word + 2]));
+        }
+
+        void writeVec3(uint word, vec3 value) {
+            uvec3 bits = floatBitsToUint(value);
+
+            target[word    ] = bits.x;
+            target[word + 1] = bits.y;
+            target[word + 2] = bits.z;
+        }
+
+        void main() {
+            uint vertex = gl_GlobalInvocationID.x;
+
+            if (vertex >= vertexCount) return;
+
+            uint base = vertex * stride;
+
+            uint  indicesWord = base + uint(offsets.z);
+            uint  weightsWord = base + uint(offsets.w);
+
+            uvec4 indices = uvec4(source[indicesWord], source[indicesWord + 1], source[indicesWord + 2], source[indicesWord + 3]);
+            vec4  weights = uintBitsToFloat(uvec4(source[weightsWord], source[weightsWord + 1], source[weightsWord + 2], source[weightsWord + 3]));
+
+            mat4 skin = weights.x * bones[firstBone + indices.x]
+                      + weights.y * bones[firstBone + indices.y]
+                      + weights.z * bones[firstBone + indices.z]
+                      + weights.w * bones[firstBone + indices.w];
+
+            uint positionWord = base + uint(offsets.x);
+            writeVec3(positionWord, (skin * vec4(readVec3(positionWord), 1.0)).xyz);
+
+            if (offsets.y < 0) return;
+
+            uint normalWord = base + uint(offsets.y);
+            writeVec3(normalWord, normalize(mat3(skin) * readVec3(normalWord)));
+        }
+    )";
+
+    bool OpenGLSkinning::isSupported() {
+        const OpenGLCapabilities& capabilities = OpenGLCapabilities::get();
+
+        return OpenGLComputeShader::isSupported() && capabilities.glslVersion >= 430 && capabilities.storageBinding(targetBinding);
+    }
+
+    OpenGLSkinning::OpenGLSkinning() { LOG_FUNCTION();
+        skinningShader = new OpenGLComputeShader("skinning", skinningShaderSource);
+        paletteBuffer  = new OpenGLStorageBuffer(sizeof(glm::mat4), paletteBinding);
+    }
+
+    OpenGLSkinning::~OpenGLSkinning() { LOG_FUNCTION();
+        for (auto& instance : instances) delete instance.skinned;
+
+        delete skinningShader;
+        delete paletteBuffer;
+    }
+
+    int32 OpenGLSkinning::addInstance(const OpenGLVertexArray* mesh) { LOG_FUNCTION();
+        if (mesh->getVertexBuffers().size() != 1 || mesh->getIndexBuffer() == nullptr) {
+            LOG("Skinned mesh has to have one vertex buffer and an index buffer.", 2);
+            return -1;
+        }
+
+        const VertexBuffer* source = mesh->getVertexBuffers()[0];
+        const VertexLayout& layout = source->getLayout();
+
+        Instance instance;
+        instance.mesh    = mesh;
+        instance.offsets = glm::ivec4(-1, -1, -1, -1);
+
+        uint32 offset = 0;
+        for (auto& element : layout.getElements()) {
+            if      (element.name == "position"    && element.type == ShaderDataType::Float3) instance.offsets.x = (int32) (offset / 4);
+            else if (element.name == "normal"      && element.type == ShaderDataType::Float3) instance.offsets.y = (int32) (offset / 4);
+            else if (element.name == "boneIndices" && element.type == ShaderDataType::Int4  ) instance.offsets.z = (int32) (offset / 4);
+            else if (element.name == "boneWeights" && element.type == ShaderDataType::Float4) instance.offsets.w = (int32) (offset / 4);
+
+            offset += ShaderDataTypeSize(element.type);
+        }
+
+        if (instance.offsets.x < 0 || instance.offsets.z < 0 || instance.offsets.w < 0 || offset % 4 != 0) {
+            LOG("Skinned mesh needs position, boneIndices and boneWeights elements in a word aligned layout.", 2);
+            return -1;
+        }
+
+        GLint64 vertexSize, indexSize;
+        glGetNamedBufferParameteri64v(source->getID()                , GL_BUFFER_SIZE, &vertexSize);
+        glGetNamedBufferParameteri64v(mesh->getIndexBuffer()->getID(), GL_BUFFER_SIZE, &indexSize );
+
+        instance.stride      = offset / 4;
+        instance.vertexCount = (uint32) (vertexSize / offset);
+
+        // the cache starts as a copy, skinning only rewrites positions and normals
+        VertexBuffer* vertexBuffer = new OpenGLVertexBuffer(layout, nullptr, (int64) vertexSize);
+        IndexBuffer * indexBuffer  = new OpenGLIndexBuffer (        nullptr, (int64) indexSize );
+
+        glCopyNamedBufferSubData(source->getID()                , vertexBuffer->getID(), 0, 0, (GLsizeiptr) vertexSize);
+        glCopyNamedBufferSubData(mesh->getIndexBuffer()->getID(), indexBuffer ->getID(), 0, 0, (GLsizeiptr) indexSize );
+
+        instance.skinned = new OpenGLVertexArray();
+        instance.skinned->addVertexBuffer(vertexBuffer);
+        instance.skinned-> setIndexBuffer(indexBuffer );
+        instance.skinned->setLods(mesh->getLods());
+
+        if (mesh->hasBounds()) instance.skinned->setBounds(mesh->getBoundsMin(), mesh->getBoundsMax());
+
+        if (!freeInstances.empty()) {
+            int32 handle = freeInstances.back();
+            freeInstances.pop_back();
+
+            instances[handle] = std::move(instance);
+            return handle;
+        }
+
+        instances.push_back(std::move(instance));
+        return (int32) instances.size() - 1;
+    }
+
+    bool OpenGLSkinning::isValid(int32 instance) const {
+        return instance >= 0 && instance < (int32) instances.size() && instances[instance].skinned != nullptr;
+    }
+
+    void OpenGLSkinning::removeInstance(int32 instance) { LOG_FUNCTION();
+        if (!isValid(instance)) {
+            LOG("Removing skinned instance that does not exist.", 2);
+            return;
+        }
+
+        delete instances[instance].skinned;
+
+        instances[instance] = Instance();
+        freeInstances.push_back(instance);
+    }
+
+    OpenGLVertexArray* OpenGLSkinning::getSkinned(int32 instance) const {
+        if (!isValid(instance)) {
+            LOG("Getting skinned instance that does not exist.", 2);
+            return nullptr;
+        }
+
+        return instances[instance].skinned;
+    }
+
+    void OpenGLSkinning::setPose(int32 instance, const glm::mat4* bones, uint32 boneCount) {
+        if (!isValid(instance)) {
+            LOG("Setting pose of skinned instance that does not exist.", 2);
+            return;
+        }
+
+        Instance& target = instances[instance];
+
+        target.bones.assign(bones, bones + boneCount);
+        target.dirty = true;
+
+        if (!target.mesh->hasBounds() || boneCount == 0) return;
+
+        // weights of a vertex sum to one, so it stays inside the box of its bones' transformed bind pose boxes
+        const glm::vec3& bindMin = target.mesh->getBoundsMin();
+        const glm::vec3& bindMax = target.mesh->getBoundsMax();
+
+        glm::vec3 boundsMin( FLT_MAX);
+        glm::vec3 boundsMax(-FLT_MAX);
+
+        for (uint32 bone = 0; bone < boneCount; bone++) {
+            for (uint32 corner = 0; corner < 8; corner++) {
+                glm::vec3 point(corner & 1 ? bindMax.x : bindMin.x, corner & 2 ? bindMax.y : bindMin.y, corner & 4 ? bindMax.z : bindMin.z);
+                glm::vec3 moved = glm::vec3(bones[bone] * glm::vec4(point, 1.f));
+
+                boundsMin = glm::min(boundsMin, moved);
+                boundsMax = glm::max(boundsMax, moved);
+            }
+        }
+
+        target.skinned->setBounds(boundsMin, boundsMax);
+    }
+
+    void OpenGLSkinning::update() { TRACE_FUNCTION();
+        // all poses of the frame go in with one upload
+        palette.clear();
+
+        for (auto& instance : instances)
+            if (instance.dirty && instance.skinned) palette.insert(palette.end(), instance.bones.begin(), instance.bones.end());
+
+        if (palette.empty()) return;
+
+        uint32 paletteSize = (uint32) (palette.size() * sizeof(glm::mat4));
+
+        paletteBuffer->reserve(paletteSize);
+        paletteBuffer->setData(palette.data(), paletteSize, 0);
+
+        OpenGLComputeShader::bindStorageBuffer(paletteBinding, paletteBuffer);
+
+        uint32 firstBone = 0;
+
+        for (auto& instance : instances) {
+            if (!instance.dirty || instance.skinned == nullptr) continue;
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, sourceBinding, instance.mesh   ->getVertexBuffers()[0]->getID());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, targetBinding, instance.skinned->getVertexBuffers()[0]->getID());
+
+            skinningShader->setUint (0, instance.vertexCount);
+            skinningShader->setUint (1, instance.stride     );
+            skinningShader->setIVec4(2, instance.offsets    );
+            skinningShader->setUint (3, firstBone           );
+
+            skinningShader->dispatch((instance.vertexCount + 63) / 64);
+
+            firstBone     += (uint32) instance.bones.size();
+            instance.dirty = false;
+        }
+
+        OpenGLComputeShader::memoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+}
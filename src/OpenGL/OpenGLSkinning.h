@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Core/Aliases.h>
+#include <glm/glm.hpp>
+
+#include "OpenGLComputeShader.h"
+#include "OpenGLStorageBuffer.h"
+#include "OpenGLVertexArray.h"
+
+namespace PetrolEngine {
+    // Compute shader skinning into per instance vertex caches.
+    // Skinned meshes have a single vertex buffer with "position" (Float3), "boneIndices" (Int4) and
+    // "boneWeights" (Float4) elements and optionally "normal" (Float3). Every instance gets its own
+    // vertex array with the same layout, so it is drawn by renderMesh with the usual shaders, and
+    // it is skinned once per pose no matter how many passes (shadows, main) draw it.
+    class OpenGLSkinning {
+    public:
+        static constexpr uint32 paletteBinding = 9;
+        static constexpr uint32 sourceBinding  = 10;
+        static constexpr uint32 targetBinding  = 11;
+
+        static bool isSupported();
+
+        OpenGLSkinning();
+        ~OpenGLSkinning();
+
+        bool isCompiled() const { return skinningShader->getID() != 0; }
+
+        // returns handle of the instance, -1 when the mesh can not be skinned
+        int32 addInstance(const OpenGLVertexArray* mesh);
+        void  removeInstance(int32 instance);
+
+        // bone matrices (model space, inverse bind pose applied) of the next update, the skinned bounds
+        // become the bind pose bounds moved by every bone so culling never drops a posed mesh
+        void setPose(int32 instance, const glm::mat4* bones, uint32 boneCount);
+
+        // skinned vertex array to draw instead of the source mesh, nullptr for handles that do not exist
+        OpenGLVertexArray* getSkinned(int32 instance) const;
+
+        // skins instances with a new pose, cheap when nothing changed so every flush can call it
+        void update();
+
+    private:
+        bool isValid(int32 instance) const;
+
+        struct Instance {
+            const OpenGLVertexArray* mesh    = nullptr;
+            OpenGLVertexArray*       skinned = nullptr;
+
+            uint32 vertexCount = 0;
+            uint32 stride      = 0;       // in words
+            glm::ivec4 offsets;           // position, normal (-1 without normals), bone indices, bone weights in words
+
+            Vector<glm::mat4> bones;
+            bool dirty = false;
+        };
+
+        Vector<Instance> instances;
+        Vector<int32   > freeInstances;
+
+        Vector<glm::mat4> palette;
+
+        OpenGLComputeShader* skinningShader = nullptr;
+        OpenGLStorageBuffer* paletteBuffer  = nullptr;
+    };
+}
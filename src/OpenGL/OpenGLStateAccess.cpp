@@ -0,0 +1,305 @@
+#include <PCH.h>
+
+#include "OpenGLStateAccess.h"
+
+#include <glad/glad.h>
+
+#include <mutex>
+
+namespace PetrolEngine {
+    static bool installed = false;
+
+    // textures do not know their target before 4.5, it is remembered from the binds
+    static std::mutex                   targetsMutex;
+    static UnorderedMap<GLuint, GLenum> textureTargets;
+    static PFNGLBINDTEXTUREPROC         bindTexture = nullptr;
+
+    static GLenum targetOf(GLuint texture) {
+        std::lock_guard<std::mutex> lock(targetsMutex);
+
+        auto found = textureTargets.find(texture);
+        return found != textureTargets.end() ? found->second : GL_TEXTURE_2D;
+    }
+
+    static GLenum bindingOf(GLenum target) {
+        switch (target) {
+            case GL_TEXTURE_1D            : return GL_TEXTURE_BINDING_1D;
+            case GL_TEXTURE_3D            : return GL_TEXTURE_BINDING_3D;
+            case GL_TEXTURE_CUBE_MAP      : return GL_TEXTURE_BINDING_CUBE_MAP;
+            case GL_TEXTURE_2D_ARRAY      : return GL_TEXTURE_BINDING_2D_ARRAY;
+            case GL_TEXTURE_2D_MULTISAMPLE: return GL_TEXTURE_BINDING_2D_MULTISAMPLE;
+            case GL_TEXTURE_RECTANGLE     : return GL_TEXTURE_BINDING_RECTANGLE;
+            default                       : return GL_TEXTURE_BINDING_2D;
+        }
+    }
+
+    // binds an object for the lifetime of the scope and puts the previous one back
+    struct BoundTexture {
+        GLenum target;
+        GLint  previous = 0;
+
+        BoundTexture(GLuint texture): target(targetOf(texture)) {
+            glGetIntegerv(bindingOf(target), &previous);
+            bindTexture(target, texture);
+        }
+
+        ~BoundTexture() { bindTexture(target, (GLuint) previous); }
+    };
+
+    struct BoundVertexArray {
+        GLint previous = 0;
+
+        BoundVertexArray(GLuint vertexArray) {
+            glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+            glBindVertexArray(vertexArray);
+        }
+
+        ~BoundVertexArray() { glBindVertexArray((GLuint) previous); }
+    };
+
+    struct BoundFramebuffer {
+        GLint previous = 0;
+
+        BoundFramebuffer(GLuint framebuffer) {
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        }
+
+        ~BoundFramebuffer() { glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint) previous); }
+    };
+
+    struct BoundReadFramebuffer {
+        GLint previous = 0;
+
+        BoundReadFramebuffer(GLuint framebuffer) {
+            glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        }
+
+        ~BoundReadFramebuffer() { glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint) previous); }
+    };
+
+    static void APIENTRY trackedBindTexture(GLenum target, GLuint texture) {
+        if (texture != 0) {
+            std::lock_guard<std::mutex> lock(targetsMutex);
+            textureTargets[texture] = target;
+        }
+
+        bindTexture(target, texture);
+    }
+
+    // buffers, the copy targets are not used for anything else
+    static void APIENTRY createBuffers(GLsizei n, GLuint* buffers) {
+        glGenBuffers(n, buffers);
+
+        // names from glGenBuffers become buffers at their first bind
+        for (GLsizei i = 0; i < n; i++) glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[i]);
+    }
+
+    static void APIENTRY namedBufferData(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, data, usage);
+    }
+
+    static void APIENTRY namedBufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data) {
+        glBindBuffer   (GL_COPY_WRITE_BUFFER, buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+    }
+
+    static void APIENTRY getNamedBufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, void* data) {
+        glBindBuffer      (GL_COPY_READ_BUFFER, buffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, offset, size, data);
+    }
+
+    static void APIENTRY clearNamedBufferData(GLuint buffer, GLenum internalFormat, GLenum format, GLenum type, const void* data) {
+        glBindBuffer     (GL_COPY_WRITE_BUFFER, buffer);
+        glClearBufferData(GL_COPY_WRITE_BUFFER, internalFormat, format, type, data);
+    }
+
+    static void APIENTRY copyNamedBufferSubData(GLuint readBuffer, GLuint writeBuffer, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size) {
+        glBindBuffer(GL_COPY_READ_BUFFER , readBuffer );
+        glBindBuffer(GL_COPY_WRITE_BUFFER, writeBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, readOffset, writeOffset, size);
+    }
+
+    static void APIENTRY getNamedBufferParameteri64v(GLuint buffer, GLenum name, GLint64* value) {
+        glBindBuffer            (GL_COPY_READ_BUFFER, buffer);
+        glGetBufferParameteri64v(GL_COPY_READ_BUFFER, name, value);
+    }
+
+    // vertex arrays
+    static void APIENTRY createVertexArrays(GLsizei n, GLuint* arrays) {
+        glGenVertexArrays(n, arrays);
+
+        for (GLsizei i = 0; i < n; i++) BoundVertexArray bound(arrays[i]);
+    }
+
+    static void APIENTRY enableVertexArrayAttrib(GLuint vertexArray, GLuint index) {
+        BoundVertexArray bound(vertexArray);
+        glEnableVertexAttribArray(index);
+    }
+
+    static void APIENTRY vertexArrayAttribFormat(GLuint vertexArray, GLuint index, GLint size, GLenum type, GLboolean normalized, GLuint offset) {
+        BoundVertexArray bound(vertexArray);
+        glVertexAttribFormat(index, size, type, normalized, offset);
+    }
+
+    static void APIENTRY vertexArrayAttribIFormat(GLuint vertexArray, GLuint index, GLint size, GLenum type, GLuint offset) {
+        BoundVertexArray bound(vertexArray);
+        glVertexAttribIFormat(index, size, type, offset);
+    }
+
+    static void APIENTRY vertexArrayAttribBinding(GLuint vertexArray, GLuint index, GLuint binding) {
+        BoundVertexArray bound(vertexArray);
+        glVertexAttribBinding(index, binding);
+    }
+
+    static void APIENTRY vertexArrayBindingDivisor(GLuint vertexArray, GLuint binding, GLuint divisor) {
+        BoundVertexArray bound(vertexArray);
+        glVertexBindingDivisor(binding, divisor);
+    }
+
+    static void APIENTRY vertexArrayVertexBuffer(GLuint vertexArray, GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride) {
+        BoundVertexArray bound(vertexArray);
+        glBindVertexBuffer(binding, buffer, offset, stride);
+    }
+
+    static void APIENTRY vertexArrayElementBuffer(GLuint vertexArray, GLuint buffer) {
+        // the element buffer binding is part of the vertex array
+        BoundVertexArray bound(vertexArray);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    }
+
+    // textures
+    static void APIENTRY createTextures(GLenum target, GLsizei n, GLuint* textures) {
+        glGenTextures(n, textures);
+
+        for (GLsizei i = 0; i < n; i++) {
+            {
+                std::lock_guard<std::mutex> lock(targetsMutex);
+                textureTargets[textures[i]] = target;
+            }
+
+            BoundTexture bound(textures[i]);
+        }
+    }
+
+    static void APIENTRY textureStorage2D(GLuint texture, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height) {
+        BoundTexture bound(texture);
+        glTexStorage2D(bound.target, levels, internalFormat, width, height);
+    }
+
+    static void APIENTRY textureParameteri(GLuint texture, GLenum name, GLint value) {
+        BoundTexture bound(texture);
+        glTexParameteri(bound.target, name, value);
+    }
+
+    static void APIENTRY getTextureLevelParameteriv(GLuint texture, GLint level, GLenum name, GLint* value) {
+        BoundTexture bound(texture);
+
+        // faces of a cube map share their size and format
+        glGetTexLevelParameteriv(bound.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : bound.target, level, name, value);
+    }
+
+    static void APIENTRY getTextureImage(GLuint texture, GLint level, GLenum format, GLenum type, GLsizei size, void* pixels) {
+        BoundTexture bound(texture);
+
+        if (bound.target != GL_TEXTURE_CUBE_MAP) {
+            glGetTexImage(bound.target, level, format, type, pixels);
+            return;
+        }
+
+        // the named call returns the six faces one after another
+        for (GLint face = 0; face < 6; face++)
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, format, type, (uint8*) pixels + size / 6 * face);
+    }
+
+    static void APIENTRY bindTextureUnit(GLuint unit, GLuint texture) {
+        GLint active = GL_TEXTURE0;
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+
+        glActiveTexture(GL_TEXTURE0 + unit);
+
+        if (texture != 0) bindTexture(targetOf(texture), texture);
+        else for (GLenum target : { GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D }) bindTexture(target, 0);
+
+        glActiveTexture((GLenum) active);
+    }
+
+    // objects that exist from glGen on
+    static void APIENTRY createSamplers(GLsizei n, GLuint* samplers) { glGenSamplers(n, samplers); }
+    static void APIENTRY createQueries(GLenum, GLsizei n, GLuint* ids) { glGenQueries(n, ids); }
+    static void APIENTRY createProgramPipelines(GLsizei n, GLuint* pipelines) { glGenProgramPipelines(n, pipelines); }
+
+    // framebuffers
+    static void APIENTRY namedFramebufferTexture(GLuint framebuffer, GLenum attachment, GLuint texture, GLint level) {
+        BoundFramebuffer bound(framebuffer);
+        glFramebufferTexture(GL_DRAW_FRAMEBUFFER, attachment, texture, level);
+    }
+
+    static void APIENTRY namedFramebufferTextureLayer(GLuint framebuffer, GLenum attachment, GLuint texture, GLint level, GLint layer) {
+        BoundFramebuffer bound(framebuffer);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, attachment, texture, level, layer);
+    }
+
+    static GLenum APIENTRY checkNamedFramebufferStatus(GLuint framebuffer, GLenum) {
+        BoundFramebuffer bound(framebuffer);
+        return glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+    }
+
+    static void APIENTRY blitNamedFramebuffer(GLuint readFramebuffer, GLuint drawFramebuffer,
+                                              GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1,
+                                              GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1,
+                                              GLbitfield mask, GLenum filter) {
+        BoundReadFramebuffer read(readFramebuffer);
+        BoundFramebuffer     draw(drawFramebuffer);
+
+        glBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+    }
+
+    void OpenGLStateAccess::install() { LOG_FUNCTION();
+        if (installed) return;
+
+        bindTexture        = glad_glBindTexture;
+        glad_glBindTexture = trackedBindTexture;
+
+        glad_glCreateBuffers               = createBuffers;
+        glad_glNamedBufferData             = namedBufferData;
+        glad_glNamedBufferSubData          = namedBufferSubData;
+        glad_glGetNamedBufferSubData       = getNamedBufferSubData;
+        glad_glClearNamedBufferData        = clearNamedBufferData;
+        glad_glCopyNamedBufferSubData      = copyNamedBufferSubData;
+        glad_glGetNamedBufferParameteri64v = getNamedBufferParameteri64v;
+
+        glad_glCreateVertexArrays          = createVertexArrays;
+        glad_glEnableVertexArrayAttrib     = enableVertexArrayAttrib;
+        glad_glVertexArrayAttribFormat     = vertexArrayAttribFormat;
+        glad_glVertexArrayAttribIFormat    = vertexArrayAttribIFormat;
+        glad_glVertexArrayAttribBinding    = vertexArrayAttribBinding;
+        glad_glVertexArrayBindingDivisor   = vertexArrayBindingDivisor;
+        glad_glVertexArrayVertexBuffer     = vertexArrayVertexBuffer;
+        glad_glVertexArrayElementBuffer    = vertexArrayElementBuffer;
+
+        glad_glCreateTextures              = createTextures;
+        glad_glTextureStorage2D            = textureStorage2D;
+        glad_glTextureParameteri           = textureParameteri;
+        glad_glGetTextureLevelParameteriv  = getTextureLevelParameteriv;
+        glad_glGetTextureImage             = getTextureImage;
+        glad_glBindTextureUnit             = bindTextureUnit;
+
+        glad_glCreateSamplers              = createSamplers;
+        glad_glCreateQueries               = createQueries;
+        glad_glCreateProgramPipelines      = createProgramPipelines;
+
+        glad_glNamedFramebufferTexture      = namedFramebufferTexture;
+        glad_glNamedFramebufferTextureLayer = namedFramebufferTextureLayer;
+        glad_glCheckNamedFramebufferStatus  = checkNamedFramebufferStatus;
+        glad_glBlitNamedFramebuffer         = blitNamedFramebuffer;
+
+        installed = true;
+
+        LOG("Named calls are emulated with bind-to-edit.", 1);
+    }
+
+    bool OpenGLStateAccess::isInstalled() { return installed; }
+}
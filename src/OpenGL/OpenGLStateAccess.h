@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Core/Aliases.h>
+
+namespace PetrolEngine {
+    // Direct state access for contexts without GL 4.5 or ARB_direct_state_access.
+    //
+    // install replaces the loaded named calls the backend uses (glCreateBuffers, glNamedBufferData,
+    // glVertexArrayAttribFormat, glBindTextureUnit, glBlitNamedFramebuffer...) with versions that bind
+    // the object, edit it and put the previous binding back, so the rest of the backend keeps a single
+    // path. Buffers are edited through GL_COPY_READ_BUFFER and GL_COPY_WRITE_BUFFER, which nothing else binds.
+    //
+    // Only the named calls are emulated, the backend still needs GL 4.3. Called by OpenGLContext::init
+    // before OpenGLCapture is installed, so captures record the named calls, also on contexts with
+    // direct state access when PETROL_GL_EMULATE_DSA is set.
+    class OpenGLStateAccess {
+    public:
+        static void install();
+        static bool isInstalled();
+    };
+}
@@ -0,0 +1,277 @@
+#include <PCH.h>
+
+#include "OpenGLStaticBatcher.h"
+#include "OpenGLRenderer.h"
+#include "OpenGLVertexArray.h"
+#include "OpenGLVertexBuffer.h"
+#include "OpenGLIndexBuffer.h"
+#include "OpenGLMeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace PetrolEngine {
+    // offset of the first element with one of the names and types, -1 without one
+    static int64 findElement(const VertexLayout& layout, std::initializer_list<const char*> names, std::initializer_list<ShaderDataType> types) {
+        int64 offset = 0;
+
+        for (auto& element : layout.getElements()) {
+            bool named = std::any_of(names.begin(), names.end(), [&](const char* name) { return element.name == name;  });
+            bool typed = std::any_of(types.begin(), types.end(), [&](ShaderDataType type) { return element.type == type; });
+
+            if (named && typed) return offset;
+
+            offset += ShaderDataTypeSize(element.type);
+        }
+
+        return -1;
+    }
+
+    static glm::vec3 readVec3(const uint8* at) {
+        glm::vec3 value;
+        std::memcpy(&value, at, sizeof(value));
+        return value;
+    }
+
+    static void writeVec3(uint8* at, const glm::vec3& value) {
+        std::memcpy(at, &value, sizeof(value));
+    }
+
+    OpenGLStaticBatcher::OpenGLStaticBatcher(float chunkSize): chunkSize(chunkSize) {}
+
+    OpenGLStaticBatcher::~OpenGLStaticBatcher() { LOG_FUNCTION();
+        for (auto& chunk : chunks) delete chunk.second.vertexArray;
+    }
+
+    uint32 OpenGLStaticBatcher::addMesh(const void* vertices, int64 verticesSize, const uint32* indices, int64 indexCount, const VertexLayout& layout) { LOG_FUNCTION();
+        Mesh mesh;
+        mesh.vertices.assign((const uint8*) vertices, (const uint8*) vertices + verticesSize);
+        mesh.indices .assign(indices, indices + indexCount);
+        mesh.layout = layout;
+        mesh.stride = OpenGLMeshOptimizer::getVertexSize(layout);
+
+        for (auto& element : layout.getElements()) mesh.signature += toString((int) element.type) + element.name + ";";
+
+        mesh.positionOffset = OpenGLMeshOptimizer::getPositionOffset(layout);
+        mesh.normalOffset   = findElement(layout, { "normal" , "normals"  }, { ShaderDataType::Float3 });
+        mesh.tangentOffset  = findElement(layout, { "tangent", "tangents" }, { ShaderDataType::Float3, ShaderDataType::Float4 });
+
+        if (mesh.positionOffset < 0) LOG("Static mesh without a position element, it is batched untransformed.", 2);
+
+        uint32 vertexCount = mesh.stride ? (uint32) (verticesSize / mesh.stride) : 0;
+
+        if (mesh.positionOffset >= 0 && vertexCount > 0) {
+            mesh.boundsMin = mesh.boundsMax = readVec3(mesh.vertices.data() + mesh.positionOffset);
+
+            for (uint32 vertex = 1; vertex < vertexCount; vertex++) {
+                glm::vec3 position = readVec3(mesh.vertices.data() + (uint64) vertex * mesh.stride + mesh.positionOffset);
+
+                mesh.boundsMin = glm::min(mesh.boundsMin, position);
+                mesh.boundsMax = glm::max(mesh.boundsMax, position);
+            }
+        }
+
+        meshes.push_back(std::move(mesh));
+        return (uint32) meshes.size() - 1;
+    }
+
+    uint32 OpenGLStaticBatcher::findBatch(Shader* shader, const Vector<const Texture*>& textures, const String& signature) {
+        for (uint32 batch = 0; batch < batches.size(); batch++) {
+            auto& it = batches[batch];
+
+            if (it.shader == shader && it.textures == textures && it.signature == signature) return batch;
+        }
+
+        batches.push_back({ shader, textures, signature });
+        return (uint32) batches.size() - 1;
+    }
+
+    uint64 OpenGLStaticBatcher::chunkKey(uint32 batch, const glm::mat4& model, const Mesh& mesh) const {
+        glm::vec3 center = glm::vec3(model * glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.f));
+
+        // batch in the top 16 bits, then 16 bits for every cell coordinate, so keys never collide
+        uint64 key = (uint64) (batch & 0xFFFF) << 48;
+
+        for (int axis = 0; axis < 3; axis++) {
+            float cell = std::clamp(std::floor(center[axis] / chunkSize), -32768.f, 32767.f);
+
+            key |= (uint64) ((uint16_t) (int32) cell) << (16 * axis);
+        }
+
+        return key;
+    }
+
+    uint32 OpenGLStaticBatcher::add(uint32 mesh, const glm::mat4& model, const Vector<const Texture*>& textures, Shader* shader) { LOG_FUNCTION();
+        Object object;
+        object.mesh  = mesh;
+        object.batch = findBatch(shader, textures, meshes[mesh].signature);
+        object.model = model;
+        object.chunk = 0;
+        object.alive = true;
+
+        objects.push_back(object);
+        insert((uint32) objects.size() - 1);
+
+        return (uint32) objects.size() - 1;
+    }
+
+    void OpenGLStaticBatcher::move(uint32 object, const glm::mat4& model) {
+        if (!objects[object].alive) return;
+
+        erase(object);
+        objects[object].model = model;
+        insert(object);
+    }
+
+    void OpenGLStaticBatcher::remove(uint32 object) {
+        if (!objects[object].alive) return;
+
+        erase(object);
+        objects[object].alive = false;
+    }
+
+    void OpenGLStaticBatcher::insert(uint32 object) {
+        Object& it = objects[object];
+        it.chunk = chunkKey(it.batch, it.model, meshes[it.mesh]);
+
+        Chunk& chunk = chunks[it.chunk];
+        chunk.batch = it.batch;
+        chunk.dirty = true;
+        chunk.objects.push_back(object);
+    }
+
+    void OpenGLStaticBatcher::erase(uint32 object) {
+        Chunk& chunk = chunks[objects[object].chunk];
+
+        chunk.objects.erase(std::find(chunk.objects.begin(), chunk.objects.end(), object));
+        chunk.dirty = true;
+    }
+
+    void OpenGLStaticBatcher::build() { LOG_FUNCTION();
+        lastRebuilds = 0;
+
+        for (auto it = chunks.begin(); it != chunks.end();) {
+            Chunk& chunk = it->second;
+
+            if (chunk.objects.empty()) {
+                delete chunk.vertexArray;
+                it = chunks.erase(it);
+                continue;
+            }
+
+            if (chunk.dirty) {
+                buildChunk(chunk);
+                lastRebuilds++;
+            }
+
+            it++;
+        }
+    }
+
+    void OpenGLStaticBatcher::buildChunk(Chunk& chunk) {
+        const Mesh& first  = meshes[objects[chunk.objects[0]].mesh];
+        uint32      stride = first.stride;
+
+        int64 vertexCount = 0;
+        int64 indexCount  = 0;
+
+        for (uint32 object : chunk.objects) {
+            auto& mesh = meshes[objects[object].mesh];
+
+            vertexCount += (int64) mesh.vertices.size() / stride;
+            indexCount  += (int64) mesh.indices .size();
+        }
+
+        Vector<uint8>  vertices((uint64) (vertexCount * stride));
+        Vector<uint32> indices;
+        indices.reserve((uint64) indexCount);
+
+        glm::vec3 boundsMin( INFINITY);
+        glm::vec3 boundsMax(-INFINITY);
+
+        int64 baseVertex = 0;
+
+        for (uint32 object : chunk.objects) {
+            auto& mesh  = meshes[objects[object].mesh];
+            auto& model = objects[object].model;
+
+            glm::mat3 rotation = glm::mat3(model);
+            glm::mat3 normals  = glm::transpose(glm::inverse(rotation));
+
+            int64  meshVertices = (int64) mesh.vertices.size() / stride;
+            uint8* destination  = vertices.data() + baseVertex * stride;
+
+            std::memcpy(destination, mesh.vertices.data(), mesh.vertices.size());
+
+            for (int64 vertex = 0; vertex < meshVertices; vertex++) {
+                uint8* at = destination + vertex * stride;
+
+                if (mesh.positionOffset >= 0) {
+                    glm::vec3 position = glm::vec3(model * glm::vec4(readVec3(at + mesh.positionOffset), 1.f));
+                    writeVec3(at + mesh.positionOffset, position);
+
+                    boundsMin = glm::min(boundsMin, position);
+                    boundsMax = glm::max(boundsMax, position);
+                }
+
+                if (mesh.normalOffset  >= 0) writeVec3(at + mesh.normalOffset , glm::normalize(normals  * readVec3(at + mesh.normalOffset )));
+                if (mesh.tangentOffset >= 0) writeVec3(at + mesh.tangentOffset, glm::normalize(rotation * readVec3(at + mesh.tangentOffset)));
+            }
+
+            for (uint32 index : mesh.indices) indices.push_back(index + (uint32) baseVertex);
+
+            baseVertex += meshVertices;
+        }
+
+        int64 verticesSize = (int64) vertices.size();
+        int64 indicesSize  = (int64) (indices.size() * sizeof(uint32));
+
+        if (chunk.vertexArray == nullptr) {
+            VertexBuffer* vertexBuffer = new OpenGLVertexBuffer(first.layout, vertices.data(), verticesSize);
+            IndexBuffer*  indexBuffer  = new OpenGLIndexBuffer (              indices .data(), indicesSize );
+
+            chunk.vertexArray = new OpenGLVertexArray();
+            chunk.vertexArray->addVertexBuffer(vertexBuffer);
+            chunk.vertexArray->setIndexBuffer (indexBuffer );
+        }
+        else {
+            chunk.vertexArray->getVertexBuffers()[0]->setData(vertices.data(), verticesSize);
+            chunk.vertexArray->getIndexBuffer()     ->setData(indices .data(), indicesSize );
+        }
+
+        if (first.positionOffset >= 0) chunk.vertexArray->setBounds(boundsMin, boundsMax);
+
+        chunk.vertexCount = vertexCount;
+        chunk.indexCount  = indexCount;
+        chunk.dirty       = false;
+    }
+
+    void OpenGLStaticBatcher::render(OpenGLRenderer& renderer, const Camera* camera) { LOG_FUNCTION();
+        for (auto& it : chunks) {
+            Chunk& chunk = it.second;
+
+            if (chunk.vertexArray == nullptr || chunk.indexCount == 0) continue;
+
+            Batch& batch = batches[chunk.batch];
+            renderer.renderMesh(chunk.vertexArray, identity, batch.textures, batch.shader, camera);
+        }
+    }
+
+    OpenGLStaticBatcher::Statistics OpenGLStaticBatcher::getStatistics() const {
+        Statistics statistics;
+        statistics.rebuilds = lastRebuilds;
+
+        for (auto& object : objects) statistics.objects += object.alive ? 1 : 0;
+
+        for (auto& it : chunks) {
+            if (it.second.vertexArray == nullptr) continue;
+
+            statistics.chunks   += 1;
+            statistics.vertices += it.second.vertexCount;
+            statistics.indices  += it.second.indexCount;
+        }
+
+        return statistics;
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <Core/Aliases.h>
+#include <Core/Renderer/VertexBuffer.h>
+#include <Core/Components/Transform.h>
+
+#include <glm/glm.hpp>
+
+namespace PetrolEngine {
+    class OpenGLRenderer;
+    class OpenGLVertexArray;
+    class OpenGLVertexBuffer;
+    class OpenGLIndexBuffer;
+    class Shader;
+    class Texture;
+    class Camera;
+
+    // Merges static objects that share a shader, textures and vertex layout into one vertex array per
+    // cell of a world space grid. Vertices are transformed on the CPU when a chunk is built (position,
+    // and "normal" / "tangent" elements when the layout has them), so a chunk is drawn with an identity
+    // transform and a single renderMesh, and its world space bounds keep GPU culling working.
+    //
+    //     uint32 rock = batcher.addMesh(vertices, verticesSize, indices, indexCount, layout);
+    //     for (auto& prop : props) batcher.add(rock, prop.model, textures, shader);
+    //     batcher.build();
+    //     ...
+    //     batcher.render(renderer, camera); // every frame, before renderer.draw()
+    //
+    // Moving or removing an object only rebuilds the chunks it leaves and enters, at the next build.
+    class OpenGLStaticBatcher {
+    public:
+        explicit OpenGLStaticBatcher(float chunkSize = 32.f);
+        ~OpenGLStaticBatcher();
+
+        // copies local space geometry, one mesh can be added as many objects
+        uint32 addMesh(const void* vertices, int64 verticesSize, const uint32* indices, int64 indexCount, const VertexLayout& layout);
+
+        uint32 add   (uint32 mesh, const glm::mat4& model, const Vector<const Texture*>& textures, Shader* shader);
+        void   move  (uint32 object, const glm::mat4& model);
+        void   remove(uint32 object);
+
+        // rebuilds chunks changed since the last build
+        void build();
+
+        // records a draw of every chunk, changes not built yet are not visible
+        void render(OpenGLRenderer& renderer, const Camera* camera);
+
+        uint32 getChunkCount() const { return (uint32) chunks.size(); }
+
+        struct Statistics {
+            uint32 objects  = 0;
+            uint32 chunks   = 0;
+            uint32 rebuilds = 0; // chunks built by the last build
+            int64  vertices = 0;
+            int64  indices  = 0;
+        };
+
+        Statistics getStatistics() const;
+
+    private:
+        struct Mesh {
+            Vector<uint8>  vertices;
+            Vector<uint32> indices;
+            VertexLayout   layout;
+            uint32         stride = 0;
+            String         signature; // element types and names, equal for layouts that can merge
+
+            int64 positionOffset = -1;
+            int64 normalOffset   = -1;
+            int64 tangentOffset  = -1;
+
+            glm::vec3 boundsMin{0.f};
+            glm::vec3 boundsMax{0.f};
+        };
+
+        // what has to be equal for objects to share a chunk
+        struct Batch {
+            Shader*                shader;
+            Vector<const Texture*> textures;
+            String                 signature;
+        };
+
+        struct Object {
+            uint32    mesh;
+            uint32    batch;
+            glm::mat4 model;
+            uint64    chunk;
+            bool      alive;
+        };
+
+        struct Chunk {
+            uint32             batch;
+            Vector<uint32>     objects;
+            OpenGLVertexArray* vertexArray = nullptr;
+            bool               dirty       = true;
+
+            int64 vertexCount = 0;
+            int64 indexCount  = 0;
+        };
+
+        uint32 findBatch (Shader* shader, const Vector<const Texture*>& textures, const String& signature);
+        uint64 chunkKey  (uint32 batch, const glm::mat4& model, const Mesh& mesh) const;
+        void   insert    (uint32 object);
+        void   erase     (uint32 object);
+        void   buildChunk(Chunk& chunk);
+
+        float chunkSize;
+
+        Vector<Mesh>   meshes;
+        Vector<Batch>  batches;
+        Vector<Object> objects;
+
+        UnorderedMap<uint64, Chunk> chunks;
+
+        uint32 lastRebuilds = 0;
+
+        // chunks are pre-transformed, every draw uses the identity
+        Transform identity;
+    };
+}
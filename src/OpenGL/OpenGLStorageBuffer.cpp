@@ -0,0 +1,46 @@
+#include <PCH.h>
+
+#include <glad/glad.h>
+
+#include "OpenGLStorageBuffer.h"
+#include "OpenGLMemory.h"
+
+namespace PetrolEngine{
+    OpenGLStorageBuffer::OpenGLStorageBuffer(uint32_t size, uint32_t binding) {
+        this->size = size;
+        this->binding = binding;
+
+        glCreateBuffers(1, &this->ID);
+        glNamedBufferData(this->ID, size, nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, this->ID);
+
+        OpenGLMemory::track(OpenGLMemory::Category::StorageBuffer, GL_BUFFER, this->ID, size, "Storage buffer " + toString(binding));
+    }
+
+    OpenGLStorageBuffer::~OpenGLStorageBuffer() {
+        OpenGLMemory::untrack(GL_BUFFER, this->ID);
+        glDeleteBuffers(1, &this->ID);
+    }
+
+    void OpenGLStorageBuffer::setData(const void* data, uint32_t size, uint32_t offset) {
+        glNamedBufferSubData(this->ID, offset, size, data);
+    }
+
+    void OpenGLStorageBuffer::reserve(uint32_t size) {
+        if (size <= this->size) {
+            // orphan the old storage so the driver does not wait for draws still reading it
+            glNamedBufferData(this->ID, this->size, nullptr, GL_DYNAMIC_DRAW);
+            return;
+        }
+
+        uint32_t newSize = this->size ? this->size : 1024;
+        while (newSize < size) newSize *= 2;
+
+        this->size = newSize;
+
+        // same buffer name is kept so the binding point stays valid
+        glNamedBufferData(this->ID, newSize, nullptr, GL_DYNAMIC_DRAW);
+
+        OpenGLMemory::resize(GL_BUFFER, this->ID, newSize);
+    }
+}
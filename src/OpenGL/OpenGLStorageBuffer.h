@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Core/Aliases.h>
+
+namespace PetrolEngine{
+    // Shader storage buffer, unlike the uniform buffer it can be resized and is not limited to 64KB.
+    class OpenGLStorageBuffer {
+    public:
+        OpenGLStorageBuffer(uint32_t size, uint32_t binding);
+        ~OpenGLStorageBuffer();
+
+        void setData(const void* data, uint32_t size, uint32_t offset);
+
+        // grows the buffer to at least given size, contents are discarded
+        void reserve(uint32_t size);
+
+        uint32_t getID     () const { return ID;      }
+        uint32_t getSize   () const { return size;    }
+        uint32_t getBinding() const { return binding; }
+
+    private:
+        uint32_t ID      = 0;
+        uint32_t size    = 0;
+        uint32_t binding = 0;
+    };
+}
@@ -1,10 +1,46 @@
 #include <PCH.h>
 
 #include "OpenGLTexture.h"
+#include "OpenGLMemory.h"
+#include "OpenGLTracer.h"
 #include <Core/Atlas.h>
 #include <Core/Image.h>
 
 namespace PetrolEngine {
+    static int64 bytesPerTexel(TextureFormat format) {
+        switch (format) {
+            case TextureFormat::RGBA16         : return 8;
+            case TextureFormat::RGBA8          : return 4;
+            case TextureFormat::RGB16          : return 6;
+            case TextureFormat::RGB8           : return 3;
+            case TextureFormat::RED            : return 1;
+            case TextureFormat::DEPTH24STENCIL8: return 4;
+            default                            : return 0;
+        }
+    }
+
+    // a full mip chain adds a third on top of the base level
+    static int64 estimateSize(int width, int height, TextureFormat format, TextureType type, bool mipmaps) {
+        int64 bytes = (int64) width * height * bytesPerTexel(format);
+
+        if (type == TextureType::TextureCube) bytes *= 6;
+        if (mipmaps) bytes = bytes * 4 / 3;
+
+        return bytes;
+    }
+
+    static String describe(int width, int height) {
+        return "Texture " + toString(width) + "x" + toString(height);
+    }
+
+    // the largest alignment the rows are padded to, RGB8 and RED rows often are not padded at all
+    static GLint rowAlignment(int64 rowBytes) {
+        if (rowBytes % 8 == 0) return 8;
+        if (rowBytes % 4 == 0) return 4;
+        if (rowBytes % 2 == 0) return 2;
+
+        return 1;
+    }
 
 	OpenGLTexture::OpenGLTexture(int width, int height, TextureFormat format, TextureType type) {
 		this->width  = width;
@@ -12,8 +48,6 @@ namespace PetrolEngine {
 		this->format = format;
         this->type   = type;
 
-		if (format == TextureFormat::RED) glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
         auto GLType   = textureTypeLookupTable  .at(type  );
         auto GLFormat = textureFormatLookupTable.at(format);
 
@@ -36,7 +70,8 @@ namespace PetrolEngine {
         }
 
         if(type == TextureType::Texture2D) {
-            if(width && height) glTexImage2D(GL_TEXTURE_2D, 0, GLFormat.second, width, height, 0, GLFormat.first, GL_UNSIGNED_BYTE, nullptr);
+            // depth stencil storage is allocated above with its own format and type
+            if(width && height && format != TextureFormat::DEPTH24STENCIL8) glTexImage2D(GL_TEXTURE_2D, 0, GLFormat.second, width, height, 0, GLFormat.first, GL_UNSIGNED_BYTE, nullptr);
 
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -46,7 +81,12 @@ namespace PetrolEngine {
 
         if(type == TextureType::TextureCube){
             for (int i = 0; i < 6; i++) {
-                if(width && height)
+                if(!width || !height) continue;
+
+                // depth cube maps are layered shadow targets, the depth stencil entry lists internal format first
+                if(format == TextureFormat::DEPTH24STENCIL8)
+                    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GLFormat.first, width, height, 0, GLFormat.second, GL_UNSIGNED_INT_24_8, nullptr);
+                else
                     glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GLFormat.second, width, height, 0, GLFormat.first, GL_UNSIGNED_BYTE, nullptr);
             }
 
@@ -58,19 +98,26 @@ namespace PetrolEngine {
         }
 
         glBindTexture(GLType, 0);
+
+        OpenGLMemory::track(OpenGLMemory::Category::Texture, GL_TEXTURE, id, estimateSize(width, height, format, type, false), describe(width, height));
 	}
 
 	OpenGLTexture::~OpenGLTexture() {
+        OpenGLMemory::untrack(GL_TEXTURE, id);
 		glDeleteTextures(1, &id);
 	}
 
-	void OpenGLTexture::updateTextureImage(const void* data, int index = -1) {
+	void OpenGLTexture::updateTextureImage(const void* data, int index = -1) { TRACE_FUNCTION();
 		auto GLFormat = textureFormatLookupTable.at(format);
         auto GLType   = textureTypeLookupTable  .at(type  );
 
         if(!height) LOG("Texture height is 0", 3);
         if(!width ) LOG("Texture width  is 0", 3);
 
+        GLint alignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, rowAlignment((int64) width * bytesPerTexel(format)));
+
         glBindTexture(GLType, id);
 
         if(type == TextureType::Texture2D)
@@ -86,36 +133,66 @@ namespace PetrolEngine {
         }
 
 		END:glGenerateMipmap(GLType);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+        OpenGLMemory::resize(GL_TEXTURE, id, estimateSize(width, height, format, type, true));
 	}
 
-	OpenGLTexture::OpenGLTexture(const Image& image) {
+	// loaded where it is used, usually the render thread, so the chain is left to glGenerateMipmap
+	static OpenGLTexturePreprocessor::Prepared prepareBase(const Image& image) {
+        OpenGLTexturePreprocessor::Options options = OpenGLTexturePreprocessor::defaults;
+        options.mipmaps = false;
+
+        return OpenGLTexturePreprocessor::prepare(image, options);
+    }
+
+	OpenGLTexture::OpenGLTexture(const Image& image): OpenGLTexture(prepareBase(image)) {}
+
+	OpenGLTexture::OpenGLTexture(const OpenGLTexturePreprocessor::Prepared& prepared) { TRACE_FUNCTION();
 		this->id   = 0;
 
-		if (!image.getData()) {
+		if (prepared.format == TextureFormat::NONE) {
             LOG("Texture failed to load. ", 2); return;
         }
 
-		this->width  = image.getWidth();
-		this->height = image.getHeight();
-
-                auto a = getFormat(image);
-		auto GLFormat = textureFormatLookupTable.at(a);
+		this->width  = prepared.levels[0].width;
+		this->height = prepared.levels[0].height;
+		this->format = prepared.format;
+        this->type   = TextureType::Texture2D;
 
 		glGenTextures(1, &id);
 		glBindTexture(GL_TEXTURE_2D, id);
-		
-		// Those are for DSA version (OpenGL 4.5 or higher)
-		//	glCreateTextures(GL_TEXTURE_2D, 1, &id);
-		//	glTexStorage2D  (GL_TEXTURE_2D, 1, GLFormat, width, height);
-		
+
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S    , GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T    , GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-		glTexImage2D    (GL_TEXTURE_2D, 0, GLFormat.second, width, height, 0, GLFormat.first, GL_UNSIGNED_BYTE, image.getData());
-		glGenerateMipmap(GL_TEXTURE_2D);
+        GLint alignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+
+        int64 bytes = 0;
+
+        for (size_t level = 0; level < prepared.levels.size(); level++) {
+            const auto& data = prepared.levels[level];
+            int64 rowBytes   = (int64) data.width * prepared.texelBytes;
+
+            glPixelStorei(GL_UNPACK_ALIGNMENT, rowAlignment(rowBytes));
+            glTexImage2D (GL_TEXTURE_2D, (GLint) level, (GLint) prepared.internalFormat, data.width, data.height, 0, prepared.dataFormat, prepared.dataType, data.getData());
+
+            bytes += rowBytes * data.height;
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+        if (!prepared.complete) {
+            glGenerateMipmap(GL_TEXTURE_2D);
+            bytes = estimateSize(width, height, format, TextureType::Texture2D, true);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, 0);
 
-		// glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        OpenGLMemory::track(OpenGLMemory::Category::Texture, GL_TEXTURE, id, bytes, describe(width, height));
 	}
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Core/Renderer/Texture.h"
+#include "OpenGLTexturePreprocessor.h"
 #include <glad/glad.h>
 
 namespace PetrolEngine {
@@ -14,12 +15,19 @@ namespace PetrolEngine {
             TextureType type = TextureType::Texture2D
 		);
 
+        // prepares level 0 only and lets the driver generate the mip chain, for loads on the render thread
         OpenGLTexture(const Image& image);
+
+        // uploads the levels as they are, the driver only generates them when prepared is not complete
+        OpenGLTexture(const OpenGLTexturePreprocessor::Prepared& prepared);
 		
 		~OpenGLTexture() override;
 
 		void updateTextureImage(const void* data, int index) override;
 	private:
+		// defines the levels of streamed textures itself
+		friend class OpenGLTextureStreamer;
+
 		const UnorderedMap<TextureFormat, Pair<GLuint, GLuint>> textureFormatLookupTable{
 			{TextureFormat::RGBA16, {GL_RGBA, GL_RGBA16}},
 			{TextureFormat::RGBA8 , {GL_RGBA, GL_RGBA8 }},
@@ -0,0 +1,421 @@
+#include <PCH.h>
+
+#include "OpenGLTexturePreprocessor.h"
+#include "OpenGLTracer.h"
+
+#include <Core/Image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86)
+    #include <xmmintrin.h>
+    #define OPENGL_IMAGES_SSE
+#endif
+
+namespace PetrolEngine {
+    OpenGLTexturePreprocessor::Options OpenGLTexturePreprocessor::defaults;
+    uint32 OpenGLTexturePreprocessor::threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    // rows are split across threads only when every thread gets at least this many texels
+    static constexpr int64 minTexelsPerThread = 64 * 1024;
+
+    // linear values are quantized to this many steps to find the sRGB code they round to
+    static constexpr int32 srgbSteps = 4095;
+
+    static constexpr float  kaiserRadius = 3.f; // in texels of the destination level
+    static constexpr float  kaiserAlpha  = 4.f;
+    static constexpr double pi           = 3.14159265358979323846;
+
+    // one texel, RGBA in linear space
+#if defined(OPENGL_IMAGES_SSE)
+    struct Texel { __m128 v; };
+
+    static inline Texel texelSet   (float r, float g, float b, float a) { return { _mm_setr_ps(r, g, b, a) };                              }
+    static inline Texel texelZero  ()                                   { return { _mm_setzero_ps() };                                     }
+    static inline Texel texelMulAdd(Texel sum, Texel texel, float w)    { return { _mm_add_ps(sum.v, _mm_mul_ps(texel.v, _mm_set1_ps(w))) }; }
+    static inline Texel texelClamp (Texel texel)                        { return { _mm_min_ps(_mm_max_ps(texel.v, _mm_setzero_ps()), _mm_set1_ps(1.f)) }; }
+    static inline void  texelStore (float* to, Texel texel)             { _mm_storeu_ps(to, texel.v);                                      }
+
+    static inline Texel texelPremultiply(Texel texel) {
+        // a, a, 1, 1 then a, a, a, 1
+        __m128 factor = _mm_shuffle_ps(texel.v, _mm_set1_ps(1.f), _MM_SHUFFLE(0, 0, 3, 3));
+        factor = _mm_shuffle_ps(factor, factor, _MM_SHUFFLE(2, 0, 0, 0));
+
+        return { _mm_mul_ps(texel.v, factor) };
+    }
+#else
+    struct Texel { float c[4]; };
+
+    static inline Texel texelSet (float r, float g, float b, float a) { return { { r, g, b, a } }; }
+    static inline Texel texelZero()                                   { return { { 0.f, 0.f, 0.f, 0.f } }; }
+
+    static inline Texel texelMulAdd(Texel sum, Texel texel, float w) {
+        for (int32 c = 0; c < 4; c++) sum.c[c] += texel.c[c] * w;
+        return sum;
+    }
+
+    static inline Texel texelClamp(Texel texel) {
+        for (int32 c = 0; c < 4; c++) texel.c[c] = std::min(std::max(texel.c[c], 0.f), 1.f);
+        return texel;
+    }
+
+    static inline void texelStore(float* to, Texel texel) { for (int32 c = 0; c < 4; c++) to[c] = texel.c[c]; }
+
+    static inline Texel texelPremultiply(Texel texel) {
+        for (int32 c = 0; c < 3; c++) texel.c[c] *= texel.c[3];
+        return texel;
+    }
+#endif
+
+    struct Tables {
+        float srgbToLinear[256];
+        float unorm       [256];            // code / 255
+        float srgbThreshold[255];           // linear value from which code + 1 is the closest
+        uint8 srgbStart    [srgbSteps + 1]; // closest code of step / srgbSteps
+
+        Tables() {
+            auto decode = [](double encoded) { return encoded <= 0.04045 ? encoded / 12.92 : std::pow((encoded + 0.055) / 1.055, 2.4); };
+
+            for (int32 code = 0; code < 256; code++) {
+                srgbToLinear[code] = (float) decode(code / 255.0);
+                unorm       [code] = (float) (code / 255.0);
+            }
+
+            for (int32 code = 0; code < 255; code++) srgbThreshold[code] = (float) decode((code + 0.5) / 255.0);
+
+            int32 code = 0;
+            for (int32 step = 0; step <= srgbSteps; step++) {
+                float value = (float) step / srgbSteps;
+
+                while (code < 255 && value >= srgbThreshold[code]) code++;
+                srgbStart[step] = (uint8) code;
+            }
+        }
+    };
+
+    static const Tables& getTables() {
+        static const Tables tables;
+        return tables;
+    }
+
+    // value in [0, 1], rounds in encoded space
+    static inline uint8 encodeSrgb(const Tables& tables, float value) {
+        int32 code = tables.srgbStart[(int32) (value * srgbSteps)];
+
+        while (code < 255 && value >= tables.srgbThreshold[code    ]) code++;
+        while (code > 0   && value <  tables.srgbThreshold[code - 1]) code--;
+
+        return (uint8) code;
+    }
+
+    static inline uint8 encodeUnorm(float value) { return (uint8) (value * 255.f + 0.5f); }
+
+    static double bessel0(double x) {
+        double sum = 1.0, term = 1.0;
+
+        for (int32 k = 1; k < 32; k++) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum  += term;
+        }
+
+        return sum;
+    }
+
+    static double kaiser(double t) {
+        if (std::abs(t) >= kaiserRadius) return 0.0;
+
+        double sinc   = t == 0.0 ? 1.0 : std::sin(pi * t) / (pi * t);
+        double window = bessel0(kaiserAlpha * std::sqrt(1.0 - (t / kaiserRadius) * (t / kaiserRadius))) / bessel0(kaiserAlpha);
+
+        return sinc * window;
+    }
+
+    // source texels and weights of every destination texel along one axis, the same count for all of them
+    struct Taps {
+        int32         count = 0;
+        Vector<int32> index;
+        Vector<float> weight;
+    };
+
+    static Taps buildTaps(int32 from, int32 to, OpenGLTexturePreprocessor::Filter filter) {
+        Taps taps;
+
+        // even sizes average pairs, odd ones (from = 2 * to + 1) cover three texels with every output,
+        // weighted by how much of each its from / to wide footprint covers, so no texel is dropped
+        if (filter == OpenGLTexturePreprocessor::Filter::Box) {
+            taps.count = (from % 2 == 0 || from == 1) ? 2 : 3;
+
+            for (int32 x = 0; x < to; x++) {
+                for (int32 tap = 0; tap < taps.count; tap++) taps.index.push_back(std::min(x * 2 + tap, from - 1));
+
+                if (taps.count == 2) {
+                    taps.weight.push_back(0.5f);
+                    taps.weight.push_back(0.5f);
+                    continue;
+                }
+
+                taps.weight.push_back((float) (to - x) / from);
+                taps.weight.push_back((float) to       / from);
+                taps.weight.push_back((float) (x + 1)  / from);
+            }
+
+            return taps;
+        }
+
+        double ratio  = (double) from / to;
+        double radius = kaiserRadius * ratio;
+
+        taps.count = (int32) std::ceil(radius * 2.0) + 1;
+        taps.index .assign((size_t) to * taps.count, 0  );
+        taps.weight.assign((size_t) to * taps.count, 0.f);
+
+        for (int32 x = 0; x < to; x++) {
+            double center = (x + 0.5) * ratio;
+            int32  first  = (int32) std::ceil(center - radius - 0.5);
+            double total  = 0.0;
+
+            Vector<double> weights;
+
+            for (int32 tap = 0; tap < taps.count; tap++) {
+                double weight = kaiser((first + tap + 0.5 - center) / ratio);
+
+                weights.push_back(weight);
+                total += weight;
+            }
+
+            for (int32 tap = 0; tap < taps.count; tap++) {
+                int32 index = (first + tap) % from;
+
+                taps.index [x * taps.count + tap] = index < 0 ? index + from : index;
+                taps.weight[x * taps.count + tap] = (float) (weights[tap] / total);
+            }
+        }
+
+        return taps;
+    }
+
+    // calls work with ranges of rows, on several threads when every one of them gets enough texels
+    static void forRows(int32 rows, int64 texelsPerRow, const std::function<void(int32, int32)>& work) {
+        int64  texels  = (int64) rows * texelsPerRow;
+        uint32 threads = (uint32) std::min<int64>({ (int64) OpenGLTexturePreprocessor::threadCount, texels / minTexelsPerThread, (int64) rows });
+
+        if (threads <= 1) { work(0, rows); return; }
+
+        Vector<std::thread> workers;
+        int32 perThread = (rows + (int32) threads - 1) / (int32) threads;
+
+        for (int32 t = 1; t < (int32) threads; t++)
+            workers.emplace_back(work, std::min(t * perThread, rows), std::min((t + 1) * perThread, rows));
+
+        work(0, std::min(perThread, rows));
+
+        for (auto& worker : workers) worker.join();
+    }
+
+    struct Encoding {
+        const Tables& tables;
+        int32         channels; // 1 or 4
+        bool          srgb;
+    };
+
+    static void decodeRow(const Encoding& encoding, const uint8* from, int32 width, Texel* to) {
+        const float* color = encoding.srgb ? encoding.tables.srgbToLinear : encoding.tables.unorm;
+        const float* unorm = encoding.tables.unorm;
+
+        if (encoding.channels == 1) {
+            for (int32 x = 0; x < width; x++) to[x] = texelSet(unorm[from[x]], 0.f, 0.f, 1.f);
+            return;
+        }
+
+        for (int32 x = 0; x < width; x++, from += 4)
+            to[x] = texelSet(color[from[0]], color[from[1]], color[from[2]], unorm[from[3]]);
+    }
+
+    static void encodeRow(const Encoding& encoding, const Texel* from, int32 width, uint8* to) {
+        float value[4];
+
+        for (int32 x = 0; x < width; x++) {
+            texelStore(value, from[x]);
+
+            if (encoding.channels == 1) { to[x] = encodeUnorm(value[0]); continue; }
+
+            for (int32 c = 0; c < 3; c++) to[x * 4 + c] = encoding.srgb ? encodeSrgb(encoding.tables, value[c]) : encodeUnorm(value[c]);
+            to[x * 4 + 3] = encodeUnorm(value[3]);
+        }
+    }
+
+    // RGBA8 from one to four components, then swizzled
+    static void expandRow(const uint8* from, int32 width, int32 components, const uint8* swizzle, uint8* to) {
+        for (int32 x = 0; x < width; x++, from += components, to += 4) {
+            uint8 rgba[4];
+
+            switch (components) {
+                case 2 : rgba[0] = rgba[1] = rgba[2] = from[0]; rgba[3] = from[1]; break;
+                case 3 : rgba[0] = from[0]; rgba[1] = from[1]; rgba[2] = from[2]; rgba[3] = 255; break;
+                default: rgba[0] = from[0]; rgba[1] = from[1]; rgba[2] = from[2]; rgba[3] = from[3]; break;
+            }
+
+            for (int32 c = 0; c < 4; c++) to[c] = rgba[swizzle[c] & 3];
+        }
+    }
+
+    // level 0 is read from its bytes, coarser levels from the texels kept when they were filtered
+    struct Source {
+        const uint8* bytes  = nullptr;
+        const Texel* texels = nullptr;
+        int32        width  = 0;
+        int32        height = 0;
+    };
+
+    // vertical taps into a row of source width, then horizontal taps out of it
+    static void filterRow(const Encoding& encoding, const Source& source, const Taps& columns, const Taps& rows, int32 y, int32 width,
+                          Texel* column, Texel* decoded, Texel* to) {
+        std::fill(column, column + source.width, texelZero());
+
+        for (int32 tap = 0; tap < rows.count; tap++) {
+            float weight = rows.weight[y * rows.count + tap];
+            int32 index  = rows.index [y * rows.count + tap];
+
+            if (weight == 0.f) continue;
+
+            const Texel* row = source.texels + (int64) index * source.width;
+
+            if (source.bytes) {
+                decodeRow(encoding, source.bytes + (int64) index * source.width * encoding.channels, source.width, decoded);
+                row = decoded;
+            }
+
+            for (int32 x = 0; x < source.width; x++) column[x] = texelMulAdd(column[x], row[x], weight);
+        }
+
+        for (int32 x = 0; x < width; x++) {
+            Texel sum = texelZero();
+
+            for (int32 tap = 0; tap < columns.count; tap++)
+                sum = texelMulAdd(sum, column[columns.index[x * columns.count + tap]], columns.weight[x * columns.count + tap]);
+
+            // the negative lobes of the Kaiser filter overshoot at sharp edges
+            to[x] = texelClamp(sum);
+        }
+    }
+
+    static bool isIdentity(const uint8* swizzle) { return swizzle[0] == 0 && swizzle[1] == 1 && swizzle[2] == 2 && swizzle[3] == 3; }
+
+    OpenGLTexturePreprocessor::Prepared OpenGLTexturePreprocessor::prepare(const Image& image, const Options& options) { TRACE_FUNCTION();
+        Prepared prepared;
+
+        if (!image.getData()) return prepared;
+
+        int32 width      = image.getWidth ();
+        int32 height     = image.getHeight();
+        int32 components = image.getComponentsNumber();
+
+        Level base;
+        base.width  = width;
+        base.height = height;
+
+        if (image.getBitsPerChannel() != 8 || components < 1 || components > 4) {
+            prepared.format = Texture::getFormat(image);
+            prepared.dataType = image.getBitsPerChannel() == 16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+            prepared.texelBytes = components * (image.getBitsPerChannel() / 8);
+
+            switch (prepared.format) {
+                case TextureFormat::RGBA16: prepared.internalFormat = GL_RGBA16; prepared.dataFormat = GL_RGBA; break;
+                case TextureFormat::RGB16 : prepared.internalFormat = GL_RGB16 ; prepared.dataFormat = GL_RGB ; break;
+                case TextureFormat::RGBA8 : prepared.internalFormat = GL_RGBA8 ; prepared.dataFormat = GL_RGBA; break;
+                case TextureFormat::RGB8  : prepared.internalFormat = GL_RGB8  ; prepared.dataFormat = GL_RGB ; break;
+                case TextureFormat::RED   : prepared.internalFormat = GL_R8    ; prepared.dataFormat = GL_RED ; break;
+                default: prepared.format = TextureFormat::NONE; return prepared;
+            }
+
+            base.external = image.getData();
+            prepared.levels.push_back(std::move(base));
+
+            return prepared;
+        }
+
+        int32 channels    = components == 1 ? 1 : 4;
+        bool  premultiply = options.premultiply && channels == 4;
+
+        // there is no core sRGB format with one channel
+        Encoding encoding{ getTables(), channels, options.srgb && channels == 4 };
+
+        prepared.format         = channels == 1 ? TextureFormat::RED : TextureFormat::RGBA8;
+        prepared.internalFormat = channels == 1 ? GL_R8  : encoding.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        prepared.dataFormat     = channels == 1 ? GL_RED : GL_RGBA;
+        prepared.dataType       = GL_UNSIGNED_BYTE;
+        prepared.texelBytes     = channels;
+        prepared.complete       = options.mipmaps;
+
+        if (channels == 1 || (components == 4 && isIdentity(options.swizzle) && !premultiply)) base.external = image.getData();
+        else {
+            base.storage.resize((size_t) width * height * 4);
+
+            forRows(height, width, [&](int32 begin, int32 end) {
+                Vector<Texel> decoded(premultiply ? width : 0);
+
+                for (int32 y = begin; y < end; y++) {
+                    uint8* row = base.storage.data() + (int64) y * width * 4;
+
+                    expandRow(image.getData() + (int64) y * width * components, width, components, options.swizzle, row);
+
+                    if (!premultiply) continue;
+
+                    decodeRow(encoding, row, width, decoded.data());
+                    for (int32 x = 0; x < width; x++) decoded[x] = texelPremultiply(decoded[x]);
+                    encodeRow(encoding, decoded.data(), width, row);
+                }
+            });
+        }
+
+        prepared.levels.push_back(std::move(base));
+
+        if (!options.mipmaps) return prepared;
+
+        Source source;
+        source.bytes  = prepared.levels[0].getData();
+        source.width  = width;
+        source.height = height;
+
+        Vector<Texel> previous, texels;
+
+        while (source.width > 1 || source.height > 1) {
+            Level next;
+            next.width  = std::max(source.width  / 2, 1);
+            next.height = std::max(source.height / 2, 1);
+            next.storage.resize((size_t) next.width * next.height * channels);
+
+            Taps columns = buildTaps(source.width , next.width , options.filter);
+            Taps rows    = buildTaps(source.height, next.height, options.filter);
+
+            texels.resize((size_t) next.width * next.height);
+
+            forRows(next.height, (int64) source.width * rows.count, [&](int32 begin, int32 end) {
+                Vector<Texel> column (source.width);
+                Vector<Texel> decoded(source.bytes ? source.width : 0);
+
+                for (int32 y = begin; y < end; y++) {
+                    Texel* row = texels.data() + (int64) y * next.width;
+
+                    filterRow(encoding, source, columns, rows, y, next.width, column.data(), decoded.data(), row);
+                    encodeRow(encoding, row, next.width, next.storage.data() + (int64) y * next.width * channels);
+                }
+            });
+
+            // every level is filtered from the unquantized one above it
+            previous.swap(texels);
+
+            source.bytes  = nullptr;
+            source.texels = previous.data();
+            source.width  = next.width;
+            source.height = next.height;
+
+            prepared.levels.push_back(std::move(next));
+        }
+
+        return prepared;
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Core/Aliases.h>
+#include <Core/Renderer/Texture.h>
+
+#include <glad/glad.h>
+
+namespace PetrolEngine {
+    class Image;
+
+    // Turns an image into the levels of a 2D texture in exactly the layout of their GL format, so the
+    // upload is a plain copy and the driver neither converts nor generates mipmaps on the render thread.
+    // prepare makes no GL calls, OpenGLResourceLoader runs it on its thread. OpenGLTexture(const Image&)
+    // is mostly constructed on the render thread, it prepares level 0 only and leaves the rest to glGenerateMipmap.
+    //
+    // 8 bit images with two to four components become RGBA8 (grey and alpha as grey, grey, grey, alpha,
+    // RGB with an opaque alpha), are swizzled and optionally premultiplied. One component images stay RED.
+    // The mip chain is filtered down to 1x1 with a box (2 texels wide, 3 along odd sizes so the last row
+    // or column is not dropped) or a separable Kaiser windowed sinc (wraps around the edges like the
+    // repeating samplers), in linear space when the color is sRGB encoded, four channels at a time with
+    // SSE where the build targets it. Rows of large levels are split across threads.
+    //
+    // Other images (16 bit) are uploaded as they are and left to glGenerateMipmap.
+    class OpenGLTexturePreprocessor {
+    public:
+        enum class Filter { Box, Kaiser };
+
+        struct Options {
+            bool   srgb        = false; // color is sRGB encoded, sampled through GL_SRGB8_ALPHA8
+            bool   premultiply = false; // color multiplied by alpha, in linear space
+            bool   mipmaps     = true;
+            Filter filter      = Filter::Box;
+            uint8  swizzle[4]  = { 0, 1, 2, 3 }; // expanded RGBA component every channel is read from
+        };
+
+        struct Level {
+            int32         width    = 0;
+            int32         height   = 0;
+            const uint8*  external = nullptr; // the image's data when level 0 is uploaded as it is
+            Vector<uint8> storage;
+
+            const uint8* getData() const { return storage.empty() ? external : storage.data(); }
+        };
+
+        struct Prepared {
+            TextureFormat format         = TextureFormat::NONE; // NONE when there is nothing to upload
+            GLenum        internalFormat = 0;
+            GLenum        dataFormat     = 0;
+            GLenum        dataType       = GL_UNSIGNED_BYTE;
+            int32         texelBytes     = 0;
+            bool          complete       = false; // every level is here, otherwise only level 0
+
+            Vector<Level> levels;
+        };
+
+        // used by OpenGLTexture(const Image&), set before textures are loaded
+        static Options defaults;
+
+        // threads prepare may use including the calling one, levels of fewer than 64k texels are not split
+        static uint32 threadCount;
+
+        // the image has to outlive the result when level 0 points at its data
+        static Prepared prepare(const Image& image) { return prepare(image, defaults); }
+        static Prepared prepare(const Image& image, const Options& options);
+    };
+}
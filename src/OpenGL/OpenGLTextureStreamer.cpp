@@ -0,0 +1,306 @@
+#include <PCH.h>
+
+#include "OpenGLTextureStreamer.h"
+#include "OpenGLTexture.h"
+#include "OpenGLMemory.h"
+
+#include <Core/Image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace PetrolEngine {
+    // box footprint of output x along one axis, even sizes average pairs and odd ones (from = 2 * to + 1)
+    // weight three texels by how much of each the from / to wide footprint covers, so no texel is dropped
+    static int32 boxTaps(int32 from, int32 to, int32 x, int32* index, float* weight) {
+        if (from % 2 == 0 || from == 1) {
+            index[0] = std::min(x * 2    , from - 1); weight[0] = 0.5f;
+            index[1] = std::min(x * 2 + 1, from - 1); weight[1] = 0.5f;
+            return 2;
+        }
+
+        index[0] = x * 2    ; weight[0] = (float) (to - x) / from;
+        index[1] = x * 2 + 1; weight[1] = (float)  to      / from;
+        index[2] = x * 2 + 2; weight[2] = (float) (x + 1)  / from;
+        return 3;
+    }
+
+    template<typename Channel>
+    static void downsample(const uint8* source, int32 width, int32 height, uint8* destination, int32 components) {
+        auto* from = (const Channel*) source;
+        auto* to   = (      Channel*) destination;
+
+        int32 nextWidth  = std::max(width  / 2, 1);
+        int32 nextHeight = std::max(height / 2, 1);
+
+        int32 rows[3], columns[3];
+        float rowWeights[3], columnWeights[3];
+
+        for (int32 y = 0; y < nextHeight; y++) {
+            int32 rowCount = boxTaps(height, nextHeight, y, rows, rowWeights);
+
+            for (int32 x = 0; x < nextWidth; x++) {
+                int32 columnCount = boxTaps(width, nextWidth, x, columns, columnWeights);
+
+                for (int32 c = 0; c < components; c++) {
+                    float sum = 0.f;
+
+                    for (int32 j = 0; j < rowCount; j++) for (int32 i = 0; i < columnCount; i++)
+                        sum += rowWeights[j] * columnWeights[i] * from[((int64) rows[j] * width + columns[i]) * components + c];
+
+                    to[(y * nextWidth + x) * components + c] = (Channel) (sum + 0.5f);
+                }
+            }
+        }
+    }
+
+    OpenGLTextureStreamer::OpenGLTextureStreamer(int64 budget): budget(budget) {}
+
+    OpenGLTextureStreamer::~OpenGLTextureStreamer() { LOG_FUNCTION();
+        for (auto& it : textures) delete it.second.texture;
+    }
+
+    OpenGLTexture* OpenGLTextureStreamer::create(const Image& image) { LOG_FUNCTION();
+        if (!image.getData()) { LOG("Streamed texture failed to load.", 2); return nullptr; }
+
+        TextureFormat textureFormat = Texture::getFormat(image);
+
+        if (textureFormat == TextureFormat::NONE || textureFormat == TextureFormat::DEPTH24STENCIL8) {
+            LOG("Texture format can not be streamed.", 2);
+            return nullptr;
+        }
+
+        // no storage yet, levels are defined one by one below
+        auto* texture = new OpenGLTexture(0, 0, textureFormat);
+        texture->width  = image.getWidth ();
+        texture->height = image.getHeight();
+
+        auto GLFormat = texture->textureFormatLookupTable.at(textureFormat);
+
+        Streamed streamed;
+        streamed.texture        = texture;
+        streamed.format         = GLFormat.first;
+        streamed.internalFormat = GLFormat.second;
+        streamed.type           = image.getBitsPerChannel() == 16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+
+        int32 components   = image.getComponentsNumber();
+        int32 channelBytes = image.getBitsPerChannel() == 16 ? 2 : 1;
+        int32 texelBytes   = components * channelBytes;
+
+        // the whole chain is built once on the CPU, level 0 is a copy of the image
+        Level base;
+        base.width  = texture->width;
+        base.height = texture->height;
+        base.data.assign(image.getData(), image.getData() + (int64) base.width * base.height * texelBytes);
+
+        streamed.levels.push_back(std::move(base));
+
+        while (streamed.levels.back().width > 1 || streamed.levels.back().height > 1) {
+            const Level& previous = streamed.levels.back();
+
+            Level next;
+            next.width  = std::max(previous.width  / 2, 1);
+            next.height = std::max(previous.height / 2, 1);
+            next.data.resize((size_t) next.width * next.height * texelBytes);
+
+            if (channelBytes == 2) downsample<uint16_t>(previous.data.data(), previous.width, previous.height, next.data.data(), components);
+            else                   downsample<uint8   >(previous.data.data(), previous.width, previous.height, next.data.data(), components);
+
+            streamed.levels.push_back(std::move(next));
+        }
+
+        uint32 count = (uint32) streamed.levels.size();
+
+        streamed.lastNeeded.assign(count, 0);
+        streamed.resident = count;
+        streamed.wanted   = count - 1;
+
+        glBindTexture(GL_TEXTURE_2D, texture->getID());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) count - 1);
+
+        Streamed& entry = textures[texture->getID()] = std::move(streamed);
+
+        // the small tail is always resident, it is what is sampled until finer levels arrive
+        for (int32 level = (int32) count - 1; level >= 0; level--) {
+            if (std::max(entry.levels[level].width, entry.levels[level].height) > (int32) residentSize) break;
+
+            load(entry, (uint32) level);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        statistics.textures      = (uint32) textures.size();
+        statistics.residentBytes = residentBytes;
+
+        return texture;
+    }
+
+    void OpenGLTextureStreamer::destroy(const Texture* texture) { LOG_FUNCTION();
+        auto entry = textures.find(texture->getID());
+        if (entry == textures.end()) return;
+
+        for (uint32 level = entry->second.resident; level < entry->second.levels.size(); level++)
+            residentBytes -= (int64) entry->second.levels[level].data.size();
+
+        delete entry->second.texture;
+        textures.erase(entry);
+
+        statistics.textures      = (uint32) textures.size();
+        statistics.residentBytes = residentBytes;
+    }
+
+    int64 OpenGLTextureStreamer::getResidentBytes(const Streamed& streamed) {
+        int64 bytes = 0;
+
+        for (uint32 level = streamed.resident; level < streamed.levels.size(); level++)
+            bytes += (int64) streamed.levels[level].data.size();
+
+        return bytes;
+    }
+
+    uint32 OpenGLTextureStreamer::levelFor(const Streamed& streamed, float pixels) {
+        float size = (float) std::max(streamed.levels[0].width, streamed.levels[0].height);
+
+        if (pixels >= size) return 0;
+
+        float level = std::floor(std::log2(size / std::max(pixels, 1.f)));
+
+        return std::min((uint32) level, (uint32) streamed.levels.size() - 1);
+    }
+
+    void OpenGLTextureStreamer::request(const Texture* texture, float pixels) {
+        auto entry = textures.find(texture->getID());
+        if (entry == textures.end()) return;
+
+        Streamed& streamed = entry->second;
+        uint32    level    = levelFor(streamed, pixels);
+
+        streamed.wanted = std::min(streamed.wanted, level);
+
+        for (uint32 it = level; it < streamed.levels.size() && streamed.lastNeeded[it] != frame + 1; it++)
+            streamed.lastNeeded[it] = frame + 1;
+    }
+
+    int32 OpenGLTextureStreamer::getResidentLevel(const Texture* texture) const {
+        auto entry = textures.find(texture->getID());
+
+        return entry == textures.end() ? -1 : (int32) entry->second.resident;
+    }
+
+    void OpenGLTextureStreamer::load(Streamed& streamed, uint32 level) {
+        const Level& data = streamed.levels[level];
+
+        // rows of RGB and RED levels are not 4 byte aligned
+        GLint alignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        glBindTexture(GL_TEXTURE_2D, streamed.texture->getID());
+        glTexImage2D (GL_TEXTURE_2D, (GLint) level, (GLint) streamed.internalFormat, data.width, data.height, 0, streamed.format, streamed.type, data.data.data());
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+        streamed.resident = level;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint) level);
+
+        residentBytes += (int64) data.data.size();
+
+        OpenGLMemory::resize(GL_TEXTURE, streamed.texture->getID(), getResidentBytes(streamed));
+
+        statistics.loadedLevels  += 1;
+        statistics.uploadedBytes += (int64) data.data.size();
+    }
+
+    void OpenGLTextureStreamer::evict(Streamed& streamed) {
+        uint32 level = streamed.resident;
+
+        // hidden before it is dropped, the texture stays complete from the new base level
+        streamed.resident = level + 1;
+
+        glBindTexture(GL_TEXTURE_2D, streamed.texture->getID());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint) streamed.resident);
+        glTexImage2D   (GL_TEXTURE_2D, (GLint) level, (GLint) streamed.internalFormat, 0, 0, 0, streamed.format, streamed.type, nullptr);
+
+        residentBytes -= (int64) streamed.levels[level].data.size();
+
+        OpenGLMemory::resize(GL_TEXTURE, streamed.texture->getID(), getResidentBytes(streamed));
+
+        statistics.evictedLevels++;
+    }
+
+    bool OpenGLTextureStreamer::makeRoom(int64 bytes, const Streamed* loading) {
+        while (residentBytes + bytes > budget) {
+            Streamed* victim = nullptr;
+
+            for (auto& it : textures) {
+                Streamed& candidate = it.second;
+
+                if (&candidate == loading) continue;
+
+                uint32 level = candidate.resident;
+                if (level >= candidate.levels.size()) continue;
+
+                // the always resident tail stays, and so does whatever this frame needs
+                if (std::max(candidate.levels[level].width, candidate.levels[level].height) <= (int32) residentSize) continue;
+                if (candidate.lastNeeded[level] == frame) continue;
+
+                if (victim == nullptr || candidate.lastNeeded[level] < victim->lastNeeded[victim->resident]) victim = &candidate;
+            }
+
+            if (victim == nullptr) return false;
+
+            evict(*victim);
+        }
+
+        return true;
+    }
+
+    void OpenGLTextureStreamer::update() { LOG_FUNCTION();
+        // requests made since the last update belong to this frame
+        frame++;
+
+        statistics.uploadedBytes = 0;
+        statistics.loadedLevels  = 0;
+        statistics.evictedLevels = 0;
+        statistics.postponed     = 0;
+
+        // coarse to fine over all textures, so a budget that runs out leaves every texture a bit sharper
+        // instead of a few of them fully resident
+        uint32 coarsest = 0;
+        for (auto& it : textures) coarsest = std::max(coarsest, (uint32) it.second.levels.size());
+
+        bool uploadsLeft = true;
+
+        for (int32 level = (int32) coarsest - 1; level >= 0 && uploadsLeft; level--) {
+            for (auto& it : textures) {
+                Streamed& streamed = it.second;
+
+                if (streamed.wanted > (uint32) level || streamed.resident != (uint32) level + 1) continue;
+
+                int64 size = (int64) streamed.levels[level].data.size();
+
+                if (statistics.uploadedBytes + size > uploadBudget && statistics.uploadedBytes > 0) {
+                    uploadsLeft = false;
+                    break;
+                }
+
+                if (!makeRoom(size, &streamed)) {
+                    statistics.postponed++;
+                    continue;
+                }
+
+                load(streamed, (uint32) level);
+            }
+        }
+
+        // a lowered budget is enforced even without loads
+        makeRoom(0, nullptr);
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        for (auto& it : textures) it.second.wanted = (uint32) it.second.levels.size() - 1;
+
+        statistics.residentBytes = residentBytes;
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <Core/Aliases.h>
+
+#include <glad/glad.h>
+
+namespace PetrolEngine {
+    class Image;
+    class Texture;
+    class OpenGLTexture;
+
+    // Mip streaming of 2D textures against a GPU memory budget.
+    //
+    // Textures created here keep their mip chain on the CPU and start with only the levels of at most
+    // residentSize texels resident. Draws report how many pixels a texture covers on screen (the
+    // renderer does it from the projected bounds of the mesh), update() then uploads the finer levels
+    // that are needed, coarse to fine and at most uploadBudget bytes per frame, and evicts the finest
+    // level of the textures needed least recently while the resident size is over the budget. Levels
+    // needed by the current frame are never evicted, loads that do not fit are postponed instead.
+    //
+    // Non-resident levels are hidden with GL_TEXTURE_BASE_LEVEL, evicted levels are redefined empty so
+    // the driver frees them, which needs mutable storage (glTexImage2D, not glTexStorage2D).
+    class OpenGLTextureStreamer {
+    public:
+        static constexpr uint32 residentSize = 64;
+
+        explicit OpenGLTextureStreamer(int64 budget = 512ll << 20);
+        ~OpenGLTextureStreamer();
+
+        void setBudget      (int64 bytes) { budget       = bytes; }
+        void setUploadBudget(int64 bytes) { uploadBudget = bytes; }
+
+        // nullptr for images without data or in formats that are not streamed (depth, NONE)
+        OpenGLTexture* create (const Image& image);
+        void           destroy(const Texture* texture);
+
+        // usage feedback for the current frame, textures that were not created here are ignored
+        void request(const Texture* texture, float pixels);
+
+        // once per frame, before the draws are submitted
+        void update();
+
+        struct Statistics {
+            uint32 textures      = 0;
+            int64  residentBytes = 0;
+            int64  uploadedBytes = 0; // by the last update
+            uint32 loadedLevels  = 0; // by the last update
+            uint32 evictedLevels = 0; // by the last update
+            uint32 postponed     = 0; // levels that did not fit in the last update
+        };
+
+        const Statistics& getStatistics() const { return statistics; }
+
+        // finest resident level, -1 for textures not created here
+        int32 getResidentLevel(const Texture* texture) const;
+
+    private:
+        struct Level {
+            int32         width;
+            int32         height;
+            Vector<uint8> data;
+        };
+
+        struct Streamed {
+            OpenGLTexture* texture;
+            GLenum         internalFormat;
+            GLenum         format;
+            GLenum         type;
+
+            Vector<Level>  levels;
+            Vector<uint64> lastNeeded; // frame every level was last requested in
+
+            uint32 resident; // finest resident level, levels below it are empty
+            uint32 wanted;   // finest level requested this frame
+        };
+
+        static uint32 levelFor        (const Streamed& streamed, float pixels);
+        static int64  getResidentBytes(const Streamed& streamed);
+
+        void load (Streamed& streamed, uint32 level);
+        void evict(Streamed& streamed);
+        bool makeRoom(int64 bytes, const Streamed* loading);
+
+        UnorderedMap<GLuint, Streamed> textures;
+
+        int64  budget;
+        int64  uploadBudget = 16ll << 20;
+        int64  residentBytes = 0;
+        uint64 frame = 0;
+
+        Statistics statistics;
+    };
+}
@@ -0,0 +1,266 @@
+#include <PCH.h>
+
+#include <glad/glad.h>
+
+#include "OpenGLTracer.h"
+#include "OpenGLCapabilities.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+namespace PetrolEngine {
+    std::atomic<bool> OpenGLTracer::enabled { false };
+    std::atomic<bool> OpenGLTracer::tracking{ false };
+
+    struct TraceEvent {
+        const char* name     = nullptr;
+        int64       begin    = 0; // nanoseconds since the tracer started
+        int64       duration = 0;
+        uint32      thread   = 0;
+    };
+
+    // GPU scopes share one timeline row
+    static constexpr uint32 gpuThread = 0;
+
+    static Vector<TraceEvent>  events;
+    static std::atomic<uint64> eventCount{ 0 };
+
+    static std::atomic<uint32> nextThread{ 1 };
+    static thread_local uint32 threadId = 0;
+
+    static thread_local const char* currentScope = nullptr;
+
+    static std::thread::id glThread;
+    static uint32          glThreadId    = 0;
+    static bool            gpuTimestamps = false;
+
+    struct GpuScope {
+        const char* name;
+        uint32 begin, end; // query indices
+        bool   ended    = false;
+        bool   resolved = false;
+    };
+
+    struct TraceFrame {
+        Vector<GLuint>   queries;
+        Vector<GpuScope> scopes;
+        uint32 usedQueries = 0;
+        int64  offset      = 0; // CPU minus GPU clock in nanoseconds
+    };
+
+    static TraceFrame frames[OpenGLTracer::framesInFlight];
+    static uint32     currentFrame = 0;
+
+    static int64 now() {
+        static const auto epoch = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    static uint32 currentThread() {
+        if (threadId == 0) threadId = nextThread.fetch_add(1, std::memory_order_relaxed);
+        return threadId;
+    }
+
+    static void push(const char* name, int64 begin, int64 end, uint32 thread) {
+        uint64 slot = eventCount.fetch_add(1, std::memory_order_relaxed);
+        events[slot % OpenGLTracer::capacity] = { name, begin, end - begin, thread };
+    }
+
+    // the timestamp is taken when the query reaches the GPU, halfway through the call is the
+    // best guess of the matching CPU time
+    static void calibrate(TraceFrame& frame) {
+        GLint64 gpuTime;
+
+        int64 before = now();
+        glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+        int64 after  = now();
+
+        frame.offset = (before + after) / 2 - (int64) gpuTime;
+    }
+
+    static int32 beginGpuScope(const char* name) {
+        TraceFrame& frame = frames[currentFrame];
+
+        if (frame.scopes.size() >= OpenGLTracer::maxGpuScopes) return -1;
+
+        if (frame.usedQueries + 2 > frame.queries.size()) {
+            uint32 oldSize = (uint32) frame.queries.size();
+            uint32 newSize = std::max<uint32>(64, oldSize * 2);
+
+            frame.queries.resize(newSize);
+            glGenQueries((GLsizei) (newSize - oldSize), frame.queries.data() + oldSize);
+        }
+
+        GpuScope scope{ name, frame.usedQueries, frame.usedQueries + 1 };
+        frame.usedQueries += 2;
+
+        glQueryCounter(frame.queries[scope.begin], GL_TIMESTAMP);
+
+        frame.scopes.push_back(scope);
+        return (int32) frame.scopes.size() - 1;
+    }
+
+    // with wait it stalls for the timestamps when the GPU is more than framesInFlight behind, otherwise
+    // scopes whose timestamps are not there yet are left for the next time. Open scopes hold their index,
+    // so the scopes are only cleared once every one of them is resolved.
+    static void resolve(TraceFrame& frame, bool wait) {
+        bool finished = true;
+
+        for (auto& scope : frame.scopes) {
+            if (scope.resolved) continue;
+            if (!scope.ended  ) { finished = false; continue; }
+
+            if (!wait) {
+                GLuint beginAvailable, endAvailable;
+                glGetQueryObjectuiv(frame.queries[scope.begin], GL_QUERY_RESULT_AVAILABLE, &beginAvailable);
+                glGetQueryObjectuiv(frame.queries[scope.end  ], GL_QUERY_RESULT_AVAILABLE, &endAvailable  );
+
+                if (!beginAvailable || !endAvailable) { finished = false; continue; }
+            }
+
+            GLuint64 begin, end;
+            glGetQueryObjectui64v(frame.queries[scope.begin], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.queries[scope.end  ], GL_QUERY_RESULT, &end  );
+
+            push(scope.name, (int64) begin + frame.offset, (int64) end + frame.offset, gpuThread);
+            scope.resolved = true;
+        }
+
+        if (!finished) return;
+
+        frame.scopes.clear();
+        frame.usedQueries = 0;
+    }
+
+    OpenGLTracer::Scope::Scope(const char* name) : name(name) {
+        if (tracking.load(std::memory_order_relaxed)) {
+            tracked      = true;
+            parent       = currentScope;
+            currentScope = name;
+        }
+
+        if (!OpenGLTracer::isEnabled()) return;
+
+        enabled = true;
+
+        if (gpuTimestamps && std::this_thread::get_id() == glThread) {
+            frame = currentFrame;
+            gpu   = beginGpuScope(name);
+        }
+
+        begin = now();
+    }
+
+    OpenGLTracer::Scope::~Scope() {
+        if (tracked) currentScope = parent;
+
+        if (!enabled) return;
+
+        push(name, begin, now(), currentThread());
+
+        if (gpu < 0) return;
+
+        GpuScope& scope = frames[frame].scopes[gpu];
+
+        glQueryCounter(frames[frame].queries[scope.end], GL_TIMESTAMP);
+        scope.ended = true;
+    }
+
+    void OpenGLTracer::enable(bool gpu) { LOG_FUNCTION();
+        if (isEnabled()) return;
+
+        if (events.empty()) events.resize(capacity);
+
+        glThread      = std::this_thread::get_id();
+        glThreadId    = currentThread();
+        gpuTimestamps = gpu && OpenGLCapabilities::get().timerQueries;
+
+        if (gpu && !gpuTimestamps) LOG("Timer queries are not supported, tracing CPU scopes only.", 1);
+
+        if (gpuTimestamps) calibrate(frames[currentFrame]);
+
+        enabled.store(true, std::memory_order_relaxed);
+    }
+
+    void OpenGLTracer::disable() { LOG_FUNCTION();
+        enabled.store(false, std::memory_order_relaxed);
+
+        if (gpuTimestamps) for (auto& frame : frames) resolve(frame, true);
+    }
+
+    void OpenGLTracer::trackScopes(bool track) {
+        tracking.store(track, std::memory_order_relaxed);
+    }
+
+    const char* OpenGLTracer::getCurrentScope() {
+        return currentScope;
+    }
+
+    void OpenGLTracer::frameBoundary() {
+        if (!isEnabled() || !gpuTimestamps) return;
+
+        currentFrame = (currentFrame + 1) % framesInFlight;
+
+        resolve  (frames[currentFrame], true);
+        calibrate(frames[currentFrame]);
+    }
+
+    static void writeEscaped(std::ofstream& file, const char* text) {
+        for (; *text; text++) {
+            if (*text == '"' || *text == '\\') file << '\\';
+            file << *text;
+        }
+    }
+
+    static void writeThreadName(std::ofstream& file, uint32 thread, const String& name) {
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":\"" << name << "\"}}";
+    }
+
+    bool OpenGLTracer::exportChromeTrace(const String& path) { LOG_FUNCTION();
+        // timestamps that are already there are picked up without waiting for the GPU
+        if (gpuTimestamps && std::this_thread::get_id() == glThread) {
+            for (uint32 i = 1; i <= framesInFlight; i++) resolve(frames[(currentFrame + i) % framesInFlight], false);
+        }
+
+        std::ofstream file(path, std::ios::out);
+
+        if (!file) {
+            LOG("Trace file " + path + " can not be opened.", 2);
+            return false;
+        }
+
+        file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+        writeThreadName(file, gpuThread, "GPU");
+
+        for (uint32 thread = 1; thread < nextThread.load(); thread++) {
+            file << ",\n";
+            writeThreadName(file, thread, thread == glThreadId ? String("GL thread") : "Thread " + toString(thread));
+        }
+
+        uint64 count = eventCount.load();
+        uint64 first = count > capacity ? count - capacity : 0;
+
+        char timing[64];
+
+        for (uint64 i = first; i < count && !events.empty(); i++) {
+            const TraceEvent& event = events[i % capacity];
+            if (event.name == nullptr) continue;
+
+            // microseconds with nanosecond precision
+            std::snprintf(timing, sizeof(timing), "\"ts\":%.3f,\"dur\":%.3f", (double) event.begin / 1000.0, (double) event.duration / 1000.0);
+
+            file << ",\n{\"name\":\"";
+            writeEscaped(file, event.name);
+            file << "\",\"cat\":\"" << (event.thread == gpuThread ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << "," << timing << "}";
+        }
+
+        file << "\n]}\n";
+
+        LOG("Exported " + toString(count - first) + " trace events to " + path + ".", 1);
+        return (bool) file;
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Core/Aliases.h>
+#include <Core/DebugTools.h>
+
+#include <atomic>
+
+// LOG_FUNCTION / LOG_SCOPE that also show up on the trace timeline, on the GL thread they are
+// timed on the GPU as well
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b)  TRACE_CONCAT_(a, b)
+
+#define TRACE_FUNCTION()  LOG_FUNCTION(); PetrolEngine::OpenGLTracer::Scope TRACE_CONCAT(traceScope, __LINE__)(__FUNCTION__)
+#define TRACE_SCOPE(name) LOG_SCOPE(name); PetrolEngine::OpenGLTracer::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+namespace PetrolEngine {
+    // Ring buffer of timed scopes for a combined CPU/GPU timeline in Chrome trace format
+    // (chrome://tracing, ui.perfetto.dev).
+    // CPU scopes are stamped with steady clock nanoseconds and the id of their thread. Scopes on
+    // the thread that enabled tracing also write GL_TIMESTAMP queries, which are read back a few
+    // frames later and moved onto the CPU clock with the offset between glGetInteger64v(GL_TIMESTAMP)
+    // and the CPU clock measured at the start of their frame. While disabled a scope costs a load.
+    class OpenGLTracer {
+    public:
+        static constexpr uint32 capacity       = 1 << 16; // events kept, older ones are overwritten
+        static constexpr uint32 framesInFlight = 3;       // frames GPU timestamps are read back after
+        static constexpr uint32 maxGpuScopes   = 4096;    // per frame, further scopes are CPU only
+
+        class Scope {
+        public:
+            Scope(const char* name);
+            ~Scope();
+
+        private:
+            const char* name;
+            const char* parent = nullptr; // scope that was current before this one
+            int64  begin   = 0;
+            uint32 frame   = 0;  // frame and index of the GPU scope, -1 without one
+            int32  gpu     = -1;
+            bool   enabled = false;
+            bool   tracked = false;
+        };
+
+        // has to be called on the GL thread
+        static void enable (bool gpuTimestamps = true);
+        static void disable();
+        static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+        // innermost scope of the calling thread while scope tracking is on (debug output attributes
+        // driver messages to it), nullptr outside of any scope
+        static void        trackScopes(bool track);
+        static const char* getCurrentScope();
+
+        // called by the renderer once the frame's work is submitted
+        static void frameBoundary();
+
+        // writes every event in the ring, GPU scopes of the last frames whose timestamps are already
+        // available included, it does not wait for the GPU
+        static bool exportChromeTrace(const String& path);
+
+    private:
+        static std::atomic<bool> enabled;
+        static std::atomic<bool> tracking;
+    };
+}
@@ -0,0 +1,308 @@
+#include <PCH.h>
+
+#include "OpenGLTransformCache.h"
+#include "OpenGLTracer.h"
+
+#include <algorithm>
+
+#if defined(__AVX__)
+    #include <immintrin.h>
+    #define OPENGL_TRANSFORMS_AVX
+#elif defined(__SSE__) || defined(_M_X64) || defined(_M_IX86)
+    #include <xmmintrin.h>
+    #define OPENGL_TRANSFORMS_SSE
+#endif
+
+namespace PetrolEngine {
+    static constexpr uint32 blockLanes = 8;
+    static constexpr uint32 maxDepth   = 256;
+
+    // levels are split across threads only when every thread gets at least this many blocks
+    static constexpr uint32 minBlocksPerThread = 128;
+
+#if defined(OPENGL_TRANSFORMS_AVX)
+    typedef __m256 Wide;
+    static constexpr uint32 wideLanes = 8;
+
+    static inline Wide wideLoad (const float* from)        { return _mm256_load_ps(from);    }
+    static inline void wideStore(float* to, Wide value)    { _mm256_store_ps(to, value);     }
+    static inline Wide wideSet  (float value)              { return _mm256_set1_ps(value);   }
+    static inline Wide wideAdd  (Wide a, Wide b)           { return _mm256_add_ps(a, b);     }
+    static inline Wide wideSub  (Wide a, Wide b)           { return _mm256_sub_ps(a, b);     }
+    static inline Wide wideMul  (Wide a, Wide b)           { return _mm256_mul_ps(a, b);     }
+#elif defined(OPENGL_TRANSFORMS_SSE)
+    typedef __m128 Wide;
+    static constexpr uint32 wideLanes = 4;
+
+    static inline Wide wideLoad (const float* from)        { return _mm_load_ps(from);       }
+    static inline void wideStore(float* to, Wide value)    { _mm_store_ps(to, value);        }
+    static inline Wide wideSet  (float value)              { return _mm_set1_ps(value);      }
+    static inline Wide wideAdd  (Wide a, Wide b)           { return _mm_add_ps(a, b);        }
+    static inline Wide wideSub  (Wide a, Wide b)           { return _mm_sub_ps(a, b);        }
+    static inline Wide wideMul  (Wide a, Wide b)           { return _mm_mul_ps(a, b);        }
+#else
+    typedef float Wide;
+    static constexpr uint32 wideLanes = 1;
+
+    static inline Wide wideLoad (const float* from)        { return *from;  }
+    static inline void wideStore(float* to, Wide value)    { *to = value;   }
+    static inline Wide wideSet  (float value)              { return value;  }
+    static inline Wide wideAdd  (Wide a, Wide b)           { return a + b;  }
+    static inline Wide wideSub  (Wide a, Wide b)           { return a - b;  }
+    static inline Wide wideMul  (Wide a, Wide b)           { return a * b;  }
+#endif
+
+    // eight nodes of one level, every matrix element and input component is an array of lanes
+    struct TransformBlock {
+        alignas(32) float parent  [16][blockLanes]; // column major, element column * 4 + row
+        alignas(32) float world   [16][blockLanes];
+        alignas(32) float position[ 3][blockLanes];
+        alignas(32) float rotation[ 4][blockLanes];
+        alignas(32) float scale   [ 3][blockLanes];
+    };
+
+    static void computeBlock(TransformBlock& block) {
+        Wide one = wideSet(1.f);
+        Wide two = wideSet(2.f);
+
+        for (uint32 lane = 0; lane < blockLanes; lane += wideLanes) {
+            Wide x = wideLoad(block.rotation[0] + lane);
+            Wide y = wideLoad(block.rotation[1] + lane);
+            Wide z = wideLoad(block.rotation[2] + lane);
+            Wide w = wideLoad(block.rotation[3] + lane);
+
+            Wide xx = wideMul(x, x), yy = wideMul(y, y), zz = wideMul(z, z);
+            Wide xy = wideMul(x, y), xz = wideMul(x, z), yz = wideMul(y, z);
+            Wide wx = wideMul(w, x), wy = wideMul(w, y), wz = wideMul(w, z);
+
+            Wide sx = wideLoad(block.scale[0] + lane);
+            Wide sy = wideLoad(block.scale[1] + lane);
+            Wide sz = wideLoad(block.scale[2] + lane);
+
+            // first three rows of the local columns, rotation times scale and the translation
+            Wide local[4][3] = {
+                { wideMul(wideSub(one, wideMul(two, wideAdd(yy, zz))), sx), wideMul(wideMul(two, wideAdd(xy, wz)), sx), wideMul(wideMul(two, wideSub(xz, wy)), sx) },
+                { wideMul(wideMul(two, wideSub(xy, wz)), sy), wideMul(wideSub(one, wideMul(two, wideAdd(xx, zz))), sy), wideMul(wideMul(two, wideAdd(yz, wx)), sy) },
+                { wideMul(wideMul(two, wideAdd(xz, wy)), sz), wideMul(wideMul(two, wideSub(yz, wx)), sz), wideMul(wideSub(one, wideMul(two, wideAdd(xx, yy))), sz) },
+                { wideLoad(block.position[0] + lane), wideLoad(block.position[1] + lane), wideLoad(block.position[2] + lane) },
+            };
+
+            for (uint32 row = 0; row < 4; row++) {
+                Wide p0 = wideLoad(block.parent[ 0 + row] + lane);
+                Wide p1 = wideLoad(block.parent[ 4 + row] + lane);
+                Wide p2 = wideLoad(block.parent[ 8 + row] + lane);
+                Wide p3 = wideLoad(block.parent[12 + row] + lane);
+
+                for (uint32 column = 0; column < 4; column++) {
+                    Wide value = wideAdd(wideAdd(wideMul(p0, local[column][0]), wideMul(p1, local[column][1])), wideMul(p2, local[column][2]));
+
+                    // the local w row is 0, 0, 0, 1
+                    if (column == 3) value = wideAdd(value, p3);
+
+                    wideStore(block.world[column * 4 + row] + lane, value);
+                }
+            }
+        }
+    }
+
+    OpenGLTransformCache::~OpenGLTransformCache() {
+        delete workers;
+    }
+
+    void OpenGLTransformCache::setThreadCount(uint32 count) {
+        threadCount = count ? count : 1;
+
+        if (workers && workers->getThreadCount() != threadCount) {
+            delete workers;
+            workers = nullptr;
+        }
+    }
+
+    bool OpenGLTransformCache::sameInputs(const Node& node, const Transform& transform) {
+        return node.position == glm::vec3(transform.position)
+            && node.scale    == glm::vec3(transform.scale   )
+            && node.rotation == glm::vec4(transform.rotation.x, transform.rotation.y, transform.rotation.z, transform.rotation.w);
+    }
+
+    uint32 OpenGLTransformCache::allocate() {
+        if (!freeNodes.empty()) {
+            uint32 index = freeNodes.back();
+            freeNodes.pop_back();
+
+            nodes[index] = {};
+            return index;
+        }
+
+        nodes .emplace_back();
+        worlds.emplace_back(1.f);
+
+        return (uint32) nodes.size() - 1;
+    }
+
+    uint32 OpenGLTransformCache::add(const Transform* transform) {
+        added++;
+
+        // up from the transform until a node already checked this frame with the same inputs,
+        // the parents of that one were checked with it
+        chain.clear();
+
+        uint32 parent = noNode;
+
+        for (const Transform* current = transform; current; current = current->parent) {
+            auto it = lookup.find(current);
+
+            if (it != lookup.end() && nodes[it->second].frame == frame && sameInputs(nodes[it->second], *current)) {
+                parent = it->second;
+                break;
+            }
+
+            if (chain.size() == maxDepth) {
+                LOG("Transform hierarchy deeper than " + toString(maxDepth) + " levels or cyclic, it is cut there.", 2);
+                break;
+            }
+
+            chain.push_back(current);
+        }
+
+        bool temporary = false;
+
+        for (size_t i = chain.size(); i-- > 0; )
+            parent = update(chain[i], parent, temporary);
+
+        return parent;
+    }
+
+    uint32 OpenGLTransformCache::update(const Transform* transform, uint32 parent, bool& temporary) {
+        auto it = lookup.find(transform);
+
+        // checked earlier this frame with other inputs: the address belongs to another transform now,
+        // that one and everything below it in the chain get nodes of their own
+        if (it != lookup.end() && nodes[it->second].frame == frame) temporary = true;
+
+        uint32 index;
+        bool   changed;
+
+        if (temporary) {
+            index = allocate();
+            temporaryNodes.push_back(index);
+            changed = true;
+        }
+        else if (it == lookup.end()) {
+            index = allocate();
+            nodes[index].transform = transform;
+            lookup[transform] = index;
+            changed = true;
+        }
+        else {
+            index = it->second;
+
+            const Node& node = nodes[index];
+            uint64 parentVersion = parent == noNode ? 0 : nodes[parent].version;
+
+            changed = node.version == 0 || node.parent != parent || node.parentVersion != parentVersion || !sameInputs(node, *transform);
+        }
+
+        Node& node = nodes[index];
+        node.frame = frame;
+
+        if (!changed) return index;
+
+        node.parent        = parent;
+        node.parentVersion = parent == noNode ? 0 : nodes[parent].version;
+        node.depth         = parent == noNode ? 0 : nodes[parent].depth + 1;
+        node.version       = nextVersion++;
+        node.position      = transform->position;
+        node.rotation      = { transform->rotation.x, transform->rotation.y, transform->rotation.z, transform->rotation.w };
+        node.scale         = transform->scale;
+
+        if (levels.size() <= node.depth) levels.resize(node.depth + 1);
+        levels[node.depth].push_back(index);
+
+        return index;
+    }
+
+    void OpenGLTransformCache::resolve() { TRACE_FUNCTION();
+        statistics.computed = 0;
+        statistics.levels   = 0;
+
+        Vector<TransformBlock> blocks;
+
+        for (uint32 depth = 0; depth < levels.size(); depth++) {
+            Vector<uint32>& level = levels[depth];
+            if (level.empty()) continue;
+
+            uint32 count = (uint32) level.size();
+            blocks.resize((count + blockLanes - 1) / blockLanes);
+
+            // parents are one level up and already final, every block is independent
+            auto computeBlocks = [this, &level, &blocks, count](uint32 first, uint32 last) {
+                for (uint32 b = first; b < last; b++) {
+                    TransformBlock& block = blocks[b];
+
+                    for (uint32 lane = 0; lane < blockLanes; lane++) {
+                        uint32 i = b * blockLanes + lane;
+
+                        // unused lanes compute the identity and are not written back
+                        const Node*      node   = i < count ? &nodes[level[i]] : nullptr;
+                        const glm::mat4  parent = node && node->parent != noNode ? worlds[node->parent] : glm::mat4(1.f);
+
+                        for (uint32 element = 0; element < 16; element++) block.parent[element][lane] = parent[element / 4][element % 4];
+
+                        for (uint32 c = 0; c < 3; c++) {
+                            block.position[c][lane] = node ? node->position[c] : 0.f;
+                            block.scale   [c][lane] = node ? node->scale   [c] : 1.f;
+                        }
+
+                        for (uint32 c = 0; c < 4; c++) block.rotation[c][lane] = node ? node->rotation[c] : (c == 3 ? 1.f : 0.f);
+                    }
+
+                    computeBlock(block);
+
+                    for (uint32 lane = 0; lane < blockLanes && b * blockLanes + lane < count; lane++) {
+                        glm::mat4& world = worlds[level[b * blockLanes + lane]];
+
+                        for (uint32 element = 0; element < 16; element++) world[element / 4][element % 4] = block.world[element][lane];
+                    }
+                }
+            };
+
+            uint32 blockCount = (uint32) blocks.size();
+            uint32 threads    = std::min(threadCount, blockCount / minBlocksPerThread);
+
+            if (threads > 1) {
+                if (workers == nullptr) workers = new OpenGLWorkerPool(threadCount);
+
+                uint32 perThread = (blockCount + threads - 1) / threads;
+
+                workers->run(threads, [&](uint32 t) { computeBlocks(std::min(t * perThread, blockCount), std::min((t + 1) * perThread, blockCount)); });
+            }
+            else computeBlocks(0, blockCount);
+
+            statistics.computed += count;
+            statistics.levels    = depth + 1;
+
+            level.clear();
+        }
+
+        // world matrices of temporaries stay where they are until the next resolve, the nodes can be reused right away
+        freeNodes.insert(freeNodes.end(), temporaryNodes.begin(), temporaryNodes.end());
+        temporaryNodes.clear();
+
+        frame++;
+
+        if (frame % 256 == 0) {
+            for (auto it = lookup.begin(); it != lookup.end(); ) {
+                if (frame - nodes[it->second].frame > 256) {
+                    freeNodes.push_back(it->second);
+                    it = lookup.erase(it);
+                }
+                else it++;
+            }
+        }
+
+        statistics.nodes = (uint32) lookup.size();
+        statistics.added = added;
+
+        added = 0;
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <Core/Aliases.h>
+#include <Core/Components/Transform.h>
+
+#include <glm/glm.hpp>
+
+#include "OpenGLWorkerPool.h"
+
+namespace PetrolEngine {
+    // World matrices of the transforms drawn in a frame, kept between frames.
+    //
+    // add reads the position, rotation, scale and parent of a transform and of its parents when the
+    // draw is recorded, a node whose inputs and parent did not change since it was last resolved keeps
+    // its world matrix. resolve computes the changed ones level by level, parents before children, eight
+    // at a time in structure of arrays blocks (AVX, SSE or scalar, whatever the build targets) and
+    // optionally on the threads of a worker pool for large levels.
+    //
+    // world = parent world * translate(position) * rotate(rotation) * scale(scale)
+    //
+    // Transforms are identified by address. A temporary whose address was already used in the frame
+    // with other inputs gets a node of its own, valid until the next resolve.
+    class OpenGLTransformCache {
+    public:
+        static constexpr uint32 noNode = UINT32_MAX;
+
+        OpenGLTransformCache() = default;
+        ~OpenGLTransformCache();
+
+        OpenGLTransformCache(const OpenGLTransformCache&) = delete;
+        OpenGLTransformCache& operator=(const OpenGLTransformCache&) = delete;
+
+        struct Statistics {
+            uint32 nodes    = 0; // cached between frames
+            uint32 added    = 0; // add calls before the last resolve
+            uint32 computed = 0; // world matrices computed by the last resolve
+            uint32 levels   = 0; // depth of the deepest computed node + 1
+        };
+
+        // returns the node of the transform, its world matrix is known after the next resolve
+        uint32 add(const Transform* transform);
+
+        // computes every changed world matrix added since the last resolve and starts a new frame
+        void resolve();
+
+        const glm::mat4& getWorld(uint32 node) const { return worlds[node]; }
+
+        // threads used by resolve including the calling one, only levels of a few thousand nodes are split,
+        // the workers are started once and wait between frames
+        void setThreadCount(uint32 count);
+
+        Statistics getStatistics() const { return statistics; }
+
+    private:
+        struct Node {
+            const Transform* transform = nullptr; // nullptr for nodes of one frame only
+            uint32 parent = noNode;
+            uint32 depth  = 0;
+            uint64 parentVersion = 0;
+            uint64 version       = 0; // changes every time the world matrix is computed
+            uint64 frame         = 0; // last frame the node was added in
+
+            glm::vec3 position{0.f};
+            glm::vec4 rotation{0.f, 0.f, 0.f, 1.f}; // quaternion x, y, z, w
+            glm::vec3 scale   {1.f};
+        };
+
+        uint32 update  (const Transform* transform, uint32 parent, bool& temporary);
+        uint32 allocate();
+
+        static bool sameInputs(const Node& node, const Transform& transform);
+
+        Vector<Node>      nodes;
+        Vector<glm::mat4> worlds;
+        Vector<uint32>    freeNodes;
+        Vector<uint32>    temporaryNodes;
+
+        UnorderedMap<const Transform*, uint32> lookup;
+
+        // changed nodes of the frame by depth
+        Vector<Vector<uint32>> levels;
+
+        Vector<const Transform*> chain;
+
+        uint64 frame       = 1;
+        uint64 nextVersion = 1;
+        uint32 threadCount = 1;
+        uint32 added       = 0;
+
+        OpenGLWorkerPool* workers = nullptr; // started by the first resolve that splits a level
+
+        Statistics statistics;
+    };
+}
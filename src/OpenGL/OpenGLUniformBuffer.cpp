@@ -3,6 +3,7 @@
 #include <glad/glad.h>
 
 #include "OpenGLUniformBuffer.h"
+#include "OpenGLMemory.h"
 
 namespace PetrolEngine{
     OpenGLUniformBuffer::OpenGLUniformBuffer(uint32_t size, uint32_t binding) {
@@ -12,9 +13,12 @@ namespace PetrolEngine{
         glCreateBuffers(1, &this->ID);
         glNamedBufferData(this->ID, size, nullptr, GL_DYNAMIC_DRAW); // TODO: investigate usage hint
         glBindBufferBase(GL_UNIFORM_BUFFER, binding, this->ID);
+
+        OpenGLMemory::track(OpenGLMemory::Category::UniformBuffer, GL_BUFFER, this->ID, size, "Uniform buffer " + toString(binding));
     }
 
     OpenGLUniformBuffer::~OpenGLUniformBuffer() {
+        OpenGLMemory::untrack(GL_BUFFER, this->ID);
         glDeleteBuffers(1, &this->ID);
     }
 
@@ -3,6 +3,8 @@
 #include <glad/glad.h>
 
 #include "OpenGLVertexArray.h"
+#include "OpenGLIndexBuffer.h"
+#include "OpenGLMemory.h"
 
 namespace PetrolEngine {
 	static GLenum ShaderDataTypeToOpenGLBaseType(ShaderDataType type) {
@@ -23,111 +25,266 @@ namespace PetrolEngine {
         }
 	}
 
+	UnorderedMap<String, OpenGLVertexArray::VertexFormat> OpenGLVertexArray::formats;
+	uint32 OpenGLVertexArray::boundVertexArray = 0;
+	bool   OpenGLVertexArray::bindingKnown     = false;
+
+	uint32 OpenGLVertexArray::objectIndexBuffer   = 0;
+	uint32 OpenGLVertexArray::objectIndexCapacity = 0;
+
 	OpenGLVertexArray::OpenGLVertexArray() { LOG_FUNCTION();
-		glGenVertexArrays(1, &ID);
 	}
 
-	void OpenGLVertexArray::setIndexBuffer(IndexBuffer*& indexBuffer) { LOG_FUNCTION();
-		glBindVertexArray(this->ID);
+	OpenGLVertexArray::VertexFormat* OpenGLVertexArray::acquireFormat(const Vector<VertexBuffer*>& vertexBuffers, String& key) { LOG_FUNCTION();
+		// element types of all buffers, None separates buffers
+		Vector<ShaderDataType> signature;
+
+		for (auto& vertexBuffer : vertexBuffers) {
+			for (auto& element : vertexBuffer->getLayout().getElements()) signature.push_back(element.type);
+			signature.push_back(ShaderDataType::None);
+		}
+
+		key.assign((const char*) signature.data(), signature.size() * sizeof(ShaderDataType));
+
+		auto entry = formats.find(key);
+
+		if (entry != formats.end()) {
+			entry->second.references++;
+			return &entry->second;
+		}
+
+		VertexFormat& format = formats[key];
+		format.references = 1;
+		format.signature  = signature;
+
+		glCreateVertexArrays(1, &format.vao);
+
+		if (objectIndexBuffer == 0) {
+			glCreateBuffers(1, &objectIndexBuffer);
+			reserveObjectIndices(1024);
+		}
+
+		// a divisor no instance count reaches, every instance of a draw reads the entry at its base instance
+		glEnableVertexArrayAttrib  (format.vao, objectIndexLocation);
+		glVertexArrayAttribIFormat (format.vao, objectIndexLocation, 1, GL_UNSIGNED_INT, 0);
+		glVertexArrayAttribBinding (format.vao, objectIndexLocation, objectIndexBinding);
+		glVertexArrayBindingDivisor(format.vao, objectIndexBinding, 0xFFFFFFFF);
+		glVertexArrayVertexBuffer  (format.vao, objectIndexBinding, objectIndexBuffer, 0, sizeof(uint32));
+
+		uint32 index = 0;
+		for (uint32 buffer = 0; buffer < vertexBuffers.size(); buffer++) {
+			auto& elements = vertexBuffers[buffer]->getLayout().getElements();
+
+			uint32 stride = 0;
+			for (auto& element : elements) stride += ShaderDataTypeSize(element.type);
+
+			uint32 vertexBinding   = buffer * 2;
+			uint32 instanceBinding = buffer * 2 + 1;
+			bool   instanced       = false;
+
+			uint32 offset = 0;
+			for (auto& element : elements) {
+				switch (auto& type = element.type)
+				{
+				    case ShaderDataType::None: LOG("None type element detected in vertex array.", 2); break;
+				    case ShaderDataType::Mat3:
+				    case ShaderDataType::Mat4: {
+				    	int count = GetComponentCount(type);
+
+				    	for (uint i = 0; i < count; i++)
+				    	{
+				    		glEnableVertexArrayAttrib (format.vao, index);
+				    		glVertexArrayAttribFormat (format.vao, index, count, ShaderDataTypeToOpenGLBaseType(type), GL_FALSE, offset + sizeof(float) * (uint)count * i);
+				    		glVertexArrayAttribBinding(format.vao, index, instanceBinding);
+				    		index++;
+				    	}
+
+				    	instanced = true;
+				    	offset   += ShaderDataTypeSize(type);
+				    	continue;
+				    }
+				    case ShaderDataType::Float :
+				    case ShaderDataType::Float2:
+				    case ShaderDataType::Float3:
+				    case ShaderDataType::Float4: {
+				    	glEnableVertexArrayAttrib (format.vao, index);
+				    	glVertexArrayAttribFormat (format.vao, index, GetComponentCount(type), ShaderDataTypeToOpenGLBaseType(type), GL_FALSE, offset);
+				    	glVertexArrayAttribBinding(format.vao, index, vertexBinding);
+
+				    	offset += ShaderDataTypeSize(type);
+				    	index++;
+				    	continue;
+				    }
+				    case ShaderDataType::Int :
+				    case ShaderDataType::Int2:
+				    case ShaderDataType::Int3:
+				    case ShaderDataType::Int4:
+				    case ShaderDataType::Bool: {
+				    	glEnableVertexArrayAttrib (format.vao, index);
+				    	glVertexArrayAttribIFormat(format.vao, index, GetComponentCount(type), ShaderDataTypeToOpenGLBaseType(type), offset);
+				    	glVertexArrayAttribBinding(format.vao, index, vertexBinding);
+
+				    	offset += ShaderDataTypeSize(type);
+				    	index++;
+				    	continue;
+				    }
+				}
+			}
+
+			if (instanced) glVertexArrayBindingDivisor(format.vao, instanceBinding, 1);
+
+			format.strides      .push_back(stride);
+			format.instanced    .push_back(instanced);
+			format.vertexBuffers.push_back(0);
+		}
+
+		return &format;
+	}
+
+	void OpenGLVertexArray::releaseFormat(const String& key) { LOG_FUNCTION();
+		auto entry = formats.find(key);
+
+		if (entry == formats.end() || --entry->second.references > 0) return;
+
+		if (bindingKnown && boundVertexArray == entry->second.vao) unbind();
+
+		glDeleteVertexArrays(1, &entry->second.vao);
+		formats.erase(entry);
+
+		if (!formats.empty()) return;
+
+		OpenGLMemory::untrack(GL_BUFFER, objectIndexBuffer);
+		glDeleteBuffers(1, &objectIndexBuffer);
+
+		objectIndexBuffer   = 0;
+		objectIndexCapacity = 0;
+	}
+
+	void OpenGLVertexArray::reserveObjectIndices(uint32 count) {
+		// before the first vertex array there is nothing reading them
+		if (objectIndexBuffer == 0 || count <= objectIndexCapacity) return;
+
+		bool tracked = objectIndexCapacity != 0;
+
+		objectIndexCapacity = objectIndexCapacity ? objectIndexCapacity : 1024;
+		while (objectIndexCapacity < count) objectIndexCapacity *= 2;
+
+		Vector<uint32> indices(objectIndexCapacity);
+		for (uint32 i = 0; i < objectIndexCapacity; i++) indices[i] = i;
+
+		// the name stays, vertex arrays keep reading it
+		glNamedBufferData(objectIndexBuffer, (GLsizeiptr) (indices.size() * sizeof(uint32)), indices.data(), GL_STATIC_DRAW);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer->getID());
+		int64 bytes = (int64) indices.size() * sizeof(uint32);
+
+		if (tracked) OpenGLMemory::resize(GL_BUFFER, objectIndexBuffer, bytes);
+		else         OpenGLMemory::track (OpenGLMemory::Category::VertexBuffer, GL_BUFFER, objectIndexBuffer, bytes, "Object indices");
+	}
+
+	void OpenGLVertexArray::detachBuffers() {
+		if (format == nullptr) return;
+
+		// names of deleted buffers can be reused, the shared vertex array must not look like it still has them
+		for (uint32 buffer = 0; buffer < vertexBuffers.size() && buffer < format->vertexBuffers.size(); buffer++)
+			if (format->vertexBuffers[buffer] == vertexBuffers[buffer]->getID()) format->vertexBuffers[buffer] = 0;
+
+		if (indexBuffer && format->indexBuffer == indexBuffer->getID()) format->indexBuffer = 0;
+	}
+
+	void OpenGLVertexArray::setIndexBuffer(IndexBuffer*& indexBuffer) { LOG_FUNCTION();
+		detachBuffers();
+		delete this->indexBuffer;
 
 		this->indexBuffer = indexBuffer;
         indexBuffer = nullptr;
-        glBindVertexArray(0);
+
+		// vertex arrays without vertex buffers (vertices pulled in the shader) share the empty format
+		if (format == nullptr) {
+			format = acquireFormat(this->vertexBuffers, formatKey);
+			ID     = format->vao;
+		}
 	}
 
 	void OpenGLVertexArray::addVertexBuffer(VertexBuffer*& vertexBuffer) { LOG_FUNCTION();
-		glBindVertexArray(this->ID);
-        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer->getID());
-
-        auto vertexLayout = vertexBuffer->getLayout();
-		
-		int layoutSize = 0;
-		for (auto& element : vertexLayout.getElements()) layoutSize += ShaderDataTypeSize(element.type);
-		
-		uint64 offset = 0;
-		uint32 index  = 0;
-		for ( auto& element : vertexLayout.getElements() ) {
-			switch (auto& type = element.type)
-			{
-			    case ShaderDataType::None: LOG("None type element detected in vertex array.", 2); break;
-			    case ShaderDataType::Mat3:
-			    case ShaderDataType::Mat4: {
-			    	int count = GetComponentCount(type);
-
-			    	for (uint i = 0; i < count; i++)
-			    	{
-			    		glEnableVertexAttribArray(index);
-
-			    		glVertexAttribPointer(
-			    			index,
-			    			count,
-			    			ShaderDataTypeToOpenGLBaseType(type),
-			    			GL_FALSE,
-			    			layoutSize,
-			    			(void*)(offset + (sizeof(float) * (uint)count * i))
-			    		);
-
-			    		glVertexAttribDivisor(index, 1);
-			    		index++;
-			    	}
-
-			    	offset += ShaderDataTypeSize(type);
-			    	continue;
-			    }
-			    case ShaderDataType::Float :
-			    case ShaderDataType::Float2:
-			    case ShaderDataType::Float3:
-			    case ShaderDataType::Float4: {
-			    	glEnableVertexAttribArray(index);
-
-			    	glVertexAttribPointer(
-			    		index,
-			    		GetComponentCount(type),
-			    		ShaderDataTypeToOpenGLBaseType(type),
-			    		GL_FALSE,
-			    		layoutSize,
-			    		(void*)offset
-			    	);
-
-			    	offset += ShaderDataTypeSize(type);
-			    	index++;
-			    	continue;
-			    }
-			    case ShaderDataType::Int :
-			    case ShaderDataType::Int2:
-			    case ShaderDataType::Int3:
-			    case ShaderDataType::Int4:
-			    case ShaderDataType::Bool: {
-			    	glEnableVertexAttribArray(index);
-
-			    	glVertexAttribIPointer(
-			    		index,
-			    		GetComponentCount(type),
-			    		ShaderDataTypeToOpenGLBaseType(type),
-			    		layoutSize,
-			    		(void*)offset
-			    	);
-
-			    	offset += ShaderDataTypeSize(type);
-			    	index++;
-			    	continue;
-			    }
-			}
+		// layout combination changes, move to the matching shared vertex array
+		if (format) {
+			detachBuffers();
+			releaseFormat(formatKey);
 		}
 
 		this->vertexBuffers.push_back(vertexBuffer);
         vertexBuffer = nullptr;
-        glBindVertexArray(0);
+
+		format = acquireFormat(this->vertexBuffers, formatKey);
+		ID     = format->vao;
+	}
+
+	void OpenGLVertexArray::bind() const {
+		if (format == nullptr) { LOG("Binding vertex array without vertex buffers.", 2); return; }
+
+		for (uint32 buffer = 0; buffer < vertexBuffers.size(); buffer++) {
+			uint32 id = vertexBuffers[buffer]->getID();
+
+			if (format->vertexBuffers[buffer] == id) continue;
+
+			glVertexArrayVertexBuffer(format->vao, buffer * 2, id, 0, (int) format->strides[buffer]);
+
+			if (format->instanced[buffer])
+				glVertexArrayVertexBuffer(format->vao, buffer * 2 + 1, id, 0, (int) format->strides[buffer]);
+
+			format->vertexBuffers[buffer] = id;
+		}
+
+		uint32 indexBufferID = indexBuffer ? indexBuffer->getID() : 0;
+
+		if (format->indexBuffer != indexBufferID) {
+			glVertexArrayElementBuffer(format->vao, indexBufferID);
+			format->indexBuffer = indexBufferID;
+		}
+
+		bind(format->vao);
+	}
+
+	void OpenGLVertexArray::unbind() {
+		bind(0);
+	}
+
+	void OpenGLVertexArray::bind(uint32 vertexArray) {
+		if (bindingKnown && boundVertexArray == vertexArray) return;
+
+		glBindVertexArray(vertexArray);
+		boundVertexArray = vertexArray;
+		bindingKnown     = true;
+	}
+
+	void OpenGLVertexArray::invalidateBinding() {
+		bindingKnown = false;
+	}
+
+	uint32 OpenGLVertexArray::getVertexFormatCount() {
+		return (uint32) formats.size();
+	}
+
+	void OpenGLVertexArray::generateLods(const Vector<uint32>& indices, const Vector<uint8>& vertices, const VertexLayout& layout, uint32 maxLevels) { LOG_FUNCTION();
+		if (indexBuffer == nullptr) { LOG("Generating lods of vertex array without index buffer.", 2); return; }
+
+		Vector<uint32> chain = OpenGLMeshOptimizer::generateLodChain(indices, vertices, layout, lods, maxLevels);
+
+		// reordering on upload would mix triangles of different levels
+		static_cast<OpenGLIndexBuffer*>(indexBuffer)->setData(chain.data(), (int64) (chain.size() * sizeof(uint32)), false);
+
+		LOG("Generated " + toString(lods.size()) + " lod levels.", 1);
 	}
 
 	OpenGLVertexArray::~OpenGLVertexArray() { LOG_FUNCTION();
+		if (format) {
+			detachBuffers();
+			releaseFormat(formatKey);
+		}
+
         for(auto& vertexBuffer : vertexBuffers)
             delete vertexBuffer;
 
         delete indexBuffer;
-
-		glDeleteBuffers(1, &ID);
 	}
 }
\ No newline at end of file
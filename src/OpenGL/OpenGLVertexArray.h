@@ -1,8 +1,13 @@
 #pragma once
 
 #include "Core/Renderer/VertexArray.h"
+#include "OpenGLMeshOptimizer.h"
+
+#include <glm/glm.hpp>
 
 namespace PetrolEngine {
+	// Vertex arrays with the same layouts share one GL vertex array object (see VertexFormat).
+	// Attribute formats are set up once per layout, meshes only swap their buffers in at bind time.
 	class OpenGLVertexArray : public VertexArray {
 	public:
 		OpenGLVertexArray();
@@ -10,6 +15,82 @@ namespace PetrolEngine {
 		void addVertexBuffer(VertexBuffer*& vertexBuffer) override;
 		void  setIndexBuffer(IndexBuffer *&  indexBuffer) override;
 
+		// binds the shared vertex array object with buffers of this mesh
+		void bind() const;
+		static void unbind();
+
+		// every vertex array bind goes through here (or bind/unbind) so the bound one is known
+		static void bind(uint32 vertexArray);
+		// for code outside the backend that may have bound its own, the next bind always reaches GL
+		static void invalidateBinding();
+
+		// number of vertex array objects alive, one per distinct layout combination
+		static uint32 getVertexFormatCount();
+
+		// Every vertex array also reads the index of the draw's object, from a buffer of 0, 1, 2...
+		// offset by the draw's base instance, so shaders find their object without gl_BaseInstance
+		// (GLSL 4.60 or ARB_shader_draw_parameters):
+		//
+		// layout(location = 15) in uint objectIndex;
+		//
+		// Meshes can use the other locations and the bindings below it.
+		static constexpr uint32 objectIndexLocation = 15;
+		static constexpr uint32 objectIndexBinding  = 15;
+
+		// grows the index buffer to at least count objects
+		static void reserveObjectIndices(uint32 count);
+
+		// local space bounding box, meshes without bounds are never culled
+		void setBounds(const glm::vec3& min, const glm::vec3& max) { boundsMin = min; boundsMax = max; bounded = true; }
+
+		bool             hasBounds   () const { return bounded;   }
+		const glm::vec3& getBoundsMin() const { return boundsMin; }
+		const glm::vec3& getBoundsMax() const { return boundsMax; }
+
+		// simplifies the mesh and replaces the index buffer with the whole chain, level 0 is the full mesh
+		void generateLods(const Vector<uint32>& indices, const Vector<uint8>& vertices, const VertexLayout& layout, uint32 maxLevels = 5);
+		// for chains baked offline, ranges have to be in the current index buffer
+		void setLods(const Vector<LodLevel>& levels) { lods = levels; }
+
+		const Vector<LodLevel>& getLods() const { return lods; }
+
 		~OpenGLVertexArray() override;
+
+	private:
+		// every vertex buffer i uses binding 2i, matrices (per instance attributes) binding 2i + 1
+		struct VertexFormat {
+			uint32                 vao        = 0;
+			uint32                 references = 0;
+			Vector<ShaderDataType> signature;
+			Vector<uint32>         strides;
+			Vector<bool  >         instanced;
+
+			// buffers currently attached, only changed ones are swapped
+			Vector<uint32>         vertexBuffers;
+			uint32                 indexBuffer = 0;
+		};
+
+		// keyed by the signature itself, its bytes
+		static UnorderedMap<String, VertexFormat> formats;
+		static uint32 boundVertexArray;
+		static bool   bindingKnown;
+
+		// lives while any format does
+		static uint32 objectIndexBuffer;
+		static uint32 objectIndexCapacity;
+
+		static VertexFormat* acquireFormat(const Vector<VertexBuffer*>& vertexBuffers, String& key);
+		static void          releaseFormat(const String& key);
+
+		void detachBuffers();
+
+		VertexFormat* format    = nullptr;
+		String        formatKey;
+
+		glm::vec3 boundsMin{0.f};
+		glm::vec3 boundsMax{0.f};
+		bool      bounded = false;
+
+		Vector<LodLevel> lods;
 	};
-}
\ No newline at end of file
+}
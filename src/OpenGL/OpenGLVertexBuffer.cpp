@@ -3,33 +3,38 @@
 #include <glad/glad.h>
 
 #include "OpenGLVertexBuffer.h"
+#include "OpenGLMemory.h"
+#include "OpenGLTracer.h"
 
 namespace PetrolEngine {
-	OpenGLVertexBuffer::OpenGLVertexBuffer(VertexLayout layout, const void* data, int64 size): VertexBuffer(layout) { LOG_FUNCTION();
+	OpenGLVertexBuffer::OpenGLVertexBuffer(VertexLayout layout, const void* data, int64 size): VertexBuffer(layout) { TRACE_FUNCTION();
 		this->layout = layout;
 		
-		glGenBuffers(1, &ID);
+		glCreateBuffers(1, &ID);
 
-		glBindBuffer(GL_ARRAY_BUFFER, ID);
+		glNamedBufferData(ID, size, data, GL_DYNAMIC_DRAW); //GL_STATIC_DRAW
 
-		glBufferData(GL_ARRAY_BUFFER, size, data, GL_DYNAMIC_DRAW); //GL_STATIC_DRAW
+		OpenGLMemory::track(OpenGLMemory::Category::VertexBuffer, GL_BUFFER, ID, size, "Vertex buffer");
 	}
 
 	OpenGLVertexBuffer::OpenGLVertexBuffer(VertexLayout layout): VertexBuffer(layout) { LOG_FUNCTION();
 		this->layout = layout;
 
-		glGenBuffers(1, &ID);
+		glCreateBuffers(1, &ID);
+
+		OpenGLMemory::track(OpenGLMemory::Category::VertexBuffer, GL_BUFFER, ID, 0, "Vertex buffer");
 	}
 
 	void OpenGLVertexBuffer::setData(const void* data, int64 size) {
-		LOG_FUNCTION();
+		TRACE_FUNCTION();
 
-		glBindBuffer(GL_ARRAY_BUFFER, ID);
+		glNamedBufferData(ID, size, data, GL_DYNAMIC_DRAW);
 
-		glBufferData(GL_ARRAY_BUFFER, size, data, GL_DYNAMIC_DRAW);
+		OpenGLMemory::resize(GL_BUFFER, ID, size);
 	}
 
 	OpenGLVertexBuffer::~OpenGLVertexBuffer() { LOG_FUNCTION();
+		OpenGLMemory::untrack(GL_BUFFER, ID);
 		glDeleteBuffers(1, &ID);
 	}
 }
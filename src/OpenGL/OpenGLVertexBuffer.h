@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Core/Renderer/VertexBuffer.h"
+#include "OpenGLVertexLayout.h"
 
 namespace PetrolEngine {
 	class OpenGLVertexBuffer : public VertexBuffer {
@@ -8,8 +9,22 @@ namespace PetrolEngine {
 		OpenGLVertexBuffer(VertexLayout layout);
 		OpenGLVertexBuffer(VertexLayout layout, const void* data, int64 size);
 
+		// typed vertices, layout is derived from the vertex struct (see OpenGLVertexLayout.h)
+		template<typename Vertex>
+		OpenGLVertexBuffer(const Vertex* vertices, int64 count): OpenGLVertexBuffer(vertexLayoutOf<Vertex>(), vertices, count * (int64) sizeof(Vertex)) {}
+
+		template<typename Vertex>
+		explicit OpenGLVertexBuffer(const Vector<Vertex>& vertices): OpenGLVertexBuffer(vertices.data(), (int64) vertices.size()) {}
+
 		virtual void setData(const void* data, int64 size) override;
 
+		// vertices have to be of the struct the buffer's layout was derived from
+		template<typename Vertex>
+		void setVertices(const Vertex* vertices, int64 count) { setData(vertices, count * (int64) sizeof(Vertex)); }
+
+		template<typename Vertex>
+		void setVertices(const Vector<Vertex>& vertices) { setVertices(vertices.data(), (int64) vertices.size()); }
+
 		~OpenGLVertexBuffer() override;
 
 		const VertexLayout& getVertexLayout() { return layout; }
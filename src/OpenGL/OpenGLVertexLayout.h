@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Core/Aliases.h>
+#include <Core/Renderer/VertexBuffer.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+
+// Compile time vertex layouts.
+// A vertex struct lists its attributes once and gets the VertexLayout (and so the
+// vertex array attribute setup) derived from it, vertices are then written as plain structs:
+//
+//     struct QuadVertex {
+//         glm::vec3 position;
+//         glm::vec2 texCoords;
+//
+//         static constexpr auto attributes() {
+//             return std::array{
+//                 VERTEX_ATTRIBUTE(QuadVertex, position ),
+//                 VERTEX_ATTRIBUTE(QuadVertex, texCoords)
+//             };
+//         }
+//     };
+//
+//     auto* buffer = new OpenGLVertexBuffer(quadVertices); // Vector<QuadVertex>
+//
+// Attributes have to be listed in declaration order and the struct has to be tightly packed,
+// offsets used by the vertex arrays are sums of attribute sizes.
+#define VERTEX_ATTRIBUTE(Vertex, member) \
+    PetrolEngine::VertexAttribute{ #member, PetrolEngine::ShaderDataTypeOf<decltype(Vertex::member)>::value, (uint32) offsetof(Vertex, member), (uint32) sizeof(Vertex::member) }
+
+namespace PetrolEngine {
+    template<typename T> struct ShaderDataTypeOf;
+
+    template<> struct ShaderDataTypeOf<float     > { static constexpr ShaderDataType value = ShaderDataType::Float ; };
+    template<> struct ShaderDataTypeOf<glm::vec2 > { static constexpr ShaderDataType value = ShaderDataType::Float2; };
+    template<> struct ShaderDataTypeOf<glm::vec3 > { static constexpr ShaderDataType value = ShaderDataType::Float3; };
+    template<> struct ShaderDataTypeOf<glm::vec4 > { static constexpr ShaderDataType value = ShaderDataType::Float4; };
+    template<> struct ShaderDataTypeOf<glm::mat3 > { static constexpr ShaderDataType value = ShaderDataType::Mat3  ; };
+    template<> struct ShaderDataTypeOf<glm::mat4 > { static constexpr ShaderDataType value = ShaderDataType::Mat4  ; };
+    template<> struct ShaderDataTypeOf<int32     > { static constexpr ShaderDataType value = ShaderDataType::Int   ; };
+    template<> struct ShaderDataTypeOf<glm::ivec2> { static constexpr ShaderDataType value = ShaderDataType::Int2  ; };
+    template<> struct ShaderDataTypeOf<glm::ivec3> { static constexpr ShaderDataType value = ShaderDataType::Int3  ; };
+    template<> struct ShaderDataTypeOf<glm::ivec4> { static constexpr ShaderDataType value = ShaderDataType::Int4  ; };
+
+    struct VertexAttribute {
+        const char*    name;
+        ShaderDataType type;
+        uint32         offset;
+        uint32         size;
+    };
+
+    namespace Detail {
+        template<typename Vertex>
+        constexpr bool isPacked() {
+            uint32 offset = 0;
+
+            for (auto& attribute : Vertex::attributes()) {
+                if (attribute.offset != offset) return false;
+                offset += attribute.size;
+            }
+
+            return offset == sizeof(Vertex);
+        }
+    }
+
+    template<typename Vertex>
+    VertexLayout vertexLayoutOf() {
+        static_assert(Detail::isPacked<Vertex>(), "Vertex attributes have to be listed in order and cover the whole struct without padding.");
+
+        Vector<VertexElement> elements;
+
+        for (auto& attribute : Vertex::attributes()) elements.push_back({ attribute.name, attribute.type });
+
+        return VertexLayout(elements);
+    }
+}
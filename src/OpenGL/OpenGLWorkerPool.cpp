@@ -0,0 +1,76 @@
+#include <PCH.h>
+
+#include "OpenGLWorkerPool.h"
+
+namespace PetrolEngine {
+    OpenGLWorkerPool::OpenGLWorkerPool(uint32 threadCount) {
+        for (uint32 i = 1; i < threadCount; i++) workers.emplace_back(&OpenGLWorkerPool::loop, this);
+    }
+
+    OpenGLWorkerPool::~OpenGLWorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        for (auto& worker : workers) worker.join();
+    }
+
+    void OpenGLWorkerPool::runParts() {
+        for (uint32 part = nextPart.fetch_add(1); part < parts; part = nextPart.fetch_add(1)) (*job)(part);
+    }
+
+    void OpenGLWorkerPool::run(uint32 parts, const std::function<void(uint32)>& work) {
+        if (workers.empty() || parts <= 1) {
+            for (uint32 part = 0; part < parts; part++) work(part);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            this->job   = &work;
+            this->parts = parts;
+            finished    = 0;
+            nextPart    = 0;
+
+            generation++;
+        }
+
+        wake.notify_all();
+
+        runParts();
+
+        // every worker has to be out of the job before it goes out of scope
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return finished == workers.size(); });
+
+        job = nullptr;
+    }
+
+    void OpenGLWorkerPool::loop() {
+        uint64 seen = 0;
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+
+                if (stopping) return;
+
+                seen = generation;
+            }
+
+            runParts();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished++;
+            }
+
+            done.notify_one();
+        }
+    }
+}
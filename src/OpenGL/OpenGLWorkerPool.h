@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Core/Aliases.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace PetrolEngine {
+    // Threads that live as long as the pool and wait for work, so splitting work every frame does
+    // not create and join threads every frame.
+    //
+    // run hands the parts of one job to the workers and the calling thread, parts are taken in order
+    // by whichever thread is free, and returns once every part is done. One job at a time, run is
+    // called from one thread.
+    class OpenGLWorkerPool {
+    public:
+        // threads including the calling one, so threadCount - 1 workers are started
+        explicit OpenGLWorkerPool(uint32 threadCount);
+        ~OpenGLWorkerPool();
+
+        OpenGLWorkerPool(const OpenGLWorkerPool&) = delete;
+        OpenGLWorkerPool& operator=(const OpenGLWorkerPool&) = delete;
+
+        uint32 getThreadCount() const { return (uint32) workers.size() + 1; }
+
+        // work is called with every part index in [0, parts)
+        void run(uint32 parts, const std::function<void(uint32)>& work);
+
+    private:
+        void loop();
+        void runParts();
+
+        Vector<std::thread> workers;
+
+        std::mutex              mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+
+        // the job, changed under the mutex while no worker is in it
+        const std::function<void(uint32)>* job = nullptr;
+        uint32 parts      = 0;
+        uint64 generation = 0;
+        uint32 finished   = 0; // workers done with the current generation
+        bool   stopping   = false;
+
+        std::atomic<uint32> nextPart{0};
+    };
+}